@@ -0,0 +1,10 @@
+rem Build for the 2-axis robots (SandTableScara, GeistBot and XYBot) - motion blocks and ISR loops are sized for 2 axes
+echo #define RBOT_NUM_AXES 2 > src\RBotBuildAxes.h
+call particle compile photon --target 0.7.0-rc.7
+del src\RBotBuildAxes.h
+for %%x in (*.bin) do (
+        call particle flash --usb %%x
+        goto breakout
+    )
+:breakout
+for %%x in (*.bin) do del %%x
@@ -26,14 +26,29 @@ public:
   AxisFloats _maxAccStepsPerTTicksPerMs;
   float _cacheLastTickRatePerSec;
 
+private:
+  // Kinematics owned by the robot - set up from these parameters when the robot is initialised
+  // and found from here by the robot's (static) transforms
+  void* _pRobotKinematics;
 
 public:
 
   AxesParams()
   {
+    _pRobotKinematics = NULL;
     clearAxes();
   }
 
+  void setRobotKinematics(void* pRobotKinematics)
+  {
+    _pRobotKinematics = pRobotKinematics;
+  }
+
+  void* getRobotKinematics()
+  {
+    return _pRobotKinematics;
+  }
+
   void clearAxes()
   {
     _masterAxisIdx            = -1;
@@ -101,6 +116,16 @@ public:
     return true;
   }
 
+  bool getMinVal(int axisIdx, float& minVal)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES)
+      return false;
+    if (!_axisParams[axisIdx]._minValValid)
+      return false;
+    minVal = _axisParams[axisIdx]._minVal;
+    return true;
+  }
+
   float getAxisMaxRange(int axisIdx)
   {
     if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES)
@@ -172,11 +197,28 @@ public:
     return _axisParams[axisIdx]._isPrimaryAxis;
   }
 
+  // Home sensor resync settings - returns false if the axis doesn't resync
+  bool getHomeSync(int axisIdx, int32_t& syncSteps, int& syncDirn, int32_t& maxSteps, int32_t& wrapSteps)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES)
+      return false;
+    AxisParams& axisParams = _axisParams[axisIdx];
+    if (!axisParams._homeSyncValid)
+      return false;
+    syncSteps = axisParams._homeSyncSteps;
+    syncDirn  = axisParams._homeSyncDirn;
+    maxSteps  = axisParams._homeSyncMaxSteps;
+    wrapSteps = axisParams._homeSyncRot ? int32_t(axisParams._stepsPerRot) : 0;
+    return true;
+  }
+
   bool ptInBounds(AxisFloats& pt, bool correctValueInPlace)
   {
     bool wasValid = true;
+    // Every axis is checked (and corrected) even once one is out of bounds
     for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-      wasValid = wasValid && _axisParams[axisIdx].ptInBounds(pt._pt[axisIdx], correctValueInPlace);
+      if (!_axisParams[axisIdx].ptInBounds(pt._pt[axisIdx], correctValueInPlace))
+        wasValid = false;
     return wasValid;
   }
 
@@ -199,12 +241,37 @@ public:
     setMasterAxis(axisIdx);
 
     // Cache axis max and min step rates
+    cacheStepRates();
+    return true;
+  }
+
+  // Change the max acceleration of an axis at runtime (e.g. M201)
+  void setMaxAccel(int axisIdx, float maxAccMMps2)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES || maxAccMMps2 <= 0)
+      return;
+    _axisParams[axisIdx]._maxAccelMMps2 = maxAccMMps2;
+    if (_masterAxisIdx >= 0)
+      _masterAxisMaxAccMMps2 = getMaxAccel(_masterAxisIdx);
+    _cacheLastTickRatePerSec = 0;
+  }
+
+  // Change the max speed of an axis at runtime (e.g. M203)
+  void setMaxSpeed(int axisIdx, float maxSpeedMMps)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES || maxSpeedMMps <= 0)
+      return;
+    _axisParams[axisIdx]._maxSpeedMMps = maxSpeedMMps;
+    cacheStepRates();
+  }
+
+  void cacheStepRates()
+  {
     for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
     {
       _maxStepRatesPerSec.setVal(axisIdx, getMaxSpeed(axisIdx) / getStepDistMM(axisIdx));
       _minStepRatesPerSec.setVal(axisIdx, getMinSpeed(axisIdx) / getStepDistMM(axisIdx));
     }
-    return true;
   }
 
   // Set the master axis either to the dominant axis (if there is one)
@@ -0,0 +1,45 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include "RobotConsts.h"
+
+// A batch of points held as a structure-of-arrays (one contiguous array per axis) so that a
+// transform over the whole batch is a set of simple loops which the compiler can vectorise
+class AxisFloatsBatch
+{
+public:
+  static constexpr int MAX_POINTS = 16;
+
+  float _vals[RobotConsts::MAX_AXES][MAX_POINTS];
+  // Set by a transform to indicate whether each point could be converted
+  bool _ok[MAX_POINTS];
+  // Number of points in the batch
+  int _count;
+
+public:
+  AxisFloatsBatch()
+  {
+    clear();
+  }
+  void clear()
+  {
+    _count = 0;
+  }
+  inline float* axisVals(int axisIdx)
+  {
+    return _vals[axisIdx];
+  }
+  // Points are passed as arrays of MAX_AXES values (e.g. AxisFloats::_pt)
+  inline void setPoint(int ptIdx, const float pt[])
+  {
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      _vals[axisIdx][ptIdx] = pt[axisIdx];
+  }
+  inline void getPoint(int ptIdx, float pt[])
+  {
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      pt[axisIdx] = _vals[axisIdx][ptIdx];
+  }
+};
@@ -15,6 +15,7 @@ public:
   static constexpr float homeOffsetVal_default    = 0.0f;
   static constexpr long homeOffSteps_default   = 0;
   static constexpr float minSpeedMMps_default     = 0.0f;
+  static constexpr long homeSyncMaxSteps_default = 20;
 
   // Parameters
   float _maxSpeedMMps;
@@ -32,6 +33,14 @@ public:
   bool _isServoAxis;
   float _homeOffsetVal;
   long _homeOffSteps;
+  // Resync of the step count when the home sensor (endStop0) becomes active during normal motion
+  // _homeSyncSteps is the step count at which the edge is expected when moving in _homeSyncDirn
+  // and _homeSyncRot indicates the count is compared modulo stepsPerRot (continuous rotation)
+  bool _homeSyncValid;
+  long _homeSyncSteps;
+  int _homeSyncDirn;
+  long _homeSyncMaxSteps;
+  bool _homeSyncRot;
 
 public:
   AxisParams()
@@ -55,6 +64,11 @@ public:
     _isServoAxis      = false;
     _homeOffsetVal    = homeOffsetVal_default;
     _homeOffSteps  = homeOffSteps_default;
+    _homeSyncValid    = false;
+    _homeSyncSteps    = 0;
+    _homeSyncDirn     = 1;
+    _homeSyncMaxSteps = homeSyncMaxSteps_default;
+    _homeSyncRot      = false;
   }
 
   float stepsPerUnit()
@@ -96,6 +110,10 @@ public:
     _isServoAxis      = RdJson::getLong("isServoAxis", 0, axisJSON) != 0;
     _homeOffsetVal    = float(RdJson::getDouble("homeOffsetVal", 0, axisJSON));
     _homeOffSteps  = RdJson::getLong("homeOffSteps", 0, axisJSON);
+    _homeSyncSteps    = RdJson::getLong("homeSyncSteps", 0, _homeSyncValid, axisJSON);
+    _homeSyncDirn     = RdJson::getLong("homeSyncDirn", 1, axisJSON) >= 0 ? 1 : -1;
+    _homeSyncMaxSteps = RdJson::getLong("homeSyncMaxSteps", AxisParams::homeSyncMaxSteps_default, axisJSON);
+    _homeSyncRot      = RdJson::getLong("homeSyncRot", 0, axisJSON) != 0;
   }
 
   void debugLog(int axisIdx)
@@ -104,5 +122,8 @@ public:
              axisIdx, _maxSpeedMMps, _maxAccelMMps2, _stepsPerRot, _unitsPerRot);
     Log.info("Axis%d params minVal %02.f (%d), maxVal %0.2f (%d), isDominant %d, isServo %d, homeOffVal %0.2f, homeOffSteps %ld",
              axisIdx, _minVal, _minValValid, _maxVal, _maxValValid, _isDominantAxis, _isServoAxis, _homeOffsetVal, _homeOffSteps);
+    if (_homeSyncValid)
+      Log.info("Axis%d params homeSyncSteps %ld, dirn %d, maxSteps %ld, rot %d",
+               axisIdx, _homeSyncSteps, _homeSyncDirn, _homeSyncMaxSteps, _homeSyncRot);
   }
 };
@@ -25,26 +25,18 @@ public:
   }
   AxisFloats(float x, float y)
   {
-    _pt[0]         = x;
-    _pt[1]         = y;
-    _pt[2]         = 0;
-    _validityFlags = 0x03;
+    setXYZ(x, y, 0, 0x03);
   }
   AxisFloats(float x, float y, float z)
   {
-    _pt[0]         = x;
-    _pt[1]         = y;
-    _pt[2]         = z;
-    _validityFlags = 0x07;
+    setXYZ(x, y, z, 0x07);
   }
   AxisFloats(float x, float y, float z, bool xValid, bool yValid, bool zValid)
   {
-    _pt[0]          = x;
-    _pt[1]          = y;
-    _pt[2]          = z;
-    _validityFlags  = xValid ? 0x01 : 0;
-    _validityFlags |= yValid ? 0x02 : 0;
-    _validityFlags |= zValid ? 0x04 : 0;
+    uint8_t validityFlags  = xValid ? 0x01 : 0;
+    validityFlags         |= yValid ? 0x02 : 0;
+    validityFlags         |= zValid ? 0x04 : 0;
+    setXYZ(x, y, z, validityFlags);
   }
   void clear()
   {
@@ -73,10 +65,7 @@ public:
   }
   void set(float val0, float val1, float val2 = 0)
   {
-    _pt[0]         = val0;
-    _pt[1]         = val1;
-    _pt[2]         = val2;
-    _validityFlags = 0x07;
+    setXYZ(val0, val1, val2, 0x07);
   }
   void setValid(int axisIdx, bool isValid)
   {
@@ -122,12 +111,11 @@ public:
   }
   float Z()
   {
-    return _pt[2];
+    return getVal(2);
   }
   void Z(float val)
   {
-    _pt[2]          = val;
-    _validityFlags |= 0x04;
+    setVal(2, val);
   }
   AxisFloats& operator=(const AxisFloats& other)
   {
@@ -218,7 +206,7 @@ public:
   }
   void logDebugStr(const char* prefixStr)
   {
-    Log.trace("%s X %0.2f Y %0.2f Z %0.2f", prefixStr, _pt[0], _pt[1], _pt[2]);
+    Log.trace("%s X %0.2f Y %0.2f Z %0.2f", prefixStr, _pt[0], _pt[1], getVal(2));
   }
   String toJSON()
   {
@@ -232,6 +220,16 @@ public:
     jsonStr += "]";
     return jsonStr;
   }
+
+private:
+  // Set the first three axes - values for axes which aren't present in this build are ignored
+  void setXYZ(float x, float y, float z, uint8_t validityFlags)
+  {
+    const float xyz[] = { x, y, z };
+    for (int i = 0; i < RobotConsts::MAX_AXES; i++)
+      _pt[i] = (i < 3) ? xyz[i] : 0;
+    _validityFlags = validityFlags & ((1 << RobotConsts::MAX_AXES) - 1);
+  }
 };
 
 class AxisValidBools
@@ -313,6 +311,10 @@ public:
   static constexpr int BITS_PER_VAL = 2;
   static constexpr int BITS_PER_VAL_MASK = 0x03;
 
+  // All axes must pack below the valid bit
+  static_assert(RobotConsts::MAX_AXES * VALS_PER_AXIS * BITS_PER_VAL < MIN_MAX_VALID_BIT - 1,
+                "AxisMinMaxBools too small for RBOT_NUM_AXES");
+
   enum AxisMinMaxEnum {
     END_STOP_NONE = 0,
     END_STOP_HIT = 1,
@@ -423,9 +425,7 @@ public:
   }
   AxisInt32s(int32_t xVal, int32_t yVal, int32_t zVal)
   {
-    vals[0] = xVal;
-    vals[1] = yVal;
-    vals[2] = zVal;
+    set(xVal, yVal, zVal);
   }
   void clear()
   {
@@ -434,9 +434,10 @@ public:
   }
   void set(int32_t val0, int32_t val1, int32_t val2 = 0)
   {
-    vals[0] = val0;
-    vals[1] = val1;
-    vals[2] = val2;
+    // Values for axes which aren't present in this build are ignored
+    const int32_t xyz[] = { val0, val1, val2 };
+    for (int i = 0; i < RobotConsts::MAX_AXES; i++)
+      vals[i] = (i < 3) ? xyz[i] : 0;
   }
   int32_t X()
   {
@@ -448,7 +449,7 @@ public:
   }
   int32_t Z()
   {
-    return vals[2];
+    return getVal(2);
   }
   int32_t getVal(int axisIdx)
   {
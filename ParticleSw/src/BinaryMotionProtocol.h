@@ -0,0 +1,283 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "RobotConsts.h"
+
+// A move decoded from (or to be encoded into) a binary frame
+// Axis values are micrometres (0.001mm) for MOVE_MM records or steps for MOVE_STEPS records and
+// the feedrate is in 0.001 units per second - with FLAG_INT16 the values must fit in an int16
+struct BinaryMotionCmd
+{
+    uint8_t _recordType;
+    uint8_t _flags;
+    uint8_t _axisMask;
+    int32_t _axisVals[RobotConsts::MAX_AXES];
+    int32_t _feedrate;
+
+    BinaryMotionCmd()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        _recordType = 0;
+        _flags = 0;
+        _axisMask = 0;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            _axisVals[axisIdx] = 0;
+        _feedrate = 0;
+    }
+
+    bool isAxisValid(int axisIdx) const
+    {
+        return (_axisMask & (1 << axisIdx)) != 0;
+    }
+
+    void setAxis(int axisIdx, int32_t val)
+    {
+        _axisVals[axisIdx] = val;
+        _axisMask |= 1 << axisIdx;
+    }
+};
+
+// Compact binary motion protocol - an alternative to G-code text for dense streams of moves
+// which needs no text parsing on the device
+// Frame:   0xA5, payload length (1 byte), payload, CRC16-CCITT of length and payload (LE)
+// Payload: one or more records each of
+//          record type (1 = MOVE_MM, 2 = MOVE_STEPS), flags, axis mask (bit per axis), move count,
+//          then for each move a value per axis in the mask and a feedrate if FLAG_FEEDRATE
+//          Values are int32 LE (or int16 LE with FLAG_INT16 - e.g. short relative moves)
+// Consecutive moves with the same type, flags and axes share a record so a dense stream of short
+// relative XY moves takes about 4 bytes a move
+// Frames can be sent on the serial port between text lines (the start byte isn't valid in text)
+// and each frame is acknowledged like a line - or one or more frames can be POSTed to the
+// binmove API
+class BinaryMotionProtocol
+{
+public:
+    static const uint8_t FRAME_START = 0xA5;
+    static const unsigned int FRAME_OVERHEAD = 4;
+    static const unsigned int MAX_PAYLOAD_LEN = 255;
+    static const unsigned int MAX_FRAME_LEN = MAX_PAYLOAD_LEN + FRAME_OVERHEAD;
+    static const unsigned int RECORD_HDR_LEN = 4;
+
+    enum RecordType
+    {
+        RECORD_MOVE_MM = 1,
+        RECORD_MOVE_STEPS = 2
+    };
+
+    enum MoveFlags
+    {
+        FLAG_RELATIVE = 0x01,
+        FLAG_RAPID = 0x02,
+        FLAG_FEEDRATE = 0x04,
+        FLAG_ENDSTOPS_ALL = 0x08,
+        FLAG_INT16 = 0x10
+    };
+
+    enum FrameResult
+    {
+        FRAME_OK,
+        FRAME_INCOMPLETE,
+        FRAME_BAD_START,
+        FRAME_BAD_CRC
+    };
+
+    // Position when reading moves from a payload
+    struct ReadPos
+    {
+        unsigned int _pos;
+        unsigned int _movesLeft;
+        uint8_t _recordType;
+        uint8_t _flags;
+        uint8_t _axisMask;
+        ReadPos()
+        {
+            _pos = 0;
+            _movesLeft = 0;
+            _recordType = 0;
+            _flags = 0;
+            _axisMask = 0;
+        }
+    };
+
+    static uint16_t crc16(const uint8_t* pData, unsigned int len)
+    {
+        uint16_t crc = 0xffff;
+        for (unsigned int i = 0; i < len; i++)
+        {
+            crc ^= (uint16_t)pData[i] << 8;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    // Length of the values of a move (not including the record header)
+    static unsigned int getMoveLen(uint8_t flags, uint8_t axisMask)
+    {
+        unsigned int valLen = (flags & FLAG_INT16) ? 2 : 4;
+        unsigned int len = 0;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            if (axisMask & (1 << axisIdx))
+                len += valLen;
+        if (flags & FLAG_FEEDRATE)
+            len += valLen;
+        return len;
+    }
+
+    // Encode as many of the moves as fit into a frame - returns the frame length (0 if none fit)
+    // and sets numEncoded
+    static unsigned int encodeFrame(const BinaryMotionCmd* pCmds, unsigned int numCmds,
+                    uint8_t* pFrame, unsigned int maxFrameLen, unsigned int& numEncoded)
+    {
+        numEncoded = 0;
+        if (maxFrameLen < FRAME_OVERHEAD)
+            return 0;
+        unsigned int maxPayloadLen = maxFrameLen - FRAME_OVERHEAD;
+        if (maxPayloadLen > MAX_PAYLOAD_LEN)
+            maxPayloadLen = MAX_PAYLOAD_LEN;
+        uint8_t* pPayload = pFrame + 2;
+        unsigned int payloadLen = 0;
+        uint8_t* pRecordCount = NULL;
+        while (numEncoded < numCmds)
+        {
+            const BinaryMotionCmd& cmd = pCmds[numEncoded];
+            unsigned int moveLen = getMoveLen(cmd._flags, cmd._axisMask);
+            // Start a new record unless the move can share the current one
+            const BinaryMotionCmd* pPrev = (numEncoded > 0) ? &pCmds[numEncoded - 1] : NULL;
+            bool newRecord = !pRecordCount || (*pRecordCount == 0xff) ||
+                        (pPrev->_recordType != cmd._recordType) || (pPrev->_flags != cmd._flags) ||
+                        (pPrev->_axisMask != cmd._axisMask);
+            if (payloadLen + moveLen + (newRecord ? RECORD_HDR_LEN : 0) > maxPayloadLen)
+                break;
+            if (newRecord)
+            {
+                pPayload[payloadLen++] = cmd._recordType;
+                pPayload[payloadLen++] = cmd._flags;
+                pPayload[payloadLen++] = cmd._axisMask;
+                pRecordCount = &pPayload[payloadLen++];
+                *pRecordCount = 0;
+            }
+            uint8_t* pOut = pPayload + payloadLen;
+            for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+                if (cmd.isAxisValid(axisIdx))
+                    setVal(pOut, cmd._axisVals[axisIdx], cmd._flags);
+            if (cmd._flags & FLAG_FEEDRATE)
+                setVal(pOut, cmd._feedrate, cmd._flags);
+            payloadLen += moveLen;
+            (*pRecordCount)++;
+            numEncoded++;
+        }
+        if (numEncoded == 0)
+            return 0;
+        pFrame[0] = FRAME_START;
+        pFrame[1] = (uint8_t)payloadLen;
+        uint16_t crc = crc16(pFrame + 1, payloadLen + 1);
+        pFrame[payloadLen + 2] = (uint8_t)(crc & 0xff);
+        pFrame[payloadLen + 3] = (uint8_t)(crc >> 8);
+        return payloadLen + FRAME_OVERHEAD;
+    }
+
+    // Check for a complete frame at the start of the data - frameLen is set when the frame
+    // length is known (i.e. for FRAME_OK, FRAME_BAD_CRC and FRAME_INCOMPLETE after the length)
+    static FrameResult checkFrame(const uint8_t* pData, unsigned int dataLen, unsigned int& frameLen)
+    {
+        frameLen = 0;
+        if (dataLen < 1)
+            return FRAME_INCOMPLETE;
+        if (pData[0] != FRAME_START)
+            return FRAME_BAD_START;
+        if (dataLen < 2)
+            return FRAME_INCOMPLETE;
+        frameLen = pData[1] + FRAME_OVERHEAD;
+        if (dataLen < frameLen)
+            return FRAME_INCOMPLETE;
+        uint16_t crc = (uint16_t)pData[frameLen - 2] | ((uint16_t)pData[frameLen - 1] << 8);
+        if (crc != crc16(pData + 1, frameLen - 3))
+            return FRAME_BAD_CRC;
+        return FRAME_OK;
+    }
+
+    // Payload of a checked frame
+    static const uint8_t* getPayload(const uint8_t* pFrame, unsigned int& payloadLen)
+    {
+        payloadLen = pFrame[1];
+        return pFrame + 2;
+    }
+
+    // Get the next move from a payload - readPos is advanced - returns false at the end of the
+    // payload or if a record is invalid (readPos._pos is then not at the end of the payload)
+    static bool getMove(const uint8_t* pPayload, unsigned int payloadLen, ReadPos& readPos, BinaryMotionCmd& cmd)
+    {
+        cmd.clear();
+        // Next record
+        if (readPos._movesLeft == 0)
+        {
+            if (readPos._pos + RECORD_HDR_LEN > payloadLen)
+                return false;
+            const uint8_t* pHdr = pPayload + readPos._pos;
+            if ((pHdr[0] != RECORD_MOVE_MM) && (pHdr[0] != RECORD_MOVE_STEPS))
+                return false;
+            if (((pHdr[2] >> RobotConsts::MAX_AXES) != 0) || (pHdr[3] == 0))
+                return false;
+            readPos._recordType = pHdr[0];
+            readPos._flags = pHdr[1];
+            readPos._axisMask = pHdr[2];
+            readPos._movesLeft = pHdr[3];
+            readPos._pos += RECORD_HDR_LEN;
+        }
+        // Move
+        if (readPos._pos + getMoveLen(readPos._flags, readPos._axisMask) > payloadLen)
+            return false;
+        cmd._recordType = readPos._recordType;
+        cmd._flags = readPos._flags;
+        cmd._axisMask = readPos._axisMask;
+        const uint8_t* pIn = pPayload + readPos._pos;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            if (cmd.isAxisValid(axisIdx))
+                cmd._axisVals[axisIdx] = getVal(pIn, cmd._flags);
+        if (cmd._flags & FLAG_FEEDRATE)
+            cmd._feedrate = getVal(pIn, cmd._flags);
+        readPos._pos = pIn - pPayload;
+        readPos._movesLeft--;
+        return true;
+    }
+
+    // Check a payload is made of complete valid records
+    static bool isPayloadComplete(unsigned int payloadLen, const ReadPos& readPos)
+    {
+        return (readPos._pos == payloadLen) && (readPos._movesLeft == 0);
+    }
+
+private:
+    static void setVal(uint8_t*& p, int32_t val, uint8_t flags)
+    {
+        uint32_t uVal = (uint32_t)val;
+        *p++ = uVal & 0xff;
+        *p++ = (uVal >> 8) & 0xff;
+        if (flags & FLAG_INT16)
+            return;
+        *p++ = (uVal >> 16) & 0xff;
+        *p++ = (uVal >> 24) & 0xff;
+    }
+
+    static int32_t getVal(const uint8_t*& p, uint8_t flags)
+    {
+        if (flags & FLAG_INT16)
+        {
+            int16_t val = (int16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+            p += 2;
+            return val;
+        }
+        uint32_t uVal = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+        return (int32_t)uVal;
+    }
+};
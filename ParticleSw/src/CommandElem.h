@@ -3,27 +3,225 @@
 
 #pragma once
 
-#include "RdJson.h"
-#include "RobotController.h"
+#include "RobotCommandArgs.h"
 
+// A command taken from the CommandQueue - this is a view of the command's record in the queue's
+// arena so nothing is copied or allocated
+// The view is only valid until the next command is taken from the queue or the queue is cleared
+// Records are either text (e.g. pattern and sequence names) or G/M codes which were parsed when
+// they were added - a parsed record holds the command letter and number, the values set in the
+// RobotCommandArgs and an optional payload of argument text (null-terminated)
+// Record layout (after the type byte)
+//    text:   command text
+//    G/M:    uint16 cmdNum, uint16 flags, float per valid axis (int32 if in steps), float feedrate,
+//            float extrude, uint32 endstops, payload (only the values flagged are present)
 class CommandElem
 {
+public:
+    enum RecordType
+    {
+        RECORD_TEXT = 'T',
+        RECORD_GCODE = 'G',
+        RECORD_MCODE = 'M'
+    };
+
+    // Max length of the header of a parsed record
+    static constexpr unsigned int MAX_PARSED_HDR_LEN = 1 + 2 + 2 + 4 * (RobotConsts::MAX_AXES + 2) + 4;
+
 private:
-    String _cmdStr;
+    const char* _pRecord;
+    unsigned int _recordLen;
+
+    static constexpr unsigned int FLAG_FEEDRATE = 0x0100;
+    static constexpr unsigned int FLAG_EXTRUDE  = 0x0200;
+    static constexpr unsigned int FLAG_ENDSTOPS = 0x0400;
+    static constexpr unsigned int FLAG_STEPS    = 0x0800;
+    static constexpr unsigned int FLAG_RELATIVE = 0x1000;
+    static constexpr unsigned int FLAG_ABSOLUTE = 0x2000;
 
 public:
     CommandElem()
     {
-        _cmdStr = "";
+        _pRecord = "";
+        _recordLen = 0;
+    }
+
+    CommandElem(const char* pRecord, unsigned int recordLen)
+    {
+        _pRecord = pRecord;
+        _recordLen = recordLen;
+    }
+
+    RecordType getType() const
+    {
+        if (_recordLen == 0)
+            return RECORD_TEXT;
+        return (RecordType)_pRecord[0];
+    }
+
+    bool isText() const
+    {
+        return getType() == RECORD_TEXT;
+    }
+
+    // Text of a text record (or the payload of a parsed record)
+    const char* c_str() const
+    {
+        if (_recordLen == 0)
+            return "";
+        if (isText())
+            return _pRecord + 1;
+        return _pRecord + getParsedHdrLen();
+    }
+
+    unsigned int length() const
+    {
+        if (_recordLen == 0)
+            return 0;
+        if (isText())
+            return _recordLen - 1;
+        return _recordLen - getParsedHdrLen();
+    }
+
+    // Command number of a parsed record
+    int getCmdNum() const
+    {
+        if (isText())
+            return -1;
+        return getUint16(_pRecord + 1);
+    }
+
+    // Get the args of a parsed record
+    void getArgs(RobotCommandArgs& cmdArgs) const
+    {
+        cmdArgs.clear();
+        if (isText())
+            return;
+        unsigned int flags = getUint16(_pRecord + 3);
+        const char* pVal = _pRecord + 5;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            if (!(flags & (1 << axisIdx)))
+                continue;
+            if (flags & FLAG_STEPS)
+                cmdArgs.setAxisSteps(axisIdx, getInt32(pVal), true);
+            else
+                cmdArgs.setAxisValMM(axisIdx, getFloat(pVal), true);
+        }
+        if (flags & FLAG_RELATIVE)
+            cmdArgs.setMoveType(RobotMoveTypeArg_Relative);
+        else if (flags & FLAG_ABSOLUTE)
+            cmdArgs.setMoveType(RobotMoveTypeArg_Absolute);
+        if (flags & FLAG_FEEDRATE)
+            cmdArgs.setFeedrate(getFloat(pVal));
+        if (flags & FLAG_EXTRUDE)
+            cmdArgs.setExtrude(getFloat(pVal));
+        if (flags & FLAG_ENDSTOPS)
+        {
+            AxisMinMaxBools endstops;
+            memcpy(&endstops._uint, pVal, sizeof(endstops._uint));
+            cmdArgs.setEndStops(endstops);
+        }
+    }
+
+    // Write the header of a parsed record - returns the length
+    static unsigned int setParsedHdr(char* pHdr, RecordType recordType, int cmdNum, RobotCommandArgs& cmdArgs)
+    {
+        unsigned int flags = 0;
+        char* pVal = pHdr + 5;
+        if (cmdArgs.isStepwise())
+            flags |= FLAG_STEPS;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            if (cmdArgs.isValid(axisIdx))
+            {
+                flags |= 1 << axisIdx;
+                if (cmdArgs.isStepwise())
+                    setInt32(pVal, cmdArgs.getPointSteps().getVal(axisIdx));
+                else
+                    setFloat(pVal, cmdArgs.getValMM(axisIdx));
+            }
+        }
+        if (cmdArgs.getMoveType() == RobotMoveTypeArg_Relative)
+            flags |= FLAG_RELATIVE;
+        else if (cmdArgs.getMoveType() == RobotMoveTypeArg_Absolute)
+            flags |= FLAG_ABSOLUTE;
+        if (cmdArgs.isFeedrateValid())
+        {
+            flags |= FLAG_FEEDRATE;
+            setFloat(pVal, cmdArgs.getFeedrate());
+        }
+        if (cmdArgs.isExtrudeValid())
+        {
+            flags |= FLAG_EXTRUDE;
+            setFloat(pVal, cmdArgs.getExtrude());
+        }
+        if (cmdArgs.getEndstopCheck().uintVal() != 0)
+        {
+            flags |= FLAG_ENDSTOPS;
+            memcpy(pVal, &cmdArgs.getEndstopCheck()._uint, sizeof(uint32_t));
+            pVal += sizeof(uint32_t);
+        }
+        pHdr[0] = (char)recordType;
+        setUint16(pHdr + 1, cmdNum);
+        setUint16(pHdr + 3, flags);
+        return pVal - pHdr;
+    }
+
+private:
+    unsigned int getParsedHdrLen() const
+    {
+        unsigned int flags = getUint16(_pRecord + 3);
+        unsigned int hdrLen = 5;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            if (flags & (1 << axisIdx))
+                hdrLen += sizeof(float);
+        if (flags & FLAG_FEEDRATE)
+            hdrLen += sizeof(float);
+        if (flags & FLAG_EXTRUDE)
+            hdrLen += sizeof(float);
+        if (flags & FLAG_ENDSTOPS)
+            hdrLen += sizeof(uint32_t);
+        return hdrLen;
+    }
+
+    static unsigned int getUint16(const char* p)
+    {
+        return (unsigned int)(uint8_t)p[0] | ((unsigned int)(uint8_t)p[1] << 8);
+    }
+
+    static void setUint16(char* p, unsigned int val)
+    {
+        p[0] = char(val & 0xff);
+        p[1] = char((val >> 8) & 0xff);
+    }
+
+    // Values are unaligned in the record so are copied
+    static float getFloat(const char*& p)
+    {
+        float val = 0;
+        memcpy(&val, p, sizeof(float));
+        p += sizeof(float);
+        return val;
+    }
+
+    static void setFloat(char*& p, float val)
+    {
+        memcpy(p, &val, sizeof(float));
+        p += sizeof(float);
     }
 
-    CommandElem(const char* pCmdStr)
+    static int32_t getInt32(const char*& p)
     {
-        _cmdStr = pCmdStr;
+        int32_t val = 0;
+        memcpy(&val, p, sizeof(int32_t));
+        p += sizeof(int32_t);
+        return val;
     }
 
-    String getString()
+    static void setInt32(char*& p, int32_t val)
     {
-        return _cmdStr;
+        memcpy(p, &val, sizeof(int32_t));
+        p += sizeof(int32_t);
     }
 };
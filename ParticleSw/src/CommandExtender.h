@@ -27,6 +27,13 @@ public:
     void setPatterns(const char* configStr)
     {
         _patternEvaluator.setConfig(configStr);
+        _validatePatternEvaluator.setConfig(configStr);
+    }
+
+    // Patterns for checking a job before it is run
+    JobValidatorPatternSource* getValidatePatternSource()
+    {
+        return &_validatePatternEvaluator;
     }
 
     const char* getPatterns()
@@ -73,5 +80,6 @@ private:
     static constexpr int MAX_PATTERN_GENERATORS = 2;
     CommandInterpreter* _pCommandInterpreter;
     PatternEvaluator _patternEvaluator;
+    PatternEvaluator _validatePatternEvaluator;
     CommandSequencer _commandSequencer;
 };
@@ -6,12 +6,14 @@
 #include "CommandExtender.h"
 #include "RobotController.h"
 #include "GCodeInterpreter.h"
+#include "BinaryMotionProtocol.h"
 
 CommandInterpreter::CommandInterpreter(WorkflowManager* pWorkflowManager, RobotController* pRobotController)
 {
     _pWorkflowManager = pWorkflowManager;
     _pRobotController = pRobotController;
     _pCommandExtender = new CommandExtender(this);
+    _pJobStore = NULL;
 }
 
 void CommandInterpreter::setSequences(const char* configStr)
@@ -40,6 +42,11 @@ const char* CommandInterpreter::getPatterns()
     return _pCommandExtender->getPatterns();
 }
 
+JobValidatorPatternSource* CommandInterpreter::getValidatePatternSource()
+{
+    return _pCommandExtender->getValidatePatternSource();
+}
+
 bool CommandInterpreter::canAcceptCommand()
 {
     if (_pWorkflowManager)
@@ -47,6 +54,27 @@ bool CommandInterpreter::canAcceptCommand()
     return false;
 }
 
+// Check there is space in the queue for all of the commands in a line (semicolon delimited) -
+// each is allowed the most it could take (as text or parsed) - tooLarge is set if the line could
+// never be queued
+bool CommandInterpreter::canAcceptLine(const char* pLine, unsigned int lineLen, bool& tooLarge)
+{
+    tooLarge = false;
+    if (!_pWorkflowManager)
+        return false;
+    unsigned int queuedBytes = 0;
+    const char* pLineEnd = pLine + lineLen;
+    for (const char* pCmd = pLine; pCmd < pLineEnd; )
+    {
+        const char* pCmdEnd = (const char*)memchr(pCmd, ';', pLineEnd - pCmd);
+        if (!pCmdEnd)
+            pCmdEnd = pLineEnd;
+        queuedBytes += CommandRingBuffer::getRecordLen(CommandElem::MAX_PARSED_HDR_LEN + (pCmdEnd - pCmd));
+        pCmd = pCmdEnd + 1;
+    }
+    return _pWorkflowManager->canAddBytes(queuedBytes, tooLarge);
+}
+
 bool CommandInterpreter::queueIsEmpty()
 {
     if (_pWorkflowManager)
@@ -54,39 +82,99 @@ bool CommandInterpreter::queueIsEmpty()
     return false;
 }
 
-bool CommandInterpreter::setWifi(const char* pCmdStr)
+// Check if a command is acted on immediately rather than queued (so it can be processed even
+// when the queue is full)
+bool CommandInterpreter::isImmediateCommand(const char* pCmdStr, unsigned int cmdLen)
+{
+    return cmdMatches(pCmdStr, cmdLen, "pause") || cmdMatches(pCmdStr, cmdLen, "resume") ||
+                cmdMatches(pCmdStr, cmdLen, "stop");
+}
+
+// Check if a command (not null-terminated) is the given name (case-insensitive)
+bool CommandInterpreter::cmdMatches(const char* pCmdStr, unsigned int cmdLen, const char* pCmdName)
+{
+    return (strlen(pCmdName) == cmdLen) && (strncasecmp(pCmdStr, pCmdName, cmdLen) == 0);
+}
+
+// Check if a command (not null-terminated) starts with the given name
+bool CommandInterpreter::cmdStartsWith(const char* pCmdStr, unsigned int cmdLen, const char* pCmdName)
+{
+    unsigned int nameLen = strlen(pCmdName);
+    return (nameLen <= cmdLen) && (strncmp(pCmdStr, pCmdName, nameLen) == 0);
+}
+
+bool CommandInterpreter::setWifi(const char* pCmdStr, unsigned int cmdLen)
 {
+    // Args are copied to fixed buffers as the command isn't null-terminated
+    static const unsigned int MAX_SSID_LEN = 32;
+    static const unsigned int MAX_PWORD_LEN = 64;
+    char ssidStr[MAX_SSID_LEN + 1];
+    char pwordStr[MAX_PWORD_LEN + 1];
+    const char* pCmdEnd = pCmdStr + cmdLen;
     // Get args
-    const char* pArgsPos = strstr(pCmdStr, " ");
+    const char* pArgsPos = (const char*)memchr(pCmdStr, ' ', cmdLen);
     if (pArgsPos == 0)
         return false;
     // SSID
     const char* pSSIDPos = pArgsPos + 1;
-    pArgsPos = strstr(pSSIDPos, " ");
+    pArgsPos = (const char*)memchr(pSSIDPos, ' ', pCmdEnd - pSSIDPos);
     if (pArgsPos == 0)
         return false;
-    int stLen = pArgsPos - pSSIDPos;
-    char* pSsidStr = new char[stLen + 1];
-    for (int i = 0; i < stLen; i++)
-        pSsidStr[i] = pSSIDPos[i];
-    pSsidStr[stLen] = 0;
+    unsigned int stLen = pArgsPos - pSSIDPos;
+    if (stLen > MAX_SSID_LEN)
+        return false;
+    memcpy(ssidStr, pSSIDPos, stLen);
+    ssidStr[stLen] = 0;
     // password
     const char* pPword = pArgsPos + 1;
+    stLen = pCmdEnd - pPword;
+    if (stLen > MAX_PWORD_LEN)
+        return false;
+    memcpy(pwordStr, pPword, stLen);
+    pwordStr[stLen] = 0;
     // Set WiFi info
-    WiFi.setCredentials(pSsidStr, pPword);
-    Log.info("CmdInterp: WiFi SSID %s pwLen %d", pSsidStr, strlen(pPword));
-    delete [] pSsidStr;
+    WiFi.setCredentials(ssidStr, pwordStr);
+    Log.info("CmdInterp: WiFi SSID %s pwLen %d", ssidStr, stLen);
     return true;
 }
 
+// Play a job from the job store - the arg is the job name or slot number
+bool CommandInterpreter::runStoredJob(const char* pCmdStr, unsigned int cmdLen)
+{
+    if (!_pJobStore || !_pJobStore->isValid())
+        return false;
+    const char* pArgsPos = (const char*)memchr(pCmdStr, ' ', cmdLen);
+    if (pArgsPos == 0)
+        return false;
+    char nameStr[JobStore::MAX_NAME_LEN + 1];
+    unsigned int stLen = pCmdStr + cmdLen - (pArgsPos + 1);
+    if ((stLen == 0) || (stLen > JobStore::MAX_NAME_LEN))
+        return false;
+    memcpy(nameStr, pArgsPos + 1, stLen);
+    nameStr[stLen] = 0;
+    int slotIdx = _pJobStore->findJob(nameStr);
+    if ((slotIdx < 0) && isdigit(nameStr[0]))
+        slotIdx = atoi(nameStr);
+    if (slotIdx < 0)
+        return false;
+    Log.info("CmdInterp: run stored job %s slot %d", nameStr, slotIdx);
+    return _jobFeeder.startStored(*_pJobStore, slotIdx);
+}
+
 void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
+{
+    processSingle(pCmdStr, strlen(pCmdStr), retStr);
+}
+
+// Process a single command - the command doesn't need to be null-terminated
+void CommandInterpreter::processSingle(const char* pCmdStr, unsigned int cmdLen, String& retStr)
 {
     const char* okRslt = "{\"rslt\":\"ok\"}";
     const char* failRslt = "{\"rslt\":\"fail\"}";
     retStr = "{\"rslt\":\"none\"}";
 
     // Check if this is an immediate command
-    if (strcasecmp(pCmdStr, "pause") == 0)
+    if (cmdMatches(pCmdStr, cmdLen, "pause"))
     {
         if (_pRobotController)
         {
@@ -94,7 +182,7 @@ void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
             retStr = okRslt;
         }
     }
-    else if (strcasecmp(pCmdStr, "resume") == 0)
+    else if (cmdMatches(pCmdStr, cmdLen, "resume"))
     {
         if (_pRobotController)
         {
@@ -102,7 +190,7 @@ void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
             retStr = okRslt;
         }
     }
-    else if (strcasecmp(pCmdStr, "stop") == 0)
+    else if (cmdMatches(pCmdStr, cmdLen, "stop"))
     {
         if (_pRobotController)
             _pRobotController->stop();
@@ -110,16 +198,24 @@ void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
             _pWorkflowManager->clear();
         if (_pCommandExtender)
             _pCommandExtender->stop();
+        _jobFeeder.stop();
         retStr = okRslt;
     }
-    else if (strstr(pCmdStr, "setwifi") == pCmdStr)
+    else if (cmdStartsWith(pCmdStr, cmdLen, "setwifi"))
     {
-        if (setWifi(pCmdStr))
+        if (setWifi(pCmdStr, cmdLen))
             retStr = okRslt;
         else
             retStr = failRslt;
     }
-    else if (strstr(pCmdStr, "clearwifi") == pCmdStr)
+    else if (cmdStartsWith(pCmdStr, cmdLen, "runjob "))
+    {
+        if (runStoredJob(pCmdStr, cmdLen))
+            retStr = okRslt;
+        else
+            retStr = failRslt;
+    }
+    else if (cmdStartsWith(pCmdStr, cmdLen, "clearwifi"))
     {
         WiFi.clearCredentials();
         Log.info("CmdInterp: WiFi Credentials Cleared");
@@ -134,9 +230,9 @@ void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
     else if (_pWorkflowManager)
     {
         // Send the line to the workflow manager
-        if (strlen(pCmdStr) != 0)
+        if (cmdLen != 0)
         {
-            bool rslt = _pWorkflowManager->add(pCmdStr);
+            bool rslt = _pWorkflowManager->add(pCmdStr, cmdLen);
             if (!rslt)
                 retStr = "{\"rslt\":\"busy\"}";
             else
@@ -149,55 +245,134 @@ void CommandInterpreter::processSingle(const char* pCmdStr, String& retStr)
 void CommandInterpreter::process(const char* pCmdStr, String& retStr, int cmdIdx)
 {
     // Handle the case of a single string
-    if (strstr(pCmdStr, ";") == NULL)
+    if (strchr(pCmdStr, ';') == NULL)
     {
         return processSingle(pCmdStr, retStr);
     }
 
-    // Handle multiple commands (semicolon delimited)
+    // Handle multiple commands (semicolon delimited) - each is passed on in place
     /*Log.trace("CmdInterp process %s", pCmdStr);*/
-    const int MAX_TEMP_CMD_STR_LEN = 1000;
+    const unsigned int MAX_CMD_STR_LEN = 1000;
     const char* pCurStr = pCmdStr;
-    const char* pCurStrEnd = pCmdStr;
     int curCmdIdx = 0;
     while (true)
     {
         // Find line end
-        if ((*pCurStrEnd == ';') || (*pCurStrEnd == '\0'))
+        const char* pCurStrEnd = strchr(pCurStr, ';');
+        unsigned int stLen = pCurStrEnd ? pCurStrEnd - pCurStr : strlen(pCurStr);
+        if ((stLen == 0) || (stLen > MAX_CMD_STR_LEN))
+            break;
+
+        // process
+        if (cmdIdx == -1 || cmdIdx == curCmdIdx)
         {
-            // Extract the line
-            int stLen = pCurStrEnd-pCurStr;
-            if ((stLen == 0) || (stLen > MAX_TEMP_CMD_STR_LEN))
-                break;
-
-            // Alloc
-            char* pCurCmd = new char [stLen+1];
-            if (!pCurCmd)
-                break;
-            for (int i = 0; i < stLen; i++)
-                pCurCmd[i] = *pCurStr++;
-            pCurCmd[stLen] = 0;
-
-            // process
-            if (cmdIdx == -1 || cmdIdx == curCmdIdx)
-            {
-                /*Log.trace("cmdProc single %d %s", stLen, pCurCmd);*/
-                processSingle(pCurCmd, retStr);
-            }
-            delete [] pCurCmd;
-
-            // Move on
-            curCmdIdx++;
-            if (*pCurStrEnd == '\0')
-                break;
-            pCurStr = pCurStrEnd + 1;
+            /*Log.trace("cmdProc single %d %.*s", stLen, stLen, pCurStr);*/
+            processSingle(pCurStr, stLen, retStr);
         }
-        pCurStrEnd++;
+
+        // Move on
+        curCmdIdx++;
+        if (!pCurStrEnd)
+            break;
+        pCurStr = pCurStrEnd + 1;
     }
 }
 
+// Process a frame of the binary motion protocol - the frame is only accepted if all of its moves
+// can be queued so returns false (and queues nothing) if busy or the frame is invalid
+bool CommandInterpreter::processBinaryFrame(const uint8_t* pFrame, unsigned int frameLen, String& retStr)
+{
+    unsigned int checkedLen = 0;
+    BinaryMotionProtocol::FrameResult frameResult = BinaryMotionProtocol::checkFrame(pFrame, frameLen, checkedLen);
+    if ((frameResult != BinaryMotionProtocol::FRAME_OK) || (checkedLen != frameLen))
+    {
+        retStr = "{\"rslt\":\"fail\",\"err\":\"frame\"}";
+        return false;
+    }
+
+    // Count and check the moves
+    unsigned int payloadLen = 0;
+    const uint8_t* pPayload = BinaryMotionProtocol::getPayload(pFrame, payloadLen);
+    BinaryMotionCmd binCmd;
+    BinaryMotionProtocol::ReadPos readPos;
+    unsigned int queuedBytes = 0;
+    while (BinaryMotionProtocol::getMove(pPayload, payloadLen, readPos, binCmd))
+        queuedBytes += WorkflowManager::getQueuedBytes(binCmd);
+    if (!BinaryMotionProtocol::isPayloadComplete(payloadLen, readPos))
+    {
+        retStr = "{\"rslt\":\"fail\",\"err\":\"payload\"}";
+        return false;
+    }
+    bool tooLarge = false;
+    if (!_pWorkflowManager || !_pWorkflowManager->canAddBytes(queuedBytes, tooLarge))
+    {
+        if (tooLarge)
+            retStr = "{\"rslt\":\"fail\",\"err\":\"toolarge\"}";
+        else
+            retStr = "{\"rslt\":\"busy\"}";
+        return false;
+    }
+
+    // Queue
+    readPos = BinaryMotionProtocol::ReadPos();
+    while (BinaryMotionProtocol::getMove(pPayload, payloadLen, readPos, binCmd))
+        _pWorkflowManager->add(binCmd);
+    retStr = "{\"rslt\":\"ok\"}";
+    return true;
+}
+
+// Process consecutive binary frames (e.g. an API POST body) - stops at the first frame which can't
+// be accepted and reports the number of frames and bytes accepted so the rest can be resent
+void CommandInterpreter::processBinary(const uint8_t* pData, unsigned int dataLen, String& retStr)
+{
+    unsigned int bytesDone = 0;
+    unsigned int framesDone = 0;
+    String frameRetStr = "{\"rslt\":\"ok\"}";
+    while (bytesDone < dataLen)
+    {
+        unsigned int frameLen = 0;
+        if (BinaryMotionProtocol::checkFrame(pData + bytesDone, dataLen - bytesDone, frameLen) == BinaryMotionProtocol::FRAME_INCOMPLETE)
+        {
+            frameRetStr = "{\"rslt\":\"fail\",\"err\":\"frame\"}";
+            break;
+        }
+        if (frameLen == 0)
+            frameLen = dataLen - bytesDone;
+        if (!processBinaryFrame(pData + bytesDone, frameLen, frameRetStr))
+            break;
+        bytesDone += frameLen;
+        framesDone++;
+    }
+    // Add counts to the result
+    retStr = frameRetStr.substring(0, frameRetStr.length() - 1) +
+                String::format(",\"frames\":%d,\"bytes\":%d}", framesDone, bytesDone);
+    Log.trace("CmdInterp processBinary len %d rslt %s", dataLen, retStr.c_str());
+}
+
 void CommandInterpreter::service()
 {
+    // Feed lines of an uploaded job while there is space in the queue
+    for (int lineIdx = 0; lineIdx < MAX_JOB_LINES_PER_SERVICE; lineIdx++)
+    {
+        if (!_jobFeeder.isRunning() || !canAcceptCommand())
+            break;
+        unsigned int lineLen = 0;
+        const char* pLine = _jobFeeder.peekLine(lineLen);
+        if (!pLine)
+            break;
+        // The line stays in the job buffer until all of its commands can be queued
+        bool tooLarge = false;
+        if (!canAcceptLine(pLine, lineLen, tooLarge))
+        {
+            if (tooLarge)
+                _jobFeeder.fail("toolarge");
+            break;
+        }
+        _jobFeeder.takeLine();
+        String retStr;
+        process(pLine, retStr);
+    }
+
     // Pump the workflow here
     // Check if the RobotController can accept more
     if (_pRobotController->canAcceptCommand())
@@ -206,13 +381,15 @@ void CommandInterpreter::service()
         bool rslt = _pWorkflowManager->get(cmdElem);
         if (rslt)
         {
-            Log.trace("CmdInterp getWorkflow rlst=%d (waiting %d), %s", rslt,
-                            _pWorkflowManager->numWaiting(),
-                            cmdElem.getString().c_str());
+            Log.trace("CmdInterp getWorkflow rlst=%d (waiting %d), type %c num %d %s", rslt,
+                            _pWorkflowManager->numWaiting(), cmdElem.getType(),
+                            cmdElem.getCmdNum(), cmdElem.c_str());
 
-            // Check for extended commands
-            if (_pCommandExtender)
-                rslt = _pCommandExtender->procCommand(cmdElem.getString().c_str());
+            // Check for extended commands (G and M codes are parsed when queued)
+            if (_pCommandExtender && cmdElem.isText())
+                rslt = _pCommandExtender->procCommand(cmdElem.c_str());
+            else
+                rslt = false;
 
             // Check for GCode
             if (!rslt)
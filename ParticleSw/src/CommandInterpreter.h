@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include "JobFeeder.h"
+
 class WorkflowManager;
 class CommandExtender;
+class JobValidatorPatternSource;
 
 // Command interpreter
 class CommandInterpreter
@@ -13,7 +16,13 @@ private:
     WorkflowManager* _pWorkflowManager;
     RobotController* _pRobotController;
     CommandExtender* _pCommandExtender;
-    bool setWifi(const char* pCmdStr);
+    JobFeeder _jobFeeder;
+    JobStore* _pJobStore;
+    static const int MAX_JOB_LINES_PER_SERVICE = 10;
+    bool setWifi(const char* pCmdStr, unsigned int cmdLen);
+    bool runStoredJob(const char* pCmdStr, unsigned int cmdLen);
+    static bool cmdMatches(const char* pCmdStr, unsigned int cmdLen, const char* pCmdName);
+    static bool cmdStartsWith(const char* pCmdStr, unsigned int cmdLen, const char* pCmdName);
 
 public:
     CommandInterpreter(WorkflowManager* pWorkflowManager, RobotController* pRobotController);
@@ -21,9 +30,23 @@ public:
     const char* getSequences();
     void setPatterns(const char* configStr);
     const char* getPatterns();
+    JobValidatorPatternSource* getValidatePatternSource();
     bool canAcceptCommand();
+    bool canAcceptLine(const char* pLine, unsigned int lineLen, bool& tooLarge);
     bool queueIsEmpty();
+    bool isImmediateCommand(const char* pCmdStr, unsigned int cmdLen);
     void processSingle(const char* pCmdStr, String& retStr);
+    void processSingle(const char* pCmdStr, unsigned int cmdLen, String& retStr);
     void process(const char* pCmdStr, String& retStr, int cmdIdx = -1);
+    bool processBinaryFrame(const uint8_t* pFrame, unsigned int frameLen, String& retStr);
+    void processBinary(const uint8_t* pData, unsigned int dataLen, String& retStr);
+    JobFeeder& getJobFeeder()
+    {
+        return _jobFeeder;
+    }
+    void setJobStore(JobStore* pJobStore)
+    {
+        _pJobStore = pJobStore;
+    }
     void service();
 };
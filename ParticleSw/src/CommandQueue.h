@@ -5,20 +5,25 @@
 #define _COMMAND_QUEUE_H_
 
 #include "application.h"
+#include "RdJson.h"
 #include "CommandElem.h"
-#include <queue>
+#include "CommandRingBuffer.h"
 
+// Commands are held in a ring sized in bytes so adding and getting commands doesn't allocate
+// Commands are either text or G/M codes parsed when added and are got as views into the ring
+// (see CommandElem)
 class CommandQueue
 {
 private:
-    std::queue<CommandElem> _cmdElemQueue;
-    unsigned int _cmdQueueMaxLen;
-    static const unsigned int _cmdQueueMaxLenDefault = 50;
+    CommandRingBuffer _cmdRing;
+    static const unsigned int _cmdQueueBytesDefault = 2000;
+    // Queue is considered full when a command of this length wouldn't fit
+    static const unsigned int _cmdQueueFullCmdLen = 100;
 
 public:
-    CommandQueue()
+    CommandQueue() :
+        _cmdRing(_cmdQueueBytesDefault)
     {
-        _cmdQueueMaxLen = _cmdQueueMaxLenDefault;
     }
 
     ~CommandQueue()
@@ -29,81 +34,97 @@ public:
     void init(const char* configStr)
     {
 //        Log.info("Configuring CommandQueue from %s", configStr);
-        _cmdQueueMaxLen = (int) RdJson::getLong("cmdQueueMaxLen",
-                                            _cmdQueueMaxLenDefault, configStr);
-        clear();
-//        Log.info("CmdQueueMaxLen %d", _cmdQueueMaxLen);
+        unsigned int cmdQueueBytes = (unsigned int) RdJson::getLong("cmdQueueBytes",
+                                            _cmdQueueBytesDefault, configStr);
+        if (cmdQueueBytes < CommandRingBuffer::getRecordLen(_cmdQueueFullCmdLen))
+            cmdQueueBytes = CommandRingBuffer::getRecordLen(_cmdQueueFullCmdLen);
+        _cmdRing.init(cmdQueueBytes);
+//        Log.info("CmdQueueBytes %d", cmdQueueBytes);
+
+        // The queue used to be sized by number of commands - that key is no longer used
+        long cmdQueueMaxLen = RdJson::getLong("cmdQueueMaxLen", -1, configStr);
+        if (cmdQueueMaxLen >= 0)
+            Log.warn("CommandQueue cmdQueueMaxLen %ld is ignored - use cmdQueueBytes (now %d bytes)",
+                        cmdQueueMaxLen, cmdQueueBytes);
     }
 
     // Check if queue full
     bool isFull()
     {
-        return (_cmdElemQueue.size() >= _cmdQueueMaxLen);
+        return !_cmdRing.canPut(_cmdQueueFullCmdLen);
+    }
+
+    // Check if records totalling a number of bytes (see CommandRingBuffer::getRecordLen) can be
+    // added - allowing for space lost when wrapping - tooLarge is set if they never could be
+    bool canAddBytes(unsigned int recordBytes, bool& tooLarge)
+    {
+        unsigned int wrapAllowance = CommandRingBuffer::getRecordLen(CommandElem::MAX_PARSED_HDR_LEN);
+        tooLarge = recordBytes + wrapAllowance > _cmdRing.capacityBytes();
+        return _cmdRing.capacityBytes() - _cmdRing.bytesUsed() >= recordBytes + wrapAllowance;
     }
 
     // Check if queue empty
     bool isEmpty()
     {
-        return (_cmdElemQueue.size() == 0);
+        return (_cmdRing.count() == 0);
     }
 
     // Clear the queue
     void clear()
     {
-        // Using technique from here https://stackoverflow.com/questions/709146/how-do-i-clear-the-stdqueue-efficiently
-        std::queue<CommandElem> emptyQ;
-        std::swap( _cmdElemQueue, emptyQ );
+        _cmdRing.clear();
     }
 
-    // Add to queue
+    // Add a text command to the queue
     bool add(const char* pCmdStr)
     {
-        // Check if queue is full
-        if (_cmdElemQueue.size() >= _cmdQueueMaxLen)
-        {
-//            Log.info("Command Queue FULL size %d max %d", _cmdElemQueue.size(), _cmdQueueMaxLen);
-            return false;
-        }
-
-        // Queue up the item
-        _cmdElemQueue.push(CommandElem(pCmdStr));
-        return true;
+        return add(pCmdStr, strlen(pCmdStr));
     }
 
-    // Get from queue
-    bool get(CommandElem& cmdElem)
+    bool add(const char* pCmdStr, unsigned int cmdLen)
     {
-        // Check if queue is empty
-        if (_cmdElemQueue.empty())
-        {
-            return false;
-        }
+        char recordType = CommandElem::RECORD_TEXT;
+        return addRecord(&recordType, 1, pCmdStr, cmdLen);
+    }
 
-        // read the item and remove
-        cmdElem = _cmdElemQueue.front();
-        _cmdElemQueue.pop();
-        return true;
+    // Add a parsed G/M code to the queue with an optional payload
+    bool add(CommandElem::RecordType recordType, int cmdNum, RobotCommandArgs& cmdArgs,
+                    const char* pPayload, unsigned int payloadLen)
+    {
+        char hdr[CommandElem::MAX_PARSED_HDR_LEN];
+        unsigned int hdrLen = CommandElem::setParsedHdr(hdr, recordType, cmdNum, cmdArgs);
+        return addRecord(hdr, hdrLen, pPayload, payloadLen);
     }
 
-    // Get from queue
-    bool get(String& cmdStr)
+    // Get from queue - the command is valid until the next get
+    bool get(CommandElem& cmdElem)
     {
-        // Check if queue is empty
-        if (_cmdElemQueue.empty())
+        const char* pCmdStr = NULL;
+        unsigned int cmdLen = 0;
+        if (!_cmdRing.get(pCmdStr, cmdLen))
         {
             return false;
         }
-
-        // read the item and remove
-        cmdStr = _cmdElemQueue.front().getString();
-        _cmdElemQueue.pop();
+        cmdElem = CommandElem(pCmdStr, cmdLen);
         return true;
     }
 
     // Get size
     int size()
     {
-        return _cmdElemQueue.size();
+        return _cmdRing.count();
+    }
+
+private:
+    bool addRecord(const char* pHdr, unsigned int hdrLen, const char* pStr, unsigned int strLen)
+    {
+        // Check if queue is full
+        if (!_cmdRing.put(pHdr, hdrLen, pStr, strLen))
+        {
+//            Log.info("Command Queue FULL used %d of %d", _cmdRing.bytesUsed(), _cmdRing.capacityBytes());
+            return false;
+        }
+        return true;
     }
 
 };
@@ -0,0 +1,199 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Ring of variable length strings held in a fixed byte arena (allocated by init() only)
+// Each string is a record of a 2 byte length followed by the string bytes and a terminator
+// Records are contiguous - if a record doesn't fit at the end of the arena a wrap marker is left
+// (or there isn't room for one) and the record starts at the beginning of the arena
+// Strings are taken as pointers into the arena and the bytes of a taken string are only
+// released when the next string is taken (or the ring is cleared) so the string remains valid
+// while it is processed - even if processing adds more strings
+class CommandRingBuffer
+{
+private:
+    std::vector<char> _arena;
+    unsigned int _putPos;
+    unsigned int _getPos;
+    // Bytes in use (including any taken record and space skipped at the end of the arena)
+    unsigned int _bytesUsed;
+    // Number of strings waiting (not including any taken record)
+    unsigned int _count;
+    // Length of the record taken by get() but not yet released
+    unsigned int _takenRecordLen;
+    static const unsigned int RECORD_HDR_BYTES = 2;
+    static const unsigned int RECORD_WRAP_MARKER = 0xffff;
+
+public:
+    static const unsigned int MAX_STR_LEN = 0xfffe;
+
+    CommandRingBuffer(unsigned int capacityBytes = 0)
+    {
+        init(capacityBytes);
+    }
+
+    void init(unsigned int capacityBytes)
+    {
+        _arena.resize(capacityBytes);
+        _arena.shrink_to_fit();
+        clear();
+    }
+
+    void clear()
+    {
+        _putPos = 0;
+        _getPos = 0;
+        _bytesUsed = 0;
+        _count = 0;
+        _takenRecordLen = 0;
+    }
+
+    unsigned int count()
+    {
+        return _count;
+    }
+
+    unsigned int bytesUsed()
+    {
+        return _bytesUsed;
+    }
+
+    unsigned int capacityBytes()
+    {
+        return _arena.size();
+    }
+
+    // Bytes needed in the arena for a string of the given length
+    static unsigned int getRecordLen(unsigned int strLen)
+    {
+        return RECORD_HDR_BYTES + strLen + 1;
+    }
+
+    // Check if a string of the given length can be added
+    bool canPut(unsigned int strLen)
+    {
+        unsigned int putPos = 0;
+        return getPutPos(strLen, putPos);
+    }
+
+    // Add a string (which doesn't need to be null-terminated)
+    bool put(const char* pStr, unsigned int strLen)
+    {
+        return put(NULL, 0, pStr, strLen);
+    }
+
+    // Add a string made of a header followed by the string - e.g. a binary header and text
+    bool put(const char* pHdr, unsigned int hdrLen, const char* pStr, unsigned int strLen)
+    {
+        strLen += hdrLen;
+        // Check there is space
+        unsigned int putPos = 0;
+        if (!getPutPos(strLen, putPos))
+            return false;
+
+        // Skip the end of the arena if wrapping
+        if (putPos != _putPos)
+        {
+            unsigned int skipLen = _arena.size() - _putPos;
+            if (skipLen >= RECORD_HDR_BYTES)
+                setRecordHdr(_putPos, RECORD_WRAP_MARKER);
+            _bytesUsed += skipLen;
+        }
+
+        // Write the record
+        setRecordHdr(putPos, strLen);
+        if (hdrLen > 0)
+            memcpy(&_arena[putPos + RECORD_HDR_BYTES], pHdr, hdrLen);
+        memcpy(&_arena[putPos + RECORD_HDR_BYTES + hdrLen], pStr, strLen - hdrLen);
+        _arena[putPos + RECORD_HDR_BYTES + strLen] = 0;
+        unsigned int recordLen = getRecordLen(strLen);
+        _putPos = putPos + recordLen;
+        _bytesUsed += recordLen;
+        _count++;
+        return true;
+    }
+
+    // Take the next string - it is null-terminated and remains valid until the next get() or
+    // clear() - the previously taken string is released
+    bool get(const char*& pStr, unsigned int& strLen)
+    {
+        releaseTaken();
+        if (_count == 0)
+            return false;
+
+        // Skip to the start of the arena if the writer wrapped
+        if ((_arena.size() - _getPos < RECORD_HDR_BYTES) || (getRecordHdr(_getPos) == RECORD_WRAP_MARKER))
+        {
+            _bytesUsed -= _arena.size() - _getPos;
+            _getPos = 0;
+        }
+
+        // Take the string
+        strLen = getRecordHdr(_getPos);
+        pStr = &_arena[_getPos + RECORD_HDR_BYTES];
+        _takenRecordLen = getRecordLen(strLen);
+        _count--;
+        return true;
+    }
+
+private:
+    void setRecordHdr(unsigned int pos, unsigned int val)
+    {
+        _arena[pos] = char(val & 0xff);
+        _arena[pos + 1] = char((val >> 8) & 0xff);
+    }
+
+    unsigned int getRecordHdr(unsigned int pos)
+    {
+        return (unsigned int)(uint8_t)_arena[pos] | ((unsigned int)(uint8_t)_arena[pos + 1] << 8);
+    }
+
+    // Release the record taken by the last get
+    void releaseTaken()
+    {
+        if (_takenRecordLen == 0)
+            return;
+        _getPos += _takenRecordLen;
+        _bytesUsed -= _takenRecordLen;
+        _takenRecordLen = 0;
+        // Start from the beginning again when empty to keep records from wrapping
+        if (_bytesUsed == 0)
+            _putPos = _getPos = 0;
+    }
+
+    // Find where a record for a string of the given length would be written
+    bool getPutPos(unsigned int strLen, unsigned int& putPos)
+    {
+        if (strLen > MAX_STR_LEN)
+            return false;
+        unsigned int recordLen = getRecordLen(strLen);
+        unsigned int arenaSize = _arena.size();
+        if (_bytesUsed == 0)
+        {
+            putPos = 0;
+            return recordLen <= arenaSize;
+        }
+        // Full
+        if (_putPos == _getPos)
+            return false;
+        // Records already wrapped - space is up to the reader
+        if (_putPos < _getPos)
+        {
+            putPos = _putPos;
+            return _getPos - _putPos >= recordLen;
+        }
+        // Space at the end of the arena or else at the start
+        if (arenaSize - _putPos >= recordLen)
+        {
+            putPos = _putPos;
+            return true;
+        }
+        putPos = 0;
+        return _getPos >= recordLen;
+    }
+};
@@ -0,0 +1,108 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A ';' delimited command sequence compiled once into a buffer of null-terminated commands and
+// an array of command offsets - so getting the next command doesn't re-scan the list
+// Commands are classed by how they must be fed - G and M codes are simply queued, homing (G28)
+// needs the queue drained first and other commands (patterns, sequences and immediate commands)
+// need the queue drained both before and after as they act when they are processed
+class CommandSequenceList
+{
+public:
+    enum FeedMode
+    {
+        FEED_QUEUED,
+        FEED_DRAIN_BEFORE,
+        FEED_DRAIN_BEFORE_AND_AFTER
+    };
+
+private:
+    char* _pCmdBuf;
+    uint16_t* _pCmdOffsets;
+    unsigned int _numCmds;
+
+public:
+    CommandSequenceList()
+    {
+        _pCmdBuf = NULL;
+        _pCmdOffsets = NULL;
+        _numCmds = 0;
+    }
+
+    ~CommandSequenceList()
+    {
+        clear();
+    }
+
+    // Compile a command list - leading spaces are removed and empty commands are skipped
+    bool compile(const char* pCmdList)
+    {
+        clear();
+        unsigned int listLen = strlen(pCmdList);
+        if ((listLen == 0) || (listLen > UINT16_MAX))
+            return false;
+        unsigned int maxCmds = 1;
+        for (const char* pStr = pCmdList; *pStr; pStr++)
+            if (*pStr == ';')
+                maxCmds++;
+        _pCmdBuf = new char[listLen + 1];
+        _pCmdOffsets = new uint16_t[maxCmds];
+        if (!_pCmdBuf || !_pCmdOffsets)
+        {
+            clear();
+            return false;
+        }
+        memcpy(_pCmdBuf, pCmdList, listLen + 1);
+        unsigned int cmdStart = 0;
+        for (unsigned int pos = 0; pos <= listLen; pos++)
+        {
+            if ((_pCmdBuf[pos] != ';') && (_pCmdBuf[pos] != 0))
+                continue;
+            _pCmdBuf[pos] = 0;
+            while ((cmdStart < pos) && isspace(_pCmdBuf[cmdStart]))
+                cmdStart++;
+            if (pos > cmdStart)
+                _pCmdOffsets[_numCmds++] = cmdStart;
+            cmdStart = pos + 1;
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        delete [] _pCmdBuf;
+        delete [] _pCmdOffsets;
+        _pCmdBuf = NULL;
+        _pCmdOffsets = NULL;
+        _numCmds = 0;
+    }
+
+    unsigned int getNumCmds()
+    {
+        return _numCmds;
+    }
+
+    const char* getCmd(unsigned int cmdIdx)
+    {
+        if (cmdIdx >= _numCmds)
+            return "";
+        return _pCmdBuf + _pCmdOffsets[cmdIdx];
+    }
+
+    static FeedMode getFeedMode(const char* pCmdStr)
+    {
+        char codeType = toupper(*pCmdStr);
+        if (((codeType != 'G') && (codeType != 'M')) || !isdigit(*(pCmdStr + 1)))
+            return FEED_DRAIN_BEFORE_AND_AFTER;
+        if ((codeType == 'G') && (atoi(pCmdStr + 1) == 28))
+            return FEED_DRAIN_BEFORE;
+        return FEED_QUEUED;
+    }
+};
@@ -1,6 +1,8 @@
 // RBotFirmware
 // Rob Dobson 2017
 
+#include "CommandSequenceList.h"
+
 class CommandInterpreter;
 
 class CommandSequencer
@@ -9,8 +11,7 @@ public:
     CommandSequencer()
     {
         _curCmdIdx = 0;
-        _numCmdsToProcess = 0;
-        // _lastMillis = 0;
+        _drainBeforeNext = false;
     }
 
     void setConfig(const char* configStr)
@@ -24,7 +25,7 @@ public:
         return _jsonConfigStr.c_str();
     }
 
-    // Process a command sequence
+    // Process a command sequence - the command list is compiled once here
     bool procCommand(const char* cmdStr)
     {
         // Find the command info
@@ -33,70 +34,59 @@ public:
         // Log.trace("CommandSequencer cmdStr %s seqStr %s", cmdStr, seqStr.c_str());
         if (isValid)
         {
-            _numCmdsToProcess = 0;
+            _commandList.clear();
             String cmdList = RdJson::getString("commands", "", seqStr.c_str(), isValid);
-            Log.trace("CommandSequencer cmdStr %s isValid %d seqStr %s cmdList %s", cmdStr, isValid, seqStr.c_str(), cmdList.c_str());
             if (isValid)
             {
-                _commandList = cmdList;
+                _commandList.compile(cmdList.c_str());
                 _curCmdIdx = 0;
-                // Count the separators
-                if (strlen(cmdList) > 0)
-                {
-                    int numSeps = 0;
-                    const char* pStr = cmdList;
-                    while(*pStr)
-                    {
-                        if (*pStr == ';')
-                            numSeps++;
-                        pStr++;
-                    }
-                    _numCmdsToProcess = numSeps + 1;
-                    Log.trace("CommandSequencer cmdStr %s seqStr %s cmdList %s numCmds %d", cmdStr, seqStr.c_str(), cmdList.c_str(), _numCmdsToProcess);
-                }
+                _drainBeforeNext = false;
+                Log.trace("CommandSequencer cmdStr %s seqStr %s cmdList %s numCmds %d", cmdStr, seqStr.c_str(),
+                                cmdList.c_str(), _commandList.getNumCmds());
             }
         }
         return isValid;
     }
 
+    // Feed commands while the queue has space - the queue is only drained (left to empty) before
+    // commands which need it (homing, patterns, sequences and immediate commands)
     void service(CommandInterpreter* pCommandInterpreter)
     {
-        // if (millis() > _lastMillis + 10000)
-        // {
-        //     _lastMillis = millis();
-        //     Log.trace("CommandSequencer process cmdStr %s cmdIdx %d numToProc %d isEmpty %d", _commandList.c_str(), _curCmdIdx, _numCmdsToProcess,
-        //                     pCommandInterpreter->queueIsEmpty());
-        // }
-        // Check there is something left to do
-        if (_numCmdsToProcess <= _curCmdIdx)
-            return;
-
-        // Only add process commands at this level if the queue is completely empty
-        if (!pCommandInterpreter->queueIsEmpty())
-            return;
+        while (_curCmdIdx < _commandList.getNumCmds())
+        {
+            if (!pCommandInterpreter->canAcceptCommand())
+                return;
+            const char* pCmdStr = _commandList.getCmd(_curCmdIdx);
+            CommandSequenceList::FeedMode feedMode = CommandSequenceList::getFeedMode(pCmdStr);
+            bool drainReqd = _drainBeforeNext || (feedMode != CommandSequenceList::FEED_QUEUED);
+            if (drainReqd && !pCommandInterpreter->queueIsEmpty())
+                return;
+            _drainBeforeNext = feedMode == CommandSequenceList::FEED_DRAIN_BEFORE_AND_AFTER;
+            _curCmdIdx++;
 
-        // Process the next command
-        Log.trace("CommandSequencer ->cmdInterp cmdStr %s cmdIdx %d numToProc %d", _commandList.c_str(), _curCmdIdx, _numCmdsToProcess);
-        String retStr;
-        pCommandInterpreter->process(_commandList.c_str(), retStr, _curCmdIdx++);
+            // Process the next command (this may stop the sequence)
+            Log.trace("CommandSequencer ->cmdInterp cmdStr %s cmdIdx %d numToProc %d", pCmdStr, _curCmdIdx - 1,
+                            _commandList.getNumCmds());
+            String retStr;
+            pCommandInterpreter->processSingle(pCmdStr, retStr);
+        }
     }
 
+    // Stop the sequence - the compiled list is kept (and replaced by the next sequence) as this
+    // may be called while one of its commands is being processed
     void stop()
     {
-        _commandList = "";
-        _numCmdsToProcess = 0;
-        _curCmdIdx = 0;
+        _curCmdIdx = _commandList.getNumCmds();
+        _drainBeforeNext = false;
     }
 private:
     // Full configuration JSON
     String _jsonConfigStr;
 
-    // List of commands to add to workflow - delimited string
-    String _commandList;
-
-    // Number of commands in command list and current position in list
-    int _numCmdsToProcess;
-    int _curCmdIdx;
+    // Compiled list of commands to add to workflow
+    CommandSequenceList _commandList;
 
-    // long _lastMillis;
+    // Position in list and flag set after a command which must complete before the next
+    unsigned int _curCmdIdx;
+    bool _drainBeforeNext;
 };
@@ -5,21 +5,66 @@
 
 #include "ConfigManager.h"
 #include "CommandInterpreter.h"
+#include "SerialLineRing.h"
+#include "BinaryMotionProtocol.h"
 
 // Serial communication protocol
+// All available characters are read into a line ring on each service call and complete lines
+// are processed while the command queue can accept them
+// Each line processed is acknowledged with "ok" (or "error:<reason>") so a host can stream
+// G-code using Grbl-style character counting - the host keeps a count of the characters sent
+// in lines not yet acknowledged and only sends a line if the count would stay within
+// RX_RING_BYTES - this keeps the command queue full without overrunning the ring
+// Immediate commands (pause, resume and stop) are like Grbl's real-time commands - they are
+// picked out as they are received (even when the ring is full) and acted on straight away, they
+// are not held in the ring (so aren't counted by the host) and the reply is "[MSG:<cmd>]" rather
+// than "ok"
+// A line is only taken from the ring when all of its commands (separated by ;) can be queued
+// A line which doesn't fit (longer than ABS_MAX_LINE_LEN, too large for the command queue or
+// received when the ring is full) is discarded and replied to with "error:linetoolong" or
+// "error:overflow"
+// Frames of the binary motion protocol can be sent between lines and are acknowledged in the
+// same way (a frame with a bad CRC is discarded using its length byte)
+// When serial streaming is enabled in the config log messages go to a different port (see
+// RBotFirmware.ino) so the port only carries replies
 class CommsSerial
 {
 private:
     int _serialPortNum;
-    String _curLine;
-    static const int MAX_REGULAR_LINE_LEN = 100;
+    SerialLineRing _rxRing;
     static const int ABS_MAX_LINE_LEN = 1000;
+    char _lineBuf[ABS_MAX_LINE_LEN + 1];
+
+    // State of the line (or frame) being received - the start of each line is kept to check for
+    // immediate commands
+    static const unsigned int IMMEDIATE_MAX_LEN = 10;
+    char _rxLineStart[IMMEDIATE_MAX_LEN + 1];
+    unsigned int _rxLineLen;
+    unsigned int _rxLineBytesInRing;
+    bool _rxLineOverflow;
+    // Frame being received - bytes still to come (0 when not in a frame) and whether the length
+    // byte is awaited
+    unsigned int _rxFrameBytesLeft;
+    bool _rxFrameAwaitLen;
+    // Line ends following a line which wasn't put in the ring (e.g. LF of CR LF) are dropped
+    bool _rxDropLineEnds;
 
 public:
-    CommsSerial(int serialPortNum)
+    // Receive window available to a host using character counting
+    static const int RX_RING_BYTES = 1024;
+
+    CommsSerial(int serialPortNum) :
+        _rxRing(RX_RING_BYTES)
     {
         _serialPortNum = serialPortNum;
-        _curLine.reserve(MAX_REGULAR_LINE_LEN);
+        _lineBuf[0] = 0;
+        _rxLineStart[0] = 0;
+        _rxLineLen = 0;
+        _rxLineBytesInRing = 0;
+        _rxLineOverflow = false;
+        _rxFrameBytesLeft = 0;
+        _rxFrameAwaitLen = false;
+        _rxDropLineEnds = false;
     }
 
     int getChar()
@@ -32,39 +77,210 @@ public:
         return -1;
     }
 
+    void sendReply(const char* pReply)
+    {
+        if (_serialPortNum == 0)
+            Serial.println(pReply);
+    }
+
     void service(CommandInterpreter& commandInterpreter)
     {
-        // Check for char
-        int ch = getChar();
-        if (ch == -1)
-            return;
+        // Read all available chars
+        while (true)
+        {
+            int ch = getChar();
+            if (ch == -1)
+                break;
+            receiveChar((char)ch, commandInterpreter);
+        }
 
-        // Check for line end
-        if ((ch == '\r') || (ch == '\n'))
+        // Process complete lines and frames
+        while (_rxRing.bytesUsed() > 0)
         {
-            // Check if empty line - ignore
-            if (_curLine.length() <= 0)
-                return;
+            // Binary frame
+            if (isFrameStart())
+            {
+                if (!serviceFrame(commandInterpreter))
+                    break;
+                continue;
+            }
+
+            // Line
+            if (!_rxRing.hasLine())
+                break;
+            unsigned int lineLen = 0;
+            unsigned int lineBytes = _rxRing.peekLine(_lineBuf, ABS_MAX_LINE_LEN, lineLen);
+
+            // Check if empty line (e.g. second char of CR LF) - ignore
+            if (lineLen == 0)
+            {
+                _rxRing.consume(lineBytes);
+                continue;
+            }
 
-            // Check for immediate instructions
-            Log.trace("CommsSerial ->cmdInterp cmdStr %s", _curLine.c_str());
+            // Reject a line too long for the line buffer rather than processing part of it
+            if (lineBytes > lineLen + 1)
+            {
+                Log.info("CommsSerial line too long - discarded");
+                _rxRing.consume(lineBytes);
+                sendReply("error:linetoolong");
+                continue;
+            }
+
+            // Leave the line in the ring until the queue has space for all of its commands - a
+            // line which could never be queued is discarded
+            bool tooLarge = false;
+            if (!commandInterpreter.canAcceptLine(_lineBuf, lineLen, tooLarge))
+            {
+                if (!tooLarge)
+                    break;
+                Log.info("CommsSerial line too large for queue - discarded");
+                _rxRing.consume(lineBytes);
+                sendReply("error:linetoolong");
+                continue;
+            }
+            _rxRing.consume(lineBytes);
+
+            // Process and acknowledge
+            Log.trace("CommsSerial ->cmdInterp cmdStr %s", _lineBuf);
             String retStr;
-            commandInterpreter.process(_curLine, retStr);
+            commandInterpreter.process(_lineBuf, retStr);
+            if (retStr.indexOf("\"busy\"") >= 0)
+                sendReply("error:busy");
+            else if (retStr.indexOf("\"fail\"") >= 0)
+                sendReply("error:fail");
+            else
+                sendReply("ok");
+        }
+    }
 
-            // Reset line
-            _curLine = "";
+private:
+    // Add a received char to the ring - immediate commands are taken out and processed here
+    void receiveChar(char ch, CommandInterpreter& commandInterpreter)
+    {
+        // Binary frame - the length byte gives the number of bytes to come
+        if (_rxFrameBytesLeft > 0)
+        {
+            storeChar(ch);
+            _rxFrameBytesLeft--;
+            if (_rxFrameAwaitLen)
+            {
+                _rxFrameBytesLeft = (uint8_t)ch + BinaryMotionProtocol::FRAME_OVERHEAD - 2;
+                _rxFrameAwaitLen = false;
+            }
+            if (_rxFrameBytesLeft == 0)
+                endRecord("error:overflow");
+            return;
+        }
+        if ((_rxLineLen == 0) && ((uint8_t)ch == BinaryMotionProtocol::FRAME_START))
+        {
+            _rxDropLineEnds = false;
+            storeChar(ch);
+            _rxFrameBytesLeft = 1;
+            _rxFrameAwaitLen = true;
             return;
         }
 
-        // Check line not too long
-        if (_curLine.length() >= ABS_MAX_LINE_LEN)
+        // Line end
+        if (SerialLineRing::isLineEnd(ch))
         {
+            if (_rxDropLineEnds)
+                return;
+            // Immediate commands are recognised from the start of the line kept here so they are
+            // acted on even if the ring overflowed while they were received
+            if ((_rxLineLen > 0) && (_rxLineLen <= IMMEDIATE_MAX_LEN) &&
+                        commandInterpreter.isImmediateCommand(_rxLineStart, _rxLineLen))
+            {
+                _rxLineStart[_rxLineLen] = 0;
+                discardRecord();
+                Log.trace("CommsSerial ->cmdInterp immediate %s", _rxLineStart);
+                String retStr;
+                commandInterpreter.process(_rxLineStart, retStr);
+                String msgStr = "[MSG:";
+                msgStr += _rxLineStart;
+                msgStr += "]";
+                sendReply(msgStr.c_str());
+                return;
+            }
+            storeChar(ch);
+            endRecord(_rxLineLen > ABS_MAX_LINE_LEN ? "error:linetoolong" : "error:overflow");
+            return;
+        }
+
+        // Line content
+        _rxDropLineEnds = false;
+        if (_rxLineLen < IMMEDIATE_MAX_LEN)
+            _rxLineStart[_rxLineLen] = ch;
+        _rxLineLen++;
+        storeChar(ch);
+    }
+
+    void storeChar(char ch)
+    {
+        if (_rxRing.put(ch))
+            _rxLineBytesInRing++;
+        else
+            _rxLineOverflow = true;
+    }
+
+    // End of a line or frame - if part of it was lost it is removed from the ring
+    void endRecord(const char* pOverflowReply)
+    {
+        if (_rxLineOverflow)
+        {
+            Log.info("CommsSerial %s - discarded", pOverflowReply);
+            discardRecord();
+            sendReply(pOverflowReply);
             return;
         }
+        _rxLineLen = 0;
+        _rxLineBytesInRing = 0;
+    }
+
+    void discardRecord()
+    {
+        _rxRing.unput(_rxLineBytesInRing);
+        _rxLineLen = 0;
+        _rxLineBytesInRing = 0;
+        _rxLineOverflow = false;
+        _rxFrameBytesLeft = 0;
+        _rxFrameAwaitLen = false;
+        _rxDropLineEnds = true;
+    }
 
-        // Add char to line
-        _curLine.concat((char)ch);
+    bool isFrameStart()
+    {
+        char ch = 0;
+        return (_rxRing.peek(&ch, 1) == 1) && ((uint8_t)ch == BinaryMotionProtocol::FRAME_START);
+    }
 
-        //Log.trace("Str = %s (%c)", _curLine.c_str(), ch);
+    // Process a binary frame at the start of the ring - returns false if the frame is incomplete or
+    // the queue is busy (the frame is left in the ring)
+    bool serviceFrame(CommandInterpreter& commandInterpreter)
+    {
+        const uint8_t* pFrame = (const uint8_t*)_lineBuf;
+        unsigned int bytesAvail = _rxRing.peek(_lineBuf, BinaryMotionProtocol::MAX_FRAME_LEN);
+        unsigned int frameLen = 0;
+        BinaryMotionProtocol::FrameResult frameResult = BinaryMotionProtocol::checkFrame(pFrame, bytesAvail, frameLen);
+        if (frameResult == BinaryMotionProtocol::FRAME_INCOMPLETE)
+            return false;
+        if (frameResult != BinaryMotionProtocol::FRAME_OK)
+        {
+            _rxRing.consume(frameLen > 0 ? frameLen : 1);
+            sendReply("error:crc");
+            return true;
+        }
+        String retStr;
+        if (commandInterpreter.processBinaryFrame(pFrame, frameLen, retStr))
+        {
+            _rxRing.consume(frameLen);
+            sendReply("ok");
+            return true;
+        }
+        if (retStr.indexOf("\"busy\"") >= 0)
+            return false;
+        _rxRing.consume(frameLen);
+        sendReply("error:frame");
+        return true;
     }
 };
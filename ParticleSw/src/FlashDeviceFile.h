@@ -0,0 +1,122 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "JobStore.h"
+
+// FlashDevice on a regular file - used on host (tests and simulation) in place of the SPI flash
+// Erase and program behave as NOR flash (erased bytes are 0xff and programming clears bits)
+class FlashDeviceFile : public FlashDevice
+{
+public:
+    static const uint32_t SECTOR_BYTES = 4096;
+
+private:
+    FILE* _pFile;
+    uint32_t _sizeBytes;
+
+public:
+    FlashDeviceFile()
+    {
+        _pFile = NULL;
+        _sizeBytes = 0;
+    }
+
+    ~FlashDeviceFile()
+    {
+        close();
+    }
+
+    // Open the file - it is created (erased) if it doesn't exist or is the wrong size
+    bool open(const char* pPath, uint32_t sizeBytes)
+    {
+        close();
+        sizeBytes = (sizeBytes / SECTOR_BYTES) * SECTOR_BYTES;
+        if (sizeBytes == 0)
+            return false;
+        _pFile = fopen(pPath, "r+b");
+        bool sizeOk = false;
+        if (_pFile)
+        {
+            fseek(_pFile, 0, SEEK_END);
+            sizeOk = (uint32_t)ftell(_pFile) == sizeBytes;
+        }
+        _sizeBytes = sizeBytes;
+        if (sizeOk)
+            return true;
+        if (_pFile)
+            fclose(_pFile);
+        _pFile = fopen(pPath, "w+b");
+        if (!_pFile)
+            return false;
+        for (uint32_t addr = 0; addr < sizeBytes; addr += SECTOR_BYTES)
+        {
+            if (!eraseSector(addr))
+            {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (_pFile)
+            fclose(_pFile);
+        _pFile = NULL;
+        _sizeBytes = 0;
+    }
+
+    uint32_t getSizeBytes()
+    {
+        return _sizeBytes;
+    }
+
+    uint32_t getSectorBytes()
+    {
+        return SECTOR_BYTES;
+    }
+
+    bool read(uint32_t addr, uint8_t* pBuf, uint32_t len)
+    {
+        if (!_pFile || (addr + len > _sizeBytes))
+            return false;
+        if (fseek(_pFile, addr, SEEK_SET) != 0)
+            return false;
+        return fread(pBuf, 1, len, _pFile) == len;
+    }
+
+    bool program(uint32_t addr, const uint8_t* pData, uint32_t len)
+    {
+        uint8_t buf[256];
+        while (len > 0)
+        {
+            uint32_t chunkLen = len < sizeof(buf) ? len : sizeof(buf);
+            if (!read(addr, buf, chunkLen))
+                return false;
+            for (uint32_t i = 0; i < chunkLen; i++)
+                buf[i] &= pData[i];
+            if ((fseek(_pFile, addr, SEEK_SET) != 0) || (fwrite(buf, 1, chunkLen, _pFile) != chunkLen))
+                return false;
+            addr += chunkLen;
+            pData += chunkLen;
+            len -= chunkLen;
+        }
+        return fflush(_pFile) == 0;
+    }
+
+    bool eraseSector(uint32_t addr)
+    {
+        if (!_pFile || (addr % SECTOR_BYTES != 0) || (addr >= _sizeBytes))
+            return false;
+        uint8_t buf[SECTOR_BYTES];
+        memset(buf, 0xff, sizeof(buf));
+        if ((fseek(_pFile, addr, SEEK_SET) != 0) || (fwrite(buf, 1, sizeof(buf), _pFile) != sizeof(buf)))
+            return false;
+        return fflush(_pFile) == 0;
+    }
+};
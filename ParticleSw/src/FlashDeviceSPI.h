@@ -0,0 +1,165 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include "application.h"
+#include "JobStore.h"
+
+// FlashDevice on an external SPI NOR flash (W25Qxx and similar parts with 4KB sectors and 256
+// byte pages) on the primary SPI port - the size is read from the JEDEC ID
+// Erasing a sector blocks for tens of ms so sectors are only erased when a job is stored
+class FlashDeviceSPI : public FlashDevice
+{
+public:
+    static const uint32_t SECTOR_BYTES = 4096;
+    static const uint32_t PAGE_BYTES = 256;
+
+private:
+    static const uint8_t CMD_WRITE_ENABLE = 0x06;
+    static const uint8_t CMD_READ_STATUS = 0x05;
+    static const uint8_t CMD_READ_DATA = 0x03;
+    static const uint8_t CMD_PAGE_PROGRAM = 0x02;
+    static const uint8_t CMD_SECTOR_ERASE = 0x20;
+    static const uint8_t CMD_JEDEC_ID = 0x9f;
+    static const uint8_t STATUS_BUSY = 0x01;
+    static const unsigned long PROGRAM_TIMEOUT_MS = 10;
+    static const unsigned long ERASE_TIMEOUT_MS = 500;
+
+    int _csPin;
+    uint32_t _sizeBytes;
+
+public:
+    FlashDeviceSPI()
+    {
+        _csPin = -1;
+        _sizeBytes = 0;
+    }
+
+    // Setup with the chip-select pin - false if no flash is found
+    bool setup(int csPin)
+    {
+        _sizeBytes = 0;
+        _csPin = csPin;
+        if (_csPin < 0)
+            return false;
+        pinMode(_csPin, OUTPUT);
+        digitalWrite(_csPin, HIGH);
+        SPI.begin(_csPin);
+        SPI.setBitOrder(MSBFIRST);
+        SPI.setDataMode(SPI_MODE0);
+        SPI.setClockSpeed(20, MHZ);
+        // Capacity is the third byte of the ID (as a power of 2)
+        select();
+        SPI.transfer(CMD_JEDEC_ID);
+        uint8_t manufId = SPI.transfer(0);
+        SPI.transfer(0);
+        uint8_t capacity = SPI.transfer(0);
+        deselect();
+        Log.info("FlashDeviceSPI: cs %d manuf %02x capacity %02x", _csPin, manufId, capacity);
+        if ((manufId == 0x00) || (manufId == 0xff) || (capacity < 0x10) || (capacity > 0x18))
+            return false;
+        _sizeBytes = 1ul << capacity;
+        return true;
+    }
+
+    uint32_t getSizeBytes()
+    {
+        return _sizeBytes;
+    }
+
+    uint32_t getSectorBytes()
+    {
+        return SECTOR_BYTES;
+    }
+
+    bool read(uint32_t addr, uint8_t* pBuf, uint32_t len)
+    {
+        if ((_sizeBytes == 0) || (addr + len > _sizeBytes))
+            return false;
+        select();
+        sendCmdAddr(CMD_READ_DATA, addr);
+        for (uint32_t i = 0; i < len; i++)
+            pBuf[i] = SPI.transfer(0);
+        deselect();
+        return true;
+    }
+
+    bool program(uint32_t addr, const uint8_t* pData, uint32_t len)
+    {
+        if ((_sizeBytes == 0) || (addr + len > _sizeBytes))
+            return false;
+        // Programming can't cross a page boundary
+        while (len > 0)
+        {
+            uint32_t chunkLen = PAGE_BYTES - (addr % PAGE_BYTES);
+            if (chunkLen > len)
+                chunkLen = len;
+            writeEnable();
+            select();
+            sendCmdAddr(CMD_PAGE_PROGRAM, addr);
+            for (uint32_t i = 0; i < chunkLen; i++)
+                SPI.transfer(pData[i]);
+            deselect();
+            if (!waitReady(PROGRAM_TIMEOUT_MS))
+                return false;
+            addr += chunkLen;
+            pData += chunkLen;
+            len -= chunkLen;
+        }
+        return true;
+    }
+
+    bool eraseSector(uint32_t addr)
+    {
+        if ((_sizeBytes == 0) || (addr % SECTOR_BYTES != 0) || (addr >= _sizeBytes))
+            return false;
+        writeEnable();
+        select();
+        sendCmdAddr(CMD_SECTOR_ERASE, addr);
+        deselect();
+        return waitReady(ERASE_TIMEOUT_MS);
+    }
+
+private:
+    void select()
+    {
+        digitalWrite(_csPin, LOW);
+    }
+
+    void deselect()
+    {
+        digitalWrite(_csPin, HIGH);
+    }
+
+    void sendCmdAddr(uint8_t cmd, uint32_t addr)
+    {
+        SPI.transfer(cmd);
+        SPI.transfer((addr >> 16) & 0xff);
+        SPI.transfer((addr >> 8) & 0xff);
+        SPI.transfer(addr & 0xff);
+    }
+
+    void writeEnable()
+    {
+        select();
+        SPI.transfer(CMD_WRITE_ENABLE);
+        deselect();
+    }
+
+    bool waitReady(unsigned long timeoutMs)
+    {
+        unsigned long startMs = millis();
+        while (true)
+        {
+            select();
+            SPI.transfer(CMD_READ_STATUS);
+            uint8_t status = SPI.transfer(0);
+            deselect();
+            if ((status & STATUS_BUSY) == 0)
+                return true;
+            if (millis() - startMs > timeoutMs)
+                return false;
+        }
+    }
+};
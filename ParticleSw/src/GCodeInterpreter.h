@@ -4,95 +4,18 @@
 #pragma once
 
 #include "ConfigManager.h"
-#include "CommandElem.h"
+#include "GCodeParser.h"
 #include "RobotController.h"
 
 class GCodeInterpreter
 {
-
 public:
-    static bool getCmdNumber(const char* pCmdStr, int& cmdNum)
-    {
-        // String passed in should start with a G or M
-        // And be followed immediately by a number
-        if (strlen(pCmdStr) < 1)
-            return false;
-        const char* pStr = pCmdStr + 1;
-        if (!isdigit(*pStr))
-            return false;
-        long rsltStr = strtol(pStr, NULL, 10);
-        cmdNum = (int) rsltStr;
-        return true;
-    }
-
-    static bool getGcodeCmdArgs(const char* pArgStr, RobotCommandArgs& cmdArgs)
-    {
-        const char* pStr = pArgStr;
-        char* pEndStr = NULL;
-        while (*pStr)
-        {
-            switch(toupper(*pStr))
-            {
-                case 'X':
-                    cmdArgs.setAxisValMM(0, strtod(++pStr, &pEndStr), true);
-                    pStr = pEndStr;
-                    break;
-                case 'Y':
-                    cmdArgs.setAxisValMM(1, strtod(++pStr, &pEndStr), true);
-                    pStr = pEndStr;
-                    break;
-                case 'Z':
-                    cmdArgs.setAxisValMM(2, strtod(++pStr, &pEndStr), true);
-                    pStr = pEndStr;
-                    break;
-                case 'E':
-                    cmdArgs.setExtrude(strtod(++pStr, &pEndStr));
-                    pStr = pEndStr;
-                    break;
-                case 'F':
-                    cmdArgs.setFeedrate(strtod(++pStr, &pEndStr));
-                    pStr = pEndStr;
-                    break;
-                case 'S':
-                    {
-                        int endstopIdx = strtol(++pStr, &pEndStr, 10);
-                        pStr = pEndStr;
-                        if (endstopIdx == 1)
-                            cmdArgs.setTestAllEndStops();
-                        else if (endstopIdx == 0)
-                            cmdArgs.setTestNoEndStops();
-                        Log.info("Set to check endstops %s", cmdArgs.toJSON().c_str());
-                        break;
-                    }
-                default:
-                    pStr++;
-                    break;
-            }
-        }
-	return true;
-    }
-
-    // Interpret GCode G commands
-    static bool interpG(String& cmdStr, RobotController* pRobotController, bool takeAction)
+    // Interpret GCode G commands - the args text is also passed for args not held in cmdArgs
+    static bool interpG(int cmdNum, RobotCommandArgs& cmdArgs, const char* pArgsStr, unsigned int argsLen,
+                    RobotController* pRobotController, bool takeAction)
     {
-        // Command string as a text buffer
-        const char* pCmdStr = cmdStr.c_str();
-
-        // Command number
-        int cmdNum = 0;
-        bool rslt = getCmdNumber(cmdStr, cmdNum);
-        if (!rslt)
-            return false;
-
-        // Get args string (separated from the GXX or MXX by a space)
-        const char* pArgsStr = "";
-        const char* pArgsPos = strstr(pCmdStr, " ");
-        if (pArgsPos != 0)
-            pArgsStr = pArgsPos + 1;
-        RobotCommandArgs cmdArgs;
-        rslt = getGcodeCmdArgs(pArgsStr, cmdArgs);
-
-        Log.info("GCodeInterpreter Cmd G%d %s", cmdNum, pArgsStr);
+        float argVal = 0;
+        Log.info("GCodeInterpreter Cmd G%d", cmdNum);
 
         // Switch on number
         switch(cmdNum)
@@ -105,6 +28,21 @@ public:
                     pRobotController->moveTo(cmdArgs);
                 }
                 return true;
+            case 4: // Dwell (P in ms or S in seconds) - queued with the motion
+                if (GCodeParser::getArgVal(pArgsStr, argsLen, 'P', argVal))
+                    argVal = argVal / 1000;
+                else if (!GCodeParser::getArgVal(pArgsStr, argsLen, 'S', argVal))
+                    argVal = 0;
+                if (takeAction && (argVal > 0))
+                {
+                    // Only taken from the queue when the robot can accept so this shouldn't fail
+                    if (!pRobotController->dwell(uint32_t(argVal * 1000 + 0.5f), cmdArgs.getNumberedCommandIndex()))
+                    {
+                        Log.error("GCodeInterpreter G4 dwell not added");
+                        return false;
+                    }
+                }
+                return true;
             case 28: // Home axes
                 if (takeAction)
                 {
@@ -138,28 +76,90 @@ public:
         return false;
     }
 
-    // Interpret GCode M commands
-    static bool interpM(String& cmdStr, RobotController* pRobotController, bool takeAction)
+    // Interpret GCode M commands - the args text is also passed for args not held in cmdArgs
+    // The motion tuning codes change limits in place (from the next move) without a reconfigure
+    static bool interpM(int cmdNum, RobotCommandArgs& cmdArgs, const char* pArgsStr, unsigned int argsLen,
+                    RobotController* pRobotController, bool takeAction)
     {
+        Log.info("GCodeInterpreter Cmd M%d", cmdNum);
+
+        MotionTuning tuning;
+        float argVal = 0;
+        switch(cmdNum)
+        {
+            case 42: // Set output pin P to level S (and report event I) when motion reaches this point
+                {
+                    if (!GCodeParser::getArgVal(pArgsStr, argsLen, 'P', argVal) || (argVal < 0))
+                        return false;
+                    int eventPin = int(argVal);
+                    bool eventPinLevel = GCodeParser::getArgVal(pArgsStr, argsLen, 'S', argVal) && (argVal != 0);
+                    int eventId = GCodeParser::getArgVal(pArgsStr, argsLen, 'I', argVal) ? int(argVal) : 0;
+                    // The pin can't be one used for motion (see MotionHelper::addEvent)
+                    if (takeAction && !pRobotController->addEvent(eventId, eventPin, eventPinLevel,
+                                    cmdArgs.getNumberedCommandIndex()))
+                    {
+                        Log.error("GCodeInterpreter M42 pin %d event not added", eventPin);
+                        return false;
+                    }
+                    return true;
+                }
+            case 400: // Event marker (reported as event I when motion reaches this point)
+                {
+                    int eventId = GCodeParser::getArgVal(pArgsStr, argsLen, 'I', argVal) ? int(argVal) : 0;
+                    if (takeAction && !pRobotController->addEvent(eventId, -1, false, cmdArgs.getNumberedCommandIndex()))
+                    {
+                        Log.error("GCodeInterpreter M400 event not added");
+                        return false;
+                    }
+                    return true;
+                }
+            case 201: // Max acceleration of axes (mm/s^2)
+            case 203: // Max speed of axes (mm/s)
+            case 204: // Acceleration limit along the path (mm/s^2 - S0 removes the limit)
+            case 205: // Junction deviation (mm)
+            case 220: // Feedrate override (percent)
+            case 221: // Extrusion override (percent)
+                GCodeParser::getMotionTuning(cmdNum, cmdArgs, pArgsStr, argsLen, tuning);
+                break;
+            default:
+                return false;
+        }
+        if (takeAction && tuning.anyValid())
+            pRobotController->setMotionTuning(tuning);
+        return true;
+    }
+
+    // Interpret a parsed GCode command
+    static bool interpParsed(CommandElem::RecordType recordType, int cmdNum, RobotCommandArgs& cmdArgs,
+                    const char* pArgsStr, unsigned int argsLen, RobotController* pRobotController, bool takeAction)
+    {
+        if (recordType == CommandElem::RECORD_GCODE)
+            return interpG(cmdNum, cmdArgs, pArgsStr, argsLen, pRobotController, takeAction);
+        else if (recordType == CommandElem::RECORD_MCODE)
+            return interpM(cmdNum, cmdArgs, pArgsStr, argsLen, pRobotController, takeAction);
         return false;
     }
 
-    // Interpret GCode commands
+    // Interpret GCode commands - commands are normally parsed when they are queued but text
+    // commands are parsed here
     static bool interpretGcode(CommandElem& cmd, RobotController* pRobotController, bool takeAction)
     {
-        // Extract code
-        String cmdStr = cmd.getString().trim();
-        if (cmdStr.length() == 0)
-            return false;
-
-        // Check for G or M codes
-        if (toupper(cmdStr.charAt(0)) == 'G')
-            return interpG(cmdStr, pRobotController, takeAction);
-        else if (toupper(cmdStr.charAt(0)) == 'M')
-            return interpM(cmdStr, pRobotController, takeAction);
+        RobotCommandArgs cmdArgs;
+        if (!cmd.isText())
+        {
+            cmd.getArgs(cmdArgs);
+            return interpParsed(cmd.getType(), cmd.getCmdNum(), cmdArgs, cmd.c_str(), cmd.length(),
+                                pRobotController, takeAction);
+        }
 
-        // Failed
-        return false;
+        // Parse text
+        CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+        int cmdNum = 0;
+        const char* pArgsStr = "";
+        unsigned int argsLen = 0;
+        if (!GCodeParser::parseGcode(cmd.c_str(), cmd.length(), recordType, cmdNum, cmdArgs, pArgsStr, argsLen))
+            return false;
+        return interpParsed(recordType, cmdNum, cmdArgs, pArgsStr, argsLen, pRobotController, takeAction);
     }
 
 };
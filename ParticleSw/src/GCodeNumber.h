@@ -0,0 +1,167 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+
+// Decimal number parser for G-code words - replaces strtod which is slow and uses double
+// arithmetic (in software on the Photon's Cortex-M3)
+// The digits are gathered into an integer mantissa (up to 9 significant digits) and a power of
+// ten which is then converted to float (one multiply or divide) or to fixed-point (integer only)
+// Accepts the forms CAM tools emit - optional spaces, optional sign and leading or trailing point
+// (e.g. X-.5, X 10, X+1., X0012.500) - but not exponents as G-code has none and the E in X1E2
+// is the next word
+class GCodeNumber
+{
+public:
+    enum ParseResult
+    {
+        PARSE_OK,
+        PARSE_NO_DIGITS,
+        PARSE_OUT_OF_RANGE
+    };
+
+    static const int MAX_SIG_DIGITS = 9;
+
+    static const char* getResultStr(ParseResult rslt)
+    {
+        switch(rslt)
+        {
+            case PARSE_OK: return "ok";
+            case PARSE_NO_DIGITS: return "no digits";
+            case PARSE_OUT_OF_RANGE: return "out of range";
+        }
+        return "unknown";
+    }
+
+    // Parse a number starting at pStr and not going beyond pEnd - value is mantissa * 10^exp10
+    // pNumEnd is set to the character after the number (or to pStr if there are no digits) so a
+    // number which is out of range can still be skipped
+    static ParseResult parseDecimal(const char* pStr, const char* pEnd, bool& isNeg, uint32_t& mantissa,
+                    int& exp10, const char*& pNumEnd)
+    {
+        isNeg = false;
+        mantissa = 0;
+        exp10 = 0;
+        pNumEnd = pStr;
+        const char* pCh = pStr;
+        while ((pCh < pEnd) && ((*pCh == ' ') || (*pCh == '\t')))
+            pCh++;
+        if ((pCh < pEnd) && ((*pCh == '-') || (*pCh == '+')))
+            isNeg = (*pCh++ == '-');
+
+        // Digits - those beyond the significant digits scale the integer part or are dropped
+        // from the fraction (rounding on the first dropped digit)
+        int sigDigits = 0;
+        bool anyDigits = false;
+        bool inFraction = false;
+        bool roundUp = false;
+        bool roundDone = false;
+        for (; pCh < pEnd; pCh++)
+        {
+            char ch = *pCh;
+            if ((ch == '.') && !inFraction)
+            {
+                inFraction = true;
+                continue;
+            }
+            if ((ch < '0') || (ch > '9'))
+                break;
+            anyDigits = true;
+            if ((mantissa == 0) && (ch == '0'))
+            {
+                if (inFraction)
+                    exp10--;
+                continue;
+            }
+            if (sigDigits < MAX_SIG_DIGITS)
+            {
+                mantissa = mantissa * 10 + (ch - '0');
+                sigDigits++;
+                if (inFraction)
+                    exp10--;
+                continue;
+            }
+            if (!roundDone)
+            {
+                roundUp = (ch >= '5');
+                roundDone = true;
+            }
+            if (!inFraction)
+                exp10++;
+        }
+        if (!anyDigits)
+            return PARSE_NO_DIGITS;
+        if (roundUp)
+            mantissa++;
+        pNumEnd = pCh;
+        if (mantissa == 0)
+            exp10 = 0;
+        if (exp10 > MAX_POW10 - MAX_SIG_DIGITS)
+            return PARSE_OUT_OF_RANGE;
+        return PARSE_OK;
+    }
+
+    // Parse as float
+    static ParseResult parseFloat(const char* pStr, const char* pEnd, float& val, const char*& pNumEnd)
+    {
+        val = 0;
+        bool isNeg = false;
+        uint32_t mantissa = 0;
+        int exp10 = 0;
+        ParseResult rslt = parseDecimal(pStr, pEnd, isNeg, mantissa, exp10, pNumEnd);
+        if (rslt != PARSE_OK)
+            return rslt;
+        val = float(mantissa);
+        if (exp10 > 0)
+            val *= getPow10(exp10);
+        else if (exp10 >= -MAX_POW10)
+            val /= getPow10(-exp10);
+        else
+            val = 0;
+        if (isNeg)
+            val = -val;
+        return PARSE_OK;
+    }
+
+    // Parse as fixed-point with fracDigits decimal places (e.g. 3 gives micrometres from mm)
+    // The value is rounded to the nearest unit (from at most 9 significant digits) and must fit in
+    // an int32
+    static ParseResult parseFixed(const char* pStr, const char* pEnd, int fracDigits, int32_t& val,
+                    const char*& pNumEnd)
+    {
+        val = 0;
+        bool isNeg = false;
+        uint32_t mantissa = 0;
+        int exp10 = 0;
+        ParseResult rslt = parseDecimal(pStr, pEnd, isNeg, mantissa, exp10, pNumEnd);
+        if (rslt != PARSE_OK)
+            return rslt;
+        uint64_t absVal = mantissa;
+        int scale = exp10 + fracDigits;
+        for (; (scale > 0) && (absVal <= INT32_MAX); scale--)
+            absVal *= 10;
+        for (; (scale < 0) && (absVal > 0); scale++)
+            absVal = (scale == -1) ? (absVal + 5) / 10 : absVal / 10;
+        if (absVal > INT32_MAX)
+            return PARSE_OUT_OF_RANGE;
+        val = isNeg ? -int32_t(absVal) : int32_t(absVal);
+        return PARSE_OK;
+    }
+
+private:
+    static const int MAX_POW10 = 38;
+
+    static float getPow10(int exp10)
+    {
+        static const float pow10Table[MAX_POW10 + 1] =
+        {
+            1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f,
+            1e10f, 1e11f, 1e12f, 1e13f, 1e14f, 1e15f, 1e16f, 1e17f, 1e18f, 1e19f,
+            1e20f, 1e21f, 1e22f, 1e23f, 1e24f, 1e25f, 1e26f, 1e27f, 1e28f, 1e29f,
+            1e30f, 1e31f, 1e32f, 1e33f, 1e34f, 1e35f, 1e36f, 1e37f, 1e38f
+        };
+        return pow10Table[exp10];
+    }
+};
@@ -0,0 +1,257 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include "CommandElem.h"
+#include "GCodeNumber.h"
+#include "RobotCommandArgs.h"
+#include "MotionTuning.h"
+
+// Parsing of G and M codes into RobotCommandArgs - used when commands are queued (and by the
+// GCodeInterpreter for commands queued as text)
+// Comments in brackets are skipped and an axis letter with no number (e.g. G28 X Y) is taken
+// as a flag for the axis (with value 0)
+class GCodeParser
+{
+public:
+    // Parse a G or M code (which doesn't need to be null-terminated) - the args string is the text
+    // following the command number
+    static bool parseGcode(const char* pCmdStr, unsigned int cmdLen, CommandElem::RecordType& recordType,
+                    int& cmdNum, RobotCommandArgs& cmdArgs, const char*& pArgsStr, unsigned int& argsLen)
+    {
+        // Skip leading whitespace
+        const char* pCmdEnd = pCmdStr + cmdLen;
+        while ((pCmdStr < pCmdEnd) && isspace(*pCmdStr))
+            pCmdStr++;
+        if (pCmdEnd - pCmdStr < 2)
+            return false;
+
+        // Check for G or M codes followed immediately by a number
+        if (toupper(*pCmdStr) == 'G')
+            recordType = CommandElem::RECORD_GCODE;
+        else if (toupper(*pCmdStr) == 'M')
+            recordType = CommandElem::RECORD_MCODE;
+        else
+            return false;
+        if (!isdigit(pCmdStr[1]))
+            return false;
+        char* pNumEnd = NULL;
+        cmdNum = (int) strtol(pCmdStr + 1, &pNumEnd, 10);
+        if (pNumEnd > pCmdEnd)
+            return false;
+
+        // Args
+        pArgsStr = pNumEnd;
+        while ((pArgsStr < pCmdEnd) && isspace(*pArgsStr))
+            pArgsStr++;
+        argsLen = pCmdEnd - pArgsStr;
+        cmdArgs.clear();
+        return getGcodeCmdArgs(pArgsStr, pCmdEnd, cmdArgs, recordType);
+    }
+
+    // Args are parsed with GCodeNumber (bounded by pArgEnd) - a word with a bad number fails the
+    // whole command rather than moving to a default position
+    // S selects the end-stops to check on G codes only (M codes use S for their own values)
+    static bool getGcodeCmdArgs(const char* pArgStr, const char* pArgEnd, RobotCommandArgs& cmdArgs,
+                    CommandElem::RecordType recordType)
+    {
+        const char* pStr = pArgStr;
+        char* pEndStr = NULL;
+        float val = 0;
+        bool valFound = false;
+        while ((pStr < pArgEnd) && *pStr)
+        {
+            switch(toupper(*pStr))
+            {
+                case '(':
+                    pStr = skipComment(pStr, pArgEnd);
+                    break;
+                case 'X':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(0, val, true);
+                    break;
+                case 'Y':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(1, val, true);
+                    break;
+                case 'Z':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(2, val, true);
+                    break;
+                case 'A':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(3, val, true);
+                    break;
+                case 'B':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(4, val, true);
+                    break;
+                case 'C':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    cmdArgs.setAxisValMM(5, val, true);
+                    break;
+                case 'E':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    if (valFound)
+                        cmdArgs.setExtrude(val);
+                    break;
+                case 'F':
+                    if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                        return false;
+                    if (valFound)
+                        cmdArgs.setFeedrate(val);
+                    break;
+                case 'S':
+                    {
+                        if (recordType != CommandElem::RECORD_GCODE)
+                        {
+                            if (!getArgNumber(pArgStr, pStr, pArgEnd, val, valFound))
+                                return false;
+                            break;
+                        }
+                        int endstopIdx = strtol(++pStr, &pEndStr, 10);
+                        pStr = pEndStr;
+                        if (endstopIdx == 1)
+                            cmdArgs.setTestAllEndStops();
+                        else if (endstopIdx == 0)
+                            cmdArgs.setTestNoEndStops();
+                        Log.info("Set to check endstops %s", cmdArgs.toJSON().c_str());
+                        break;
+                    }
+                default:
+                    pStr++;
+                    break;
+            }
+        }
+	return true;
+    }
+
+    // Get the value of a single letter arg from the args text (e.g. S in M220 S50 which isn't
+    // held in cmdArgs) - false if the arg isn't present
+    static bool getArgVal(const char* pArgsStr, unsigned int argsLen, char argName, float& val)
+    {
+        const char* pArgEnd = pArgsStr + argsLen;
+        for (const char* pStr = pArgsStr; pStr < pArgEnd; pStr++)
+        {
+            if (*pStr == '(')
+            {
+                pStr = skipComment(pStr, pArgEnd) - 1;
+                continue;
+            }
+            if (toupper(*pStr) != argName)
+                continue;
+            if ((pStr > pArgsStr) && isalpha(*(pStr - 1)))
+                continue;
+            const char* pNumEnd = NULL;
+            return GCodeNumber::parseFloat(pStr + 1, pArgEnd, val, pNumEnd) == GCodeNumber::PARSE_OK;
+        }
+        return false;
+    }
+
+    // Get the motion tuning changes from M201 (max acceleration of axes - mm/s^2), M203 (max speed
+    // of axes - mm/s), M204 (path acceleration limit S or P - mm/s^2 - 0 removes the limit), M205
+    // (junction deviation J - mm), M220 (feedrate override S - percent) and M221 (extrusion override
+    // S - percent) - returns false if the M code isn't one of these
+    static bool getMotionTuning(int cmdNum, RobotCommandArgs& cmdArgs, const char* pArgsStr, unsigned int argsLen,
+                    MotionTuning& tuning)
+    {
+        float argVal = 0;
+        switch(cmdNum)
+        {
+            case 201:
+            case 203:
+                for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+                {
+                    if (!cmdArgs.isValid(axisIdx) || (cmdArgs.getValMM(axisIdx) <= 0))
+                        continue;
+                    if (cmdNum == 201)
+                        tuning.setMaxAcc(axisIdx, cmdArgs.getValMM(axisIdx));
+                    else
+                        tuning.setMaxSpeed(axisIdx, cmdArgs.getValMM(axisIdx));
+                }
+                return true;
+            case 204:
+                if (getArgVal(pArgsStr, argsLen, 'S', argVal) || getArgVal(pArgsStr, argsLen, 'P', argVal))
+                {
+                    tuning._pathAccValid = argVal >= 0;
+                    tuning._pathAccMMps2 = argVal;
+                }
+                return true;
+            case 205:
+                if (getArgVal(pArgsStr, argsLen, 'J', argVal))
+                {
+                    tuning._junctionDeviationValid = argVal >= 0;
+                    tuning._junctionDeviation = argVal;
+                }
+                return true;
+            case 220:
+            case 221:
+                if (getArgVal(pArgsStr, argsLen, 'S', argVal) && (argVal > 0))
+                {
+                    if (cmdNum == 220)
+                    {
+                        tuning._feedrateOverrideValid = true;
+                        tuning._feedrateOverridePC = argVal;
+                    }
+                    else
+                    {
+                        tuning._extrudeOverrideValid = true;
+                        tuning._extrudeOverridePC = argVal;
+                    }
+                }
+                return true;
+        }
+        return false;
+    }
+
+private:
+    // Parse the number following the arg letter at pStr and move pStr past it - a letter with
+    // nothing after it but spaces, another word or a comment is a flag (valFound is false and val
+    // is 0) - errors are logged with the arg letter and position
+    static bool getArgNumber(const char* pArgStr, const char*& pStr, const char* pArgEnd, float& val,
+                    bool& valFound)
+    {
+        const char* pNumEnd = NULL;
+        GCodeNumber::ParseResult rslt = GCodeNumber::parseFloat(pStr + 1, pArgEnd, val, pNumEnd);
+        valFound = rslt == GCodeNumber::PARSE_OK;
+        if ((rslt == GCodeNumber::PARSE_NO_DIGITS) && isWordEnd(pStr + 1, pArgEnd))
+        {
+            val = 0;
+            pStr++;
+            return true;
+        }
+        if (rslt != GCodeNumber::PARSE_OK)
+        {
+            Log.error("GCodeParser: arg %c at args pos %d %s", *pStr, int(pStr - pArgStr),
+                            GCodeNumber::getResultStr(rslt));
+            return false;
+        }
+        pStr = pNumEnd;
+        return true;
+    }
+
+    static bool isWordEnd(const char* pStr, const char* pArgEnd)
+    {
+        while ((pStr < pArgEnd) && ((*pStr == ' ') || (*pStr == '\t')))
+            pStr++;
+        return (pStr >= pArgEnd) || (*pStr == 0) || isalpha(*pStr) || (*pStr == '(');
+    }
+
+    // Returns the position after the comment (or the end if the comment isn't closed)
+    static const char* skipComment(const char* pStr, const char* pArgEnd)
+    {
+        while ((pStr < pArgEnd) && *pStr && (*pStr != ')'))
+            pStr++;
+        if ((pStr < pArgEnd) && (*pStr == ')'))
+            pStr++;
+        return pStr;
+    }
+};
@@ -0,0 +1,124 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Kinematics for the GeistBot - a polar robot with a rotating arm (axis 0, units are degrees
+// clockwise from North) and a linear carriage on the arm (axis 1, units are mm from the centre)
+// The carriage is driven by a rack and pinion with the pinion motor mounted on the arm so when
+// the arm rotates with the pinion held still the carriage moves along the rack - to keep the
+// linear position constant the linear motor has to make one step in the same direction for each
+// rotation step, i.e. linear actuator steps = linear steps + rotation steps
+class GeistBotKinematics
+{
+public:
+  // Points closer than this to the centre keep the current azimuth
+  static constexpr float NEAR_CENTRE_MM = 0.1f;
+
+private:
+  int32_t _stepsPerRot0;
+  float _stepsPerDeg0;
+  float _stepsPerMM1;
+  bool _minValValid;
+  float _minVal;
+  bool _maxValValid;
+  float _maxVal;
+
+  static constexpr float PI_F         = 3.14159265358979f;
+  static constexpr float TWO_PI_F     = 2 * PI_F;
+  static constexpr float DEGS_PER_RAD = 180.0f / PI_F;
+  static constexpr float RADS_PER_DEG = PI_F / 180.0f;
+
+public:
+  GeistBotKinematics()
+  {
+    setGeometry(1, 1, 1, false, 0, false, 0);
+  }
+
+  // stepsPerRot0/unitsPerRot0 for the rotation axis and steps per mm for the linear axis with
+  // the linear axis bounds
+  void setGeometry(float stepsPerRot0, float unitsPerRot0, float stepsPerMM1,
+                   bool minValValid, float minVal, bool maxValValid, float maxVal)
+  {
+    _stepsPerRot0 = int32_t(stepsPerRot0);
+    if (_stepsPerRot0 <= 0)
+      _stepsPerRot0 = 1;
+    _stepsPerDeg0 = stepsPerRot0 / unitsPerRot0;
+    _stepsPerMM1  = stepsPerMM1;
+    _minValValid  = minValValid;
+    _minVal       = minVal;
+    _maxValValid  = maxValValid;
+    _maxVal       = maxVal;
+  }
+
+  // Convert a cartesian point to actuator steps given the current actuator position
+  // The arm always takes the shortest rotation to the new azimuth
+  // Returns false if the point is outside the linear axis bounds (and allowOutOfBounds isn't set)
+  bool ptToActuator(float x, float y, int32_t curSteps0, int32_t curSteps1,
+                    float& steps0, float& steps1, bool allowOutOfBounds) const
+  {
+    // Required linear position and check bounds
+    float reqLinearMM = sqrtf(x * x + y * y);
+    bool inBounds = !((_minValValid && reqLinearMM < _minVal) || (_maxValValid && reqLinearMM > _maxVal));
+    if (!inBounds && !allowOutOfBounds)
+      return false;
+
+    // Current position
+    float curAzimuthRads = 0, curLinearMM = 0;
+    actuatorToPolar(curSteps0, curSteps1, curAzimuthRads, curLinearMM);
+
+    // Shortest rotation to the required azimuth (measured clockwise from North) - at the centre
+    // any azimuth will do so don't rotate
+    float azimuthDiffRads = 0;
+    if (reqLinearMM >= NEAR_CENTRE_MM)
+    {
+      azimuthDiffRads = atan2f(x, y) - curAzimuthRads;
+      if (azimuthDiffRads > PI_F)
+        azimuthDiffRads -= TWO_PI_F;
+      else if (azimuthDiffRads <= -PI_F)
+        azimuthDiffRads += TWO_PI_F;
+    }
+
+    // Convert to steps - the linear actuator also makes the rotation steps (rack coupling)
+    float actuator0Diff = azimuthDiffRads * DEGS_PER_RAD * _stepsPerDeg0;
+    float actuator1Diff = (reqLinearMM - curLinearMM) * _stepsPerMM1 + actuator0Diff;
+    steps0 = curSteps0 + actuator0Diff;
+    steps1 = curSteps1 + actuator1Diff;
+    return inBounds;
+  }
+
+  // Convert actuator steps to polar coordinates (azimuth in radians clockwise from North)
+  void actuatorToPolar(int32_t steps0, int32_t steps1, float& azimuthRads, float& linearMM) const
+  {
+    // Azimuth from the rotation steps within a single rotation
+    int32_t rotSteps = steps0 % _stepsPerRot0;
+    if (rotSteps < 0)
+      rotSteps += _stepsPerRot0;
+    azimuthRads = rotSteps / _stepsPerDeg0 * RADS_PER_DEG;
+
+    // The linear position is the difference between linear and rotation steps (see above)
+    linearMM = (steps1 - steps0) / _stepsPerMM1;
+  }
+
+  void actuatorToPt(int32_t steps0, int32_t steps1, float& x, float& y) const
+  {
+    float azimuthRads = 0, linearMM = 0;
+    actuatorToPolar(steps0, steps1, azimuthRads, linearMM);
+    x = linearMM * sinf(azimuthRads);
+    y = linearMM * cosf(azimuthRads);
+  }
+
+  // Bring the rotation steps back within a single rotation - the linear steps include the rotation
+  // steps so they are moved by the same amount which leaves the position unchanged
+  // Returns the number of steps removed
+  int32_t correctStepOverflow(int32_t& steps0, int32_t& steps1) const
+  {
+    int32_t correction = (steps0 / _stepsPerRot0) * _stepsPerRot0;
+    steps0 -= correction;
+    steps1 -= correction;
+    return correction;
+  }
+};
@@ -0,0 +1,260 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "SerialLineRing.h"
+#include "JobStore.h"
+
+// Device-side buffer for a G-code job uploaded in chunks (e.g. by the jobstart and jobappend API)
+// Lines are taken from the buffer by CommandInterpreter::service whenever the command queue has
+// space so the job streams into the workflow without a round trip per line - a line is only
+// removed from the buffer (takeLine) once the queue has accepted it
+// A line longer than JOB_MAX_LINE_LEN fails the job rather than running part of the line
+// A job can also be played from a JobStore slot - the buffer is then refilled from the store
+// (read ahead in chunks) as lines are taken so no host is needed while the job runs
+// The buffer is only allocated when a job is first started
+class JobFeeder
+{
+public:
+    enum JobState
+    {
+        JOB_IDLE,
+        JOB_RUNNING,
+        JOB_PAUSED,
+        JOB_DONE,
+        JOB_FAILED
+    };
+
+    static const unsigned int JOB_BUFFER_BYTES_DEFAULT = 4096;
+    static const unsigned int JOB_MAX_LINE_LEN = 200;
+    static const unsigned int STORE_READ_CHUNK_BYTES = 256;
+
+private:
+    SerialLineRing _jobRing;
+    unsigned int _bufferBytes;
+    JobState _state;
+    // Set when the last chunk of the job has been received
+    bool _endReceived;
+    unsigned long _totalBytes;
+    unsigned long _rxBytes;
+    unsigned long _fedBytes;
+    unsigned long _linesFed;
+    // Job being played from a store (NULL when uploaded)
+    JobStore* _pStore;
+    unsigned int _storeSlot;
+    char _lineBuf[JOB_MAX_LINE_LEN + 1];
+    // Bytes in the buffer of the line returned by peekLine (0 if none)
+    unsigned int _peekedLineBytes;
+    // Reason the job failed (NULL if it hasn't)
+    const char* _pFailReason;
+
+public:
+    JobFeeder(unsigned int bufferBytes = JOB_BUFFER_BYTES_DEFAULT)
+    {
+        _bufferBytes = bufferBytes;
+        _lineBuf[0] = 0;
+        clearJob();
+    }
+
+    // Start a new job - totalBytes is the size of the whole job if known (for progress)
+    void start(unsigned long totalBytes)
+    {
+        if (_jobRing.capacityBytes() == 0)
+            _jobRing.init(_bufferBytes);
+        clearJob();
+        _totalBytes = totalBytes;
+        _state = JOB_RUNNING;
+    }
+
+    // Start playing a job from a store slot
+    bool startStored(JobStore& jobStore, unsigned int slotIdx)
+    {
+        uint32_t jobLen = 0;
+        if (!jobStore.getJobInfo(slotIdx, NULL, 0, jobLen))
+            return false;
+        start(jobLen);
+        _pStore = &jobStore;
+        _storeSlot = slotIdx;
+        if (jobLen == 0)
+            _endReceived = true;
+        readAhead();
+        return true;
+    }
+
+    bool isStored()
+    {
+        return _pStore != NULL;
+    }
+
+    // Append a chunk of the job - the chunk is only accepted if all of it fits - the job is complete
+    // when isLast is set or the total size given to start() has been received
+    bool append(const char* pData, unsigned int dataLen, bool isLast)
+    {
+        if ((_state == JOB_IDLE) || (_state == JOB_DONE) || (_state == JOB_FAILED) || _endReceived || _pStore)
+            return false;
+        if (dataLen > getBufferFree())
+            return false;
+        for (unsigned int i = 0; i < dataLen; i++)
+            _jobRing.put(pData[i]);
+        _rxBytes += dataLen;
+        _endReceived = isLast || ((_totalBytes > 0) && (_rxBytes >= _totalBytes));
+        return true;
+    }
+
+    void pause(bool pauseIt)
+    {
+        if (pauseIt && (_state == JOB_RUNNING))
+            _state = JOB_PAUSED;
+        else if (!pauseIt && (_state == JOB_PAUSED))
+            _state = JOB_RUNNING;
+    }
+
+    // Stop the job - the rest of the buffer is discarded (counts are kept for status)
+    void stop()
+    {
+        if ((_state == JOB_IDLE) || (_state == JOB_FAILED))
+            return;
+        _jobRing.clear();
+        _peekedLineBytes = 0;
+        _state = JOB_DONE;
+    }
+
+    // End the job because a line can't be run (the rest of the buffer is discarded)
+    void fail(const char* pReason)
+    {
+        if ((_state == JOB_IDLE) || (_state == JOB_DONE) || (_state == JOB_FAILED))
+            return;
+        _jobRing.clear();
+        _peekedLineBytes = 0;
+        _pFailReason = pReason;
+        _state = JOB_FAILED;
+    }
+
+    bool isRunning()
+    {
+        return _state == JOB_RUNNING;
+    }
+
+    JobState getState()
+    {
+        return _state;
+    }
+
+    unsigned int getBufferFree()
+    {
+        return _jobRing.capacityBytes() - _jobRing.bytesUsed();
+    }
+
+    // Get the next line of a running job (empty lines are skipped) - the line stays in the buffer
+    // until takeLine() so the same line is returned until then - the line is valid until the next
+    // call - returns NULL if there is no complete line yet or the job isn't running
+    const char* peekLine(unsigned int& lineLen)
+    {
+        lineLen = 0;
+        while (_state == JOB_RUNNING)
+        {
+            readAhead();
+            unsigned int lineBytes = _jobRing.peekLine(_lineBuf, JOB_MAX_LINE_LEN, lineLen);
+            bool tooLong = lineBytes > lineLen + 1;
+            // The last line of the job may not be terminated (and a line longer than the buffer
+            // can never be)
+            bool bufferBlocked = _jobRing.isFull() || (_pStore && (getBufferFree() < STORE_READ_CHUNK_BYTES));
+            if ((lineBytes == 0) && (_endReceived || bufferBlocked) && (_jobRing.bytesUsed() > 0))
+            {
+                lineBytes = _jobRing.bytesUsed();
+                lineLen = _jobRing.peek(_lineBuf, JOB_MAX_LINE_LEN);
+                _lineBuf[lineLen] = 0;
+                tooLong = lineBytes > JOB_MAX_LINE_LEN;
+            }
+            if (tooLong)
+            {
+                fail("linetoolong");
+                return NULL;
+            }
+            if (lineBytes == 0)
+            {
+                if (_endReceived)
+                    _state = JOB_DONE;
+                return NULL;
+            }
+            if (lineLen == 0)
+            {
+                _jobRing.consume(lineBytes);
+                _fedBytes += lineBytes;
+                continue;
+            }
+            _peekedLineBytes = lineBytes;
+            return _lineBuf;
+        }
+        return NULL;
+    }
+
+    // Remove the line returned by peekLine once it has been accepted
+    void takeLine()
+    {
+        if (_peekedLineBytes == 0)
+            return;
+        _jobRing.consume(_peekedLineBytes);
+        _fedBytes += _peekedLineBytes;
+        _peekedLineBytes = 0;
+        _linesFed++;
+    }
+
+    void getStatusJSON(char* pBuf, unsigned int bufLen)
+    {
+        static const char* stateStrs[] = { "idle", "running", "paused", "done", "failed" };
+        int pct = -1;
+        if (_totalBytes > 0)
+            pct = (int)(_fedBytes * 100 / _totalBytes);
+        else if (_endReceived && (_rxBytes > 0))
+            pct = (int)(_fedBytes * 100 / _rxBytes);
+        snprintf(pBuf, bufLen, "{\"job\":\"%s\",\"rxBytes\":%lu,\"fedBytes\":%lu,\"lines\":%lu,"
+                    "\"total\":%lu,\"end\":%d,\"bufFree\":%u,\"pct\":%d,\"src\":\"%s\",\"err\":\"%s\"}",
+                    stateStrs[_state], _rxBytes, _fedBytes, _linesFed, _totalBytes,
+                    _endReceived ? 1 : 0, getBufferFree(), pct, _pStore ? "store" : "upload",
+                    _pFailReason ? _pFailReason : "");
+    }
+
+private:
+    void clearJob()
+    {
+        _jobRing.clear();
+        _state = JOB_IDLE;
+        _endReceived = false;
+        _totalBytes = 0;
+        _rxBytes = 0;
+        _fedBytes = 0;
+        _linesFed = 0;
+        _pStore = NULL;
+        _storeSlot = 0;
+        _peekedLineBytes = 0;
+        _pFailReason = NULL;
+    }
+
+    // Refill the buffer from the store while a whole chunk fits
+    void readAhead()
+    {
+        if (!_pStore || _endReceived)
+            return;
+        char chunk[STORE_READ_CHUNK_BYTES];
+        while (!_endReceived && (getBufferFree() >= STORE_READ_CHUNK_BYTES))
+        {
+            uint32_t chunkLen = STORE_READ_CHUNK_BYTES;
+            if (chunkLen > _totalBytes - _rxBytes)
+                chunkLen = _totalBytes - _rxBytes;
+            // A failed read ends the job at what has been read
+            if (_pStore->read(_storeSlot, _rxBytes, chunk, chunkLen) != chunkLen)
+            {
+                _endReceived = true;
+                break;
+            }
+            for (unsigned int i = 0; i < chunkLen; i++)
+                _jobRing.put(chunk[i]);
+            _rxBytes += chunkLen;
+            _endReceived = _rxBytes >= _totalBytes;
+        }
+    }
+};
@@ -0,0 +1,245 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Raw access to a NOR-flash-like device - erased bytes read as 0xff and programming can only
+// clear bits - implemented by FlashDeviceSPI (external SPI flash) and FlashDeviceFile (a regular
+// file on host)
+class FlashDevice
+{
+public:
+    virtual ~FlashDevice()
+    {
+    }
+    virtual uint32_t getSizeBytes() = 0;
+    virtual uint32_t getSectorBytes() = 0;
+    virtual bool read(uint32_t addr, uint8_t* pBuf, uint32_t len) = 0;
+    virtual bool program(uint32_t addr, const uint8_t* pData, uint32_t len) = 0;
+    virtual bool eraseSector(uint32_t addr) = 0;
+};
+
+// Store for jobs (G-code, pattern and sequence names - anything the CommandInterpreter accepts)
+// The flash is divided into equal slots - each has a header page (written when the job is
+// complete so a partly written job is never run) followed by the job text
+class JobStore
+{
+public:
+    static const unsigned int MAX_NAME_LEN = 31;
+    static const uint32_t HEADER_BYTES = 256;
+    static const uint32_t HEADER_MAGIC = 0x4a6f6253;
+
+private:
+    FlashDevice* _pFlash;
+    unsigned int _numSlots;
+    uint32_t _slotBytes;
+    // Write in progress
+    int _writeSlot;
+    uint32_t _writeLen;
+    uint32_t _erasedTo;
+    char _writeName[MAX_NAME_LEN + 1];
+
+    struct SlotHeader
+    {
+        uint32_t _magic;
+        uint32_t _jobLen;
+        char _name[MAX_NAME_LEN + 1];
+    };
+
+public:
+    JobStore()
+    {
+        _pFlash = NULL;
+        _numSlots = 0;
+        _slotBytes = 0;
+        _writeSlot = -1;
+        _writeLen = 0;
+        _erasedTo = 0;
+        _writeName[0] = 0;
+    }
+
+    // Setup on a flash device - slots are a whole number of sectors
+    bool setup(FlashDevice* pFlash, unsigned int numSlots)
+    {
+        _pFlash = NULL;
+        _numSlots = 0;
+        _writeSlot = -1;
+        if (!pFlash || (numSlots == 0))
+            return false;
+        uint32_t sectorBytes = pFlash->getSectorBytes();
+        if ((sectorBytes == 0) || (sectorBytes < HEADER_BYTES))
+            return false;
+        uint32_t slotBytes = (pFlash->getSizeBytes() / numSlots / sectorBytes) * sectorBytes;
+        if (slotBytes <= HEADER_BYTES)
+            return false;
+        _pFlash = pFlash;
+        _numSlots = numSlots;
+        _slotBytes = slotBytes;
+        return true;
+    }
+
+    bool isValid()
+    {
+        return _pFlash != NULL;
+    }
+
+    unsigned int getNumSlots()
+    {
+        return _numSlots;
+    }
+
+    // Max job length in a slot
+    uint32_t getMaxJobBytes()
+    {
+        return _slotBytes > HEADER_BYTES ? _slotBytes - HEADER_BYTES : 0;
+    }
+
+    // Get the job in a slot - false if the slot is empty (or the job wasn't completely written)
+    bool getJobInfo(unsigned int slotIdx, char* pName, unsigned int nameMaxLen, uint32_t& jobLen)
+    {
+        jobLen = 0;
+        if (pName && (nameMaxLen > 0))
+            pName[0] = 0;
+        SlotHeader hdr;
+        if (!readHeader(slotIdx, hdr))
+            return false;
+        jobLen = hdr._jobLen;
+        if (pName && (nameMaxLen > 0))
+        {
+            strncpy(pName, hdr._name, nameMaxLen - 1);
+            pName[nameMaxLen - 1] = 0;
+        }
+        return true;
+    }
+
+    // Find a slot by job name - -1 if not found
+    int findJob(const char* pName)
+    {
+        for (unsigned int slotIdx = 0; slotIdx < _numSlots; slotIdx++)
+        {
+            SlotHeader hdr;
+            if (readHeader(slotIdx, hdr) && (strcmp(hdr._name, pName) == 0))
+                return slotIdx;
+        }
+        return -1;
+    }
+
+    // Start writing a job to a slot (the slot is erased as it is written)
+    bool startWrite(unsigned int slotIdx, const char* pName)
+    {
+        _writeSlot = -1;
+        if (!isValid() || (slotIdx >= _numSlots))
+            return false;
+        // Erase the header sector so the old job is no longer valid
+        uint32_t slotAddr = slotIdx * _slotBytes;
+        if (!_pFlash->eraseSector(slotAddr))
+            return false;
+        _erasedTo = slotAddr + _pFlash->getSectorBytes();
+        _writeSlot = slotIdx;
+        _writeLen = 0;
+        strncpy(_writeName, pName ? pName : "", MAX_NAME_LEN);
+        _writeName[MAX_NAME_LEN] = 0;
+        // Name is reported in JSON
+        for (char* pCh = _writeName; *pCh; pCh++)
+            if ((*pCh == '"') || (*pCh == '\\') || (*pCh < ' '))
+                *pCh = '_';
+        return true;
+    }
+
+    bool isWriting()
+    {
+        return _writeSlot >= 0;
+    }
+
+    // Append to the job being written - on failure the write is abandoned (the slot stays empty)
+    bool write(const char* pData, uint32_t len)
+    {
+        if (!isWriting())
+            return false;
+        if (!writeData(pData, len))
+        {
+            _writeSlot = -1;
+            return false;
+        }
+        _writeLen += len;
+        return true;
+    }
+
+    // Complete the job being written - the header is written last
+    bool endWrite()
+    {
+        if (!isWriting())
+            return false;
+        SlotHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr._magic = HEADER_MAGIC;
+        hdr._jobLen = _writeLen;
+        memcpy(hdr._name, _writeName, sizeof(hdr._name));
+        bool rslt = _pFlash->program(_writeSlot * _slotBytes, (const uint8_t*)&hdr, sizeof(hdr));
+        _writeSlot = -1;
+        return rslt;
+    }
+
+    // Read part of a job - returns the number of bytes read
+    uint32_t read(unsigned int slotIdx, uint32_t offset, char* pBuf, uint32_t len)
+    {
+        if (!isValid() || (slotIdx >= _numSlots) || (offset > getMaxJobBytes()))
+            return 0;
+        if (len > getMaxJobBytes() - offset)
+            len = getMaxJobBytes() - offset;
+        if (!_pFlash->read(slotIdx * _slotBytes + HEADER_BYTES + offset, (uint8_t*)pBuf, len))
+            return 0;
+        return len;
+    }
+
+    // List of jobs as JSON
+    void getJobsJSON(char* pBuf, unsigned int bufLen)
+    {
+        unsigned int pos = snprintf(pBuf, bufLen, "{\"slots\":%u,\"maxBytes\":%lu,\"jobs\":[",
+                        _numSlots, (unsigned long)getMaxJobBytes());
+        bool first = true;
+        for (unsigned int slotIdx = 0; (slotIdx < _numSlots) && (pos < bufLen); slotIdx++)
+        {
+            SlotHeader hdr;
+            if (!readHeader(slotIdx, hdr))
+                continue;
+            pos += snprintf(pBuf + pos, bufLen - pos, "%s{\"slot\":%u,\"name\":\"%s\",\"bytes\":%lu}",
+                        first ? "" : ",", slotIdx, hdr._name, (unsigned long)hdr._jobLen);
+            first = false;
+        }
+        if (pos < bufLen)
+            snprintf(pBuf + pos, bufLen - pos, "]}");
+    }
+
+private:
+    bool writeData(const char* pData, uint32_t len)
+    {
+        if (_writeLen + len > getMaxJobBytes())
+            return false;
+        uint32_t addr = _writeSlot * _slotBytes + HEADER_BYTES + _writeLen;
+        // Erase sectors ahead of the write
+        while (_erasedTo < addr + len)
+        {
+            if (!_pFlash->eraseSector(_erasedTo))
+                return false;
+            _erasedTo += _pFlash->getSectorBytes();
+        }
+        return _pFlash->program(addr, (const uint8_t*)pData, len);
+    }
+
+    bool readHeader(unsigned int slotIdx, SlotHeader& hdr)
+    {
+        if (!isValid() || (slotIdx >= _numSlots) || ((int)slotIdx == _writeSlot))
+            return false;
+        if (!_pFlash->read(slotIdx * _slotBytes, (uint8_t*)&hdr, sizeof(hdr)))
+            return false;
+        if ((hdr._magic != HEADER_MAGIC) || (hdr._jobLen > getMaxJobBytes()))
+            return false;
+        hdr._name[MAX_NAME_LEN] = 0;
+        return true;
+    }
+};
@@ -0,0 +1,456 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "RobotConsts.h"
+#include "GCodeParser.h"
+
+// Result of validating a job - kept separate from the validator so it can be reported without
+// knowing the type of point checker
+class JobValidatorStatus
+{
+public:
+  // Reason for failing - a point or (for the last two) the command itself
+  enum PointResult
+  {
+    POINT_OK,
+    POINT_OUT_OF_BOUNDS,
+    POINT_UNREACHABLE,
+    POINT_INVALID_COMMAND,
+    POINT_PATTERN_UNBOUNDED
+  };
+
+  enum State
+  {
+    STATE_IDLE,
+    STATE_RUNNING,
+    STATE_PASSED,
+    STATE_FAILED
+  };
+
+  State _state;
+  // Lines and moves checked so far
+  int _linesChecked;
+  int _movesChecked;
+  // Total travel (primary axes) and bounding box of all points
+  float _travelMM;
+  bool _boundsValid;
+  float _boundsMin[RobotConsts::MAX_AXES];
+  float _boundsMax[RobotConsts::MAX_AXES];
+  // First point which failed (line numbers start at 1)
+  PointResult _failResult;
+  int _failLineNum;
+  float _failPt[RobotConsts::MAX_AXES];
+  // Time spent validating
+  uint32_t _elapsedUs;
+
+  JobValidatorStatus()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    _state        = STATE_IDLE;
+    _linesChecked = 0;
+    _movesChecked = 0;
+    _travelMM     = 0;
+    _boundsValid  = false;
+    _failResult   = POINT_OK;
+    _failLineNum  = 0;
+    _elapsedUs    = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _boundsMin[axisIdx] = 0;
+      _boundsMax[axisIdx] = 0;
+      _failPt[axisIdx]    = 0;
+    }
+  }
+
+  static const char* getStateStr(State state)
+  {
+    switch (state)
+    {
+      case STATE_RUNNING: return "running";
+      case STATE_PASSED:  return "passed";
+      case STATE_FAILED:  return "failed";
+      default:            return "idle";
+    }
+  }
+
+  static const char* getPointResultStr(PointResult pointResult)
+  {
+    switch (pointResult)
+    {
+      case POINT_OUT_OF_BOUNDS:     return "outOfBounds";
+      case POINT_UNREACHABLE:       return "unreachable";
+      case POINT_INVALID_COMMAND:   return "invalidCommand";
+      case POINT_PATTERN_UNBOUNDED: return "patternUnbounded";
+      default:                      return "ok";
+    }
+  }
+
+  // Format as JSON - returns the length written (truncated to fit maxLen)
+  int toJSON(char* pBuf, int maxLen)
+  {
+    int pos = snprintf(pBuf, maxLen, "{\"state\":\"%s\",\"lines\":%d,\"moves\":%d,\"travelMM\":%0.1f,\"us\":%lu",
+                       getStateStr(_state), _linesChecked, _movesChecked, _travelMM, (unsigned long)_elapsedUs);
+    if (_boundsValid)
+    {
+      pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, ",\"min\":[");
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "%s%0.2f", axisIdx == 0 ? "" : ",", _boundsMin[axisIdx]);
+      pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "],\"max\":[");
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "%s%0.2f", axisIdx == 0 ? "" : ",", _boundsMax[axisIdx]);
+      pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "]");
+    }
+    if (_state == STATE_FAILED)
+    {
+      pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, ",\"fail\":\"%s\",\"failLine\":%d,\"failPt\":[",
+                      getPointResultStr(_failResult), _failLineNum);
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "%s%0.2f", axisIdx == 0 ? "" : ",", _failPt[axisIdx]);
+      pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "]");
+    }
+    pos += snprintf(pBuf + pos, maxLen > pos ? maxLen - pos : 0, "}");
+    return pos < maxLen ? pos : maxLen - 1;
+  }
+};
+
+// Source of the points of a pattern named in a job (the PatternEvaluator) - kept abstract so the
+// validator doesn't depend on the expression evaluator
+class JobValidatorPatternSource
+{
+public:
+  virtual ~JobValidatorPatternSource() {}
+  // Start generating the points of a pattern - false if the command isn't a pattern name
+  virtual bool startPattern(const char* pCmdStr) = 0;
+  // Get the next point (X and Y) - false when the pattern has finished
+  virtual bool getPatternPoint(float& x, float& y) = 0;
+  virtual void stopPattern() = 0;
+};
+
+// Pre-flight check of a whole G-code job without moving - every move target is run through the
+// point checker (which does the robot's bounds check and ptToActuator) and the first point that
+// fails is reported along with the total travel and bounding box
+// The job is processed a slice at a time so that it can run in the background with a time budget
+// Lines are separated by newlines or semicolons (as CommandInterpreter::process splits them) and
+// each is parsed with GCodeParser in the same way as when it is queued - G0/G1 moves, G28 (home),
+// G90/G91 (absolute/relative) and G92 (set position) are followed, a G or M code which doesn't
+// parse fails the job, other lines are looked up as patterns (whose points are checked as the G0
+// moves the pattern would send) and anything else is skipped
+// PointCheckerT must provide:
+//    JobValidatorStatus::PointResult checkPoint(const float pt[])
+//    void goHome()
+//    bool isPrimaryAxis(int axisIdx)
+template<typename PointCheckerT>
+class JobValidator
+{
+public:
+  typedef uint32_t (*microsFnType)();
+
+private:
+  PointCheckerT& _pointChecker;
+  microsFnType _microsFn;
+  JobValidatorStatus _status;
+
+  // Patterns (NULL if patterns aren't checked) and the points checked for the current one
+  static const int MAX_PATTERN_POINTS = 100000;
+  static const unsigned int MAX_PATTERN_NAME_LEN = 100;
+  JobValidatorPatternSource* _pPatternSource;
+  bool _patternRunning;
+  int _patternPoints;
+
+  // Job text (not copied so must remain valid while validating) and position in it
+  const char* _pJob;
+  const char* _pCurLine;
+  int _lineNum;
+
+  // Modal state and position
+  bool _moveRelative;
+  float _curPos[RobotConsts::MAX_AXES];
+  float _homePos[RobotConsts::MAX_AXES];
+
+public:
+  JobValidator(PointCheckerT& pointChecker, microsFnType microsFn) :
+    _pointChecker(pointChecker)
+  {
+    _microsFn = microsFn;
+    _pPatternSource = NULL;
+    _patternRunning = false;
+    _patternPoints  = 0;
+    _pJob     = NULL;
+    _pCurLine = NULL;
+    _lineNum  = 0;
+    _moveRelative = false;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _curPos[axisIdx]  = 0;
+      _homePos[axisIdx] = 0;
+    }
+  }
+
+  // Start validating a job from the given position (homing returns to homePos) - patterns in the
+  // job are checked if a pattern source is given
+  void start(const char* pJob, const float startPos[], const float homePos[], bool moveRelative,
+             JobValidatorPatternSource* pPatternSource = NULL)
+  {
+    stopPattern();
+    _pPatternSource = pPatternSource;
+    _status.clear();
+    _status._state = JobValidatorStatus::STATE_RUNNING;
+    _pJob          = pJob;
+    _pCurLine      = pJob;
+    _lineNum       = 0;
+    _moveRelative  = moveRelative;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _curPos[axisIdx]  = startPos[axisIdx];
+      _homePos[axisIdx] = homePos[axisIdx];
+    }
+  }
+
+  void stop()
+  {
+    stopPattern();
+    if (_status._state == JobValidatorStatus::STATE_RUNNING)
+      _status._state = JobValidatorStatus::STATE_IDLE;
+    _pJob = _pCurLine = NULL;
+  }
+
+  bool isRunning()
+  {
+    return _status._state == JobValidatorStatus::STATE_RUNNING;
+  }
+
+  JobValidatorStatus& getStatus()
+  {
+    return _status;
+  }
+
+  // Validate lines until the job is complete or the time budget is used up
+  // Returns true when validation has finished
+  bool service(uint32_t budgetUs)
+  {
+    if (!isRunning())
+      return true;
+    uint32_t startUs = _microsFn();
+    while (true)
+    {
+      if (!checkNextLine())
+        break;
+      if (_microsFn() - startUs >= budgetUs)
+        break;
+    }
+    _status._elapsedUs += _microsFn() - startUs;
+    return !isRunning();
+  }
+
+  // Validate the whole job in one go
+  JobValidatorStatus& validate(const char* pJob, const float startPos[], const float homePos[], bool moveRelative,
+                               JobValidatorPatternSource* pPatternSource = NULL)
+  {
+    start(pJob, startPos, homePos, moveRelative, pPatternSource);
+    while (checkNextLine())
+      ;
+    return _status;
+  }
+
+private:
+  // Check the next line - returns false when validation has finished
+  bool checkNextLine()
+  {
+    if (_patternRunning)
+      return checkNextPatternPoint();
+    if (!_pCurLine || (*_pCurLine == '\0'))
+    {
+      _status._state = JobValidatorStatus::STATE_PASSED;
+      return false;
+    }
+
+    // Find the end of the line
+    const char* pLineEnd = _pCurLine;
+    while ((*pLineEnd != '\0') && (*pLineEnd != '\n') && (*pLineEnd != ';'))
+      pLineEnd++;
+    _lineNum++;
+    _status._linesChecked++;
+    bool lineOk = checkLine(_pCurLine, pLineEnd);
+    _pCurLine = (*pLineEnd == '\0') ? pLineEnd : pLineEnd + 1;
+    if (!lineOk)
+    {
+      _status._state = JobValidatorStatus::STATE_FAILED;
+      return false;
+    }
+    return true;
+  }
+
+  // Check a single line - returns false if it fails
+  bool checkLine(const char* pStr, const char* pEnd)
+  {
+    // Trim whitespace
+    while ((pStr < pEnd) && isspace(*pStr))
+      pStr++;
+    while ((pEnd > pStr) && isspace(*(pEnd - 1)))
+      pEnd--;
+    if (pStr >= pEnd)
+      return true;
+
+    // Parse as it would be when queued
+    CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+    int cmdNum = 0;
+    RobotCommandArgs cmdArgs;
+    const char* pArgsStr = "";
+    unsigned int argsLen = 0;
+    if (!GCodeParser::parseGcode(pStr, pEnd - pStr, recordType, cmdNum, cmdArgs, pArgsStr, argsLen))
+    {
+      // A G or M code which doesn't parse would be queued as text and then not run
+      if (((toupper(*pStr) == 'G') || (toupper(*pStr) == 'M')) && (pEnd - pStr > 1) && isdigit(pStr[1]))
+      {
+        _status._failResult  = JobValidatorStatus::POINT_INVALID_COMMAND;
+        _status._failLineNum = _lineNum;
+        return false;
+      }
+      return checkPatternStart(pStr, pEnd);
+    }
+    if (recordType != CommandElem::RECORD_GCODE)
+      return true;
+
+    // Axis values on the line
+    bool anyValid = false;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      anyValid = anyValid || cmdArgs.isValid(axisIdx);
+
+    switch (cmdNum)
+    {
+      case 0:
+      case 1:
+        {
+          // Destination
+          float newPos[RobotConsts::MAX_AXES];
+          for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+          {
+            newPos[axisIdx] = _curPos[axisIdx];
+            if (cmdArgs.isValid(axisIdx))
+              newPos[axisIdx] = _moveRelative ? _curPos[axisIdx] + cmdArgs.getValMM(axisIdx) : cmdArgs.getValMM(axisIdx);
+          }
+          return checkMove(newPos);
+        }
+      case 28:
+        {
+          // Homing goes to the home position (on the axes specified or all axes)
+          for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            if (!anyValid || cmdArgs.isValid(axisIdx))
+              _curPos[axisIdx] = _homePos[axisIdx];
+          _pointChecker.goHome();
+          return true;
+        }
+      case 90:
+        _moveRelative = false;
+        return true;
+      case 91:
+        _moveRelative = true;
+        return true;
+      case 92:
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+          if (cmdArgs.isValid(axisIdx))
+            _curPos[axisIdx] = cmdArgs.getValMM(axisIdx);
+        return true;
+    }
+    return true;
+  }
+
+  // Start checking the points of a pattern if the line is a pattern name
+  bool checkPatternStart(const char* pStr, const char* pEnd)
+  {
+    if (!_pPatternSource || ((unsigned int)(pEnd - pStr) > MAX_PATTERN_NAME_LEN))
+      return true;
+    char patternName[MAX_PATTERN_NAME_LEN + 1];
+    memcpy(patternName, pStr, pEnd - pStr);
+    patternName[pEnd - pStr] = '\0';
+    _patternRunning = _pPatternSource->startPattern(patternName);
+    _patternPoints  = 0;
+    return true;
+  }
+
+  // Check the next point of a pattern (a G0 to X and Y) - returns false when validation has
+  // finished - a pattern which hasn't stopped after MAX_PATTERN_POINTS fails
+  bool checkNextPatternPoint()
+  {
+    float x = 0, y = 0;
+    if (!_pPatternSource->getPatternPoint(x, y))
+    {
+      _patternRunning = false;
+      return true;
+    }
+    bool pointOk = false;
+    _patternPoints++;
+    if (_patternPoints > MAX_PATTERN_POINTS)
+    {
+      _status._failResult  = JobValidatorStatus::POINT_PATTERN_UNBOUNDED;
+      _status._failLineNum = _lineNum;
+    }
+    else
+    {
+      float newPos[RobotConsts::MAX_AXES];
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        newPos[axisIdx] = _curPos[axisIdx];
+      newPos[0] = _moveRelative ? _curPos[0] + x : x;
+      newPos[1] = _moveRelative ? _curPos[1] + y : y;
+      pointOk = checkMove(newPos);
+    }
+    if (pointOk)
+      return true;
+    stopPattern();
+    _status._state = JobValidatorStatus::STATE_FAILED;
+    return false;
+  }
+
+  void stopPattern()
+  {
+    if (_patternRunning && _pPatternSource)
+      _pPatternSource->stopPattern();
+    _patternRunning = false;
+  }
+
+  // Check a move to a new position and accumulate travel and bounds
+  bool checkMove(float newPos[])
+  {
+    _status._movesChecked++;
+    JobValidatorStatus::PointResult pointResult = _pointChecker.checkPoint(newPos);
+    if (pointResult != JobValidatorStatus::POINT_OK)
+    {
+      _status._failResult  = pointResult;
+      _status._failLineNum = _lineNum;
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        _status._failPt[axisIdx] = newPos[axisIdx];
+      return false;
+    }
+
+    // Travel and bounds
+    float distSq = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      if (_pointChecker.isPrimaryAxis(axisIdx))
+      {
+        float delta = newPos[axisIdx] - _curPos[axisIdx];
+        distSq += delta * delta;
+      }
+      if (!_status._boundsValid || (newPos[axisIdx] < _status._boundsMin[axisIdx]))
+        _status._boundsMin[axisIdx] = newPos[axisIdx];
+      if (!_status._boundsValid || (newPos[axisIdx] > _status._boundsMax[axisIdx]))
+        _status._boundsMax[axisIdx] = newPos[axisIdx];
+      _curPos[axisIdx] = newPos[axisIdx];
+    }
+    _status._boundsValid = true;
+    _status._travelMM += sqrtf(distSq);
+    return true;
+  }
+};
@@ -0,0 +1,91 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include "AxisValues.h"
+#include "AxisPosition.h"
+#include "AxisFloatsBatch.h"
+#include "AxesParams.h"
+
+// Kinematics policies
+// A robot's kinematics are given to MotionHelper::setKinematics<KinematicsT>() as a class with
+// static methods matching the transform function types in MotionPlanner.h:
+//   ptToActuator, actuatorToPt, correctStepOverflow and ptsToActuator (the batch version)
+// and a flag:
+//   IS_AXIS_LINEAR - each actuator is a linear function of its own axis which doesn't depend on
+//                    the current position, so a straight line in axis units is a straight line
+//                    of steps and moves can be split without converting each block
+// The policy is a template parameter of MotionHelper::blocksToAddWith so the transforms are
+// inlined into the loop which splits moves into blocks rather than called through pointers
+// The robot classes (e.g. RobotSandTableScara) are themselves policies
+
+// Cartesian robots (XYBot and MugBot) - each axis is scaled and offset independently
+class CartesianKinematics
+{
+public:
+    static constexpr bool IS_AXIS_LINEAR = true;
+
+    static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds)
+    {
+        // Check machine bounds and fix the value if required - the point is then still reachable
+        // (as in the batch version)
+        axesParams.ptInBounds(targetPt, !allowOutOfBounds);
+
+        // Perform conversion
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            // Axis val from home point
+            float axisValFromHome = targetPt.getVal(axisIdx) - axesParams.getHomeOffsetVal(axisIdx);
+            // Convert to steps and add offset to home in steps
+            outActuator.setVal(axisIdx, axisValFromHome * axesParams.getStepsPerUnit(axisIdx)
+                            + axesParams.gethomeOffSteps(axisIdx));
+        }
+        return true;
+    }
+
+    // Batch version of ptToActuator - each axis is a linear transform over the whole batch
+    static void ptsToActuator(AxisFloatsBatch& targetPts, AxisFloatsBatch& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds)
+    {
+        int numPts = targetPts._count;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            // Check machine bounds and fix the values if required
+            float* pVals = targetPts.axisVals(axisIdx);
+            float minVal = 0, maxVal = 0;
+            if (!allowOutOfBounds && axesParams.getMinVal(axisIdx, minVal))
+                for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+                    pVals[ptIdx] = fmaxf(pVals[ptIdx], minVal);
+            if (!allowOutOfBounds && axesParams.getMaxVal(axisIdx, maxVal))
+                for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+                    pVals[ptIdx] = fminf(pVals[ptIdx], maxVal);
+
+            // Convert to steps and add offset to home in steps
+            float* pOut = outActuator.axisVals(axisIdx);
+            float homeOffsetVal = axesParams.getHomeOffsetVal(axisIdx);
+            float stepsPerUnit = axesParams.getStepsPerUnit(axisIdx);
+            float homeOffSteps = float(axesParams.gethomeOffSteps(axisIdx));
+            for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+                pOut[ptIdx] = (pVals[ptIdx] - homeOffsetVal) * stepsPerUnit + homeOffSteps;
+        }
+        for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+            outActuator._ok[ptIdx] = true;
+        outActuator._count = numPts;
+    }
+
+    static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+    {
+        // Perform conversion
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            float ptVal = targetActuator.getVal(axisIdx) - axesParams.gethomeOffSteps(axisIdx);
+            ptVal = ptVal / axesParams.getStepsPerUnit(axisIdx) + axesParams.getHomeOffsetVal(axisIdx);
+            outPt.setVal(axisIdx, ptVal);
+        }
+    }
+
+    static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+    {
+        // Not necessary for a non-continuous rotation bot
+    }
+};
@@ -13,8 +13,8 @@ TEST_MOTION_ACTUATOR_DEF
 // Static interval timer
 IntervalTimer MotionActuator::_isrMotionTimer;
 
-// Static refrerence to a single MotionActuator instance
-MotionActuator* MotionActuator::_pMotionActuatorInstance = NULL;
+// Flag indicating the timer has been started by the first MotionActuator constructed
+bool MotionActuator::_isrMotionTimerStarted = false;
 
 // Function that handles ISR calls based on a timer
 // When ISR is enabled this is called every MotionBlock::TICK_INTERVAL_NS nanoseconds
@@ -23,9 +23,15 @@ void MotionActuator::_isrStepperMotion(void)
   // Instrumentation code to time ISR execution (if enabled - see TestMotionActuator.h)
   TEST_MOTION_ACTUATOR_TIME_START
 
-  // Process block
-  if (_pMotionActuatorInstance)
-    _pMotionActuatorInstance->procTick();
+  // Process a tick for each configured motion channel
+  int numActuators = _numIsrActuators;
+  for (int chanIdx = 0; chanIdx < numActuators; chanIdx++)
+    _pIsrActuators[chanIdx]->procTick();
+
+  // End the step pulses - channels are in the order their pulses started so the wait for the
+  // first channel's pulse width covers most (or all) of the wait for the others
+  for (int chanIdx = 0; chanIdx < numActuators; chanIdx++)
+    _pIsrActuators[chanIdx]->endStepPulses();
 
   // Time execution
   TEST_MOTION_ACTUATOR_TIME_END
@@ -33,12 +39,44 @@ void MotionActuator::_isrStepperMotion(void)
 
 #endif
 
+// Static references to the MotionActuator instances (one per motion channel) and those serviced
+// by the ISR
+MotionActuator* volatile MotionActuator::_pMotionActuators[MotionActuator::MAX_MOTION_CHANNELS] = { NULL };
+MotionActuator* volatile MotionActuator::_pIsrActuators[MotionActuator::MAX_MOTION_CHANNELS] = { NULL };
+volatile int MotionActuator::_numIsrActuators = 0;
+
+// Add this channel to those serviced by the ISR (if not already) - the entry is filled in before
+// the count is increased so the ISR never sees an empty entry
+void MotionActuator::isrAdd()
+{
+  if (_motionChannelIdx < 0)
+    return;
+  for (int chanIdx = 0; chanIdx < _numIsrActuators; chanIdx++)
+    if (_pIsrActuators[chanIdx] == this)
+      return;
+  _pIsrActuators[_numIsrActuators] = this;
+  _numIsrActuators = _numIsrActuators + 1;
+}
+
+// Stop the ISR servicing this channel
+void MotionActuator::isrRemove()
+{
+  __disable_irq();
+  int numActuators = 0;
+  for (int chanIdx = 0; chanIdx < _numIsrActuators; chanIdx++)
+    if (_pIsrActuators[chanIdx] != this)
+      _pIsrActuators[numActuators++] = _pIsrActuators[chanIdx];
+  _numIsrActuators = numActuators;
+  __enable_irq();
+}
+
 // Process method called by main program loop
 void MotionActuator::process()
 {
   // If not using ISR call procTick on every process call
 #ifndef USE_SPARK_INTERVAL_TIMER_ISR
   procTick();
+  endStepPulses();
 #endif
 
   // Instrumentation - used to collect test information about operation of MotionActuator
@@ -54,7 +92,8 @@ void MotionActuator::procTick()
   // Instrumentation
   TEST_MOTION_ACTUATOR_STEP_END
 
-  // Do a step-end for any motor which needs one - return here to avoid too short a pulse
+  // Do a step-end for any motor which needs one - when pulses are longer than can be timed within
+  // the ISR they are ended here and we return to avoid too short a pulse
   bool anyPinReset = false;
   for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
   {
@@ -72,14 +111,19 @@ void MotionActuator::procTick()
     return;
   }
 
-  // Check if paused
-  if (_isPaused)
+  // Check if paused or stopped by a feed hold
+  if (_isPaused || (_feedHoldState == FEED_HOLD_STOPPED))
     return;
 
   // Peek a MotionPipelineElem from the queue
   MotionBlock* pBlock = _motionPipeline.peekGet();
   if (!pBlock)
+  {
+    // Nothing left to decelerate through
+    if (_feedHoldState == FEED_HOLD_DECELERATING)
+      _feedHoldState = FEED_HOLD_STOPPED;
     return;
+  }
 
   // Check if the element can be executed
   if (!pBlock->_canExecute)
@@ -88,6 +132,13 @@ void MotionActuator::procTick()
     return;
   }
 
+  // Dwell and event blocks have no steps
+  if (!pBlock->isMove())
+  {
+    procSpecialBlock(pBlock);
+    return;
+  }
+
   // See if the block was already executing and set isExecuting if not
   bool newBlock = !pBlock->_isExecuting;
   pBlock->_isExecuting = true;
@@ -100,6 +151,7 @@ void MotionActuator::procTick()
     {
       int32_t stepsTotal = pBlock->_stepsTotalMaybeNeg[axisIdx];
       _stepsTotalAbs[axisIdx]          = abs(stepsTotal);
+      _stepDirn[axisIdx]               = (stepsTotal >= 0) ? 1 : -1;
       _curStepCount[axisIdx]           = 0;
       _curAccumulatorRelative[axisIdx] = 0;
       // Set direction for the axis
@@ -112,12 +164,25 @@ void MotionActuator::procTick()
       TEST_MOTION_ACTUATOR_STEP_DIRN
     }
 
+    // Apply any change the planner made to the step counts before this block (only once as the
+    // block restarts after a feed hold)
+    if (pBlock->_hasStepsRebase)
+    {
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        _axisStepsFromHome[axisIdx] += pBlock->_stepsRebase[axisIdx];
+      _stepsRebaseCount++;
+      pBlock->_hasStepsRebase = false;
+    }
+
     // Accumulator reset
     _curAccumulatorStep = 0;
     _curAccumulatorNS   = 0;
 
-    // Step rate
+    // Step rate - during a feed hold carry on decelerating from the previous block's rate
+    uint32_t prevStepRatePerTTicks = _curStepRatePerTTicks;
     _curStepRatePerTTicks = pBlock->_initialStepRatePerTTicks;
+    if ((_feedHoldState == FEED_HOLD_DECELERATING) && (prevStepRatePerTTicks < _curStepRatePerTTicks))
+      _curStepRatePerTTicks = prevStepRatePerTTicks;
 
     // Log.info("MotionActuator: New Block XSt %ld, YSt %ld, ZSt %ld, MaxStpAx %d, initRt %ld, maxRt %ld, endRt %ld, acc %ld",
     //             _stepsTotalAbs[0], _stepsTotalAbs[1], _stepsTotalAbs[2],
@@ -231,8 +296,21 @@ void MotionActuator::procTick()
     // Subtract from accumulator leaving remainder to combat rounding errors
     _curAccumulatorNS -= MotionBlock::NS_IN_A_MS;
 
+    // Feed hold decelerates at the max rate regardless of the block's profile and stops when slow enough
+    if (_feedHoldState == FEED_HOLD_DECELERATING)
+    {
+      if (_curStepRatePerTTicks > MIN_STEP_RATE_PER_TTICKS + pBlock->_accStepsPerTTicksPerMS)
+      {
+        _curStepRatePerTTicks -= pBlock->_accStepsPerTTicksPerMS;
+      }
+      else
+      {
+        _feedHoldState = FEED_HOLD_STOPPED;
+        return;
+      }
+    }
     // Check if decelerating
-    if (_curStepCount[pBlock->_axisIdxWithMaxSteps] > pBlock->_stepsBeforeDecel)
+    else if (_curStepCount[pBlock->_axisIdxWithMaxSteps] > pBlock->_stepsBeforeDecel)
     {
       // Log.info("MotionActuator: Decel Steps/s %ld Accel %ld", _curStepRatePerTTicks, pBlock->_accStepsPerTTicksPerMS);
       if (_curStepRatePerTTicks > std::max(MIN_STEP_RATE_PER_TTICKS + pBlock->_accStepsPerTTicksPerMS,
@@ -268,7 +346,10 @@ void MotionActuator::procTick()
       if (pAxisInfo->_pinStep != -1)
         pinSetFast(pAxisInfo->_pinStep);
       pAxisInfo->_pinStepCurLevel = 1;
+      if (_homeSyncAnyEnabled)
+        homeSyncCheck(axisIdxMaxSteps);
       _curStepCount[axisIdxMaxSteps]++;
+      _axisStepsFromHome[axisIdxMaxSteps] += _stepDirn[axisIdxMaxSteps];
       if (_curStepCount[axisIdxMaxSteps] < _stepsTotalAbs[axisIdxMaxSteps])
         anyAxisMoving = true;
 
@@ -295,7 +376,10 @@ void MotionActuator::procTick()
           pinSetFast(pAxisInfo->_pinStep);
       //  Log.trace("pinSetFast: %d (ax %d)", pAxisInfo->_pinStep, axisIdx);
         pAxisInfo->_pinStepCurLevel = 1;
+        if (_homeSyncAnyEnabled)
+          homeSyncCheck(axisIdx);
         _curStepCount[axisIdx]++;
+        _axisStepsFromHome[axisIdx] += _stepDirn[axisIdx];
         if (_curStepCount[axisIdx] < _stepsTotalAbs[axisIdx])
           anyAxisMoving = true;
 
@@ -304,6 +388,14 @@ void MotionActuator::procTick()
       }
     }
 
+    // Pulse width is timed from here as the last step pin has now been set (timing from before
+    // the pins were set would shorten the pulses by the time taken above)
+    _stepPulsesStartSysTicks = System.ticks();
+
+    // Step pulses are ended after all channels have been ticked if they are short enough - the
+    // next step can then start on the next tick
+    _stepPulsesPending = _stepPulseEndInIsr;
+
     // Any axes still moving?
     if (!anyAxisMoving)
     {
@@ -319,6 +411,138 @@ void MotionActuator::procTick()
   }
 }
 
+// Dwell and event blocks - a dwell waits (timed by the ms accumulator) and an event sets its
+// output pin (if any) and is recorded for the main loop to report
+void MotionActuator::procSpecialBlock(MotionBlock* pBlock)
+{
+  // A feed hold stops here straight away as nothing is moving
+  if (_feedHoldState == FEED_HOLD_DECELERATING)
+  {
+    _feedHoldState = FEED_HOLD_STOPPED;
+    return;
+  }
+
+  // New block
+  if (!pBlock->_isExecuting)
+  {
+    pBlock->_isExecuting = true;
+    _curAccumulatorNS = 0;
+    _dwellMsElapsed = 0;
+    _curStepRatePerTTicks = 0;
+  }
+
+  if (pBlock->_blockType == MotionBlock::BLOCK_DWELL)
+  {
+    // Wait until the dwell time has elapsed
+    if (_dwellMsElapsed < pBlock->_dwellMs)
+    {
+      _curAccumulatorNS += MotionBlock::TICK_INTERVAL_NS;
+      if (_curAccumulatorNS < MotionBlock::NS_IN_A_MS)
+        return;
+      _curAccumulatorNS -= MotionBlock::NS_IN_A_MS;
+      _dwellMsElapsed++;
+      if (_dwellMsElapsed < pBlock->_dwellMs)
+        return;
+    }
+  }
+  else
+  {
+    // Event reached - the pin is made an output here so it is left alone until motion gets here
+    if (pBlock->_eventPin >= 0)
+    {
+      pinMode(pBlock->_eventPin, OUTPUT);
+      digitalWriteFast(pBlock->_eventPin, pBlock->_eventPinLevel);
+    }
+    _lastEventId = pBlock->_eventId;
+    _eventsReached++;
+  }
+
+  // Block complete
+  _motionPipeline.remove();
+  if (pBlock->getNumberedCommandIndex() != RobotConsts::NUMBERED_COMMAND_NONE)
+  {
+    _lastDoneNumberedCmdIdx = pBlock->getNumberedCommandIndex();
+  }
+}
+
+// Called from the main loop once a feed hold has stopped (so the ISR won't touch the pipeline)
+// The block which was executing is changed to cover only the steps not yet taken so that the
+// remaining path can be replanned from a standstill
+// Returns true if the block was changed
+bool MotionActuator::feedHoldTrimBlock()
+{
+  if (_feedHoldState != FEED_HOLD_STOPPED)
+    return false;
+  MotionBlock* pBlock = _motionPipeline.peekGet();
+  if (!pBlock || !pBlock->_isExecuting)
+    return false;
+
+  // A dwell carries on with the time remaining
+  if (pBlock->_blockType == MotionBlock::BLOCK_DWELL)
+  {
+    Log.info("MotionActuator: feed hold stopped at %lums of %lums dwell", _dwellMsElapsed, pBlock->_dwellMs);
+    pBlock->trimDwell(_dwellMsElapsed);
+    return true;
+  }
+
+  // Record the stop point
+  uint32_t stepsDone[RobotConsts::MAX_AXES];
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    stepsDone[axisIdx] = _curStepCount[axisIdx];
+  Log.info("MotionActuator: feed hold stopped at steps %lu,%lu of %lu,%lu",
+           stepsDone[0], stepsDone[1], _stepsTotalAbs[0], _stepsTotalAbs[1]);
+
+  // Trim the block
+  pBlock->trimToRemainingSteps(stepsDone);
+  return true;
+}
+
+// Check the home sensor of an axis which is being stepped - the sensor reflects the position
+// before this step so the count is latched before it is updated (as when homing to the sensor)
+// Only the first edge is latched until the main loop takes it
+void MotionActuator::homeSyncCheck(int axisIdx)
+{
+  if (!_homeSyncEnabled[axisIdx])
+    return;
+  RobotConsts::RawMotionAxis_t* pAxisInfo = &_rawMotionHwInfo._axis[axisIdx];
+  bool isActive = (pinReadFast(pAxisInfo->_pinEndStopMin) != 0) == pAxisInfo->_pinEndStopMinactLvl;
+  if (isActive && !_homeSyncWasActive[axisIdx] && (_stepDirn[axisIdx] == _homeSyncDirn[axisIdx]) &&
+            !_homeSyncLatched[axisIdx])
+  {
+    _homeSyncLatchSteps[axisIdx] = _axisStepsFromHome[axisIdx];
+    _homeSyncLatchRebaseCount[axisIdx] = _stepsRebaseCount;
+    _homeSyncLatched[axisIdx]    = true;
+  }
+  _homeSyncWasActive[axisIdx] = isActive;
+}
+
+// End step pulses started in this tick once the pulse width has elapsed
+void MotionActuator::endStepPulses()
+{
+  if (!_stepPulsesPending)
+    return;
+  _stepPulsesPending = false;
+
+  // Wait for the pulse width (system ticks are CPU cycles so this is accurate at the uS level)
+  while (System.ticks() - _stepPulsesStartSysTicks < _stepPulseWidthSysTicks)
+    ;
+
+  // Instrumentation
+  TEST_MOTION_ACTUATOR_STEP_END
+
+  // Reset any step pins which are high
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    RobotConsts::RawMotionAxis_t* pAxisInfo = &_rawMotionHwInfo._axis[axisIdx];
+    if (pAxisInfo->_pinStepCurLevel == 1)
+    {
+      if (pAxisInfo->_pinStep != -1)
+        pinResetFast(pAxisInfo->_pinStep);
+      pAxisInfo->_pinStepCurLevel = 0;
+    }
+  }
+}
+
 String MotionActuator::getDebugStr()
 {
   #ifdef TEST_MOTION_ACTUATOR_ENABLE
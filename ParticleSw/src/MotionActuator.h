@@ -17,10 +17,28 @@
 
 class MotionActuator
 {
+public:
+  // Width of the step pulse - pulses up to MAX_IN_ISR_STEP_PULSE_US are ended within the same
+  // ISR call so a step can be issued on every tick, longer pulses are ended on the next tick
+  // The ISR waits once for the pulses of all channels (rather than once per channel)
+  static constexpr uint32_t stepPulseWidthUs_default  = 1;
+  static constexpr uint32_t MAX_IN_ISR_STEP_PULSE_US  = 10;
+
+  // Feed hold - motion decelerates to a stop and then waits to be resumed
+  enum FeedHoldState
+  {
+    FEED_HOLD_NONE,
+    FEED_HOLD_DECELERATING,
+    FEED_HOLD_STOPPED
+  };
+
 private:
   // If this is true nothing will move
   volatile bool _isPaused;
 
+  // Feed hold state - changed by the ISR from decelerating to stopped
+  volatile FeedHoldState _feedHoldState;
+
   // Pipeline of blocks to be processed
   MotionPipeline& _motionPipeline;
 
@@ -38,13 +56,32 @@ private:
 #endif
 
 #ifdef USE_SPARK_INTERVAL_TIMER_ISR
-  // ISR based interval timer
+  // ISR based interval timer - a single timer services every motion channel
   static IntervalTimer _isrMotionTimer;
-  static MotionActuator* _pMotionActuatorInstance;
+  static bool _isrMotionTimerStarted;
   static constexpr uint16_t ISR_TIMER_PERIOD_US = uint16_t(MotionBlock::TICK_INTERVAL_NS / 1000l);
 #endif
 
+public:
+  // Max number of independent motion channels (each with its own pipeline)
+  static constexpr int MAX_MOTION_CHANNELS = 4;
+
 private:
+  // Motion channels - a channel index is allocated to each actuator when constructed but the
+  // ISR only services the channels which have been configured (_pIsrActuators[0.._numIsrActuators-1])
+  static MotionActuator* volatile _pMotionActuators[MAX_MOTION_CHANNELS];
+  static MotionActuator* volatile _pIsrActuators[MAX_MOTION_CHANNELS];
+  static volatile int _numIsrActuators;
+  int _motionChannelIdx;
+
+private:
+  // Step pulse width and whether the pulse is ended within the ISR
+  uint32_t _stepPulseWidthUs;
+  uint32_t _stepPulseWidthSysTicks;
+  bool _stepPulseEndInIsr;
+  // Step pulses started in this tick which are still to be ended (and when they started)
+  bool _stepPulsesPending;
+  uint32_t _stepPulsesStartSysTicks;
   // Execution info for the currently executing block
   bool _isEnabled;
   // End-stop reached
@@ -54,31 +91,100 @@ private:
   // Steps
   uint32_t _stepsTotalAbs[RobotConsts::MAX_AXES];
   uint32_t _curStepCount[RobotConsts::MAX_AXES];
+  int32_t _stepDirn[RobotConsts::MAX_AXES];
+  // Live position - absolute step counts updated on every step (in the same frame as the
+  // planner's step counts as blocks carry any rebase made by the planner)
+  volatile int32_t _axisStepsFromHome[RobotConsts::MAX_AXES];
+  // Bumped by the ISR when the step counts are rebased so that readers can detect it
+  volatile uint32_t _stepsRebaseCount;
+  // Home sensor resync - the step count is latched when the sensor becomes active while the axis
+  // moves in _homeSyncDirn and the latch is held until taken by the main loop
+  bool _homeSyncAnyEnabled;
+  bool _homeSyncEnabled[RobotConsts::MAX_AXES];
+  int32_t _homeSyncDirn[RobotConsts::MAX_AXES];
+  bool _homeSyncWasActive[RobotConsts::MAX_AXES];
+  volatile bool _homeSyncLatched[RobotConsts::MAX_AXES];
+  volatile int32_t _homeSyncLatchSteps[RobotConsts::MAX_AXES];
+  // _stepsRebaseCount when latched - shows if the counts were rebased after the edge
+  volatile uint32_t _homeSyncLatchRebaseCount[RobotConsts::MAX_AXES];
   // Current step rate (in steps per K ticks)
   uint32_t _curStepRatePerTTicks;
   // Accumulators for stepping and acceleration increments
   uint32_t _curAccumulatorStep;
   uint32_t _curAccumulatorNS;
   uint32_t _curAccumulatorRelative[RobotConsts::MAX_AXES];
+  // Time elapsed in the current dwell block
+  uint32_t _dwellMsElapsed;
+  // Last event block reached and count of events reached (read by the main loop)
+  volatile int _lastEventId;
+  volatile uint32_t _eventsReached;
 
 public:
   MotionActuator(MotionIO& motionIO, MotionPipeline& motionPipeline) :
     _motionPipeline(motionPipeline)
   {
     // Init
+    _stepPulseWidthUs       = stepPulseWidthUs_default;
+    _stepPulseWidthSysTicks = 0;
+    _stepPulseEndInIsr      = false;
+    _stepPulsesPending      = false;
+    _stepPulsesStartSysTicks = 0;
+    _stepsRebaseCount       = 0;
+    _dwellMsElapsed         = 0;
+    _lastEventId            = 0;
+    _eventsReached          = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _stepDirn[axisIdx]          = 1;
+      _axisStepsFromHome[axisIdx] = 0;
+      _homeSyncEnabled[axisIdx]   = false;
+      _homeSyncDirn[axisIdx]      = 1;
+      _homeSyncWasActive[axisIdx] = false;
+      _homeSyncLatched[axisIdx]   = false;
+      _homeSyncLatchSteps[axisIdx] = 0;
+      _homeSyncLatchRebaseCount[axisIdx] = 0;
+    }
+    _homeSyncAnyEnabled = false;
     clear();
 
+    // Allocate a channel index - the channel is serviced by the ISR once configured
+    _motionChannelIdx = -1;
+    for (int chanIdx = 0; chanIdx < MAX_MOTION_CHANNELS; chanIdx++)
+    {
+      if (_pMotionActuators[chanIdx] == NULL)
+      {
+        _motionChannelIdx = chanIdx;
+        _pMotionActuators[chanIdx] = this;
+        break;
+      }
+    }
+    if (_motionChannelIdx < 0)
+      Log.error("MotionActuator: too many motion channels (max %d)", MAX_MOTION_CHANNELS);
+
     // If we are using the ISR then create the Spark Interval Timer and start it
 #ifdef USE_SPARK_INTERVAL_TIMER_ISR
-    if (_pMotionActuatorInstance == NULL)
+    if (!_isrMotionTimerStarted)
     {
-      _pMotionActuatorInstance = this;
+      _isrMotionTimerStarted = true;
       _isrMotionTimer.begin(_isrStepperMotion, ISR_TIMER_PERIOD_US, uSec);
       Log.info("MotionActuator: Starting ISR timer");
     }
 #endif
   }
 
+  ~MotionActuator()
+  {
+    // Stop the ISR servicing this channel
+    isrRemove();
+    if (_motionChannelIdx >= 0)
+      _pMotionActuators[_motionChannelIdx] = NULL;
+  }
+
+  int getMotionChannelIdx()
+  {
+    return _motionChannelIdx;
+  }
+
   void setRawMotionHwInfo(RobotConsts::RawMotionHwInfo_t& rawMotionHwInfo)
   {
     _rawMotionHwInfo = rawMotionHwInfo;
@@ -92,13 +198,23 @@ public:
 #endif
   }
 
-  void config()
+  void configure(const char* robotConfigJSON)
   {
+    // Step pulse width
+    _stepPulseWidthUs       = uint32_t(RdJson::getLong("stepPulseWidthUs", stepPulseWidthUs_default, robotConfigJSON));
+    _stepPulseWidthSysTicks = _stepPulseWidthUs * System.ticksPerMicrosecond();
+    _stepPulseEndInIsr      = _stepPulseWidthUs <= MAX_IN_ISR_STEP_PULSE_US;
+    Log.info("MotionActuator: stepPulseWidthUs %lu, pulse ended %s", _stepPulseWidthUs,
+             _stepPulseEndInIsr ? "in same tick" : "on next tick");
+
+    // Now configured so service this channel in the ISR
+    isrAdd();
   }
 
   void clear()
   {
     _isPaused = true;
+    _feedHoldState = FEED_HOLD_NONE;
     _endStopReached = false;
     _lastDoneNumberedCmdIdx = RobotConsts::NUMBERED_COMMAND_NONE;
 #ifdef TEST_MOTION_ACTUATOR_ENABLE
@@ -115,6 +231,32 @@ public:
     }
   }
 
+  // Start a feed hold - the current block decelerates at max acceleration (continuing into
+  // following blocks if needed) and motion then waits at the stop point
+  void feedHoldStart()
+  {
+    if (_feedHoldState != FEED_HOLD_NONE)
+      return;
+    MotionBlock* pBlock = _motionPipeline.peekGet();
+    if (pBlock && pBlock->_isExecuting)
+      _feedHoldState = FEED_HOLD_DECELERATING;
+    else
+      _feedHoldState = FEED_HOLD_STOPPED;
+  }
+
+  // End the feed hold - only valid once stopped and after the pipeline has been replanned
+  void feedHoldEnd()
+  {
+    _feedHoldState = FEED_HOLD_NONE;
+  }
+
+  FeedHoldState getFeedHoldState()
+  {
+    return _feedHoldState;
+  }
+
+  bool feedHoldTrimBlock();
+
   void clearEndstopReached()
   {
     _endStopReached = false;
@@ -129,6 +271,80 @@ public:
   {
     return _lastDoneNumberedCmdIdx;
   }
+
+  // Id of the last event block reached and the number reached so far
+  int getLastEventId()
+  {
+    return _lastEventId;
+  }
+
+  uint32_t getEventsReached()
+  {
+    return _eventsReached;
+  }
+
+  // Get the live step counts - retried if the ISR rebased them part way through
+  void getAxisStepsFromHome(AxisInt32s& stepsFromHome)
+  {
+    uint32_t rebaseCount = 0;
+    do
+    {
+      rebaseCount = _stepsRebaseCount;
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        stepsFromHome.vals[axisIdx] = _axisStepsFromHome[axisIdx];
+    } while (rebaseCount != _stepsRebaseCount);
+  }
+
+  uint32_t getStepsRebaseCount()
+  {
+    return _stepsRebaseCount;
+  }
+
+  // Set or change the live step counts - only when the pipeline is empty (otherwise changes are
+  // passed in the blocks so that they happen at the right point in the motion)
+  void setAxisStepsFromHome(AxisInt32s& stepsFromHome)
+  {
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      _axisStepsFromHome[axisIdx] = stepsFromHome.vals[axisIdx];
+    _stepsRebaseCount++;
+  }
+  void rebaseAxisStepsFromHome(const int32_t stepsRebase[])
+  {
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      _axisStepsFromHome[axisIdx] += stepsRebase[axisIdx];
+    _stepsRebaseCount++;
+  }
+
+  // Enable latching of the step count on the home sensor (endStop0) edge while moving in the
+  // given direction - call after setRawMotionHwInfo()
+  void setHomeSync(int axisIdx, bool enable, int32_t dirn)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES)
+      return;
+    int pin = _rawMotionHwInfo._axis[axisIdx]._pinEndStopMin;
+    _homeSyncEnabled[axisIdx] = false;
+    _homeSyncLatched[axisIdx] = false;
+    _homeSyncDirn[axisIdx]    = (dirn >= 0) ? 1 : -1;
+    if (enable && (pin >= 0))
+      _homeSyncWasActive[axisIdx] = (pinReadFast(pin) != 0) == _rawMotionHwInfo._axis[axisIdx]._pinEndStopMinactLvl;
+    _homeSyncEnabled[axisIdx] = enable && (pin >= 0);
+    _homeSyncAnyEnabled = false;
+    for (int i = 0; i < RobotConsts::MAX_AXES; i++)
+      _homeSyncAnyEnabled |= _homeSyncEnabled[i];
+  }
+
+  // Take the step count latched at the home sensor edge (if there is one) along with the rebase
+  // count at the time
+  bool takeHomeSyncLatch(int axisIdx, int32_t& latchSteps, uint32_t& latchRebaseCount)
+  {
+    if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES || !_homeSyncLatched[axisIdx])
+      return false;
+    latchSteps = _homeSyncLatchSteps[axisIdx];
+    latchRebaseCount = _homeSyncLatchRebaseCount[axisIdx];
+    _homeSyncLatched[axisIdx] = false;
+    return true;
+  }
+
   void process();
 
   String getDebugStr();
@@ -139,4 +355,9 @@ private:
   static void _isrStepperMotion(void);
 #endif
   void procTick();
+  void procSpecialBlock(MotionBlock* pBlock);
+  void homeSyncCheck(int axisIdx);
+  void endStepPulses();
+  void isrAdd();
+  void isrRemove();
 };
@@ -19,15 +19,34 @@ public:
   static constexpr uint32_t TTICKS_VALUE = 1000000000l;
 
   // Tick interval in NS
-  // 20000NS means max of 25k steps per second (as each step requires 2 entries to ISR - at least)
-  // The ISR time is now averaging 1.3uS and max 2.8uS so this could be reduced to 10000 if needed
+  // 20000NS means max of 50k steps per second when the step pulse is ended within the ISR (see
+  // stepPulseWidthUs in MotionActuator) or 25k steps per second if a long pulse is configured
+  // (as each step then requires 2 entries to ISR - at least)
+  // The ISR time is now averaging 1.3uS (plus the pulse width) and max 2.8uS so this could be reduced to 10000 if needed
   static constexpr uint32_t TICK_INTERVAL_NS = 20000;
   static constexpr float TICKS_PER_SEC       = (1e9f / TICK_INTERVAL_NS);
 
   // Number of ns in ms
   static constexpr uint32_t NS_IN_A_MS = 1000000;
 
+  // Kinds of block - dwell (a timed pause) and event (signalled by the actuator when reached)
+  // blocks have no steps and are planned as zero-speed junctions
+  enum BlockType
+  {
+    BLOCK_MOVE,
+    BLOCK_DWELL,
+    BLOCK_EVENT
+  };
+
 public:
+  // Kind of block
+  BlockType _blockType;
+  // Dwell time for dwell blocks
+  uint32_t _dwellMs;
+  // Event id and optional output pin (-1 if none) set to a level when an event block is reached
+  int _eventId;
+  int _eventPin;
+  bool _eventPinLevel;
   // Max speed for move (maybe reduced by feedrate in a GCode command)
   float _feedrateMMps;
   // Distance (pythagorean) to move considering primary axes only
@@ -38,11 +57,20 @@ public:
   float _entrySpeedMMps;
   // Computed exit speed for this block
   float _exitSpeedMMps;
+  // Max acceleration along the path - limited so that no actuator exceeds its own acceleration
+  float _maxAccMMps2;
+  // Steps of the axis with most steps per mm along the path - 0 if speeds are in the units of
+  // that axis (stepwise moves)
+  float _masterAxisStepsPerMM;
   // End-stops to test
   AxisMinMaxBools _endStopsToCheck;
   // Numbered command index - to help keep track of block execution from other processes
   // like homing
   int _numberedCommandIndex;
+  // Change to the absolute step counts made by the planner before this block was planned (e.g.
+  // whole rotations removed by correctStepOverflow) - applied by the actuator when the block starts
+  bool _hasStepsRebase;
+  int32_t _stepsRebase[RobotConsts::MAX_AXES];
 
   // Flags
   struct
@@ -73,11 +101,18 @@ public:
   void clear()
   {
     // Clear values
+    _blockType                = BLOCK_MOVE;
+    _dwellMs                  = 0;
+    _eventId                  = 0;
+    _eventPin                 = -1;
+    _eventPinLevel            = false;
     _feedrateMMps             = 0;
     _moveDistPrimaryAxesMM    = 0;
     _maxEntrySpeedMMps        = 0;
     _entrySpeedMMps           = 0;
     _exitSpeedMMps            = 0;
+    _maxAccMMps2              = 0;
+    _masterAxisStepsPerMM     = 0;
     _isExecuting              = false;
     _canExecute               = false;
     _axisIdxWithMaxSteps      = 0;
@@ -87,9 +122,32 @@ public:
     _maxStepRatePerTTicks     = 0;
     _stepsBeforeDecel         = 0;
     _numberedCommandIndex     = 0;
+    _hasStepsRebase           = false;
     _endStopsToCheck.none();
     for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
       _stepsTotalMaybeNeg[axisIdx] = 0;
+      _stepsRebase[axisIdx]        = 0;
+    }
+  }
+
+  bool isMove()
+  {
+    return _blockType == BLOCK_MOVE;
+  }
+
+  void setDwell(uint32_t dwellMs)
+  {
+    _blockType = BLOCK_DWELL;
+    _dwellMs   = dwellMs;
+  }
+
+  void setEvent(int eventId, int eventPin, bool eventPinLevel)
+  {
+    _blockType     = BLOCK_EVENT;
+    _eventId       = eventId;
+    _eventPin      = eventPin;
+    _eventPinLevel = eventPinLevel;
   }
 
   void setNumberedCommandIndex(int cmdIdx)
@@ -128,6 +186,42 @@ public:
     }
   }
 
+  // Change the block to cover only the steps remaining after those already done
+  // The block then starts from a standstill and needs to be replanned before it can execute
+  void trimToRemainingSteps(const uint32_t stepsDone[])
+  {
+    int32_t absMaxStepsOrig = abs(_stepsTotalMaybeNeg[_axisIdxWithMaxSteps]);
+    int32_t absMaxStepsRemaining = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      int32_t stepsRemaining = abs(_stepsTotalMaybeNeg[axisIdx]) - int32_t(stepsDone[axisIdx]);
+      if (stepsRemaining < 0)
+        stepsRemaining = 0;
+      _stepsTotalMaybeNeg[axisIdx] = (_stepsTotalMaybeNeg[axisIdx] < 0) ? -stepsRemaining : stepsRemaining;
+      if (stepsRemaining > absMaxStepsRemaining)
+      {
+        absMaxStepsRemaining = stepsRemaining;
+        _axisIdxWithMaxSteps = axisIdx;
+      }
+    }
+    if (absMaxStepsOrig > 0)
+      _moveDistPrimaryAxesMM = _moveDistPrimaryAxesMM * absMaxStepsRemaining / absMaxStepsOrig;
+    if ((_masterAxisStepsPerMM > 0) && (_moveDistPrimaryAxesMM > 0))
+      _masterAxisStepsPerMM = absMaxStepsRemaining / _moveDistPrimaryAxesMM;
+    _maxEntrySpeedMMps = 0;
+    _entrySpeedMMps    = 0;
+    _canExecute        = false;
+    _isExecuting       = false;
+  }
+
+  // Change a dwell block to cover only the time remaining (used when resuming from a feed hold)
+  void trimDwell(uint32_t dwellMsDone)
+  {
+    _dwellMs      = (dwellMsDone < _dwellMs) ? _dwellMs - dwellMsDone : 0;
+    _canExecute   = false;
+    _isExecuting  = false;
+  }
+
   uint32_t getExitStepRatePerTTicks()
   {
     return _finalStepRatePerTTicks;
@@ -161,13 +255,28 @@ public:
     if (_isExecuting)
       return;
 
+    // Dwell and event blocks have no stepping profile
+    if (!isMove())
+    {
+      _canExecute = true;
+      return;
+    }
+
     // Find the max number of steps for any axis
     uint32_t absMaxStepsForAnyAxis = abs(_stepsTotalMaybeNeg[_axisIdxWithMaxSteps]);
 
-    // Get the initial step rate, final step rate and max acceleration for the axis with max steps
-    float initialStepRatePerSec = _entrySpeedMMps / axesParams.getStepDistMM(_axisIdxWithMaxSteps);
-    float finalStepRatePerSec   = _exitSpeedMMps / axesParams.getStepDistMM(_axisIdxWithMaxSteps);
-    float axisAccStepsPerSec2   = axesParams.getMaxAccStepsPerSec2(_axisIdxWithMaxSteps);
+    // Steps per mm along the path and acceleration for the axis with max steps
+    float stepsPerMM          = _masterAxisStepsPerMM;
+    float axisAccStepsPerSec2 = _maxAccMMps2 * stepsPerMM;
+    if (stepsPerMM <= 0)
+    {
+      stepsPerMM          = 1 / axesParams.getStepDistMM(_axisIdxWithMaxSteps);
+      axisAccStepsPerSec2 = axesParams.getMaxAccStepsPerSec2(_axisIdxWithMaxSteps);
+    }
+
+    // Get the initial step rate and final step rate for the axis with max steps
+    float initialStepRatePerSec = _entrySpeedMMps * stepsPerMM;
+    float finalStepRatePerSec   = _exitSpeedMMps * stepsPerMM;
 
     // Calculate the distance decelerating and ensure within bounds
     // Using the facts for the block ... (assuming max accleration followed by max deceleration):
@@ -190,7 +299,7 @@ public:
     uint32_t stepsDecelerating = 0;
 
     // Find max possible rate for this axis
-    float axisMaxStepRatePerSec = _feedrateMMps / axesParams.getStepDistMM(_axisIdxWithMaxSteps);
+    float axisMaxStepRatePerSec = _feedrateMMps * stepsPerMM;
 
     // See if max speed will be reached
     uint32_t stepsToMaxSpeed =
@@ -220,7 +329,7 @@ public:
     _initialStepRatePerTTicks = uint32_t((initialStepRatePerSec * TTICKS_VALUE) / TICKS_PER_SEC);
     _maxStepRatePerTTicks     = uint32_t((axisMaxStepRatePerSec * TTICKS_VALUE) / TICKS_PER_SEC);
     _finalStepRatePerTTicks   = uint32_t((finalStepRatePerSec * TTICKS_VALUE) / TICKS_PER_SEC);
-    _accStepsPerTTicksPerMS   = uint32_t(axesParams.getMaxAccStepsPerTTicksPerMs(_axisIdxWithMaxSteps, TTICKS_VALUE, TICKS_PER_SEC));
+    _accStepsPerTTicksPerMS   = uint32_t((TTICKS_VALUE * axisAccStepsPerSec2) / TICKS_PER_SEC / 1000);
     _stepsBeforeDecel         = absMaxStepsForAnyAxis - stepsDecelerating;
 
     // No more changes
@@ -230,16 +339,25 @@ public:
 
   void debugShowBlkHead()
   {
-    Log.info("#i EntMMps ExtMMps StTotX StTotY StTotZ St>Dec    Init      Pk     Fin     Acc");
+    // Steps column for each axis
+    static const char AXIS_NAMES[] = "XYZABC";
+    char stepsHead[7 * RobotConsts::MAX_AXES + 1];
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      snprintf(stepsHead + axisIdx * 7, 8, " StTot%c", AXIS_NAMES[axisIdx]);
+    Log.info("#i EntMMps ExtMMps%s St>Dec    Init      Pk     Fin     Acc", stepsHead);
   }
 
   void debugShowBlock(int elemIdx, AxesParams& axesParams)
   {
-    Log.info("%2d%8.3f%8.3f%7ld%7ld%7ld%7lu%8.3f%8.3f%8.3f%8lu", elemIdx,
+    // Steps column for each axis
+    char stepsStr[12 * RobotConsts::MAX_AXES + 1];
+    int stepsStrLen = 0;
+    stepsStr[0] = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      stepsStrLen += snprintf(stepsStr + stepsStrLen, sizeof(stepsStr) - stepsStrLen, "%7ld", getStepsToTarget(axisIdx));
+    Log.info("%2d%8.3f%8.3f%s%7lu%8.3f%8.3f%8.3f%8lu", elemIdx,
              _entrySpeedMMps, _exitSpeedMMps,
-             getStepsToTarget(0),
-             getStepsToTarget(1),
-             getStepsToTarget(2),
+             stepsStr,
              _stepsBeforeDecel,
              DEBUG_STEP_TTICKS_TO_MMPS(_initialStepRatePerTTicks, axesParams, 0),
              DEBUG_STEP_TTICKS_TO_MMPS(_maxStepRatePerTTicks, axesParams, 0),
@@ -9,11 +9,14 @@
 
 MotionHelper::MotionHelper() :
   _motionActuator(_motionIO, _motionPipeline),
-  _motionHoming(this)
+  _motionHoming(this),
+  _jobValidator(_validatePointChecker, validatorMicros)
 {
   // Init
   _isPaused        = false;
+  _feedHoldResumePending = false;
   _moveRelative    = false;
+  _extrudeFactor   = 1.0f;
   _xMaxMM          = 0;
   _yMaxMM          = 0;
   _blockDistanceMM = 0;
@@ -23,8 +26,18 @@ MotionHelper::MotionHelper() :
   _ptToActuatorFn        = NULL;
   _actuatorToPtFn        = NULL;
   _correctStepOverflowFn = NULL;
+  _ptsToActuatorFn       = NULL;
+  _blocksToAddFn         = NULL;
+  _blocksToAddLinear     = false;
   // Handling of splitting-up of motion into smaller blocks
   _blocksToAddTotal = 0;
+  // Live position
+  _livePosition.clear();
+  _livePositionValid    = false;
+  _livePositionLastMs   = 0;
+  _livePositionUpdateMs = livePositionUpdateMs_default;
+  // Job validation
+  _validateBudgetUs = validateBudgetUs_default;
 }
 
 // Destructor
@@ -36,13 +49,18 @@ MotionHelper::~MotionHelper()
 // to actuator coordinates
 // There is also a function to correct step overflow which is important in robots
 // which have continuous rotation as step counts would otherwise overflow 32bit integer values
+// Robots can optionally provide a batch version of ptToActuator which is used when a move is
+// split into blocks - robots whose transform depends on the current position shouldn't
 void MotionHelper::setTransforms(ptToActuatorFnType ptToActuatorFn, actuatorToPtFnType actuatorToPtFn,
-                                 correctStepOverflowFnType correctStepOverflowFn)
+                                 correctStepOverflowFnType correctStepOverflowFn,
+                                 ptsToActuatorFnType ptsToActuatorFn)
 {
   // Store callbacks
   _ptToActuatorFn        = ptToActuatorFn;
   _actuatorToPtFn        = actuatorToPtFn;
   _correctStepOverflowFn = correctStepOverflowFn;
+  _ptsToActuatorFn       = ptsToActuatorFn;
+  _blocksToAddFn         = ptsToActuatorFn ? &MotionHelper::blocksToAddBatch : NULL;
 }
 
 // Configure the robot and pipeline parameters using a JSON input string
@@ -58,6 +76,7 @@ void MotionHelper::configure(const char* robotConfigJSON)
   // Motion Pipeline and Planner
   float junctionDeviation = float(RdJson::getDouble("junctionDeviation", junctionDeviation_default, robotConfigJSON));
   _motionPlanner.configure(junctionDeviation);
+  _extrudeFactor = 1.0f;
 
   // MotionIO
   _motionIO.deinit();
@@ -89,9 +108,29 @@ void MotionHelper::configure(const char* robotConfigJSON)
   RobotConsts::RawMotionHwInfo_t rawMotionHwInfo;
   _motionIO.getRawMotionHwInfo(rawMotionHwInfo);
   _motionActuator.setRawMotionHwInfo(rawMotionHwInfo);
+  _motionActuator.configure(robotConfigJSON);
+
+  // Home sensor resync during motion
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    int32_t syncSteps = 0, maxSteps = 0, wrapSteps = 0;
+    int syncDirn = 1;
+    bool homeSync = _axesParams.getHomeSync(axisIdx, syncSteps, syncDirn, maxSteps, wrapSteps);
+    _motionActuator.setHomeSync(axisIdx, homeSync, syncDirn);
+  }
+
+  // Live position update rate
+  _livePositionUpdateMs = RdJson::getLong("livePositionUpdateMs", livePositionUpdateMs_default, robotConfigJSON);
+
+  // Job validation time budget per service call
+  _validateBudgetUs = RdJson::getLong("validateBudgetUs", validateBudgetUs_default, robotConfigJSON);
+  _jobValidator.stop();
 
   // Clear motion info
   _curAxisPosition.clear();
+  _motionPlanner.clearStepsRebase();
+  _motionActuator.setAxisStepsFromHome(_curAxisPosition._stepsFromHome);
+  _livePositionValid = false;
 }
 
 // Check if a command can be accepted into the motion pipeline
@@ -102,23 +141,78 @@ bool MotionHelper::canAccept()
 }
 
 // Pause (or un-pause) all motion
+// Pausing is a feed hold - motion decelerates to a stop so no steps are lost and on resume the
+// remaining path is replanned from a standstill
 void MotionHelper::pause(bool pauseIt)
 {
-  _motionActuator.pause(pauseIt);
+  if (pauseIt)
+  {
+    _motionActuator.feedHoldStart();
+    _feedHoldResumePending = false;
+  }
+  else
+  {
+    _feedHoldResumePending = true;
+    feedHoldResumeProcess();
+  }
   _isPaused = pauseIt;
 }
 
+// Resume from a feed hold once deceleration has completed
+void MotionHelper::feedHoldResumeProcess()
+{
+  if (!_feedHoldResumePending)
+    return;
+  if (_motionActuator.getFeedHoldState() == MotionActuator::FEED_HOLD_DECELERATING)
+    return;
+
+  // Replan from the stop point
+  if (_motionActuator.feedHoldTrimBlock())
+    _motionPlanner.recalculatePipeline(_motionPipeline, _axesParams, true);
+  _motionActuator.feedHoldEnd();
+  _motionActuator.pause(false);
+  _feedHoldResumePending = false;
+}
+
 // Check if paused
 bool MotionHelper::isPaused()
 {
   return _isPaused;
 }
 
-// Stop
+// Stop - queued blocks are discarded and the planner's position is resynced to where the robot
+// actually stopped (changes to the step counts carried by discarded blocks or still waiting in
+// the planner are applied to the actuator first so they aren't lost)
 void MotionHelper::stop()
 {
+  // Paused so the ISR doesn't start a block (and apply its change) while the pipeline is cleared
+  _motionActuator.pause(true);
+  int32_t stepsRebase[RobotConsts::MAX_AXES];
+  _motionPlanner.takeStepsRebase(stepsRebase);
+  for (unsigned int blockIdx = 0; blockIdx < _motionPipeline.count(); blockIdx++)
+  {
+    MotionBlock* pBlock = _motionPipeline.peekNthFromGet(blockIdx);
+    if (!pBlock || !pBlock->_hasStepsRebase)
+      continue;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      stepsRebase[axisIdx] += pBlock->_stepsRebase[axisIdx];
+  }
   _motionPipeline.clear();
   _motionActuator.clear();
+  _motionActuator.rebaseAxisStepsFromHome(stepsRebase);
+  _motionPlanner.motionStopped();
+  _blocksToAddTotal = 0;
+
+  // Resync
+  _motionActuator.getAxisStepsFromHome(_curAxisPosition._stepsFromHome);
+  if (_actuatorToPtFn)
+  {
+    AxisFloats actuatorPos;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      actuatorPos.setVal(axisIdx, float(_curAxisPosition._stepsFromHome.getVal(axisIdx)));
+    _actuatorToPtFn(actuatorPos, _curAxisPosition._axisPositionMM, _curAxisPosition, _axesParams);
+  }
+  _livePositionValid = false;
   pause(false);
 }
 
@@ -136,12 +230,66 @@ void MotionHelper::setMotionParams(RobotCommandArgs& args)
     _moveRelative = (args.getMoveType() == RobotMoveTypeArg_Relative);
 }
 
+// Change motion limits in place without reconfiguring - this is called between commands (so
+// after all the blocks of the previous move have been added) and blocks already in the pipeline
+// keep the limits they were planned with
+void MotionHelper::setMotionTuning(MotionTuning& tuning)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    if (tuning.isMaxAccValid(axisIdx))
+      _axesParams.setMaxAccel(axisIdx, tuning._maxAccMMps2[axisIdx]);
+    if (tuning.isMaxSpeedValid(axisIdx))
+      _axesParams.setMaxSpeed(axisIdx, tuning._maxSpeedMMps[axisIdx]);
+  }
+  if (tuning._pathAccValid)
+    _motionPlanner.setMaxPathAcc(tuning._pathAccMMps2);
+  if (tuning._junctionDeviationValid)
+    _motionPlanner.setJunctionDeviation(tuning._junctionDeviation);
+  if (tuning._feedrateOverrideValid)
+    _motionPlanner.setFeedrateFactor(tuning._feedrateOverridePC / 100);
+  if ((tuning._extrudeOverrideValid) && (tuning._extrudeOverridePC > 0))
+    _extrudeFactor = tuning._extrudeOverridePC / 100;
+}
+
+// Add a dwell to the pipeline - motion decelerates to a stop, waits and then continues without
+// the pipeline being drained
+bool MotionHelper::dwell(uint32_t dwellMs, int numberedCmdIdx)
+{
+  if (!canAccept())
+    return false;
+  MotionBlock block;
+  block.setDwell(dwellMs);
+  block.setNumberedCommandIndex(numberedCmdIdx);
+  return _motionPlanner.addSpecialBlock(block, _axesParams, _motionPipeline);
+}
+
+// Add an event marker to the pipeline - when motion reaches it the output pin (if not -1) is set
+// to the level and the event id is reported in the status
+// The pin is only made an output when the event is reached and a pin used for motion (step,
+// direction, enable, servo or end-stop) is refused
+bool MotionHelper::addEvent(int eventId, int eventPin, bool eventPinLevel, int numberedCmdIdx)
+{
+  if (!canAccept())
+    return false;
+  if ((eventPin >= 0) && _motionIO.isPinInUse(eventPin))
+  {
+    Log.error("MotionHelper event pin %d is used for motion", eventPin);
+    return false;
+  }
+  MotionBlock block;
+  block.setEvent(eventId, eventPin, eventPinLevel);
+  block.setNumberedCommandIndex(numberedCmdIdx);
+  return _motionPlanner.addSpecialBlock(block, _axesParams, _motionPipeline);
+}
+
 // Get current status of robot
 void MotionHelper::getCurStatus(RobotCommandArgs& args)
 {
-  // Get current position
-  args.setPointMM(_curAxisPosition._axisPositionMM);
-  args.setPointSteps(_curAxisPosition._stepsFromHome);
+  // Get current position (where the robot actually is rather than the end of the planned motion)
+  AxisPosition& livePosition = getLivePosition();
+  args.setPointMM(livePosition._axisPositionMM);
+  args.setPointSteps(livePosition._stepsFromHome);
   // Get end-stop values
   args.setEndStops(_motionIO.getEndStopVals());
   // Absolute/Relative movement
@@ -150,6 +298,8 @@ void MotionHelper::getCurStatus(RobotCommandArgs& args)
   args.setPause(_isPaused);
   // Queue length
   args.setNumQueued(_motionPipeline.count());
+  // Events reached
+  args.setEvents(_motionActuator.getLastEventId(), _motionActuator.getEventsReached());
 }
 
 // Command the robot to home one or more axes
@@ -161,11 +311,19 @@ void MotionHelper::goHome(RobotCommandArgs& args)
 // Command the robot to move (adding a command to the pipeline of motion)
 bool MotionHelper::moveTo(RobotCommandArgs& args)
 {
-  // Handle stepwise motion
+  // Handle stepwise motion - homing moves are planned on their own (starting and ending at rest)
+  // and other moves in steps (e.g. from the binary protocol) are planned like any other move
   if (args.isStepwise())
   {
+    if (!_motionHoming.isHomingInProgress())
+      return moveToSteps(args);
     _motionPlanner.moveToStepwise(args, _curAxisPosition, _axesParams, _motionPipeline);
+    return true;
   }
+  // Extrusion override
+  if (args.isExtrudeValid() && (_extrudeFactor != 1.0f))
+    args.setExtrude(args.getExtrude() * _extrudeFactor);
+
   // Fill in the destPos for axes for which values not specified
   // Handle relative motion override if present
   // Don't use servo values for computing distance to travel
@@ -216,6 +374,39 @@ bool MotionHelper::moveTo(RobotCommandArgs& args)
   return true;
 }
 
+// Move to a position given in steps - the destination is converted to a point so the move is
+// planned with look-ahead and the position in mm is kept in step with the step counts
+// The move isn't split into blocks as the steps are the exact destination
+bool MotionHelper::moveToSteps(RobotCommandArgs& args)
+{
+  if (!_actuatorToPtFn)
+  {
+    Log.error("MotionHelper: move in steps not supported by this robot");
+    return false;
+  }
+  AxisFloats actuatorCoords;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    int32_t steps = _curAxisPosition._stepsFromHome.getVal(axisIdx);
+    if (args.isValid(axisIdx))
+    {
+      if (args.getMoveType() == RobotMoveTypeArg_Relative)
+        steps += args.getPointSteps().getVal(axisIdx);
+      else
+        steps = args.getPointSteps().getVal(axisIdx);
+    }
+    actuatorCoords.setVal(axisIdx, float(steps));
+  }
+  // Axes the robot doesn't convert stay where they are
+  AxisFloats destPos = _curAxisPosition._axisPositionMM;
+  _actuatorToPtFn(actuatorCoords, destPos, _curAxisPosition, _axesParams);
+  args.setPointMM(destPos);
+  if (!addToPlanner(args, actuatorCoords))
+    return false;
+  _motionIO.enableMotors(true, false);
+  return true;
+}
+
 // A single moveTo command can be split into blocks - this function checks if such
 // splitting is in progress and adds the split-up motion blocks accordingly
 void MotionHelper::blocksToAddProcess()
@@ -227,6 +418,13 @@ void MotionHelper::blocksToAddProcess()
     if (_blocksToAddTotal <= 0)
       return;
 
+    // Convert as many blocks as possible in one go if the robot supports it
+    if (_blocksToAddFn)
+    {
+      (this->*_blocksToAddFn)();
+      continue;
+    }
+
     // Add to pipeline any blocks that are waiting to be expanded out
     AxisFloats nextBlockDest = _blocksToAddStartPos + _blocksToAddDelta * float(_blocksToAddCurBlock + 1);
 
@@ -250,23 +448,114 @@ void MotionHelper::blocksToAddProcess()
   }
 }
 
+// Add the next batch of split-up blocks - the destinations are generated and converted to
+// actuator coordinates with a single call to the robot's batch transform
+void MotionHelper::blocksToAddBatch()
+{
+  int numPts = blocksToAddBatchPts();
+  if (numPts <= 0)
+    return;
+
+  // Convert to actuator coordinates
+  _ptsToActuatorFn(_blocksToAddPts, _blocksToAddActuator, _curAxisPosition, _axesParams,
+                   _blocksToAddCommandArgs.getAllowOutOfBounds());
+  blocksToAddBatchPlan(numPts);
+
+  // The batch was converted in a single frame of step counts so only rebase once it is planned
+  correctStepOverflow();
+
+  // Enable motors
+  _motionIO.enableMotors(true, false);
+}
+
+// Generate the destinations of the next batch of split-up blocks - returns the number of blocks
+int MotionHelper::blocksToAddBatchPts()
+{
+  // Number of blocks in this batch - limited by space in the pipeline
+  int numPts = _blocksToAddTotal - _blocksToAddCurBlock;
+  if (numPts > int(_motionPipeline.slotsFree()))
+    numPts = _motionPipeline.slotsFree();
+  if (numPts > AxisFloatsBatch::MAX_POINTS)
+    numPts = AxisFloatsBatch::MAX_POINTS;
+  if (numPts <= 0)
+    return 0;
+
+  // Destinations
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    float* pVals    = _blocksToAddPts.axisVals(axisIdx);
+    float startVal  = _blocksToAddStartPos._pt[axisIdx];
+    float deltaVal  = _blocksToAddDelta._pt[axisIdx];
+    int firstBlock  = _blocksToAddCurBlock + 1;
+    for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+      pVals[ptIdx] = startVal + deltaVal * float(firstBlock + ptIdx);
+  }
+  _blocksToAddPts._count = numPts;
+
+  // If last block then just use end point coords
+  _blocksToAddCurBlock += numPts;
+  if (_blocksToAddCurBlock >= _blocksToAddTotal)
+  {
+    _blocksToAddPts.setPoint(numPts - 1, _blocksToAddEndPos._pt);
+    _blocksToAddTotal = 0;
+  }
+  return numPts;
+}
+
+// Add a converted batch of split-up blocks to the planner - points which couldn't be converted
+// are skipped
+void MotionHelper::blocksToAddBatchPlan(int numPts)
+{
+  AxisFloats nextBlockDest = _blocksToAddEndPos;
+  AxisFloats actuatorCoords;
+  for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+  {
+    if (!_blocksToAddActuator._ok[ptIdx])
+      continue;
+    _blocksToAddPts.getPoint(ptIdx, nextBlockDest._pt);
+    _blocksToAddActuator.getPoint(ptIdx, actuatorCoords._pt);
+    _blocksToAddCommandArgs.setPointMM(nextBlockDest);
+    addToPlanner(_blocksToAddCommandArgs, actuatorCoords, false);
+  }
+}
+
 // Add a movement to the pipeline using the planner which computes suitable motion
 bool MotionHelper::addToPlanner(RobotCommandArgs& args)
 {
   // Convert the move to actuator coordinates
   AxisFloats actuatorCoords;
-  _ptToActuatorFn(args.getPointMM(), actuatorCoords, _curAxisPosition, _axesParams, args.getAllowOutOfBounds());
+  if (!_ptToActuatorFn(args.getPointMM(), actuatorCoords, _curAxisPosition, _axesParams, args.getAllowOutOfBounds()))
+    return false;
+  return addToPlanner(args, actuatorCoords);
+}
 
+// Add a movement which has already been converted to actuator coordinates
+bool MotionHelper::addToPlanner(RobotCommandArgs& args, AxisFloats& actuatorCoords, bool correctOverflow)
+{
   // Plan the move
   bool moveOk = _motionPlanner.moveTo(args, actuatorCoords, _curAxisPosition, _axesParams, _motionPipeline);
   if (moveOk)
   {
     // Update axisMotion
     _curAxisPosition._axisPositionMM = args.getPointMM();
+    if (correctOverflow)
+      correctStepOverflow();
   }
   return moveOk;
 }
 
+// Let the robot rebase the step counts (e.g. continuously rotating axes) - the change is
+// recorded in the planner and carried by the next block added so the actuator's absolute counts
+// are rebased when that block starts (after the queued blocks, which are in the old frame)
+void MotionHelper::correctStepOverflow()
+{
+  if (!_correctStepOverflowFn)
+    return;
+  AxisInt32s prevStepsFromHome = _curAxisPosition._stepsFromHome;
+  _correctStepOverflowFn(_curAxisPosition, _axesParams);
+  stepsRebased(prevStepsFromHome);
+}
+
 // Called regularly to allow the MotionHelper to do background work such as
 // adding split-up blocks to the pipeline and checking if motors should be
 // disabled after a period of no motion
@@ -276,9 +565,18 @@ void MotionHelper::service()
   // motion is handled by ISR
   _motionActuator.process();
 
+  // Complete any resume from feed hold
+  feedHoldResumeProcess();
+
   // Process any split-up blocks to be added to the pipeline
   blocksToAddProcess();
 
+  // Correct the step counts from any home sensor edge seen while moving
+  homeSyncProcess();
+
+  // Pass any change in step counts to the actuator if there is no block to carry it
+  stepsRebaseWhenIdle();
+
   // Service MotionIO
   if (_motionPipeline.count() > 0)
     _motionIO.motionIsActive();
@@ -289,6 +587,37 @@ void MotionHelper::service()
   if (_motionHoming.isHomingInProgress())
     _motionIO.motionIsActive();
 
+  // Background job validation
+  if (_jobValidator.isRunning())
+  {
+    if (_jobValidator.service(_validateBudgetUs))
+    {
+      JobValidatorStatus& status = _jobValidator.getStatus();
+      Log.info("MotionHelper validate %s lines %d moves %d travel %0.1fmm failLine %d took %lums",
+               JobValidatorStatus::getStateStr(status._state), status._linesChecked, status._movesChecked,
+               status._travelMM, status._failLineNum, (unsigned long)(status._elapsedUs / 1000));
+      _validateJob = "";
+    }
+  }
+}
+
+// Start a pre-flight check of a job - the job is checked from the position the robot will be at
+// once the moves already planned are complete and uses the robot's own transforms
+void MotionHelper::validateJob(const String& job, JobValidatorPatternSource* pPatternSource)
+{
+  _jobValidator.stop();
+  if (!_ptToActuatorFn)
+    return;
+  _validateJob = job;
+  _validatePointChecker.setup(_ptToActuatorFn, _correctStepOverflowFn, _axesParams, _curAxisPosition);
+  float startPos[RobotConsts::MAX_AXES];
+  float homePos[RobotConsts::MAX_AXES];
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    startPos[axisIdx] = _curAxisPosition._axisPositionMM.getVal(axisIdx);
+    homePos[axisIdx]  = _axesParams.getHomeOffsetVal(axisIdx);
+  }
+  _jobValidator.start(_validateJob.c_str(), startPos, homePos, _moveRelative, pPatternSource);
 }
 
 // Set home coordinates
@@ -296,8 +625,145 @@ void MotionHelper::setCurPositionAsHome(int axisIdx)
 {
   if (axisIdx < 0 || axisIdx >= RobotConsts::MAX_AXES)
     return;
+  AxisInt32s prevStepsFromHome = _curAxisPosition._stepsFromHome;
   _curAxisPosition._axisPositionMM.setVal(axisIdx, _axesParams.getHomeOffsetVal(axisIdx));
   _curAxisPosition._stepsFromHome.setVal(axisIdx, _axesParams.gethomeOffSteps(axisIdx));
+  stepsRebased(prevStepsFromHome);
+}
+
+// The planner's step counts have been changed (other than by planning a move) - the actuator's
+// live step counts are changed to match when the next block starts (or immediately if idle)
+void MotionHelper::stepsRebased(AxisInt32s& prevStepsFromHome)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    _motionPlanner.addStepsRebase(axisIdx, _curAxisPosition._stepsFromHome.getVal(axisIdx) - prevStepsFromHome.getVal(axisIdx));
+  stepsRebaseWhenIdle();
+}
+
+// Only the main loop adds blocks so once the pipeline is empty the ISR isn't using the step counts
+void MotionHelper::stepsRebaseWhenIdle()
+{
+  if (!_motionPlanner.isStepsRebasePending() || _motionPipeline.canGet())
+    return;
+  int32_t stepsRebase[RobotConsts::MAX_AXES];
+  _motionPlanner.takeStepsRebase(stepsRebase);
+  _motionActuator.rebaseAxisStepsFromHome(stepsRebase);
+  _livePositionValid = false;
+}
+
+// Steps lost (or gained) are corrected when a home sensor edge is seen during normal motion
+// The step count latched by the actuator at the edge is compared with the count expected there
+// and the difference (limited to homeSyncMaxSteps per edge) is applied to the planner's step
+// counts and carried to the actuator in the next block so that later moves are planned from the
+// corrected position - nothing is done until homing has completed
+// The latched count is only in the planner's frame if every earlier change to the step counts
+// (a previous correction, home being set or overflow correction) had reached the actuator before
+// the edge - otherwise the edge is ignored (rather than corrected twice) and the next one is used
+void MotionHelper::homeSyncProcess()
+{
+  bool latched[RobotConsts::MAX_AXES];
+  int32_t latchSteps[RobotConsts::MAX_AXES];
+  bool anyLatched = false, latchesValid = true;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    uint32_t latchRebaseCount = 0;
+    latched[axisIdx] = _motionActuator.takeHomeSyncLatch(axisIdx, latchSteps[axisIdx], latchRebaseCount);
+    if (!latched[axisIdx])
+      continue;
+    anyLatched = true;
+    if (latchRebaseCount != _motionActuator.getStepsRebaseCount())
+      latchesValid = false;
+  }
+  if (!anyLatched)
+    return;
+  if (_motionHoming.isHomingInProgress() || !_motionHoming._isHomedOk)
+    return;
+  if (!latchesValid || !isStepsRebaseApplied())
+  {
+    Log.info("MotionHelper homeSync edge ignored as step counts are being rebased");
+    return;
+  }
+
+  AxisInt32s prevStepsFromHome = _curAxisPosition._stepsFromHome;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    if (!latched[axisIdx])
+      continue;
+    int32_t syncSteps = 0, maxSteps = 0, wrapSteps = 0;
+    int syncDirn = 1;
+    if (!_axesParams.getHomeSync(axisIdx, syncSteps, syncDirn, maxSteps, wrapSteps))
+      continue;
+
+    // Error - for continuously rotating axes this is the nearest equivalent position
+    int32_t stepsErr = latchSteps[axisIdx] - syncSteps;
+    if (wrapSteps > 0)
+    {
+      stepsErr %= wrapSteps;
+      if (stepsErr >= wrapSteps / 2)
+        stepsErr -= wrapSteps;
+      else if (stepsErr < -wrapSteps / 2)
+        stepsErr += wrapSteps;
+    }
+    if (stepsErr == 0)
+      continue;
+    int32_t correction = -stepsErr;
+    if (correction > maxSteps)
+      correction = maxSteps;
+    else if (correction < -maxSteps)
+      correction = -maxSteps;
+
+    // Apply
+    _curAxisPosition._stepsFromHome.vals[axisIdx] += correction;
+    Log.info("MotionHelper homeSync axis %d latched %ld expected %ld error %ld correction %ld",
+             axisIdx, latchSteps[axisIdx], syncSteps, stepsErr, correction);
+  }
+  stepsRebased(prevStepsFromHome);
+}
+
+// Check that every change to the step counts has been passed to the actuator - none is waiting
+// for a block to carry it and none is in a block the actuator hasn't started
+bool MotionHelper::isStepsRebaseApplied()
+{
+  if (_motionPlanner.isStepsRebasePending())
+    return false;
+  for (unsigned int blockIdx = 0; blockIdx < _motionPipeline.count(); blockIdx++)
+  {
+    MotionBlock* pBlock = _motionPipeline.peekNthFromGet(blockIdx);
+    if (pBlock && pBlock->_hasStepsRebase)
+      return false;
+  }
+  return true;
+}
+
+// Get the position the robot is actually at - the actuator's live step counts are converted with
+// the robot's actuatorToPt at most once per _livePositionUpdateMs and only if they have changed
+AxisPosition& MotionHelper::getLivePosition()
+{
+  if (_livePositionValid && !Utils::isTimeout(millis(), _livePositionLastMs, _livePositionUpdateMs))
+    return _livePosition;
+  _livePositionLastMs = millis();
+
+  // Check if moved
+  AxisInt32s stepsFromHome;
+  _motionActuator.getAxisStepsFromHome(stepsFromHome);
+  bool hasMoved = !_livePositionValid;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    if (stepsFromHome.getVal(axisIdx) != _livePosition._stepsFromHome.getVal(axisIdx))
+      hasMoved = true;
+  if (!hasMoved)
+    return _livePosition;
+
+  // Convert to a point
+  _livePosition._stepsFromHome = stepsFromHome;
+  if (_actuatorToPtFn)
+  {
+    AxisFloats actuatorPos;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      actuatorPos.setVal(axisIdx, float(stepsFromHome.getVal(axisIdx)));
+    _actuatorToPtFn(actuatorPos, _livePosition._axisPositionMM, _curAxisPosition, _axesParams);
+  }
+  _livePositionValid = true;
+  return _livePosition;
 }
 
 // Debug helper methods
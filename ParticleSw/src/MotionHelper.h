@@ -11,6 +11,9 @@
 #include "MotionIO.h"
 #include "MotionActuator.h"
 #include "MotionHoming.h"
+#include "MotionPointChecker.h"
+#include "MotionTuning.h"
+#include "KinematicsPolicy.h"
 
 class MotionHelper
 {
@@ -19,10 +22,14 @@ public:
   static constexpr float junctionDeviation_default  = 0.05f;
   static constexpr float distToTravelMM_ignoreBelow = 0.01f;
   static constexpr int pipelineLen_default          = 100;
+  static constexpr unsigned long livePositionUpdateMs_default = 100;
+  static constexpr unsigned long validateBudgetUs_default     = 2000;
 
 private:
   // Pause
   bool _isPaused;
+  // Resume requested while a feed hold is still decelerating
+  bool _feedHoldResumePending;
   // Robot dimensions
   float _xMaxMM;
   float _yMaxMM;
@@ -34,8 +41,15 @@ private:
   ptToActuatorFnType _ptToActuatorFn;
   actuatorToPtFnType _actuatorToPtFn;
   correctStepOverflowFnType _correctStepOverflowFn;
+  ptsToActuatorFnType _ptsToActuatorFn;
+  // Adds the next batch of split-up blocks - an instance of blocksToAddWith for the robot's
+  // kinematics policy, blocksToAddBatch for a batch transform function or NULL for neither
+  typedef void (MotionHelper::*blocksToAddFnType)();
+  blocksToAddFnType _blocksToAddFn;
   // Relative motion
   bool _moveRelative;
+  // Extrusion override (M221) as a factor
+  float _extrudeFactor;
   // Planner used to plan the pipeline of motion
   MotionPlanner _motionPlanner;
   // Axis Current Motion
@@ -49,6 +63,19 @@ private:
   // Homing
   MotionHoming _motionHoming;
 
+  // Live position - converted from the actuator's step counts when requested and cached as the
+  // conversion can be slow (at most once per _livePositionUpdateMs)
+  AxisPosition _livePosition;
+  bool _livePositionValid;
+  unsigned long _livePositionLastMs;
+  unsigned long _livePositionUpdateMs;
+
+  // Job validation - runs in the background for up to _validateBudgetUs per service() call
+  String _validateJob;
+  MotionPointChecker _validatePointChecker;
+  JobValidator<MotionPointChecker> _jobValidator;
+  unsigned long _validateBudgetUs;
+
   // Split-up movement blocks to be added to pipeline
   // Number of blocks to add
   int _blocksToAddTotal;
@@ -62,6 +89,15 @@ private:
   AxisFloats _blocksToAddDelta;
   // Command args for block generation
   RobotCommandArgs _blocksToAddCommandArgs;
+  // Batches used when the robot has a batch transform
+  AxisFloatsBatch _blocksToAddPts;
+  AxisFloatsBatch _blocksToAddActuator;
+  // Actuator coordinates of the start, end and each block for kinematics which are linear on
+  // each axis - only used if both ends of the move are in bounds
+  bool _blocksToAddLinear;
+  AxisFloats _blocksToAddStartActuator;
+  AxisFloats _blocksToAddEndActuator;
+  AxisFloats _blocksToAddDeltaActuator;
 
   // Debug
   unsigned long _debugLastPosDispMs;
@@ -71,7 +107,18 @@ public:
   ~MotionHelper();
 
   void setTransforms(ptToActuatorFnType ptToActuatorFn, actuatorToPtFnType actuatorToPtFn,
-                     correctStepOverflowFnType correctStepOverflowFn);
+                     correctStepOverflowFnType correctStepOverflowFn,
+                     ptsToActuatorFnType ptsToActuatorFn = NULL);
+
+  // Set the transforms from a kinematics policy (see KinematicsPolicy.h) - moves which are split
+  // into blocks are then converted with the policy's transforms inlined
+  template <typename KinematicsT>
+  void setKinematics()
+  {
+    setTransforms(KinematicsT::ptToActuator, KinematicsT::actuatorToPt, KinematicsT::correctStepOverflow,
+                  KinematicsT::ptsToActuator);
+    _blocksToAddFn = &MotionHelper::blocksToAddWith<KinematicsT>;
+  }
 
   void configure(const char* robotConfigJSON);
 
@@ -112,22 +159,43 @@ public:
   }
 
   void setCurPositionAsHome(int axisIdx);
+  AxisPosition& getLivePosition();
 
   bool moveTo(RobotCommandArgs& args);
   void setMotionParams(RobotCommandArgs& args);
+  void setMotionTuning(MotionTuning& tuning);
+  bool dwell(uint32_t dwellMs, int numberedCmdIdx);
+  bool addEvent(int eventId, int eventPin, bool eventPinLevel, int numberedCmdIdx);
   void getCurStatus(RobotCommandArgs& args);
   void goHome(RobotCommandArgs& args);
   int getLastCompletedNumberedCmdIdx()
   {
     return _motionActuator.getLastCompletedNumberedCmdIdx();
   }
+  int getMotionChannelIdx()
+  {
+    return _motionActuator.getMotionChannelIdx();
+  }
   void service();
 
+  // Pre-flight check of a job (G-code lines and patterns) from the current position - no motion
+  void validateJob(const String& job, JobValidatorPatternSource* pPatternSource);
+  JobValidatorStatus& getValidateStatus()
+  {
+    return _jobValidator.getStatus();
+  }
+
   unsigned long getLastActiveUnixTime()
   {
     return _motionIO.getLastActiveUnixTime();
   }
 
+  // Check if a pin is used for motion (steppers, servos, end-stops and motor enable)
+  bool isPinInUse(int pin)
+  {
+    return _motionIO.isPinInUse(pin);
+  }
+
   // Test code
   void debugShowBlocks();
   void debugShowTiming();
@@ -145,6 +213,95 @@ private:
     return(v > fmin(b1, b2) && v < fmax(b1, b2));
   }
 
+  bool moveToSteps(RobotCommandArgs& args);
   bool addToPlanner(RobotCommandArgs& args);
+  bool addToPlanner(RobotCommandArgs& args, AxisFloats& actuatorCoords, bool correctOverflow = true);
+  void correctStepOverflow();
   void blocksToAddProcess();
+  void blocksToAddBatch();
+  int blocksToAddBatchPts();
+  void blocksToAddBatchPlan(int numPts);
+  template <typename KinematicsT>
+  void blocksToAddWith();
+  void feedHoldResumeProcess();
+  void stepsRebased(AxisInt32s& prevStepsFromHome);
+  void stepsRebaseWhenIdle();
+  void homeSyncProcess();
+  bool isStepsRebaseApplied();
+  static uint32_t validatorMicros()
+  {
+    return micros();
+  }
 };
+
+// Add the next batch of split-up blocks using a kinematics policy - as blocksToAddBatch but the
+// transforms are called directly and, for kinematics which are linear on each axis, the blocks'
+// actuator coordinates are stepped along the line so no block is converted
+template <typename KinematicsT>
+void MotionHelper::blocksToAddWith()
+{
+  // At the start of a move convert the ends - if either had to be brought in bounds the blocks
+  // between them are converted (and brought in bounds) individually
+  if (KinematicsT::IS_AXIS_LINEAR && (_blocksToAddCurBlock == 0))
+  {
+    AxisFloats startPt = _blocksToAddStartPos;
+    AxisFloats endPt = _blocksToAddEndPos;
+    bool allowOutOfBounds = _blocksToAddCommandArgs.getAllowOutOfBounds();
+    _blocksToAddLinear = KinematicsT::ptToActuator(startPt, _blocksToAddStartActuator, _curAxisPosition, _axesParams, allowOutOfBounds) &&
+                         KinematicsT::ptToActuator(endPt, _blocksToAddEndActuator, _curAxisPosition, _axesParams, allowOutOfBounds);
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      if ((startPt._pt[axisIdx] != _blocksToAddStartPos._pt[axisIdx]) || (endPt._pt[axisIdx] != _blocksToAddEndPos._pt[axisIdx]))
+        _blocksToAddLinear = false;
+    _blocksToAddDeltaActuator = (_blocksToAddEndActuator - _blocksToAddStartActuator) / float(_blocksToAddTotal);
+  }
+
+  if (KinematicsT::IS_AXIS_LINEAR && _blocksToAddLinear)
+  {
+    // Number of blocks in this batch - limited by space in the pipeline
+    int numPts = _blocksToAddTotal - _blocksToAddCurBlock;
+    if (numPts > int(_motionPipeline.slotsFree()))
+      numPts = _motionPipeline.slotsFree();
+    if (numPts <= 0)
+      return;
+    AxisFloats nextBlockDest;
+    AxisFloats actuatorCoords;
+    for (int ptIdx = 0; ptIdx < numPts; ptIdx++)
+    {
+      _blocksToAddCurBlock++;
+      if (_blocksToAddCurBlock >= _blocksToAddTotal)
+      {
+        nextBlockDest = _blocksToAddEndPos;
+        actuatorCoords = _blocksToAddEndActuator;
+        _blocksToAddTotal = 0;
+      }
+      else
+      {
+        float blockNum = float(_blocksToAddCurBlock);
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+          nextBlockDest._pt[axisIdx] = _blocksToAddStartPos._pt[axisIdx] + _blocksToAddDelta._pt[axisIdx] * blockNum;
+          actuatorCoords._pt[axisIdx] = _blocksToAddStartActuator._pt[axisIdx] + _blocksToAddDeltaActuator._pt[axisIdx] * blockNum;
+        }
+      }
+      _blocksToAddCommandArgs.setPointMM(nextBlockDest);
+      addToPlanner(_blocksToAddCommandArgs, actuatorCoords, false);
+    }
+  }
+  else
+  {
+    int numPts = blocksToAddBatchPts();
+    if (numPts <= 0)
+      return;
+    KinematicsT::ptsToActuator(_blocksToAddPts, _blocksToAddActuator, _curAxisPosition, _axesParams,
+                               _blocksToAddCommandArgs.getAllowOutOfBounds());
+    blocksToAddBatchPlan(numPts);
+  }
+
+  // The batch was converted in a single frame of step counts so only rebase once it is planned
+  AxisInt32s prevStepsFromHome = _curAxisPosition._stepsFromHome;
+  KinematicsT::correctStepOverflow(_curAxisPosition, _axesParams);
+  stepsRebased(prevStepsFromHome);
+
+  // Enable motors
+  _motionIO.enableMotors(true, false);
+}
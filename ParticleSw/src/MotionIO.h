@@ -21,6 +21,7 @@ private:
   StepperMotor* _stepperMotors[RobotConsts::MAX_AXES];
   // Servo motors
   Servo* _servoMotors[RobotConsts::MAX_AXES];
+  int _servoPins[RobotConsts::MAX_AXES];
   // Step enable
   int _stepEnablePin;
   bool _stepEnLev = true;
@@ -40,6 +41,7 @@ public:
     {
       _stepperMotors[i] = NULL;
       _servoMotors[i]   = NULL;
+      _servoPins[i]     = -1;
       for (int j = 0; j < RobotConsts::MAX_ENDSTOPS_PER_AXIS; j++)
         _endStops[i][j] = NULL;
     }
@@ -71,6 +73,7 @@ public:
         _servoMotors[i]->detach();
       delete _servoMotors[i];
       _servoMotors[i] = NULL;
+      _servoPins[i] = -1;
       for (int j = 0; j < RobotConsts::MAX_ENDSTOPS_PER_AXIS; j++)
       {
         delete _endStops[i][j];
@@ -107,7 +110,10 @@ public:
       {
         _servoMotors[axisIdx] = new Servo();
         if (_servoMotors[axisIdx])
+        {
           _servoMotors[axisIdx]->attach(servoPin);
+          _servoPins[axisIdx] = servoPin;
+        }
       }
     }
 
@@ -293,6 +299,37 @@ public:
       enableMotors(false, true);
   }
 
+  // Check if a pin is used for motion (e.g. before it is used as a general output)
+  bool isPinInUse(int pin)
+  {
+    if (pin == _stepEnablePin)
+      return true;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      if (_stepperMotors[axisIdx])
+      {
+        int stepPin = -1, dirnPin = -1;
+        bool dirnReverse = false;
+        _stepperMotors[axisIdx]->getPins(stepPin, dirnPin, dirnReverse);
+        if ((pin == stepPin) || (pin == dirnPin))
+          return true;
+      }
+      if (pin == _servoPins[axisIdx])
+        return true;
+      for (int endStopIdx = 0; endStopIdx < RobotConsts::MAX_ENDSTOPS_PER_AXIS; endStopIdx++)
+      {
+        if (!_endStops[axisIdx][endStopIdx])
+          continue;
+        int sensePin = -1;
+        bool actLvl = false;
+        _endStops[axisIdx][endStopIdx]->getPins(sensePin, actLvl);
+        if (pin == sensePin)
+          return true;
+      }
+    }
+    return false;
+  }
+
   void getRawMotionHwInfo(RobotConsts::RawMotionHwInfo_t& raw)
   {
     // Fill in the info
@@ -5,95 +5,82 @@
 
 #include "MotionRingBuffer.h"
 #include "MotionBlock.h"
-#include <vector>
 
 class MotionPipeline
 {
 private:
-  MotionRingBufferPosn _pipelinePosn;
-  std::vector<MotionBlock> _pipeline;
+  // Shared between the planner (producer) and the ISR (consumer)
+  MotionRingBuffer<MotionBlock> _pipeline;
 
 public:
   MotionPipeline() :
-    _pipelinePosn(0)
+    _pipeline(0)
   {
   }
 
+  // Pipeline size is rounded up to a power of two
   void init(int pipelineSize)
   {
-    _pipeline.resize(pipelineSize);
-    _pipelinePosn.init(pipelineSize);
+    _pipeline.init(pipelineSize);
   }
 
   // Clear the pipeline
   void clear()
   {
-    _pipelinePosn.clear();
+    _pipeline.clear();
   }
 
   unsigned int count()
   {
-    return _pipelinePosn.count();
+    return _pipeline.count();
   }
 
   // Check if ready to accept data
   bool canAccept()
   {
-    return _pipelinePosn.canPut();
+    return _pipeline.canPut();
+  }
+
+  // Number of blocks that can be added
+  unsigned int slotsFree()
+  {
+    return _pipeline.capacity() - _pipeline.count();
   }
 
   // Add to pipeline
   bool add(MotionBlock& block)
   {
-    // Check if full
-    if (!_pipelinePosn.canPut())
-      return false;
-
-    // Add the item
-    _pipeline[_pipelinePosn._putPos] = block;
-    _pipelinePosn.hasPut();
-    return true;
+    return _pipeline.put(block);
   }
 
   // Can get from queue (i.e. not empty)
   bool canGet()
   {
-    return _pipelinePosn.canGet();
+    return _pipeline.canGet();
   }
 
   // Get from queue
   bool get(MotionBlock& block)
   {
-    // Check if queue is empty
-    if (!_pipelinePosn.canGet())
-      return false;
-
-    // read the item and remove
-    block = _pipeline[_pipelinePosn._getPos];
-    _pipelinePosn.hasGot();
-    return true;
+    return _pipeline.get(block);
   }
 
   // Remove last element from queue
   bool remove()
   {
     // Check if queue is empty
-    if (!_pipelinePosn.canGet())
+    if (!_pipeline.canGet())
       return false;
 
     // remove item
-    _pipelinePosn.hasGot();
+    _pipeline.hasGot();
     return true;
   }
 
   // Peek the block which would be got (if there is one)
   MotionBlock* peekGet()
   {
-    // Check if queue is empty
-    if (!_pipelinePosn.canGet())
-      return NULL;
-    // get pointer to the last item (don't remove)
-    return &(_pipeline[_pipelinePosn._getPos]);
+    return _pipeline.peekGet();
   }
 
   // Peek from the put position
@@ -102,11 +89,7 @@ public:
   // returns NULL when nothing to peek
   MotionBlock* peekNthFromPut(unsigned int N)
   {
-    // Get index
-    int nthPos = _pipelinePosn.getNthFromPut(N);
-    if (nthPos < 0)
-      return NULL;
-    return &(_pipeline[nthPos]);
+    return _pipeline.peekNthFromPut(N);
   }
 
   // Peek from the get position
@@ -115,11 +98,7 @@ public:
   // returns NULL when nothing to peek
   MotionBlock* peekNthFromGet(unsigned int N)
   {
-    // Get index
-    int nthPos = _pipelinePosn.getNthFromGet(N);
-    if (nthPos < 0)
-      return NULL;
-    return &(_pipeline[nthPos]);
+    return _pipeline.peekNthFromGet(N);
   }
 
   // Debug
@@ -10,10 +10,15 @@
 #endif
 
 #include "MotionPipeline.h"
+#include "AxisFloatsBatch.h"
 
+// ptToActuator returns false if the point can't be reached - a point outside the axis bounds is
+// moved to the bounds (unless allowOutOfBounds) and is still converted
 typedef bool (*ptToActuatorFnType) (AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds);
 typedef void (*actuatorToPtFnType) (AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams);
 typedef void (*correctStepOverflowFnType) (AxisPosition& curPos, AxesParams& axesParams);
+// Batch version of ptToActuator - curPos is the position before the first point in the batch
+typedef void (*ptsToActuatorFnType) (AxisFloatsBatch& targetPts, AxisFloatsBatch& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds);
 
 class MotionPlanner
 {
@@ -22,16 +27,25 @@ private:
   float _minimumPlannerSpeedMMps;
   // Junction deviation
   float _junctionDeviation;
+  // Runtime limits (M204 and M220) - path acceleration limit (0 for none) and feedrate factor
+  float _maxPathAccMMps2;
+  float _feedrateFactor;
 
   // Structure to store details on last processed block
   struct MotionBlockSequentialData
   {
     AxisFloats _unitVectors;
     float      _maxParamSpeedMMps;
+    // Direction of motion in actuator space and actuator distance per mm along the path
+    AxisFloats _actuatorUnitVectors;
+    float      _actuatorDistPerMM;
   };
   // Data on previously processed block
   bool _prevMotionBlockValid;
   MotionBlockSequentialData _prevMotionBlock;
+  // Change to the step counts not yet passed to the actuator - carried by the next block added
+  bool _stepsRebasePending;
+  int32_t _stepsRebase[RobotConsts::MAX_AXES];
 
 public:
   MotionPlanner()
@@ -40,11 +54,73 @@ public:
     _minimumPlannerSpeedMMps = 0;
     // Configure the motion pipeline - these values will be changed in config
     _junctionDeviation = 0;
+    _maxPathAccMMps2 = 0;
+    _feedrateFactor = 1.0f;
+    clearStepsRebase();
   }
 
   void configure(float junctionDeviation)
   {
     _junctionDeviation = junctionDeviation;
+    _maxPathAccMMps2 = 0;
+    _feedrateFactor = 1.0f;
+  }
+
+  // Runtime changes - these apply to blocks added from now on (blocks already in the pipeline
+  // keep the limits they were planned with)
+  void setJunctionDeviation(float junctionDeviation)
+  {
+    if (junctionDeviation >= 0)
+      _junctionDeviation = junctionDeviation;
+  }
+
+  void setMaxPathAcc(float maxPathAccMMps2)
+  {
+    if (maxPathAccMMps2 >= 0)
+      _maxPathAccMMps2 = maxPathAccMMps2;
+  }
+
+  void setFeedrateFactor(float feedrateFactor)
+  {
+    if (feedrateFactor > 0)
+      _feedrateFactor = feedrateFactor;
+  }
+
+  // Record a change made to the step counts outside the planner (e.g. whole rotations removed by
+  // correctStepOverflow or home being set) - the actuator's live step counts are changed to match
+  // when it starts the next block added
+  void addStepsRebase(int axisIdx, int32_t steps)
+  {
+    if ((axisIdx < 0) || (axisIdx >= RobotConsts::MAX_AXES) || (steps == 0))
+      return;
+    _stepsRebase[axisIdx] += steps;
+    _stepsRebasePending = true;
+  }
+
+  bool isStepsRebasePending()
+  {
+    return _stepsRebasePending;
+  }
+
+  // Take the pending change (used when the pipeline is empty so there is no next block)
+  void takeStepsRebase(int32_t stepsRebase[])
+  {
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      stepsRebase[axisIdx] = _stepsRebase[axisIdx];
+    clearStepsRebase();
+  }
+
+  void clearStepsRebase()
+  {
+    _stepsRebasePending = false;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      _stepsRebase[axisIdx] = 0;
+  }
+
+  // Motion was stopped and the pipeline cleared - the next block starts from a standstill
+  void motionStopped()
+  {
+    _prevMotionBlockValid = false;
   }
 
   // Entry point for adding a motion block
@@ -88,55 +164,76 @@ public:
     // Set numbered command index if present
     block.setNumberedCommandIndex(args.getNumberedCommandIndex());
 
+    // Find if there are any steps
+    float stepsFloat[RobotConsts::MAX_AXES];
+    bool hasSteps = false;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      // Check if any steps to perform
+      stepsFloat[axisIdx] = destActuatorCoords._pt[axisIdx] - curAxisPositions._stepsFromHome.vals[axisIdx];
+      int32_t steps       = int32_t(ceilf(stepsFloat[axisIdx]));
+      if (steps != 0)
+        hasSteps = true;
+      // Value (and direction)
+      block.setStepsToTarget(axisIdx, steps);
+    }
+
+    // Check there are some actual steps
+    if (!hasSteps)
+      return false;
+
     // Max speed (may be overridden downwards by feedrate)
     float validFeedrateMMps = 1e8;
     if (args.isFeedrateValid())
-      validFeedrateMMps = args.getFeedrate();
+      validFeedrateMMps = args.getFeedrate() * _feedrateFactor;
 
-    // Find the unit vectors for the primary axes and check the feedrate
+    // Find the unit vectors for the primary axes
     AxisFloats unitVectors;
     for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
     {
       if (axesParams.isPrimaryAxis(axisIdx))
-      {
-        // Unit vector calculation
         unitVectors._pt[axisIdx] = float(deltas[axisIdx] / moveDist);
-
-        // Check the feedrate
-        float axisSpeedAtRequestedFeedrateMMps = fabsf(unitVectors._pt[axisIdx] * validFeedrateMMps);
-        float axisMaxSpeedMMps                 = axesParams.getMaxSpeed(axisIdx);
-        if (axisSpeedAtRequestedFeedrateMMps > axisMaxSpeedMMps)
-          validFeedrateMMps = fabsf(axisMaxSpeedMMps / unitVectors._pt[axisIdx]);
-      }
     }
 
-    // Calculate move time
-    double reciprocalTime = validFeedrateMMps / moveDist;
+    // The steps for each actuator over the block's distance give its rate of change with distance
+    // along the path (a finite-difference Jacobian) - the feedrate and acceleration are limited so
+    // that no actuator exceeds its own max speed or acceleration
+    // For cartesian robots this is the same as limiting each axis but on nonlinear robots it only
+    // slows the blocks that need it (e.g. those near the centre of a SandTableScara)
+    float pathAccMMps2 = axesParams._masterAxisMaxAccMMps2;
+    if (_maxPathAccMMps2 > 0)
+      pathAccMMps2 = fminf(pathAccMMps2, _maxPathAccMMps2);
+    float maxAccMMps2 = pathAccMMps2;
+    AxisFloats actuatorUnitVectors;
+    float actuatorSquareSum = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      float stepsPerMM = stepsFloat[axisIdx] / moveDist;
+      if (stepsPerMM == 0)
+        continue;
+      float absStepsPerMM = fabsf(stepsPerMM);
+      validFeedrateMMps = fminf(validFeedrateMMps, axesParams._maxStepRatesPerSec.getValNoCk(axisIdx) / absStepsPerMM);
+      maxAccMMps2       = fminf(maxAccMMps2, axesParams.getMaxAccStepsPerSec2(axisIdx) / absStepsPerMM);
+      // Actuator movement in its own units (e.g. mm of arc) per mm along the path
+      actuatorUnitVectors._pt[axisIdx] = stepsPerMM * axesParams.getStepDistMM(axisIdx);
+      actuatorSquareSum += powf(actuatorUnitVectors._pt[axisIdx], 2);
+    }
+    float actuatorDistPerMM = sqrtf(actuatorSquareSum);
+    if (actuatorDistPerMM > 0)
+      actuatorUnitVectors = actuatorUnitVectors / actuatorDistPerMM;
+    // A feedrate override below 100% also slows moves limited by the axis max speeds
+    if (!args.isFeedrateValid() && (_feedrateFactor < 1.0f))
+      validFeedrateMMps *= _feedrateFactor;
 
 #ifdef DEBUG_MOTIONPLANNER_INFO
-    Log.info("ValidatedFeedrate %0.3f, reciprocalTime %0.3f", validFeedrateMMps, reciprocalTime);
+    Log.info("ValidatedFeedrate %0.3f, maxAcc %0.3f, actuatorDistPerMM %0.3f", validFeedrateMMps, maxAccMMps2, actuatorDistPerMM);
 #endif
 
     // Store values in the block
     block._feedrateMMps          = float(validFeedrateMMps);
     block._moveDistPrimaryAxesMM = float(moveDist);
-
-    // Find if there are any steps
-    bool hasSteps = false;
-    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-    {
-      // Check if any steps to perform
-      float   stepsFloat = destActuatorCoords._pt[axisIdx] - curAxisPositions._stepsFromHome.vals[axisIdx];
-      int32_t steps      = int32_t(ceilf(stepsFloat));
-      if (steps != 0)
-        hasSteps = true;
-      // Value (and direction)
-      block.setStepsToTarget(axisIdx, steps);
-    }
-
-    // Check there are some actual steps
-    if (!hasSteps)
-      return false;
+    block._maxAccMMps2           = maxAccMMps2;
+    block._masterAxisStepsPerMM  = block.getAbsStepsToTarget(block._axisIdxWithMaxSteps) / moveDist;
 
     // If there is a prior block then compute the maximum speed at exit of the second block to keep
     // the junction deviation within bounds - there are more comments in the Smoothieware (and GRBL) code
@@ -155,9 +252,9 @@ public:
       {
         // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
         // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
-        float cosTheta = -_prevMotionBlock._unitVectors.X() * unitVectors.X()
-                         - _prevMotionBlock._unitVectors.Y() * unitVectors.Y()
-                         - _prevMotionBlock._unitVectors.Z() * unitVectors.Z();
+        float cosTheta = 0;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+          cosTheta -= _prevMotionBlock._unitVectors.getValNoCk(axisIdx) * unitVectors.getValNoCk(axisIdx);
 
         // Skip and use default max junction speed for 0 degree acute junction.
         if (cosTheta < 0.95F)
@@ -170,10 +267,30 @@ public:
             // Trig half angle identity, always positive
             float sinThetaD2 = sqrtf(0.5F * (1.0F - cosTheta));
             vmaxJunction = fminf(vmaxJunction,
-                                 sqrtf(axesParams._masterAxisMaxAccMMps2 * junctionDeviation * sinThetaD2 /
+                                 sqrtf(pathAccMMps2 * junctionDeviation * sinThetaD2 /
                                        (1.0F - sinThetaD2)));
           }
         }
+
+        // Apply the same rule in actuator space - this has no effect for cartesian robots but
+        // on nonlinear robots a smooth path can still be a sharp change of direction for the
+        // actuators (and a reversal of an actuator needs a stop)
+        float actuatorCosTheta = 0;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+          actuatorCosTheta -= _prevMotionBlock._actuatorUnitVectors.getValNoCk(axisIdx) * actuatorUnitVectors.getValNoCk(axisIdx);
+        if (actuatorCosTheta >= 0.95F)
+        {
+          vmaxJunction = _minimumPlannerSpeedMMps;
+        }
+        else if (actuatorCosTheta > -0.95F)
+        {
+          float sinThetaD2 = sqrtf(0.5F * (1.0F - actuatorCosTheta));
+          float junctionActuatorDistPerMM = fmaxf(_prevMotionBlock._actuatorDistPerMM, actuatorDistPerMM);
+          if (junctionActuatorDistPerMM > 0)
+            vmaxJunction = fminf(vmaxJunction,
+                                 sqrtf(pathAccMMps2 * junctionDeviation * sinThetaD2 /
+                                       (1.0F - sinThetaD2)) / junctionActuatorDistPerMM);
+        }
       }
     }
     block._maxEntrySpeedMMps = vmaxJunction;
@@ -184,10 +301,12 @@ public:
 #endif
 
     // Add the element to the pipeline and remember previous element
-    motionPipeline.add(block);
+    addToPipeline(block, motionPipeline);
     MotionBlockSequentialData prevBlockInfo;
     prevBlockInfo._maxParamSpeedMMps = block._feedrateMMps;
     prevBlockInfo._unitVectors       = unitVectors;
+    prevBlockInfo._actuatorUnitVectors = actuatorUnitVectors;
+    prevBlockInfo._actuatorDistPerMM = actuatorDistPerMM;
     _prevMotionBlock                 = prevBlockInfo;
     _prevMotionBlockValid            = true;
 
@@ -219,7 +338,9 @@ public:
 #endif
   }
 
-  void recalculatePipeline(MotionPipeline& motionPipeline, AxesParams& axesParams)
+  // With fullReplan set every block that isn't executing is recalculated - this is used when
+  // resuming from a feed hold as the first block then starts from a standstill
+  void recalculatePipeline(MotionPipeline& motionPipeline, AxesParams& axesParams, bool fullReplan = false)
   {
     // The last block in the pipe (most recently added) will have zero exit speed
     // For each block, walking backwards in the queue :
@@ -258,9 +379,16 @@ public:
         break;
       }
 
+      // A dwell or event block is a zero-speed junction so nothing before it can change
+      if (!fullReplan && !pBlock->isMove() && blockIdx > 0)
+      {
+        previousBlockExitSpeed = 0;
+        break;
+      }
+
       // If entry speed is already at the maximum entry speed then we can stop here as no further changes are
       // going to be made by going back further
-      if (pBlock->_entrySpeedMMps == pBlock->_maxEntrySpeedMMps && blockIdx > 1)
+      if (!fullReplan && pBlock->_entrySpeedMMps == pBlock->_maxEntrySpeedMMps && blockIdx > 1)
       {
 #ifdef DEBUG_MOTIONPLANNER_INFO
         Log.info("++++++++++++++++++++++++++++++ Optimizing block %d, prevSpeed %0.3f", blockIdx, pBlock->_exitSpeedMMps);
@@ -275,7 +403,7 @@ public:
       {
         // Assume for now that that whole block will be deceleration and calculate the max speed we can enter to be able to slow
         // to the exit speed required
-        float maxEntrySpeed = MotionBlock::maxAchievableSpeed(axesParams._masterAxisMaxAccMMps2,
+        float maxEntrySpeed = MotionBlock::maxAchievableSpeed(pFollowingBlock->_maxAccMMps2,
                                     pFollowingBlock->_exitSpeedMMps, pFollowingBlock->_moveDistPrimaryAxesMM);
         pFollowingBlock->_entrySpeedMMps = fminf(maxEntrySpeed, pFollowingBlock->_maxEntrySpeedMMps);
 
@@ -309,7 +437,7 @@ public:
       pBlock->_entrySpeedMMps = previousBlockExitSpeed;
 
       // Calculate maximum speed possible for the block - based on acceleration at the best rate
-      float maxExitSpeed = pBlock->maxAchievableSpeed(axesParams._masterAxisMaxAccMMps2,
+      float maxExitSpeed = pBlock->maxAchievableSpeed(pBlock->_maxAccMMps2,
                                     pBlock->_entrySpeedMMps, pBlock->_moveDistPrimaryAxesMM);
       pBlock->_exitSpeedMMps = fminf(maxExitSpeed, pBlock->_exitSpeedMMps);
 
@@ -391,7 +519,7 @@ public:
     block.prepareForStepping(axesParams);
 
     // Add the block
-    motionPipeline.add(block);
+    addToPipeline(block, motionPipeline);
     _prevMotionBlockValid = true;
 
     // Return the change in actuator position
@@ -406,4 +534,34 @@ public:
 
     return true;
   }
+
+  // Add a dwell or event block - these are zero-speed junctions so the blocks before decelerate
+  // to a stop and the blocks after start from a standstill but the pipeline doesn't need to
+  // drain around them (any steps rebase is left for the next move block)
+  bool addSpecialBlock(MotionBlock& block, AxesParams& axesParams, MotionPipeline& motionPipeline)
+  {
+    block._feedrateMMps          = 0;
+    block._moveDistPrimaryAxesMM = 0;
+    block._maxEntrySpeedMMps     = 0;
+    block._entrySpeedMMps        = 0;
+    block._exitSpeedMMps         = 0;
+    if (!motionPipeline.add(block))
+      return false;
+    _prevMotionBlockValid = false;
+    recalculatePipeline(motionPipeline, axesParams);
+    return true;
+  }
+
+private:
+  // Add a block to the pipeline passing any pending change to the step counts with it
+  bool addToPipeline(MotionBlock& block, MotionPipeline& motionPipeline)
+  {
+    block._hasStepsRebase = _stepsRebasePending;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      block._stepsRebase[axisIdx] = _stepsRebase[axisIdx];
+    if (!motionPipeline.add(block))
+      return false;
+    clearStepsRebase();
+    return true;
+  }
 };
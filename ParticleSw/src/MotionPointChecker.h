@@ -0,0 +1,83 @@
+// RBotFirmware
+// Rob Dobson 2016-18
+
+#pragma once
+
+#include "AxesParams.h"
+#include "AxisPosition.h"
+#include "MotionPlanner.h"
+#include "JobValidator.h"
+
+// Point checker used by the JobValidator - checks each point against the axis bounds and the
+// robot's ptToActuator transform without moving
+// The step counts are simulated in the same way as the planner so that robots whose transform
+// depends on the current position (e.g. choosing the shortest path) are checked as they would run
+class MotionPointChecker
+{
+private:
+  ptToActuatorFnType _ptToActuatorFn;
+  correctStepOverflowFnType _correctStepOverflowFn;
+  AxesParams* _pAxesParams;
+  AxisPosition _simPosition;
+
+public:
+  MotionPointChecker()
+  {
+    _ptToActuatorFn        = NULL;
+    _correctStepOverflowFn = NULL;
+    _pAxesParams           = NULL;
+    _simPosition.clear();
+  }
+
+  void setup(ptToActuatorFnType ptToActuatorFn, correctStepOverflowFnType correctStepOverflowFn,
+             AxesParams& axesParams, AxisPosition& startPosition)
+  {
+    _ptToActuatorFn        = ptToActuatorFn;
+    _correctStepOverflowFn = correctStepOverflowFn;
+    _pAxesParams           = &axesParams;
+    _simPosition           = startPosition;
+  }
+
+  JobValidatorStatus::PointResult checkPoint(const float pt[])
+  {
+    if (!_pAxesParams || !_ptToActuatorFn)
+      return JobValidatorStatus::POINT_UNREACHABLE;
+    AxisFloats targetPt;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      targetPt.setVal(axisIdx, pt[axisIdx]);
+    if (!_pAxesParams->ptInBounds(targetPt, false))
+      return JobValidatorStatus::POINT_OUT_OF_BOUNDS;
+    AxisFloats actuatorCoords;
+    if (!_ptToActuatorFn(targetPt, actuatorCoords, _simPosition, *_pAxesParams, false))
+      return JobValidatorStatus::POINT_UNREACHABLE;
+
+    // Step counts as the planner would leave them
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      int32_t steps = int32_t(ceilf(actuatorCoords._pt[axisIdx] - _simPosition._stepsFromHome.vals[axisIdx]));
+      _simPosition._stepsFromHome.vals[axisIdx] += steps;
+    }
+    _simPosition._axisPositionMM = targetPt;
+    if (_correctStepOverflowFn)
+      _correctStepOverflowFn(_simPosition, *_pAxesParams);
+    return JobValidatorStatus::POINT_OK;
+  }
+
+  void goHome()
+  {
+    if (!_pAxesParams)
+      return;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _simPosition._axisPositionMM.setVal(axisIdx, _pAxesParams->getHomeOffsetVal(axisIdx));
+      _simPosition._stepsFromHome.setVal(axisIdx, _pAxesParams->gethomeOffSteps(axisIdx));
+    }
+  }
+
+  bool isPrimaryAxis(int axisIdx)
+  {
+    if (!_pAxesParams)
+      return true;
+    return _pAxesParams->isPrimaryAxis(axisIdx);
+  }
+};
@@ -1,110 +1,147 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
 #pragma once
 
-// Generic interrupt-safe ring buffer pointer class
-// Each pointer is only updated by one source (ISR or main thread)
-class MotionRingBufferPosn
+#include <atomic>
+#include <vector>
+
+// Single-producer/single-consumer ring buffer shared between the main thread and the ISR
+// The producer (planner) only ever writes _putPos and the consumer (ISR) only ever writes _getPos
+// Positions are free-running counters - the capacity is a power of two so the slot index is
+// found by masking and the number of elements is simply _putPos - _getPos (unsigned wrap is fine)
+// Elements are published with release stores and observed with acquire loads so a slot is
+// always completely written before the other side can see it
+template <typename ElemT>
+class MotionRingBuffer
 {
-public:
-  volatile unsigned int _putPos;
-  volatile unsigned int _getPos;
-  unsigned int _bufLen;
+private:
+  std::atomic<unsigned int> _putPos;
+  std::atomic<unsigned int> _getPos;
+  unsigned int _capacity;
+  unsigned int _mask;
+  std::vector<ElemT> _buf;
 
-  MotionRingBufferPosn(int maxLen)
+public:
+  MotionRingBuffer(unsigned int minCapacity = 0)
   {
-    init(maxLen);
+    init(minCapacity);
   }
 
-  void init(int maxLen)
+  // Capacity is rounded up to the next power of two
+  void init(unsigned int minCapacity)
   {
-    _bufLen = maxLen;
-    _putPos = 0;
-    _getPos = 0;
+    unsigned int capacity = 0;
+    if (minCapacity > 0)
+    {
+      capacity = 1;
+      while (capacity < minCapacity)
+        capacity <<= 1;
+    }
+    _capacity = capacity;
+    _mask     = capacity > 0 ? capacity - 1 : 0;
+    _buf.resize(capacity);
+    clear();
   }
 
   void clear()
   {
-    _getPos = _putPos = 0;
+    _putPos.store(0, std::memory_order_relaxed);
+    _getPos.store(0, std::memory_order_release);
+  }
+
+  unsigned int capacity()
+  {
+    return _capacity;
+  }
+
+  unsigned int count()
+  {
+    return _putPos.load(std::memory_order_acquire) - _getPos.load(std::memory_order_acquire);
   }
+
+  // Producer side
   bool canPut()
   {
-    if (_bufLen == 0)
+    return (_putPos.load(std::memory_order_relaxed) - _getPos.load(std::memory_order_acquire)) < _capacity;
+  }
+
+  // Slot to fill before calling hasPut() - NULL if full
+  ElemT* putSlot()
+  {
+    if (!canPut())
+      return NULL;
+    return &_buf[_putPos.load(std::memory_order_relaxed) & _mask];
+  }
+
+  // Publish the slot returned by putSlot()
+  void hasPut()
+  {
+    _putPos.store(_putPos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool put(const ElemT& elem)
+  {
+    ElemT* pSlot = putSlot();
+    if (!pSlot)
       return false;
-    if (_putPos == _getPos)
-      return true;
-    unsigned int gp = _getPos;
-    if (_putPos > gp)
-    {
-      if ((_putPos != _bufLen - 1) || (gp != 0))
-        return true;
-    }
-    else
-    {
-      if (gp - _putPos > 1)
-        return true;
-    }
-    return false;
+    *pSlot = elem;
+    hasPut();
+    return true;
   }
 
+  // Consumer side
   bool canGet()
   {
-    return _putPos != _getPos;
+    return _putPos.load(std::memory_order_acquire) != _getPos.load(std::memory_order_relaxed);
   }
 
-  void hasPut()
+  // Peek the element which would be got next - NULL if empty
+  ElemT* peekGet()
   {
-    _putPos++;
-    if (_putPos >= _bufLen)
-      _putPos = 0;
+    unsigned int getPos = _getPos.load(std::memory_order_relaxed);
+    if (_putPos.load(std::memory_order_acquire) == getPos)
+      return NULL;
+    return &_buf[getPos & _mask];
   }
 
+  // Release the element at the get position back to the producer
   void hasGot()
   {
-    _getPos++;
-    if (_getPos >= _bufLen)
-      _getPos = 0;
+    _getPos.store(_getPos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
   }
 
-  unsigned int count()
+  bool get(ElemT& elem)
   {
-    unsigned int getPos = _getPos;
-    if (getPos <= _putPos)
-      return _putPos - getPos;
-    return _bufLen - getPos + _putPos;
+    ElemT* pElem = peekGet();
+    if (!pElem)
+      return false;
+    elem = *pElem;
+    hasGot();
+    return true;
   }
 
   // Get Nth element prior to the put position
   // 0 is the last element put in the queue
   // 1 is the one put in before that
-  // Returns -1 if invalid
-  int getNthFromPut(unsigned int N)
+  // Returns NULL if invalid
+  ElemT* peekNthFromPut(unsigned int N)
   {
-    if (!canGet())
-      return -1;
-    if (N >= _bufLen)
-      return -1;
-    int nthPos = _putPos - 1 - N;
-    if (nthPos < 0)
-      nthPos += _bufLen;
-    if (((unsigned int) (nthPos + 1) == _getPos) || ((unsigned int) (nthPos + 1) == _bufLen && _getPos == 0))
-      return -1;
-    return nthPos;
+    unsigned int putPos = _putPos.load(std::memory_order_relaxed);
+    if (N >= putPos - _getPos.load(std::memory_order_acquire))
+      return NULL;
+    return &_buf[(putPos - 1 - N) & _mask];
   }
 
   // Get Nth element from the get position
   // 0 is the element next got from the queue
   // 1 is the one got after that
-  // returns -1 if invalid
-  int getNthFromGet(unsigned int N)
+  // Returns NULL if invalid
+  ElemT* peekNthFromGet(unsigned int N)
   {
-    if (!canGet())
-      return -1;
-    if (N >= _bufLen)
-      return -1;
-    unsigned int nthPos = _getPos + N;
-    if (nthPos >= _bufLen)
-      nthPos -= _bufLen;
-    if (nthPos == _putPos)
-      return -1;
-    return nthPos;
+    unsigned int getPos = _getPos.load(std::memory_order_acquire);
+    if (N >= _putPos.load(std::memory_order_acquire) - getPos)
+      return NULL;
+    return &_buf[(getPos + N) & _mask];
   }
 };
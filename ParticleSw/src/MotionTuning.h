@@ -0,0 +1,83 @@
+// RBotFirmware
+// Rob Dobson 2016-18
+
+#pragma once
+
+#include "RobotConsts.h"
+
+// Runtime changes to the motion limits (set by M201, M203, M204, M205, M220 and M221) which are
+// applied in place to the axes params and planner - only the values flagged valid are changed
+// and the changes last until the robot is next configured
+class MotionTuning
+{
+public:
+  // Max acceleration (mm/s^2) and max speed (mm/s) of individual axes - bit per axis
+  uint8_t _maxAccAxisMask;
+  float _maxAccMMps2[RobotConsts::MAX_AXES];
+  uint8_t _maxSpeedAxisMask;
+  float _maxSpeedMMps[RobotConsts::MAX_AXES];
+  // Acceleration limit along the path (mm/s^2 - 0 for no limit other than the axes)
+  bool _pathAccValid;
+  float _pathAccMMps2;
+  // Junction deviation (mm)
+  bool _junctionDeviationValid;
+  float _junctionDeviation;
+  // Feedrate and extrusion overrides (percent)
+  bool _feedrateOverrideValid;
+  float _feedrateOverridePC;
+  bool _extrudeOverrideValid;
+  float _extrudeOverridePC;
+
+public:
+  MotionTuning()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    _maxAccAxisMask = 0;
+    _maxSpeedAxisMask = 0;
+    for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    {
+      _maxAccMMps2[axisIdx] = 0;
+      _maxSpeedMMps[axisIdx] = 0;
+    }
+    _pathAccValid = false;
+    _pathAccMMps2 = 0;
+    _junctionDeviationValid = false;
+    _junctionDeviation = 0;
+    _feedrateOverrideValid = false;
+    _feedrateOverridePC = 100;
+    _extrudeOverrideValid = false;
+    _extrudeOverridePC = 100;
+  }
+
+  void setMaxAcc(int axisIdx, float maxAccMMps2)
+  {
+    _maxAccMMps2[axisIdx] = maxAccMMps2;
+    _maxAccAxisMask |= 1 << axisIdx;
+  }
+
+  void setMaxSpeed(int axisIdx, float maxSpeedMMps)
+  {
+    _maxSpeedMMps[axisIdx] = maxSpeedMMps;
+    _maxSpeedAxisMask |= 1 << axisIdx;
+  }
+
+  bool isMaxAccValid(int axisIdx)
+  {
+    return (_maxAccAxisMask & (1 << axisIdx)) != 0;
+  }
+
+  bool isMaxSpeedValid(int axisIdx)
+  {
+    return (_maxSpeedAxisMask & (1 << axisIdx)) != 0;
+  }
+
+  bool anyValid()
+  {
+    return (_maxAccAxisMask != 0) || (_maxSpeedAxisMask != 0) || _pathAccValid || _junctionDeviationValid ||
+           _feedrateOverrideValid || _extrudeOverrideValid;
+  }
+};
@@ -4,10 +4,13 @@
 #pragma once
 
 #include "PatternEvaluator_Vars.h"
+#include "JobValidator.h"
 #include "tinyexpr.h"
 #include <vector>
 
-class PatternEvaluator
+// Patterns are also run (without moving) to check a job before it is run - a separate evaluator
+// is used so that checking doesn't affect a pattern which is running
+class PatternEvaluator : public JobValidatorPatternSource
 {
 public:
     PatternEvaluator()
@@ -162,22 +165,31 @@ public:
         if (!pCommandInterpreter->canAcceptCommand())
             return;
 
+        // Get next point and send to commandInterpreter
+        AxisFloats pt;
+        if (!getNextPoint(pt))
+            return;
+        String cmdStr = String::format("G0 X%0.2f Y%0.2f", pt._pt[0], pt._pt[1]);
+        Log.trace("PatternEval ->cmdInterp %s", cmdStr.c_str());
+        String retStr;
+        pCommandInterpreter->process(cmdStr.c_str(), retStr);
+    }
+
+    // Evaluate the next point - returns false (and stops) if there isn't one - after the last
+    // point (when the stop variable is set) the pattern is stopped
+    bool getNextPoint(AxisFloats& pt)
+    {
         // Evaluate expressions
         evalExpressions(false, true);
 
-        // Get next point and send to commandInterpreter
-        AxisFloats pt;
+        // Get next point
         bool isValid = getPoint(pt);
         if (!isValid)
         {
             Log.info("PatternEval stopped X and Y must be specified");
             _isRunning = false;
-            return;
+            return false;
         }
-        String cmdStr = String::format("G0 X%0.2f Y%0.2f", pt._pt[0], pt._pt[1]);
-        Log.trace("PatternEval ->cmdInterp %s", cmdStr.c_str());
-        String retStr;
-        pCommandInterpreter->process(cmdStr.c_str(), retStr);
 
         // Check if we reached a limit
         bool stopReqd = 0;
@@ -186,14 +198,36 @@ public:
         {
             Log.info("PatternEval stopped STOP variable not specified");
             _isRunning = false;
-            return;
         }
-        if (stopReqd)
+        else if (stopReqd)
         {
             Log.info("PatternEval stopped STOP = TRUE");
             _isRunning = false;
-            return;
         }
+        return true;
+    }
+
+    // JobValidatorPatternSource - the points are generated in the same way as when running
+    virtual bool startPattern(const char* pCmdStr)
+    {
+        return procCommand(pCmdStr);
+    }
+
+    virtual bool getPatternPoint(float& x, float& y)
+    {
+        if (!_isRunning)
+            return false;
+        AxisFloats pt;
+        if (!getNextPoint(pt))
+            return false;
+        x = pt._pt[0];
+        y = pt._pt[1];
+        return true;
+    }
+
+    virtual void stopPattern()
+    {
+        cleanUp();
     }
 
     bool procCommand(const char* cmdStr)
@@ -9,6 +9,8 @@
 #include "DebugLoopTimer.h"
 #include "RobotTypes.h"
 #include "RBotDefaults.h"
+#include "FlashDeviceSPI.h"
+#include "ConfigPinMap.h"
 
 // Web server
 #include "RdWebServer.h"
@@ -21,19 +23,27 @@ RestAPIEndpoints restAPIEndpoints;
 
 //define RUN_TESTS_CONFIG
 //#define RUN_TEST_WORKFLOW
+//#define RUN_TEST_SCARA_KINEMATICS
 #ifdef RUN_TEST_CONFIG
 #include "TestConfigManager.h"
 #endif
 #ifdef RUN_TEST_WORKFLOW
 #include "TestWorkflowGCode.h"
 #endif
+#ifdef RUN_TEST_SCARA_KINEMATICS
+#include "TestScaraKinematicsTiming.h"
+#endif
 
 SYSTEM_MODE(AUTOMATIC);
 SYSTEM_THREAD(ENABLED);
 
 // Application info
 static const char* APPLICATION_NAME = "RBotFirmware";
+// Logging is on the USB serial port unless serial streaming is enabled in the main config
+// e.g. "serialStreaming":1 - logging then moves to Serial1 (TX pin) so the USB serial port only
+// carries the streaming protocol replies
 SerialLogHandler logHandler(LOG_LEVEL_INFO);
+Serial1LogHandler* pStreamingLogHandler = NULL;
 
 // Robot controller
 RobotController _robotController;
@@ -44,9 +54,35 @@ WorkflowManager _workflowManager;
 // Command interpreter
 CommandInterpreter _commandInterpreter(&_workflowManager, &_robotController);
 
+// Auxiliary motion channels - each is an independent robot (e.g. a turntable or lighting axis)
+// with its own command queue, planner and pipeline - all channels are stepped by the same ISR
+class AuxMotionChannel
+{
+public:
+    RobotController _robotController;
+    WorkflowManager _workflowManager;
+    CommandInterpreter _commandInterpreter;
+    bool _isConfigured;
+    AuxMotionChannel() :
+        _commandInterpreter(&_workflowManager, &_robotController)
+    {
+        _isConfigured = false;
+    }
+};
+static const int NUM_AUX_MOTION_CHANNELS = MotionActuator::MAX_MOTION_CHANNELS - 1;
+AuxMotionChannel _auxMotionChannels[NUM_AUX_MOTION_CHANNELS];
+
 // Serial comms
 CommsSerial _commsSerial(0);
 
+// Job store on external SPI flash - configured by jobStore in the main config
+// e.g. "jobStore":{"spiCS":"D6","slots":4}
+// The flash is on the primary SPI port (A3 SCK, A4 MISO, A5 MOSI) so the chip-select can be any
+// other pin which isn't used for motion (the default robot configs use A2 for motor enable)
+static const char* JOB_STORE_DEFAULT_CS_PIN = "D6";
+FlashDeviceSPI _flashDeviceSPI;
+JobStore _jobStore;
+
 // Note that the value here for maxLen must be bigger than the value returned for restAPI_GetSettings()
 // This is to ensure the web-app doesn't return a string that is too long
 static const int EEPROM_CONFIG_BASE = 0;
@@ -139,6 +175,46 @@ void restAPI_Sequence(RestAPIEndpointMsg& apiMsg, String& retStr)
     _commandInterpreter.process(apiMsg._pArgStr, retStr);
 }
 
+// Binary motion protocol frames in the POST content (see BinaryMotionProtocol.h) - the result
+// includes the frames and bytes accepted so that the remainder can be resent if busy
+void restAPI_BinMove(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.trace("RestAPI BinMove method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    if (!apiMsg._pMsgContent || apiMsg._msgContentLen <= 0)
+    {
+        retStr = "{\"rslt\":\"fail\",\"err\":\"nocontent\"}";
+        return;
+    }
+    _commandInterpreter.processBinary(apiMsg._pMsgContent, apiMsg._msgContentLen, retStr);
+}
+
+// Pre-flight check of a job (G-code lines separated by newlines or semicolons and pattern names)
+// via API - the job is in the POST content or the args - runs in the background, results from
+// validatestatus
+void restAPI_Validate(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.info("RestAPI Validate method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    String jobStr;
+    if (apiMsg._pMsgContent && apiMsg._msgContentLen > 0)
+    {
+        jobStr.reserve(apiMsg._msgContentLen);
+        for (int i = 0; i < apiMsg._msgContentLen; i++)
+            jobStr.concat((char)apiMsg._pMsgContent[i]);
+    }
+    else if (apiMsg._pArgStr)
+    {
+        jobStr = apiMsg._pArgStr;
+    }
+    _robotController.validateJob(jobStr, _commandInterpreter.getValidatePatternSource());
+    retStr = _robotController.getValidateStatusJSON();
+}
+
+// Get status of pre-flight check
+void restAPI_ValidateStatus(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    retStr = _robotController.getValidateStatusJSON();
+}
+
 // Get machine status
 void restAPI_Status(RestAPIEndpointMsg& apiMsg, String& retStr)
 {
@@ -147,6 +223,188 @@ void restAPI_Status(RestAPIEndpointMsg& apiMsg, String& retStr)
     retStr = cmdArgs.toJSON();
 }
 
+// Get the aux motion channel index from the start of the API args (e.g. 0/G1 X10) - -1 if not valid
+int restAPI_GetAuxChannelIdx(const char* pArgStr, const char*& pChannelArgs)
+{
+    char* pEndStr = NULL;
+    long chanIdx = strtol(pArgStr, &pEndStr, 10);
+    if ((pEndStr == pArgStr) || (chanIdx < 0) || (chanIdx >= NUM_AUX_MOTION_CHANNELS))
+        return -1;
+    if (!_auxMotionChannels[chanIdx]._isConfigured)
+        return -1;
+    pChannelArgs = (*pEndStr == '/') ? pEndStr + 1 : pEndStr;
+    return chanIdx;
+}
+
+// Exec command on an aux motion channel via API
+void restAPI_AuxExec(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.info("RestAPI AuxExec method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    const char* pChannelArgs = "";
+    int chanIdx = restAPI_GetAuxChannelIdx(apiMsg._pArgStr, pChannelArgs);
+    if (chanIdx < 0)
+    {
+        retStr = "{\"rslt\":\"fail\"}";
+        return;
+    }
+    _auxMotionChannels[chanIdx]._commandInterpreter.process(pChannelArgs, retStr);
+}
+
+// Get status of an aux motion channel
+void restAPI_AuxStatus(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    const char* pChannelArgs = "";
+    int chanIdx = restAPI_GetAuxChannelIdx(apiMsg._pArgStr, pChannelArgs);
+    if (chanIdx < 0)
+    {
+        retStr = "{\"rslt\":\"fail\"}";
+        return;
+    }
+    RobotCommandArgs cmdArgs;
+    _auxMotionChannels[chanIdx]._robotController.getCurStatus(cmdArgs);
+    retStr = cmdArgs.toJSON();
+}
+
+// Result of a job API call with the job status
+void restAPI_JobResult(const char* rsltStr, String& retStr)
+{
+    char statusStr[200];
+    _commandInterpreter.getJobFeeder().getStatusJSON(statusStr, sizeof(statusStr));
+    retStr = String::format("{\"rslt\":\"%s\",", rsltStr) + (statusStr + 1);
+}
+
+// Start an uploaded G-code job - the args can give the total size of the job (for progress) and
+// the POST content is the first chunk - lines are fed to the workflow as the queue has space
+void restAPI_JobStart(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.info("RestAPI JobStart method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    JobFeeder& jobFeeder = _commandInterpreter.getJobFeeder();
+    unsigned long totalBytes = apiMsg._pArgStr ? strtoul(apiMsg._pArgStr, NULL, 10) : 0;
+    jobFeeder.start(totalBytes);
+    bool rslt = true;
+    if (apiMsg._pMsgContent && (apiMsg._msgContentLen > 0))
+        rslt = jobFeeder.append((const char*)apiMsg._pMsgContent, apiMsg._msgContentLen, false);
+    restAPI_JobResult(rslt ? "ok" : "busy", retStr);
+}
+
+// Append a chunk (POST content) to the job - busy if there isn't space for all of it (retry
+// when bufFree allows) - the args are "last" for the final chunk
+void restAPI_JobAppend(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.trace("RestAPI JobAppend method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    JobFeeder& jobFeeder = _commandInterpreter.getJobFeeder();
+    bool isLast = apiMsg._pArgStr && (strncasecmp(apiMsg._pArgStr, "last", 4) == 0);
+    const char* pData = apiMsg._pMsgContent ? (const char*)apiMsg._pMsgContent : "";
+    unsigned int dataLen = apiMsg._pMsgContent ? apiMsg._msgContentLen : 0;
+    bool rslt = jobFeeder.append(pData, dataLen, isLast);
+    restAPI_JobResult(rslt ? "ok" : "busy", retStr);
+}
+
+// Pause the job (and motion)
+void restAPI_JobPause(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    _commandInterpreter.getJobFeeder().pause(true);
+    _robotController.pause(true);
+    restAPI_JobResult("ok", retStr);
+}
+
+// Resume the job (and motion)
+void restAPI_JobResume(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    _commandInterpreter.getJobFeeder().pause(false);
+    _robotController.pause(false);
+    restAPI_JobResult("ok", retStr);
+}
+
+// Stop the job - as the stop command this also stops motion and clears the queue
+void restAPI_JobStop(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    String stopRetStr;
+    _commandInterpreter.process("stop", stopRetStr);
+    restAPI_JobResult("ok", retStr);
+}
+
+// Get job status
+void restAPI_JobStatus(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    restAPI_JobResult("ok", retStr);
+}
+
+// Check if any motion channel is moving - erasing a flash sector blocks the loop for up to
+// 500ms which would starve the motion pipeline so jobs are only stored when motion is idle
+bool isMotionIdle()
+{
+    if (!_robotController.isIdle())
+        return false;
+    for (int chanIdx = 0; chanIdx < NUM_AUX_MOTION_CHANNELS; chanIdx++)
+        if (_auxMotionChannels[chanIdx]._isConfigured && !_auxMotionChannels[chanIdx]._robotController.isIdle())
+            return false;
+    return true;
+}
+
+// Start storing a job - the args are the slot and job name and the POST content is the first chunk
+// Busy (retry later) while motion is in progress
+void restAPI_StoreStart(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.info("RestAPI StoreStart method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    if (!isMotionIdle())
+    {
+        retStr = "{\"rslt\":\"busy\"}";
+        return;
+    }
+    const char* pArgs = apiMsg._pArgStr ? apiMsg._pArgStr : "";
+    char* pNameStr = NULL;
+    unsigned long slotIdx = strtoul(pArgs, &pNameStr, 10);
+    if ((pNameStr == pArgs) || (*pNameStr != '/') || (*(pNameStr + 1) == 0) ||
+                    !_jobStore.startWrite(slotIdx, pNameStr + 1))
+    {
+        retStr = "{\"rslt\":\"fail\"}";
+        return;
+    }
+    bool rslt = true;
+    if (apiMsg._pMsgContent && (apiMsg._msgContentLen > 0))
+        rslt = _jobStore.write((const char*)apiMsg._pMsgContent, apiMsg._msgContentLen);
+    retStr = rslt ? "{\"rslt\":\"ok\"}" : "{\"rslt\":\"fail\"}";
+}
+
+// Append a chunk (POST content) to the job being stored - the args are "last" for the final
+// chunk and the job is only listed (and can only be run) once that is received
+// Busy while motion is in progress - the write isn't abandoned so the chunk can be sent again
+void restAPI_StoreAppend(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    Log.trace("RestAPI StoreAppend method %d contentLen %d", apiMsg._method, apiMsg._msgContentLen);
+    if (!isMotionIdle())
+    {
+        retStr = "{\"rslt\":\"busy\"}";
+        return;
+    }
+    bool isLast = apiMsg._pArgStr && (strncasecmp(apiMsg._pArgStr, "last", 4) == 0);
+    bool rslt = true;
+    if (apiMsg._pMsgContent && (apiMsg._msgContentLen > 0))
+        rslt = _jobStore.write((const char*)apiMsg._pMsgContent, apiMsg._msgContentLen);
+    else
+        rslt = _jobStore.isWriting();
+    if (rslt && isLast)
+        rslt = _jobStore.endWrite();
+    retStr = rslt ? "{\"rslt\":\"ok\"}" : "{\"rslt\":\"fail\"}";
+}
+
+// Run a stored job - the args are the job name or slot (as the runjob command)
+void restAPI_StoreRun(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    String runRetStr;
+    _commandInterpreter.process((String("runjob ") + (apiMsg._pArgStr ? apiMsg._pArgStr : "")).c_str(), runRetStr);
+    restAPI_JobResult(runRetStr.indexOf("ok") >= 0 ? "ok" : "fail", retStr);
+}
+
+// List stored jobs
+void restAPI_StoreList(RestAPIEndpointMsg& apiMsg, String& retStr)
+{
+    char listStr[600];
+    _jobStore.getJobsJSON(listStr, sizeof(listStr));
+    retStr = listStr;
+}
+
 // Exec via particle function
 void particleAPI_Exec(const char* cmdStr, String& retStr)
 {
@@ -154,6 +412,19 @@ void particleAPI_Exec(const char* cmdStr, String& retStr)
     _commandInterpreter.process(cmdStr, retStr);
 }
 
+// Check the job store chip-select isn't an SPI data pin or used by any motion channel
+bool isJobStoreCSPinFree(int csPin)
+{
+    if ((csPin < 0) || (csPin == A3) || (csPin == A4) || (csPin == A5))
+        return false;
+    if (_robotController.isPinInUse(csPin))
+        return false;
+    for (int chanIdx = 0; chanIdx < NUM_AUX_MOTION_CHANNELS; chanIdx++)
+        if (_auxMotionChannels[chanIdx]._isConfigured && _auxMotionChannels[chanIdx]._robotController.isPinInUse(csPin))
+            return false;
+    return true;
+}
+
 void reconfigure()
 {
     // Get the config data
@@ -176,6 +447,19 @@ void reconfigure()
     _robotController.init(robotConfig.c_str());
     _workflowManager.init(robotConfig.c_str());
 
+    // Init any aux motion channels which have a config
+    for (int chanIdx = 0; chanIdx < NUM_AUX_MOTION_CHANNELS; chanIdx++)
+    {
+        AuxMotionChannel& channel = _auxMotionChannels[chanIdx];
+        String auxRobotConfig = RdJson::getString(("/auxRobotConfig" + String(chanIdx)).c_str(), "", configData.c_str());
+        channel._isConfigured = auxRobotConfig.length() > 0;
+        if (!channel._isConfigured)
+            continue;
+        Log.info("RBotFirmware: aux motion channel %d", chanIdx);
+        channel._robotController.init(auxRobotConfig.c_str());
+        channel._workflowManager.init(auxRobotConfig.c_str());
+    }
+
     // Configure the command interpreter
     Log.info("Main setting config");
     String patternsStr = RdJson::getString("/patterns", "{}", configManager.getConfigData().c_str());
@@ -184,6 +468,21 @@ void reconfigure()
     String sequencesStr = RdJson::getString("/sequences", "{}", configManager.getConfigData().c_str());
     _commandInterpreter.setSequences(sequencesStr);
     Log.info("Main sequences %s", sequencesStr.c_str());
+
+    // Job store
+    String jobStoreConfig = RdJson::getString("/jobStore", "", configData.c_str());
+    if (jobStoreConfig.length() > 0)
+    {
+        String csPinName = RdJson::getString("spiCS", JOB_STORE_DEFAULT_CS_PIN, jobStoreConfig.c_str());
+        long numSlots = RdJson::getLong("slots", 4, jobStoreConfig.c_str());
+        int csPin = ConfigPinMap::getPinFromName(csPinName.c_str());
+        bool csPinOk = isJobStoreCSPinFree(csPin);
+        if (!csPinOk)
+            Log.error("Main jobStore cs %s is used for SPI or motion", csPinName.c_str());
+        bool storeOk = csPinOk && _flashDeviceSPI.setup(csPin) && _jobStore.setup(&_flashDeviceSPI, numSlots);
+        Log.info("Main jobStore cs %s slots %ld %s", csPinName.c_str(), numSlots, storeOk ? "ok" : "FAILED");
+        _commandInterpreter.setJobStore(storeOk ? &_jobStore : NULL);
+    }
 }
 
 void handleStartupCommands()
@@ -221,10 +520,22 @@ void setup()
     Utils::logLongStr("Main: ConfigStr", configStr.c_str(), true);
     configManager.setConfigData(configStr.c_str());
 
+    // Move logging off the USB serial port if it is used for streaming
+    if (RdJson::getLong("serialStreaming", 0, configStr.c_str()) != 0)
+    {
+        Log.info("Main: serial streaming - logging moves to Serial1");
+        LogManager::instance()->removeHandler(&logHandler);
+        pStreamingLogHandler = new Serial1LogHandler(115200, LOG_LEVEL_INFO);
+    }
+
     #ifdef RUN_TEST_CONFIG
     TestConfigManager::runTests();
     #endif
 
+    #ifdef RUN_TEST_SCARA_KINEMATICS
+    TestScaraKinematicsTiming::runTests();
+    #endif
+
     // Add API endpoints
     restAPIEndpoints.addEndpoint("getRobotTypes", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_GetRobotTypes, "", "");
     restAPIEndpoints.addEndpoint("getRobotTypeConfig", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_GetRobotTypeConfig, "", "");
@@ -233,7 +544,22 @@ void setup()
     restAPIEndpoints.addEndpoint("exec", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_Exec, "", "");
     restAPIEndpoints.addEndpoint("pattern", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_Pattern, "", "");
     restAPIEndpoints.addEndpoint("sequence", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_Sequence, "", "");
+    restAPIEndpoints.addEndpoint("binmove", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_BinMove, "", "");
+    restAPIEndpoints.addEndpoint("jobstart", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobStart, "", "");
+    restAPIEndpoints.addEndpoint("jobappend", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobAppend, "", "");
+    restAPIEndpoints.addEndpoint("jobpause", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobPause, "", "");
+    restAPIEndpoints.addEndpoint("jobresume", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobResume, "", "");
+    restAPIEndpoints.addEndpoint("jobstop", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobStop, "", "");
+    restAPIEndpoints.addEndpoint("jobstatus", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_JobStatus, "", "");
+    restAPIEndpoints.addEndpoint("storestart", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_StoreStart, "", "");
+    restAPIEndpoints.addEndpoint("storeappend", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_StoreAppend, "", "");
+    restAPIEndpoints.addEndpoint("storerun", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_StoreRun, "", "");
+    restAPIEndpoints.addEndpoint("storelist", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_StoreList, "", "");
     restAPIEndpoints.addEndpoint("status", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_Status, "", "");
+    restAPIEndpoints.addEndpoint("validate", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_Validate, "", "");
+    restAPIEndpoints.addEndpoint("validatestatus", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_ValidateStatus, "", "");
+    restAPIEndpoints.addEndpoint("auxexec", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_AuxExec, "", "");
+    restAPIEndpoints.addEndpoint("auxstatus", RestAPIEndpointDef::ENDPOINT_CALLBACK, restAPI_AuxStatus, "", "");
 
     // Construct web server
     Log.info("Main: Constructing Web Server");
@@ -343,6 +669,13 @@ void loop()
         // Service the robot controller
         debugLoopTimer.blockStart(3);
         _robotController.service();
+        for (int chanIdx = 0; chanIdx < NUM_AUX_MOTION_CHANNELS; chanIdx++)
+        {
+            if (!_auxMotionChannels[chanIdx]._isConfigured)
+                continue;
+            _auxMotionChannels[chanIdx]._commandInterpreter.service();
+            _auxMotionChannels[chanIdx]._robotController.service();
+        }
         debugLoopTimer.blockEnd(3);
 
     }
@@ -381,6 +714,9 @@ void loop()
         }
         // Check for web server idle and attempt to write when it is idle
         bool robotActive = _robotController.wasActiveInLastNSeconds(ROBOT_IDLE_BEFORE_WRITE_EEPROM_SECS);
+        for (int chanIdx = 0; chanIdx < NUM_AUX_MOTION_CHANNELS; chanIdx++)
+            if (_auxMotionChannels[chanIdx]._isConfigured)
+                robotActive |= _auxMotionChannels[chanIdx]._robotController.wasActiveInLastNSeconds(ROBOT_IDLE_BEFORE_WRITE_EEPROM_SECS);
         bool webActive = ((pWebServer) && (pWebServer->wasActiveInLastNSeconds(WEB_IDLE_BEFORE_WRITE_EEPROM_SECS)));
         if ((configMustWrite || (!robotActive && !webActive) || (ROBOT_IDLE_BEFORE_WRITE_EEPROM_SECS == 0 && WEB_IDLE_BEFORE_WRITE_EEPROM_SECS == 0)))
             configPersistence.write(configManager.getConfigData().c_str());
@@ -24,6 +24,7 @@ public:
     {
     }
 
+
     // Pause (or un-pause) all motion
     virtual void pause(bool pauseIt)
     {
@@ -76,11 +77,38 @@ public:
         _motionHelper.setMotionParams(args);
     }
 
+    virtual void setMotionTuning(MotionTuning& tuning)
+    {
+        _motionHelper.setMotionTuning(tuning);
+    }
+
+    // Dwell and event markers in the motion pipeline
+    virtual bool dwell(uint32_t dwellMs, int numberedCmdIdx)
+    {
+        return _motionHelper.dwell(dwellMs, numberedCmdIdx);
+    }
+
+    virtual bool addEvent(int eventId, int eventPin, bool eventPinLevel, int numberedCmdIdx)
+    {
+        return _motionHelper.addEvent(eventId, eventPin, eventPinLevel, numberedCmdIdx);
+    }
+
     virtual void getCurStatus(RobotCommandArgs& args)
     {
         _motionHelper.getCurStatus(args);
     }
 
+    // Pre-flight check of a job
+    virtual void validateJob(const String& job, JobValidatorPatternSource* pPatternSource)
+    {
+        _motionHelper.validateJob(job, pPatternSource);
+    }
+
+    virtual JobValidatorStatus& getValidateStatus()
+    {
+        return _motionHelper.getValidateStatus();
+    }
+
     // Homing commands
     virtual void goHome(RobotCommandArgs& args)
     {
@@ -26,6 +26,8 @@ private:
   bool _pause : 1;
   int _queuedCommands;
   int _numberedCommandIndex;
+  int _lastEventId;
+  uint32_t _eventsReached;
   AxisFloats _ptInMM;
   AxisInt32s _ptInSteps;
   float _extrudeValue;
@@ -56,6 +58,8 @@ public:
     _feedrateValue = 0.0;
     _moveType      = RobotMoveTypeArg_None;
     _queuedCommands = 0;
+    _lastEventId = 0;
+    _eventsReached = 0;
   }
 private:
   void copy(const RobotCommandArgs& copyFrom)
@@ -76,6 +80,8 @@ private:
     _numberedCommandIndex = copyFrom._numberedCommandIndex;
     _moveType      = copyFrom._moveType;
     _queuedCommands = copyFrom._queuedCommands;
+    _lastEventId   = copyFrom._lastEventId;
+    _eventsReached = copyFrom._eventsReached;
   }
 public:
   RobotCommandArgs(const RobotCommandArgs& other)
@@ -247,6 +253,19 @@ public:
   {
     _pause = pause;
   }
+  void setEvents(int lastEventId, uint32_t eventsReached)
+  {
+    _lastEventId = lastEventId;
+    _eventsReached = eventsReached;
+  }
+  int getLastEventId()
+  {
+    return _lastEventId;
+  }
+  uint32_t getEventsReached()
+  {
+    return _eventsReached;
+  }
   String toJSON()
   {
     String jsonStr;
@@ -274,6 +293,11 @@ public:
     String queuedCommandsStr = String::format("%d", _queuedCommands);
     jsonStr += ", \"Qd\":" + queuedCommandsStr;
     jsonStr += String(", \"pause\":") + (_pause ? "1" : "0");
+    if (_eventsReached > 0)
+    {
+      String eventsStr = String::format("%d, \"evtN\":%lu", _lastEventId, (unsigned long)_eventsReached);
+      jsonStr += ", \"evt\":" + eventsStr;
+    }
     jsonStr += "}";
     return jsonStr;
   }
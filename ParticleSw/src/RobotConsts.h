@@ -1,8 +1,21 @@
 #pragma once
 
+// Number of axes is fixed at build time - every MotionBlock and every ISR loop is sized by it
+// so 2-axis robots should build with RBOT_NUM_AXES 2 and machines with up to 6 axes are possible
+// The Particle cloud compiler doesn't take defines so build2axis.bat generates RBotBuildAxes.h
+#if defined(__has_include)
+#if __has_include("RBotBuildAxes.h")
+#include "RBotBuildAxes.h"
+#endif
+#endif
+#ifndef RBOT_NUM_AXES
+#define RBOT_NUM_AXES 3
+#endif
+
 namespace RobotConsts
 {
-  static constexpr int MAX_AXES              = 3;
+  static constexpr int MAX_AXES              = RBOT_NUM_AXES;
+  static_assert(MAX_AXES >= 2 && MAX_AXES <= 6, "RBOT_NUM_AXES must be between 2 and 6");
   static constexpr int MAX_ENDSTOPS_PER_AXIS = 2;
 
   // MOTOR_TYPE_DRIVER has an A4988 or similar stepper driver chip that just requires step and direction
@@ -87,7 +87,9 @@ public:
 
         if (_pRobot)
         {
-            _motionHelper.setTestMode(TEST_MOTION_ACTUATOR_CONFIG);
+            // Test instrumentation is shared so only the first motion channel uses it
+            if (_motionHelper.getMotionChannelIdx() == 0)
+                _motionHelper.setTestMode(TEST_MOTION_ACTUATOR_CONFIG);
             _pRobot->pause(false);
         }
 
@@ -163,6 +165,29 @@ public:
         _pRobot->setMotionParams(args);
     }
 
+    // Change motion limits in place (runtime tuning M-codes)
+    void setMotionTuning(MotionTuning& tuning)
+    {
+        if (!_pRobot)
+            return;
+        _pRobot->setMotionTuning(tuning);
+    }
+
+    // Dwell (G4) and event markers (M42, M400) queued with the motion
+    bool dwell(uint32_t dwellMs, int numberedCmdIdx)
+    {
+        if (!_pRobot)
+            return false;
+        return _pRobot->dwell(dwellMs, numberedCmdIdx);
+    }
+
+    bool addEvent(int eventId, int eventPin, bool eventPinLevel, int numberedCmdIdx)
+    {
+        if (!_pRobot)
+            return false;
+        return _pRobot->addEvent(eventId, eventPin, eventPinLevel, numberedCmdIdx);
+    }
+
     // Get status
     void getCurStatus(RobotCommandArgs& args)
     {
@@ -171,6 +196,31 @@ public:
         _pRobot->getCurStatus(args);
     }
 
+    // Start pre-flight check of a job (patterns named in the job are checked if a pattern source
+    // is given)
+    void validateJob(const String& job, JobValidatorPatternSource* pPatternSource)
+    {
+        if (!_pRobot)
+            return;
+        _pRobot->validateJob(job, pPatternSource);
+    }
+
+    // Get status of pre-flight check as JSON
+    String getValidateStatusJSON()
+    {
+        char jsonStr[300];
+        if (!_pRobot)
+        {
+            JobValidatorStatus status;
+            status.toJSON(jsonStr, sizeof(jsonStr));
+        }
+        else
+        {
+            _pRobot->getValidateStatus().toJSON(jsonStr, sizeof(jsonStr));
+        }
+        return jsonStr;
+    }
+
     // Go Home
     void goHome(RobotCommandArgs& args)
     {
@@ -187,6 +237,18 @@ public:
         _pRobot->setHome(args);
     }
 
+    // Check if motion is complete (nothing in the pipeline)
+    bool isIdle()
+    {
+        return _motionHelper.isIdle();
+    }
+
+    // Check if a pin is used for motion
+    bool isPinInUse(int pin)
+    {
+        return _motionHelper.isPinInUse(pin);
+    }
+
     bool wasActiveInLastNSeconds(int nSeconds)
     {
         if (!_pRobot)
@@ -7,6 +7,7 @@
 #include "Utils.h"
 #include "RobotBase.h"
 #include "MotionHelper.h"
+#include "GeistBotKinematics.h"
 #include "math.h"
 
 class RobotGeistBot : public RobotBase
@@ -26,128 +27,61 @@ private:
 
 public:
 
+    // Notes for GeistBot
+    // Axis 0 rotates the arm (units are degrees clockwise from North)
+    // Axis 1 moves the carriage along the arm using a rack and pinion (units are mm from the centre)
+    // The pinion motor is mounted on the arm so rotation of the arm also moves the carriage - see GeistBotKinematics.h
+
+    // Convert a cartesian point to actuator coordinates - the arm takes the shortest rotation from
+    // the current position so the result depends on curPos
     static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds)
     {
-        // // Trig for required position (azimuth is measured clockwise from North)
-        // PointND& pt = motionElem._pt2MM;
-        // double reqAlphaRads = atan2(pt._pt[0], pt._pt[1]);
-        // if (reqAlphaRads < 0)
-        //     reqAlphaRads = 2 * M_PI + reqAlphaRads;
-        // double reqLinearMM = sqrt(pt._pt[0] * pt._pt[0] + pt._pt[1] * pt._pt[1]);
-        //
-        // // Log.trace("xyToActuator x %0.2f y %0.2f ax0StNow %d ax1StNow %d rqAlphaD %0.2f rqLinMM %0.2f",
-        // //         xy[0], xy[1], axisParams[0]._stepsFromHome, axisParams[1]._stepsFromHome,
-        // //         reqAlphaRads * 180 / M_PI, reqLinearMM);
-        //
-        // // Get current position
-        // PointND axisPosns;
-        // for (int i = 0; i < MAX_AXES; i++)
-        //     axisPosns._pt[i] = axisParams[i]._stepsFromHome;
-        // double currentPolar[NUM_ROBOT_AXES];
-        // actuatorToPolar(axisPosns, currentPolar, axisParams, 2);
-        //
-        // // Calculate shortest azimuth distance
-        // double alphaDiffRads = reqAlphaRads - currentPolar[0];
-        // bool alphaRotateCw = alphaDiffRads > 0;
-        // if (fabs(alphaDiffRads) > M_PI)
-        // {
-        //     alphaDiffRads = 2 * M_PI - fabs(alphaDiffRads);
-        //     alphaRotateCw = !alphaRotateCw;
-        // }
-        // double alphaDiffDegs = fabs(alphaDiffRads) * 180 / M_PI;
-        //
-        // // Linear distance
-        // double linearDiffMM = reqLinearMM - currentPolar[1];
-        //
-        // // Convert to steps - note that to keep the linear position constant the linear stepper needs to step one step in the same
-        // // direction as the arm rotation stepper - so the linear stepper steps required is the sum of the rotation and linear steps
-        // double actuator0Diff = alphaDiffDegs * axisParams[0].stepsPerUnit() * (alphaRotateCw ? 1 : -1);
-        // double actuator1Diff = linearDiffMM * axisParams[1].stepsPerUnit() + actuator0Diff;
-        // actuatorCoords._pt[0] = axisParams[0]._stepsFromHome + actuator0Diff;
-        // actuatorCoords._pt[1] = axisParams[1]._stepsFromHome + actuator1Diff;
-        //
-        // // Log.trace("xyToActuator reqAlphaD %0.2f curAlphaD %0.2f alphaDiffD %0.2f aRotCw %d linDiffMM %0.2f ax0Diff %0.2f ax1Diff %0.2f ax0Tgt %0.2f ax1Tgt %0.2f",
-        // //                 reqAlphaRads * 180 / M_PI, currentPolar[0] * 180 / M_PI, alphaDiffDegs, alphaRotateCw,
-        // //                 linearDiffMM, actuator0Diff, actuator1Diff, actuatorCoords[0], actuatorCoords[1]);
-        // //
-        // // Log.trace("bounds check X (En%d) %d, Y (En%d) %d", axisParams[1]._minValValid, reqLinearMM < axisParams[1]._minVal,
-        // //             axisParams[1]._maxValValid, reqLinearMM > axisParams[1]._maxVal);
-        //
-        // // Cross check
-        // double checkPolarCoords[NUM_ROBOT_AXES];
-        // actuatorToPolar(actuatorCoords, checkPolarCoords, axisParams, 2);
-        // double checkX = checkPolarCoords[1] * sin(checkPolarCoords[0]);
-        // double checkY = checkPolarCoords[1] * cos(checkPolarCoords[0]);
-        // double checkErr = sqrt((checkX-pt._pt[0]) * (checkX-pt._pt[0]) + (checkY-pt._pt[1]) * (checkY-pt._pt[1]));
-        // if (checkErr > 0.1)
-        //     Log.trace("check reqX %02.f checkX %0.2f, reqY %0.2f checkY %0.2f, error %0.2f, %s", pt._pt[0], checkX, pt._pt[1], checkY,
-        //                     checkErr, (checkErr>0.1) ? "****** FAILED ERROR CHECK" : "");
-        //
-        // // Check machine bounds for linear axis
-        // if (axisParams[1]._minValValid && reqLinearMM < axisParams[1]._minVal)
-        //     return false;
-        // if (axisParams[1]._maxValValid && reqLinearMM > axisParams[1]._maxVal)
-        //     return false;
-        return true;
+        GeistBotKinematics& kinematics = getKinematics(axesParams);
+        return kinematics.ptToActuator(targetPt._pt[0], targetPt._pt[1],
+                    curPos._stepsFromHome.getVal(0), curPos._stepsFromHome.getVal(1),
+                    outActuator._pt[0], outActuator._pt[1], allowOutOfBounds);
     }
 
-    static void actuatorToPolar(AxisFloats& actuatorCoords, float polarCoordsAzFirst[], AxesParams& axesParams)
+    static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
     {
-        // Calculate azimuth
-        int alphaSteps = (abs(int(actuatorCoords._pt[0])) % (int)(axesParams.getstepsPerRot(0)));
-        double alphaDegs = alphaSteps / axesParams.getStepsPerUnit(0);
-        if (actuatorCoords._pt[0] < 0)
-            alphaDegs = axesParams.getunitsPerRot(0)-alphaDegs;
-        polarCoordsAzFirst[0] = alphaDegs * M_PI / 180;
-
-        // Calculate linear position (note that this robot has interaction between azimuth and linear motion as the rack moves
-        // if the pinion gear remains still and the arm assembly moves around it) - so the required linear calculation uses the
-        // difference in linear and arm rotation steps
-        long linearStepsFromHome = actuatorCoords._pt[1] - actuatorCoords._pt[0];
-        polarCoordsAzFirst[1] = linearStepsFromHome / axesParams.getStepsPerUnit(1);
-
-        // Log.trace("actuatorToPolar c0 %0.2f c1 %0.2f alphaSteps %d alphaDegs %0.2f linStpHm %d rotD %0.2f lin %0.2f", actuatorCoords[0], actuatorCoords[1],
-        //     alphaSteps, alphaDegs, linearStepsFromHome, polarCoordsAzFirst[0] * 180 / M_PI, polarCoordsAzFirst[1]);
+        GeistBotKinematics& kinematics = getKinematics(axesParams);
+        kinematics.actuatorToPt(int32_t(targetActuator.getVal(0)), int32_t(targetActuator.getVal(1)),
+                    outPt._pt[0], outPt._pt[1]);
     }
 
-    static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+    // Keep the rotation steps within a single rotation so that continuous rotation doesn't overflow
+    static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
     {
-        float polarCoords[NUM_ROBOT_AXES];
-        actuatorToPolar(targetActuator, polarCoords, axesParams);
+        GeistBotKinematics& kinematics = getKinematics(axesParams);
+        int32_t steps0 = curPos._stepsFromHome.getVal(0);
+        int32_t steps1 = curPos._stepsFromHome.getVal(1);
+        if (kinematics.correctStepOverflow(steps0, steps1) == 0)
+            return;
+        curPos._stepsFromHome.setVal(0, steps0);
+        curPos._stepsFromHome.setVal(1, steps1);
+    }
 
-        // Trig
-        outPt._pt[0] = polarCoords[1] * sinf(polarCoords[0]);
-        outPt._pt[1] = polarCoords[1] * cosf(polarCoords[0]);
-        // Log.trace("actuatorToXy curX %0.2f curY %0.2f", xy[0], xy[1]);
+private:
+    // Kinematics of the robot which owns the axis parameters
+    static GeistBotKinematics& getKinematics(AxesParams& axesParams)
+    {
+        return *static_cast<GeistBotKinematics*>(axesParams.getRobotKinematics());
     }
 
-    static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+    // Take the geometry from the axis parameters (after configuration)
+    void setupKinematics()
     {
-        int rotationSteps = (int)(axesParams.getstepsPerRot(0));
-        // Debug
-        bool showDebug = false;
-        if (axesParams.gethomeOffSteps(0) > rotationSteps || axesParams.gethomeOffSteps(0) <= -rotationSteps)
-        {
-            Log.trace("CORRECTING ax0 %ld ax1 %ld",
-                            axesParams.gethomeOffSteps(0), axesParams.gethomeOffSteps(1));
-            showDebug = true;
-        }
-        // Bring steps from home values back within a single rotation
-        while (axesParams.gethomeOffSteps(0) > rotationSteps)
-        {
-            axesParams.sethomeOffSteps(0, axesParams.gethomeOffSteps(0) - rotationSteps);
-            axesParams.sethomeOffSteps(1, axesParams.gethomeOffSteps(1) - rotationSteps);
-        }
-        while (axesParams.gethomeOffSteps(0) <= -rotationSteps)
-        {
-            axesParams.sethomeOffSteps(0, axesParams.gethomeOffSteps(0) + rotationSteps);
-            axesParams.sethomeOffSteps(1, axesParams.gethomeOffSteps(1) + rotationSteps);
-        }
-        if (showDebug)
-            Log.trace("CORRECTED ax0 %ld ax1 %ld",
-                            axesParams.gethomeOffSteps(0), axesParams.gethomeOffSteps(1));
+        AxesParams& axesParams = _motionHelper.getAxesParams();
+        float minVal = 0, maxVal = 0;
+        bool minValid = axesParams.getMinVal(1, minVal);
+        bool maxValid = axesParams.getMaxVal(1, maxVal);
+        _kinematics.setGeometry(axesParams.getstepsPerRot(0), axesParams.getunitsPerRot(0),
+                    axesParams.getStepsPerUnit(1), minValid, minVal, maxValid, maxVal);
     }
 
+    // Kinematics for this robot (each motion channel has its own robot)
+    GeistBotKinematics _kinematics;
+
 private:
     // Homing state
     typedef enum HOMING_STATE
@@ -197,9 +131,23 @@ public:
         _homingStepsLimit = 0;
         _maxHomingSecs = maxHomingSecs_default;
         _timeBetweenHomingStepsUs = _homingRotateSlowStepTimeUs;
+        _motionHelper.getAxesParams().setRobotKinematics(&_kinematics);
         _motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
     }
 
+    ~RobotGeistBot()
+    {
+        _motionHelper.getAxesParams().setRobotKinematics(NULL);
+    }
+
+    // Init motion controller from config and set up the kinematics
+    bool init(const char* robotConfigStr)
+    {
+        RobotBase::init(robotConfigStr);
+        setupKinematics();
+        return true;
+    }
+
     // Set config
 //     bool init(const char* robotConfigStr)
 //     {
@@ -17,51 +17,6 @@ public:
     static constexpr int _homingLinearFastStepTimeUs = 15;
     static constexpr int _homingLinearSlowStepTimeUs = 24;
 
-public:
-
-    static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds)
-    {
-        // Note that the rotation angle comes straight from the Y parameter
-        // This means that drawings in the range 0 .. 240mm height (assuming 1:1 scaling is chosen)
-        // will translate directly to the surface of the mug and makes the drawing
-        // mug-radius independent
-
-        // Check machine bounds and fix the value if required
-        bool ptWasValid = axesParams.ptInBounds(targetPt, !allowOutOfBounds);
-
-        // Perform conversion
-        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-        {
-            // Axis val from home point
-            float axisValFromHome = targetPt.getVal(axisIdx) - axesParams.getHomeOffsetVal(axisIdx);
-            // Convert to steps and add offset to home in steps
-            outActuator.setVal(axisIdx, axisValFromHome * axesParams.getStepsPerUnit(axisIdx)
-                            + axesParams.gethomeOffSteps(axisIdx));
-
-            // Log.info("ptToActuator %f -> %f (homeOffVal %f, homeOffSteps %ld)",
-            //         pt.getVal(axisIdx), actuatorCoords._pt[axisIdx],
-            //         axesParams.getHomeOffsetVal(axisIdx), axesParams.gethomeOffSteps(axisIdx));
-        }
-        return ptWasValid;
-    }
-
-    static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
-    {
-        // Perform conversion
-        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-        {
-            float ptVal = targetActuator.getVal(axisIdx) - axesParams.gethomeOffSteps(axisIdx);
-            ptVal = ptVal / axesParams.getStepsPerUnit(axisIdx) + axesParams.getHomeOffsetVal(axisIdx);
-            outPt.setVal(axisIdx, ptVal);
-            // Log.info("actuatorToPt %d %f -> %f (perunit %f)", axisIdx, actuatorCoords.getVal(axisIdx),
-            //                 ptVal, axesParams.getStepsPerUnit(axisIdx));
-        }
-    }
-
-    static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
-    {
-    }
-
 private:
     // Homing state
     typedef enum HOMING_STATE
@@ -100,7 +55,7 @@ public:
         _maxHomingSecs = maxHomingSecs_default;
         _homeX = _homeY = _homeZ = false;
         _timeBetweenHomingStepsUs = _homingLinearSlowStepTimeUs;
-        _motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+        _motionHelper.setKinematics<CartesianKinematics>();
     }
 
     // Set config
@@ -2,9 +2,12 @@
 // Rob Dobson 2016-2018
 
 #include "RobotTypes.h"
+#include "RobotConsts.h"
 
 const char* RobotTypes::_robotConfigs[] = {
 
+// MugBot's pen lift servo is a third axis so it isn't offered by 2-axis builds
+#if RBOT_NUM_AXES >= 3
    "{\"robotType\":\"MugBot\",\"xMaxMM\":150,\"yMaxMM\":120,"
    "\"homingSeq\":\"B-x;B+r9X;B-1.0;B=h$\","
    "\"cmdsAtStart\":\"\","
@@ -18,6 +21,7 @@ const char* RobotTypes::_robotConfigs[] = {
    "\"axis2\":{\"servoPin\":\"D0\",\"isServoAxis\":1,\"isPrimaryAxis\": 0,\"homeOffsetVal\":180,\"homeOffSteps\":2500,"
    "\"minVal\":0,\"maxVal\":180,\"stepsPerRot\":2000,\"unitsPerRot\":360}"
    "}",
+#endif
 
 // static const char* ROBOT_CONFIG_STR_GEISTBOT =
 //     "{\"robotType\":\"GeistBot\",\"xMaxMM\":400,\"yMaxMM\":400, "
@@ -63,7 +67,7 @@ const char* RobotTypes::_robotConfigs[] = {
    "\"stepsPerRot\":3200,\"unitsPerRot\":32},"
    "\"axis1\":{\"stepPin\":\"D4\",\"dirnPin\":\"D5\",\"maxSpeed\":100.0,\"maxAcc\":10.0,"
    "\"stepsPerRot\":3200,\"unitsPerRot\":32},"
-   "\"commandQueue\":{\"cmdQueueMaxLen\":50}"
+   "\"commandQueue\":{\"cmdQueueBytes\":2000}"
    "}"
  };
 
@@ -11,52 +11,11 @@
 
 class RobotXYBot : public RobotBase
 {
-public:
-
-    static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams, bool allowOutOfBounds)
-    {
-        // Check machine bounds and fix the value if required
-        bool ptWasValid = axesParams.ptInBounds(targetPt, !allowOutOfBounds);
-
-        // Perform conversion
-        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-        {
-            // Axis val from home point
-            float axisValFromHome = targetPt.getVal(axisIdx) - axesParams.getHomeOffsetVal(axisIdx);
-            // Convert to steps and add offset to home in steps
-            outActuator.setVal(axisIdx, axisValFromHome * axesParams.getStepsPerUnit(axisIdx)
-                            + axesParams.gethomeOffSteps(axisIdx));
-
-            Log.trace("ptToActuator %f -> %f (homeOffVal %f, homeOffSteps %ld)",
-                    targetPt.getVal(axisIdx), outActuator._pt[axisIdx],
-                    axesParams.getHomeOffsetVal(axisIdx), axesParams.gethomeOffSteps(axisIdx));
-        }
-        return ptWasValid;
-    }
-
-    static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
-    {
-        // Perform conversion
-        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
-        {
-            float ptVal = targetActuator.getVal(axisIdx) - axesParams.gethomeOffSteps(axisIdx);
-            ptVal = ptVal / axesParams.getStepsPerUnit(axisIdx) + axesParams.getHomeOffsetVal(axisIdx);
-            outPt.setVal(axisIdx, ptVal);
-            Log.trace("actuatorToPt %d %f -> %f (perunit %f)", axisIdx, targetActuator.getVal(axisIdx),
-                            ptVal, axesParams.getStepsPerUnit(axisIdx));
-        }
-    }
-
-    static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
-    {
-        // Not necessary for a non-continuous rotation bot
-    }
-
 public:
     RobotXYBot(const char* pRobotTypeName, MotionHelper& motionHelper) :
         RobotBase(pRobotTypeName, motionHelper)
     {
-        _motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+        _motionHelper.setKinematics<CartesianKinematics>();
     }
 
     // // Set config
@@ -0,0 +1,295 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Kinematics for the SandTableScara
+// The geometry (arm lengths, squares, reciprocals and step scaling) is precomputed from the
+// axis parameters so the transforms done for every block are single-precision with no logging
+// All angles are in degrees clockwise from North
+// Positive stepping direction for axis 0 is clockwise movement of the upper arm
+// Positive stepping direction for axis 1 is anticlockwise movement of the lower arm
+// Axis 0 zero steps is at 0 degrees, axis 1 zero steps is at 180 degrees
+class SandTableScaraKinematics
+{
+public:
+  enum ROTATION_TYPE {
+    ROTATION_NORMAL,
+    ROTATION_OUT_OF_BOUNDS,
+    ROTATION_IS_NEAR_CENTRE,
+  };
+
+  // Points closer than this to the centre are treated as the centre
+  static constexpr float NEAR_CENTRE_MM = 0.1f;
+
+private:
+  // Axis parameters the geometry was computed from
+  float _unitsPerRot0;
+  float _unitsPerRot1;
+  float _stepsPerRot0;
+  float _stepsPerRot1;
+  bool _maxValValid;
+  float _maxVal;
+
+  // Precomputed geometry
+  float _shoulderElbowMM;
+  float _elbowHandMM;
+  float _maxRadiusMM;
+  float _shoulderElbowSq;
+  float _elbowHandSq;
+  float _recipTwoShoulderElbow;
+  float _recipTwoShoulderElbowElbowHand;
+  float _stepsPerDeg0;
+  float _stepsPerDeg1;
+  float _degsPerStep0;
+  float _degsPerStep1;
+
+  // Weights for joint travel
+  float _jointWeight0;
+  float _jointWeight1;
+
+  static constexpr float PI_F         = 3.14159265358979f;
+  static constexpr float TWO_PI_F     = 2 * PI_F;
+  static constexpr float DEGS_PER_RAD = 180.0f / PI_F;
+  static constexpr float RADS_PER_DEG = PI_F / 180.0f;
+
+public:
+  SandTableScaraKinematics()
+  {
+    _unitsPerRot0 = 0;
+    _unitsPerRot1 = 0;
+    _stepsPerRot0 = 0;
+    _stepsPerRot1 = 0;
+    _maxValValid  = false;
+    _maxVal       = 0;
+    _jointWeight0 = 1;
+    _jointWeight1 = 1;
+    setGeometry(1, 1, 1, 1, false, 0);
+  }
+
+  // The _unitsPerRot values indicate the circumference of the circle formed by moving each
+  // arm through 360 degrees - recalculation only happens if a value has changed
+  void setGeometry(float unitsPerRot0, float unitsPerRot1, float stepsPerRot0, float stepsPerRot1,
+                   bool maxValValid, float maxVal)
+  {
+    if ((unitsPerRot0 == _unitsPerRot0) && (unitsPerRot1 == _unitsPerRot1) &&
+        (stepsPerRot0 == _stepsPerRot0) && (stepsPerRot1 == _stepsPerRot1) &&
+        (maxValValid == _maxValValid) && (maxVal == _maxVal))
+      return;
+    _unitsPerRot0 = unitsPerRot0;
+    _unitsPerRot1 = unitsPerRot1;
+    _stepsPerRot0 = stepsPerRot0;
+    _stepsPerRot1 = stepsPerRot1;
+    _maxValValid  = maxValValid;
+    _maxVal       = maxVal;
+
+    // Arm lengths and reach
+    _shoulderElbowMM = unitsPerRot0 / TWO_PI_F;
+    _elbowHandMM     = unitsPerRot1 / TWO_PI_F;
+    _maxRadiusMM     = _shoulderElbowMM + _elbowHandMM;
+    if (maxValValid && (maxVal < _maxRadiusMM))
+      _maxRadiusMM = maxVal;
+
+    // Cosine rule terms
+    _shoulderElbowSq                = _shoulderElbowMM * _shoulderElbowMM;
+    _elbowHandSq                    = _elbowHandMM * _elbowHandMM;
+    _recipTwoShoulderElbow          = 1 / (2 * _shoulderElbowMM);
+    _recipTwoShoulderElbowElbowHand = 1 / (2 * _shoulderElbowMM * _elbowHandMM);
+
+    // Step scaling
+    _stepsPerDeg0 = stepsPerRot0 / 360;
+    _stepsPerDeg1 = stepsPerRot1 / 360;
+    _degsPerStep0 = 360 / stepsPerRot0;
+    _degsPerStep1 = 360 / stepsPerRot1;
+  }
+
+  // Convert a cartesian point to arm rotations
+  // Of the two solutions this chooses the one which keeps the angle between the arms in 0..180
+  // and any point near the centre is (0, 180) - see ptToActuatorMinTravel for the choice based
+  // on the current position
+  ROTATION_TYPE ptToRotations(float x, float y, float& alphaDegs, float& betaDegs) const
+  {
+    float alpha2Degs = 0, beta2Degs = 0;
+    ROTATION_TYPE rotationType = ptToRotationOptions(x, y, alphaDegs, betaDegs, alpha2Degs, beta2Degs);
+    if (rotationType == ROTATION_IS_NEAR_CENTRE)
+      return rotationType;
+    float betweenArms1 = wrapDegrees(betaDegs - alphaDegs);
+    if (!(betweenArms1 >= 0 && betweenArms1 < 180))
+    {
+      alphaDegs = alpha2Degs;
+      betaDegs  = beta2Degs;
+    }
+    return rotationType;
+  }
+
+  // Both arm configurations which reach a cartesian point (wrapped to 0..360)
+  ROTATION_TYPE ptToRotationOptions(float x, float y, float& alpha1Degs, float& beta1Degs,
+                    float& alpha2Degs, float& beta2Degs) const
+  {
+    // Centre of the machine is a special case (many solutions)
+    if ((fabsf(x) < NEAR_CENTRE_MM) && (fabsf(y) < NEAR_CENTRE_MM))
+    {
+      alpha1Degs = alpha2Degs = 0;
+      beta1Degs  = beta2Degs  = 180;
+      return ROTATION_IS_NEAR_CENTRE;
+    }
+
+    // Distance from origin to pt (forms one side of triangle where arm segments form other sides)
+    float thirdSideSq = x * x + y * y;
+    float thirdSideMM = sqrtf(thirdSideSq);
+    bool posValid     = thirdSideMM <= _maxRadiusMM;
+
+    // Angle from North to the point (X and Y are flipped from normal as angles are clockwise)
+    float delta1 = atan2f(x, y);
+    if (delta1 < 0)
+      delta1 += TWO_PI_F;
+
+    // Angle of triangle opposite elbow-hand side
+    float delta2 = acosClamped((thirdSideSq + _shoulderElbowSq - _elbowHandSq) * _recipTwoShoulderElbow / thirdSideMM);
+
+    // Angle of triangle opposite third side
+    float innerAngleOppThird = acosClamped((_shoulderElbowSq + _elbowHandSq - thirdSideSq) * _recipTwoShoulderElbowElbowHand);
+
+    // The two pairs of angles that solve these equations
+    // alpha is the angle from shoulder to elbow, beta is angle from elbow to hand
+    float alpha1rads = delta1 - delta2;
+    float beta1rads  = alpha1rads - innerAngleOppThird + PI_F;
+    float alpha2rads = delta1 + delta2;
+    float beta2rads  = alpha2rads + innerAngleOppThird - PI_F;
+    alpha1Degs = wrapDegrees(alpha1rads * DEGS_PER_RAD);
+    beta1Degs  = wrapDegrees(beta1rads * DEGS_PER_RAD);
+    alpha2Degs = wrapDegrees(alpha2rads * DEGS_PER_RAD);
+    beta2Degs  = wrapDegrees(beta2rads * DEGS_PER_RAD);
+    return posValid ? ROTATION_NORMAL : ROTATION_OUT_OF_BOUNDS;
+  }
+
+  // Convert a cartesian point to actuator steps choosing the arm configuration and the direction
+  // of rotation of each arm which needs the least joint travel from the current actuator position
+  // Travel on each axis is weighted by the joint weights (e.g. time per step)
+  // Through the centre the upper arm stays where it is and only the lower arm rotates
+  ROTATION_TYPE ptToActuatorMinTravel(float x, float y, int32_t curSteps0, int32_t curSteps1,
+                    float& steps0, float& steps1) const
+  {
+    // Current rotations
+    float curAlphaDegs = 0, curBetaDegs = 0;
+    actuatorToRotation(curSteps0, curSteps1, curAlphaDegs, curBetaDegs);
+
+    // Options
+    float alpha1Degs = 0, beta1Degs = 0, alpha2Degs = 0, beta2Degs = 0;
+    ROTATION_TYPE rotationType = ptToRotationOptions(x, y, alpha1Degs, beta1Degs, alpha2Degs, beta2Degs);
+    if (rotationType == ROTATION_IS_NEAR_CENTRE)
+    {
+      // The lower arm must point back along the upper arm
+      steps0 = float(curSteps0);
+      steps1 = curSteps1 - angleDiffDegs(curAlphaDegs + 180, curBetaDegs) * _stepsPerDeg1;
+      return rotationType;
+    }
+
+    // Steps for each option (axis 1 steps are in the opposite sense to beta)
+    float opt1Diff0 = angleDiffDegs(alpha1Degs, curAlphaDegs) * _stepsPerDeg0;
+    float opt1Diff1 = -angleDiffDegs(beta1Degs, curBetaDegs) * _stepsPerDeg1;
+    float opt2Diff0 = angleDiffDegs(alpha2Degs, curAlphaDegs) * _stepsPerDeg0;
+    float opt2Diff1 = -angleDiffDegs(beta2Degs, curBetaDegs) * _stepsPerDeg1;
+    float opt1Travel = fabsf(opt1Diff0) * _jointWeight0 + fabsf(opt1Diff1) * _jointWeight1;
+    float opt2Travel = fabsf(opt2Diff0) * _jointWeight0 + fabsf(opt2Diff1) * _jointWeight1;
+    bool useOpt1 = opt1Travel <= opt2Travel;
+    steps0 = curSteps0 + (useOpt1 ? opt1Diff0 : opt2Diff0);
+    steps1 = curSteps1 + (useOpt1 ? opt1Diff1 : opt2Diff1);
+    return rotationType;
+  }
+
+  // Weights applied to travel on each joint when choosing the solution with least travel
+  void setJointWeights(float jointWeight0, float jointWeight1)
+  {
+    _jointWeight0 = jointWeight0;
+    _jointWeight1 = jointWeight1;
+  }
+
+  // Convert arm rotations to a cartesian point
+  void rotationsToPoint(float alphaDegs, float betaDegs, float& x, float& y) const
+  {
+    // Beta is the direction of the lower arm (the same convention as ptToRotations)
+    float alpha = alphaDegs * RADS_PER_DEG;
+    float beta  = betaDegs * RADS_PER_DEG;
+    x = _shoulderElbowMM * sinf(alpha) + _elbowHandMM * sinf(beta);
+    y = _shoulderElbowMM * cosf(alpha) + _elbowHandMM * cosf(beta);
+  }
+
+  // Convert arm rotations to actuator steps
+  void rotationToActuator(float alphaDegs, float betaDegs, float& steps0, float& steps1) const
+  {
+    steps0 = alphaDegs * _stepsPerDeg0;
+    // For beta values the rotation should always be between 0 steps and + 1/2 * stepsPerRotation
+    float betaStepTarget = _stepsPerRot1 - wrapDegrees(betaDegs - 180) * _stepsPerDeg1;
+    if (betaStepTarget >= 0 && betaStepTarget < _stepsPerRot1 / 2)
+      steps1 = betaStepTarget;
+    else
+      steps1 = betaStepTarget - _stepsPerRot1;
+  }
+
+  // Convert actuator steps to arm rotations - whole rotations are removed in integer arithmetic
+  // first so that large step counts don't lose precision
+  void actuatorToRotation(int32_t steps0, int32_t steps1, float& alphaDegs, float& betaDegs) const
+  {
+    alphaDegs = wrapDegrees(stepsInRotation(steps0, int32_t(_stepsPerRot0)) * _degsPerStep0);
+    betaDegs  = wrapDegrees(540 - stepsInRotation(steps1, int32_t(_stepsPerRot1)) * _degsPerStep1);
+  }
+
+  // Remove whole rotations from the actuator step counts so that they stay within the ranges
+  // produced by rotationToActuator (axis 0 in 0..stepsPerRot, axis 1 within +/- half a rotation)
+  // The arms are driven independently so this doesn't change the position
+  // Returns true if either count was changed
+  bool correctStepOverflow(int32_t& steps0, int32_t& steps1) const
+  {
+    int32_t stepsPerRot0 = int32_t(_stepsPerRot0);
+    int32_t stepsPerRot1 = int32_t(_stepsPerRot1);
+    if ((stepsPerRot0 <= 0) || (stepsPerRot1 <= 0))
+      return false;
+    int32_t new0 = stepsInRotation(steps0, stepsPerRot0);
+    int32_t new1 = stepsInRotation(steps1 + stepsPerRot1 / 2, stepsPerRot1) - stepsPerRot1 / 2;
+    if ((new0 == steps0) && (new1 == steps1))
+      return false;
+    steps0 = new0;
+    steps1 = new1;
+    return true;
+  }
+
+  float getStepsPerRot(int axisIdx) const
+  {
+    return axisIdx == 0 ? _stepsPerRot0 : _stepsPerRot1;
+  }
+
+  static inline float wrapDegrees(float angle)
+  {
+    return angle - 360.0f * floorf(angle / 360.0f);
+  }
+
+  // Shortest signed rotation from one angle to another (-180..180)
+  static inline float angleDiffDegs(float toDegs, float fromDegs)
+  {
+    float diff = wrapDegrees(toDegs - fromDegs);
+    return diff > 180 ? diff - 360 : diff;
+  }
+
+private:
+  // Steps within a single rotation (0..stepsPerRot)
+  static inline int32_t stepsInRotation(int32_t steps, int32_t stepsPerRot)
+  {
+    if (stepsPerRot <= 0)
+      return steps;
+    int32_t rotSteps = steps % stepsPerRot;
+    return rotSteps < 0 ? rotSteps + stepsPerRot : rotSteps;
+  }
+
+  static inline float acosClamped(float val)
+  {
+    if (val > 1)
+      val = 1;
+    if (val < -1)
+      val = -1;
+    return acosf(val);
+  }
+};
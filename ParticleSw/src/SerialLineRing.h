@@ -0,0 +1,157 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Ring of received serial bytes (allocated by init() only) from which complete lines are taken
+// (also used to buffer uploaded jobs - see JobFeeder)
+// Bytes are held as received (including line terminators) so the bytes in use are exactly the
+// bytes a host has sent and not yet had acknowledged - this is what a host counts when using
+// character-counting flow control and the ring capacity is the window the host may use
+class SerialLineRing
+{
+private:
+    std::vector<char> _buf;
+    unsigned int _putPos;
+    unsigned int _getPos;
+    unsigned int _bytesUsed;
+    // Number of line terminators in the ring
+    unsigned int _lineEndCount;
+
+public:
+    SerialLineRing(unsigned int capacityBytes = 0)
+    {
+        init(capacityBytes);
+    }
+
+    void init(unsigned int capacityBytes)
+    {
+        _buf.resize(capacityBytes);
+        _buf.shrink_to_fit();
+        clear();
+    }
+
+    void clear()
+    {
+        _putPos = 0;
+        _getPos = 0;
+        _bytesUsed = 0;
+        _lineEndCount = 0;
+    }
+
+    unsigned int capacityBytes()
+    {
+        return _buf.size();
+    }
+
+    unsigned int bytesUsed()
+    {
+        return _bytesUsed;
+    }
+
+    bool isFull()
+    {
+        return _bytesUsed >= _buf.size();
+    }
+
+    // Check if there is a complete line
+    bool hasLine()
+    {
+        return _lineEndCount > 0;
+    }
+
+    static bool isLineEnd(char ch)
+    {
+        return (ch == '\n') || (ch == '\r');
+    }
+
+    // Add a received byte
+    bool put(char ch)
+    {
+        if (isFull())
+            return false;
+        _buf[_putPos] = ch;
+        _putPos = (_putPos + 1) % _buf.size();
+        _bytesUsed++;
+        if (isLineEnd(ch))
+            _lineEndCount++;
+        return true;
+    }
+
+    // Remove the most recently added bytes (e.g. part of a line which is being discarded) - returns
+    // the number removed
+    unsigned int unput(unsigned int numBytes)
+    {
+        if (numBytes > _bytesUsed)
+            numBytes = _bytesUsed;
+        for (unsigned int i = 0; i < numBytes; i++)
+        {
+            _putPos = (_putPos + _buf.size() - 1) % _buf.size();
+            if (isLineEnd(_buf[_putPos]))
+                _lineEndCount--;
+        }
+        _bytesUsed -= numBytes;
+        if (_bytesUsed == 0)
+            _putPos = _getPos = 0;
+        return numBytes;
+    }
+
+    // Copy the first complete line (without its terminator) and null-terminate it
+    // Characters beyond maxLen are not copied (lineLen is the copied length so a line which was
+    // too long has a return value greater than lineLen + 1)
+    // Returns the number of bytes the line occupies in the ring (0 if there is no complete line)
+    // The line stays in the ring until consumed so that it can be checked before it is accepted
+    unsigned int peekLine(char* pLine, unsigned int maxLen, unsigned int& lineLen)
+    {
+        lineLen = 0;
+        if (!hasLine())
+            return 0;
+        unsigned int pos = _getPos;
+        for (unsigned int i = 0; i < _bytesUsed; i++)
+        {
+            char ch = _buf[pos];
+            if (isLineEnd(ch))
+            {
+                pLine[lineLen] = 0;
+                return i + 1;
+            }
+            if (lineLen < maxLen)
+                pLine[lineLen++] = ch;
+            pos = (pos + 1) % _buf.size();
+        }
+        pLine[lineLen] = 0;
+        return 0;
+    }
+
+    // Copy bytes from the start of the ring (e.g. a binary frame) - returns the number copied
+    unsigned int peek(char* pBuf, unsigned int maxLen)
+    {
+        unsigned int numBytes = (maxLen < _bytesUsed) ? maxLen : _bytesUsed;
+        unsigned int pos = _getPos;
+        for (unsigned int i = 0; i < numBytes; i++)
+        {
+            pBuf[i] = _buf[pos];
+            pos = (pos + 1) % _buf.size();
+        }
+        return numBytes;
+    }
+
+    // Remove bytes (e.g. a line returned by peekLine) from the ring
+    void consume(unsigned int numBytes)
+    {
+        if (numBytes > _bytesUsed)
+            numBytes = _bytesUsed;
+        for (unsigned int i = 0; i < numBytes; i++)
+        {
+            if (isLineEnd(_buf[_getPos]))
+                _lineEndCount--;
+            _getPos = (_getPos + 1) % _buf.size();
+        }
+        _bytesUsed -= numBytes;
+        if (_bytesUsed == 0)
+            _putPos = _getPos = 0;
+    }
+};
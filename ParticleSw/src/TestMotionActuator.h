@@ -18,7 +18,6 @@
 #include "application.h"
 #include "MotionRingBuffer.h"
 #include "ConfigPinMap.h"
-#include <vector>
 
 static constexpr int TEST_OUTPUT_STEPS = 1000;
 
@@ -58,13 +57,11 @@ public:
       int _val : 1;
     };
   };
-  MotionRingBufferPosn _stepBufPos;
-  std::vector<TestOutputStepInf> _stepBuf;
+  MotionRingBuffer<TestOutputStepInf> _stepBuf;
 
   TestOutputStepData() :
-    _stepBufPos(TEST_OUTPUT_STEPS)
+    _stepBuf(TEST_OUTPUT_STEPS)
   {
-    _stepBuf.resize(TEST_OUTPUT_STEPS);
   }
 
   void stepStart(int axisIdx)
@@ -86,33 +83,32 @@ public:
     // Ignore if it is a lowering of a step pin (to avoid end of test problem)
     if ((val == 0) && (pin == 17 || pin == 15))
       return;
-    if (_stepBufPos.canPut())
+    TestOutputStepInf* pInf = _stepBuf.putSlot();
+    if (pInf)
     {
-      TestOutputStepInf newInf;
-      newInf._micros                = micros();
-      newInf._pin                   = uint8_t(pin);
-      newInf._val                   = val;
-      _stepBuf[_stepBufPos._putPos] = newInf;
-      _stepBufPos.hasPut();
+      pInf->_micros = micros();
+      pInf->_pin    = uint8_t(pin);
+      pInf->_val    = val;
+      _stepBuf.hasPut();
     }
   }
 
   TestOutputStepInf getStepInf()
   {
-    TestOutputStepInf inf = _stepBuf[_stepBufPos._getPos];
-    _stepBufPos.hasGot();
+    TestOutputStepInf inf;
+    _stepBuf.get(inf);
     return inf;
   }
 
   void process()
   {
-    // Log.trace("StepBuf getPos %d putPos %d count %d", _stepBufPos._getPos, _stepBufPos._putPos, _stepBufPos.count());
+    // Log.trace("StepBuf count %d", _stepBuf.count());
 
     // Get
     for (int i = 0; i < 5; i++)
     {
       // Check if can get
-      if (!_stepBufPos.canGet())
+      if (!_stepBuf.canGet())
       {
         // Log.trace("Process can't get");
         return;
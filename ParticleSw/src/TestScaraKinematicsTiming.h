@@ -0,0 +1,44 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+#pragma once
+
+#include "SandTableScaraKinematics.h"
+
+// Times the SandTableScara transforms on the target (Tests/TestScaraKinematics does the same on the host)
+class TestScaraKinematicsTiming
+{
+public:
+    static void runTests()
+    {
+        static const int NUM_TRANSFORMS = 10000;
+        SandTableScaraKinematics kinematics;
+        kinematics.setGeometry(628.318, 628.318, 9600, 9600, true, 185);
+
+        // Points on a spiral
+        float stepsSum = 0;
+        unsigned long startUs = micros();
+        for (int i = 0; i < NUM_TRANSFORMS; i++)
+        {
+            float ang = i * 0.01f, rad = (i % 1850) * 0.1f;
+            float alpha = 0, beta = 0, steps0 = 0, steps1 = 0;
+            kinematics.ptToRotations(rad * sinf(ang), rad * cosf(ang), alpha, beta);
+            kinematics.rotationToActuator(alpha, beta, steps0, steps1);
+            stepsSum += steps0 + steps1;
+        }
+        unsigned long ptToActuatorUs = micros() - startUs;
+
+        startUs = micros();
+        for (int i = 0; i < NUM_TRANSFORMS; i++)
+        {
+            float alpha = 0, beta = 0, x = 0, y = 0;
+            kinematics.actuatorToRotation(i, 4800 - i, alpha, beta);
+            kinematics.rotationsToPoint(alpha, beta, x, y);
+            stepsSum += x + y;
+        }
+        unsigned long actuatorToPtUs = micros() - startUs;
+
+        Log.info("TestScaraKinematicsTiming ptToActuator %0.0f/s actuatorToPt %0.0f/s (chk %0.1f)",
+                 NUM_TRANSFORMS * 1e6 / ptToActuatorUs, NUM_TRANSFORMS * 1e6 / actuatorToPtUs, stepsSum);
+    }
+};
@@ -62,7 +62,7 @@ public:
                 {
                     Log.info("");
                     Log.info("Get %d = %s, initMem %d, mem %d, lowMem %d", rslt,
-                                    cmdElem.getString().c_str(), initialMemory,
+                                    cmdElem.c_str(), initialMemory,
                                     System.freeMemory(), lowestMemory);
                     GCodeInterpreter::interpretGcode(cmdElem, robotController, true);
                 }
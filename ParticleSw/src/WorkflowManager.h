@@ -5,6 +5,8 @@
 
 #include "application.h"
 #include "CommandQueue.h"
+#include "GCodeInterpreter.h"
+#include "BinaryMotionProtocol.h"
 
 class WorkflowManager
 {
@@ -35,6 +37,12 @@ public:
         return _cmdQueue.isFull();
     }
 
+    // Check if records totalling a number of bytes can be added (see getQueuedBytes)
+    bool canAddBytes(unsigned int recordBytes, bool& tooLarge)
+    {
+        return _cmdQueue.canAddBytes(recordBytes, tooLarge);
+    }
+
     // Check if queue empty
     bool isEmpty()
     {
@@ -44,19 +52,73 @@ public:
     // Add to workflow
     bool add(const char* pCmdStr)
     {
-        bool rslt = _cmdQueue.add(pCmdStr);
-        Log.trace("WorkflowManager add %s rslt %d numInQueue %d",
-                        pCmdStr, rslt, _cmdQueue.size());
+        return add(pCmdStr, strlen(pCmdStr));
+    }
+
+    // G and M codes are parsed here so that they are ready to execute when taken from the queue
+    // (M codes keep the args text as they may have args not held in RobotCommandArgs)
+    bool add(const char* pCmdStr, unsigned int cmdLen)
+    {
+        RobotCommandArgs cmdArgs;
+        CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+        int cmdNum = 0;
+        const char* pArgsStr = "";
+        unsigned int argsLen = 0;
+        bool rslt = false;
+        if (GCodeParser::parseGcode(pCmdStr, cmdLen, recordType, cmdNum, cmdArgs, pArgsStr, argsLen))
+        {
+            // Args text is only kept for codes which have args not held in cmdArgs
+            if ((recordType != CommandElem::RECORD_MCODE) && !((recordType == CommandElem::RECORD_GCODE) && (cmdNum == 4)))
+                argsLen = 0;
+            rslt = _cmdQueue.add(recordType, cmdNum, cmdArgs, pArgsStr, argsLen);
+        }
+        else
+        {
+            rslt = _cmdQueue.add(pCmdStr, cmdLen);
+        }
+        Log.trace("WorkflowManager add %.*s rslt %d numInQueue %d",
+                        cmdLen, pCmdStr, rslt, _cmdQueue.size());
         return rslt;
     }
 
-    // Get from workflow
-    bool get(String& cmdStr)
+    // Add a move from the binary protocol - queued as a parsed G0/G1 with no text involved
+    bool add(const BinaryMotionCmd& binCmd)
+    {
+        RobotCommandArgs cmdArgs;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        {
+            if (!binCmd.isAxisValid(axisIdx))
+                continue;
+            if (binCmd._recordType == BinaryMotionProtocol::RECORD_MOVE_STEPS)
+                cmdArgs.setAxisSteps(axisIdx, binCmd._axisVals[axisIdx], true);
+            else
+                cmdArgs.setAxisValMM(axisIdx, binCmd._axisVals[axisIdx] / 1000.0f, true);
+        }
+        cmdArgs.setMoveType((binCmd._flags & BinaryMotionProtocol::FLAG_RELATIVE) ?
+                        RobotMoveTypeArg_Relative : RobotMoveTypeArg_Absolute);
+        if (binCmd._flags & BinaryMotionProtocol::FLAG_FEEDRATE)
+            cmdArgs.setFeedrate(binCmd._feedrate / 1000.0f);
+        if (binCmd._flags & BinaryMotionProtocol::FLAG_ENDSTOPS_ALL)
+            cmdArgs.setTestAllEndStops();
+        int cmdNum = (binCmd._flags & BinaryMotionProtocol::FLAG_RAPID) ? 0 : 1;
+        return _cmdQueue.add(CommandElem::RECORD_GCODE, cmdNum, cmdArgs, "", 0);
+    }
+
+    // Bytes a binary move takes in the queue
+    static unsigned int getQueuedBytes(const BinaryMotionCmd& binCmd)
     {
-        return _cmdQueue.get(cmdStr);
+        unsigned int hdrLen = 5;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+            if (binCmd.isAxisValid(axisIdx))
+                hdrLen += 4;
+        if (binCmd._flags & BinaryMotionProtocol::FLAG_FEEDRATE)
+            hdrLen += 4;
+        if (binCmd._flags & BinaryMotionProtocol::FLAG_ENDSTOPS_ALL)
+            hdrLen += 4;
+        return CommandRingBuffer::getRecordLen(hdrLen);
     }
 
-    // Get from workflow
+    // Get from workflow - the command is valid until the next get
     bool get(CommandElem& cmdElem)
     {
         return _cmdQueue.get(cmdElem);
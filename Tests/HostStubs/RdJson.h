@@ -0,0 +1,133 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host stand-in for the RdJson library - values are looked up by key in the top level of the
+// JSON object given (which is all the motion configuration uses)
+
+#pragma once
+
+#include "application.h"
+
+class RdJson
+{
+public:
+  static String getString(const char* dataPath, const char* defaultValue, const char* pSourceStr, bool& isValid)
+  {
+    std::string val;
+    isValid = findValue(dataPath, pSourceStr, val);
+    return isValid ? String(val) : String(defaultValue);
+  }
+
+  static String getString(const char* dataPath, const char* defaultValue, const char* pSourceStr)
+  {
+    bool isValid = false;
+    return getString(dataPath, defaultValue, pSourceStr, isValid);
+  }
+
+  static double getDouble(const char* dataPath, double defaultValue, bool& isValid, const char* pSourceStr)
+  {
+    std::string val;
+    isValid = findValue(dataPath, pSourceStr, val);
+    return isValid ? strtod(val.c_str(), NULL) : defaultValue;
+  }
+
+  static double getDouble(const char* dataPath, double defaultValue, const char* pSourceStr)
+  {
+    bool isValid = false;
+    return getDouble(dataPath, defaultValue, isValid, pSourceStr);
+  }
+
+  static long getLong(const char* dataPath, long defaultValue, bool& isValid, const char* pSourceStr)
+  {
+    std::string val;
+    isValid = findValue(dataPath, pSourceStr, val);
+    return isValid ? strtol(val.c_str(), NULL, 0) : defaultValue;
+  }
+
+  static long getLong(const char* dataPath, long defaultValue, const char* pSourceStr)
+  {
+    bool isValid = false;
+    return getLong(dataPath, defaultValue, isValid, pSourceStr);
+  }
+
+private:
+  // Find a key at the top level of an object - strings are returned without quotes and objects
+  // and arrays as their JSON text
+  static bool findValue(const char* pKey, const char* pJson, std::string& val)
+  {
+    if (!pJson)
+      return false;
+    std::string key = std::string("\"") + pKey + "\"";
+    int depth = 0;
+    for (const char* pCh = pJson; *pCh; pCh++)
+    {
+      if (*pCh == '"')
+      {
+        if ((depth == 1) && (strncmp(pCh, key.c_str(), key.length()) == 0))
+        {
+          const char* pVal = pCh + key.length();
+          while (isspace(*pVal))
+            pVal++;
+          if (*pVal == ':')
+            return getValue(pVal + 1, val);
+        }
+        pCh = skipString(pCh);
+        if (!*pCh)
+          return false;
+        continue;
+      }
+      if ((*pCh == '{') || (*pCh == '['))
+        depth++;
+      else if ((*pCh == '}') || (*pCh == ']'))
+        depth--;
+    }
+    return false;
+  }
+
+  // Returns a pointer to the closing quote
+  static const char* skipString(const char* pCh)
+  {
+    for (pCh++; *pCh && (*pCh != '"'); pCh++)
+      if ((*pCh == '\\') && *(pCh + 1))
+        pCh++;
+    return pCh;
+  }
+
+  static bool getValue(const char* pVal, std::string& val)
+  {
+    while (isspace(*pVal))
+      pVal++;
+    if (*pVal == '"')
+    {
+      const char* pEnd = skipString(pVal);
+      val.assign(pVal + 1, pEnd - pVal - 1);
+      return true;
+    }
+    if ((*pVal == '{') || (*pVal == '['))
+    {
+      int depth = 0;
+      const char* pCh = pVal;
+      for (; *pCh; pCh++)
+      {
+        if (*pCh == '"')
+        {
+          pCh = skipString(pCh);
+          if (!*pCh)
+            break;
+          continue;
+        }
+        if ((*pCh == '{') || (*pCh == '['))
+          depth++;
+        else if (((*pCh == '}') || (*pCh == ']')) && (--depth == 0))
+          break;
+      }
+      val.assign(pVal, *pCh ? pCh - pVal + 1 : pCh - pVal);
+      return true;
+    }
+    const char* pEnd = pVal;
+    while (*pEnd && (*pEnd != ',') && (*pEnd != '}') && (*pEnd != ']') && !isspace(*pEnd))
+      pEnd++;
+    val.assign(pVal, pEnd - pVal);
+    return pEnd != pVal;
+  }
+};
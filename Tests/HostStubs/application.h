@@ -0,0 +1,267 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host stand-in for the Particle firmware API - just enough for the host tests to compile firmware
+// sources from ParticleSw/src unchanged
+// The last log message is kept so tests can check what was reported
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+// String (a subset of Particle's Wiring String)
+class String
+{
+public:
+  std::string _s;
+  String() {}
+  String(const char* pStr) : _s(pStr ? pStr : "") {}
+  String(const std::string& str) : _s(str) {}
+  String(char ch) : _s(1, ch) {}
+  String(int val) : _s(std::to_string(val)) {}
+  String(unsigned int val) : _s(std::to_string(val)) {}
+  String(long val) : _s(std::to_string(val)) {}
+  String(unsigned long val) : _s(std::to_string(val)) {}
+  String(double val) : _s(std::to_string(val)) {}
+  static String format(const char* pFormat, ...)
+  {
+    char buf[2000];
+    va_list args;
+    va_start(args, pFormat);
+    vsnprintf(buf, sizeof(buf), pFormat, args);
+    va_end(args);
+    return String(buf);
+  }
+  const char* c_str() const { return _s.c_str(); }
+  operator const char*() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  void reserve(unsigned int len) { _s.reserve(len); }
+  bool concat(char ch) { _s += ch; return true; }
+  bool concat(const char* pStr) { _s += pStr; return true; }
+  bool equals(const char* pStr) const { return _s == pStr; }
+  bool equalsIgnoreCase(const char* pStr) const { return strcasecmp(_s.c_str(), pStr) == 0; }
+  String& trim()
+  {
+    size_t startPos = _s.find_first_not_of(" \t\r\n");
+    size_t endPos = _s.find_last_not_of(" \t\r\n");
+    _s = (startPos == std::string::npos) ? "" : _s.substr(startPos, endPos - startPos + 1);
+    return *this;
+  }
+  char charAt(unsigned int idx) const { return idx < _s.size() ? _s[idx] : 0; }
+  String substring(unsigned int startPos) const { return _s.substr(std::min<size_t>(startPos, _s.size())); }
+  String substring(unsigned int startPos, unsigned int endPos) const
+  {
+    startPos = std::min<size_t>(startPos, _s.size());
+    return _s.substr(startPos, endPos > startPos ? endPos - startPos : 0);
+  }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+  int indexOf(char ch) const { size_t pos = _s.find(ch); return pos == std::string::npos ? -1 : int(pos); }
+  int indexOf(const char* pStr) const { size_t pos = _s.find(pStr); return pos == std::string::npos ? -1 : int(pos); }
+  void remove(unsigned int idx) { if (idx < _s.size()) _s.erase(idx); }
+  void remove(unsigned int idx, unsigned int count) { if (idx < _s.size()) _s.erase(idx, count); }
+  void toCharArray(char* pBuf, unsigned int bufLen) const
+  {
+    if (bufLen == 0)
+      return;
+    strncpy(pBuf, _s.c_str(), bufLen - 1);
+    pBuf[bufLen - 1] = 0;
+  }
+  String& operator+=(const String& str) { _s += str._s; return *this; }
+  String& operator+=(const char* pStr) { _s += pStr; return *this; }
+  String& operator+=(char ch) { _s += ch; return *this; }
+  String& operator+=(int val) { _s += std::to_string(val); return *this; }
+  bool operator==(const char* pStr) const { return _s == pStr; }
+};
+inline String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+inline String operator+(const String& a, const char* b) { return String(a._s + b); }
+inline String operator+(const char* a, const String& b) { return String(std::string(a) + b._s); }
+inline String operator+(const String& a, char b) { return String(a._s + b); }
+
+// Logging - messages are only printed if hostLogPrint is set
+class HostLogger
+{
+public:
+  static bool& printEnabled()
+  {
+    static bool enabled = false;
+    return enabled;
+  }
+  static char* lastMsg()
+  {
+    static char msg[1000];
+    return msg;
+  }
+  static void clearLastMsg()
+  {
+    lastMsg()[0] = 0;
+  }
+#define HOST_LOGGER_FN(name) \
+  void name(const char* pFormat, ...) \
+  { \
+    va_list args; \
+    va_start(args, pFormat); \
+    vsnprintf(lastMsg(), 1000, pFormat, args); \
+    va_end(args); \
+    if (printEnabled()) \
+      printf(#name " %s\n", lastMsg()); \
+  }
+  HOST_LOGGER_FN(trace)
+  HOST_LOGGER_FN(info)
+  HOST_LOGGER_FN(warn)
+  HOST_LOGGER_FN(error)
+#undef HOST_LOGGER_FN
+};
+static HostLogger Log __attribute__((unused));
+
+// Time - the host clock only moves when a test advances it (System.ticks() also moves by a tick
+// on every call so busy-waits on it end)
+class HostClock
+{
+public:
+  static uint64_t& us()
+  {
+    static uint64_t curUs = 0;
+    return curUs;
+  }
+  static void advanceUs(uint64_t us)
+  {
+    HostClock::us() += us;
+  }
+};
+inline unsigned long millis() { return (unsigned long)(HostClock::us() / 1000); }
+inline unsigned long micros() { return (unsigned long)HostClock::us(); }
+inline void delay(unsigned long ms) { HostClock::advanceUs(uint64_t(ms) * 1000); }
+inline void delayMicroseconds(unsigned int us) { HostClock::advanceUs(us); }
+
+class HostSystem
+{
+public:
+  uint32_t ticks()
+  {
+    static uint32_t tickCount = 0;
+    return tickCount++;
+  }
+  uint32_t ticksPerMicrosecond() { return 1; }
+  int freeMemory() { return 100000; }
+};
+static HostSystem System __attribute__((unused));
+inline uint32_t SystemTicks() { return System.ticks(); }
+inline uint32_t SystemTicksPerMicrosecond() { return System.ticksPerMicrosecond(); }
+
+class HostTime
+{
+public:
+  long now() { return long(HostClock::us() / 1000000); }
+};
+static HostTime Time __attribute__((unused));
+
+// Serial port - tests queue the chars received and check the lines sent
+class HostSerial
+{
+public:
+  std::deque<char> _rxChars;
+  std::vector<std::string> _txLines;
+  void begin(int baud) {}
+  int available() { return int(_rxChars.size()); }
+  int read()
+  {
+    if (_rxChars.empty())
+      return -1;
+    char ch = _rxChars.front();
+    _rxChars.pop_front();
+    return (uint8_t)ch;
+  }
+  void println(const char* pStr) { _txLines.push_back(pStr); }
+  void hostReceive(const char* pStr) { _rxChars.insert(_rxChars.end(), pStr, pStr + strlen(pStr)); }
+};
+static HostSerial Serial __attribute__((unused));
+
+// Pins - levels and modes are recorded so tests can set inputs and check outputs
+typedef int PinMode;
+enum { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+#define HIGH 1
+#define LOW 0
+class HostPins
+{
+public:
+  static const int MAX_PINS = 64;
+  static int* levels()
+  {
+    static int pinLevels[MAX_PINS] = { 0 };
+    return pinLevels;
+  }
+  static int* modes()
+  {
+    static int pinModes[MAX_PINS] = { 0 };
+    return pinModes;
+  }
+  // Count of low to high writes (e.g. step pulses)
+  static int* risingEdges()
+  {
+    static int pinRisingEdges[MAX_PINS] = { 0 };
+    return pinRisingEdges;
+  }
+  static bool valid(int pin)
+  {
+    return (pin >= 0) && (pin < MAX_PINS);
+  }
+};
+inline void pinMode(int pin, int mode) { if (HostPins::valid(pin)) HostPins::modes()[pin] = mode; }
+inline void digitalWrite(int pin, int val)
+{
+  if (!HostPins::valid(pin))
+    return;
+  if (val && !HostPins::levels()[pin])
+    HostPins::risingEdges()[pin]++;
+  HostPins::levels()[pin] = val ? 1 : 0;
+}
+inline void digitalWriteFast(int pin, int val) { digitalWrite(pin, val); }
+inline int digitalRead(int pin) { return HostPins::valid(pin) ? HostPins::levels()[pin] : 0; }
+inline void pinSetFast(int pin) { digitalWrite(pin, 1); }
+inline void pinResetFast(int pin) { digitalWrite(pin, 0); }
+inline int pinReadFast(int pin) { return digitalRead(pin); }
+#define _ASSERT(x) do { if (!(x)) { printf("ASSERT %s at %s:%d\n", #x, __FILE__, __LINE__); abort(); } } while (0)
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+// Pin names used by ConfigPinMap
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+#define A4 14
+#define A5 15
+#define A6 16
+#define A7 17
+#define DAC A6
+#define WKP A7
+#define RX 18
+#define TX 19
+
+class Servo
+{
+public:
+  void attach(int pin) {}
+  void detach() {}
+  void writeMicroseconds(int us) {}
+};
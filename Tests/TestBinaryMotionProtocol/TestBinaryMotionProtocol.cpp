@@ -0,0 +1,278 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for BinaryMotionProtocol - frames of random moves are encoded and decoded, corrupted
+// frames are checked to be rejected and the size and decode time of a dense job are compared with
+// the equivalent G-code text parsed with strtod
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "BinaryMotionProtocol.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static BinaryMotionCmd randomMove()
+{
+  BinaryMotionCmd cmd;
+  cmd._recordType = (rand() % 2) ? BinaryMotionProtocol::RECORD_MOVE_MM : BinaryMotionProtocol::RECORD_MOVE_STEPS;
+  cmd._flags = rand() % 32;
+  int32_t valRange = (cmd._flags & BinaryMotionProtocol::FLAG_INT16) ? 65536 : 2000000000;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    if (rand() % 2)
+      cmd.setAxis(axisIdx, (int32_t)(((int64_t)rand() * 7919) % valRange - valRange / 2));
+  if (cmd._axisMask == 0)
+    cmd.setAxis(0, 0);
+  if (cmd._flags & BinaryMotionProtocol::FLAG_FEEDRATE)
+    cmd._feedrate = rand() % (valRange / 2);
+  return cmd;
+}
+
+static bool sameMove(const BinaryMotionCmd& a, const BinaryMotionCmd& b)
+{
+  if ((a._recordType != b._recordType) || (a._flags != b._flags) || (a._axisMask != b._axisMask))
+    return false;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    if (a.isAxisValid(axisIdx) && (a._axisVals[axisIdx] != b._axisVals[axisIdx]))
+      return false;
+  if ((a._flags & BinaryMotionProtocol::FLAG_FEEDRATE) && (a._feedrate != b._feedrate))
+    return false;
+  return true;
+}
+
+static void testRoundTrip()
+{
+  uint8_t frame[BinaryMotionProtocol::MAX_FRAME_LEN];
+  srand(1);
+  for (int testIdx = 0; testIdx < 10000; testIdx++)
+  {
+    // Random moves (with runs of similar moves which share records) - as many as fit are encoded
+    std::vector<BinaryMotionCmd> moves;
+    int numMoves = 1 + rand() % 100;
+    for (int i = 0; i < numMoves; i++)
+    {
+      BinaryMotionCmd cmd = randomMove();
+      if ((i > 0) && (rand() % 4 != 0))
+      {
+        cmd._recordType = moves.back()._recordType;
+        cmd._flags = moves.back()._flags;
+        cmd._axisMask = moves.back()._axisMask;
+        bool isInt16 = (cmd._flags & BinaryMotionProtocol::FLAG_INT16) != 0;
+        for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+          cmd._axisVals[axisIdx] = isInt16 ? int16_t(rand()) : rand();
+        cmd._feedrate = isInt16 ? int16_t(rand()) : rand();
+      }
+      moves.push_back(cmd);
+    }
+    unsigned int numEncoded = 0;
+    unsigned int frameLen = BinaryMotionProtocol::encodeFrame(moves.data(), moves.size(), frame, sizeof(frame), numEncoded);
+    check((frameLen > 0) && (frameLen <= sizeof(frame)), "frame length");
+    check((numEncoded > 0) && (numEncoded <= moves.size()), "moves encoded");
+    if (numEncoded < moves.size())
+    {
+      unsigned int nextMoveLen = BinaryMotionProtocol::getMoveLen(moves[numEncoded]._flags, moves[numEncoded]._axisMask);
+      check(frameLen + nextMoveLen > BinaryMotionProtocol::MAX_FRAME_LEN - BinaryMotionProtocol::RECORD_HDR_LEN,
+            "frame full when not all moves encoded");
+    }
+    moves.resize(numEncoded);
+
+    // Incomplete frames
+    unsigned int checkedLen = 0;
+    check(BinaryMotionProtocol::checkFrame(frame, frameLen - 1, checkedLen) == BinaryMotionProtocol::FRAME_INCOMPLETE,
+          "truncated frame incomplete");
+
+    // Decode
+    check(BinaryMotionProtocol::checkFrame(frame, frameLen, checkedLen) == BinaryMotionProtocol::FRAME_OK, "frame ok");
+    check(checkedLen == frameLen, "checked length");
+    unsigned int gotPayloadLen = 0;
+    const uint8_t* pPayload = BinaryMotionProtocol::getPayload(frame, gotPayloadLen);
+    BinaryMotionProtocol::ReadPos readPos;
+    BinaryMotionCmd got;
+    unsigned int numGot = 0;
+    while (BinaryMotionProtocol::getMove(pPayload, gotPayloadLen, readPos, got))
+    {
+      check((numGot < moves.size()) && sameMove(moves[numGot], got), "decoded move matches");
+      numGot++;
+    }
+    check(numGot == moves.size(), "all moves decoded");
+    check(BinaryMotionProtocol::isPayloadComplete(gotPayloadLen, readPos), "payload consumed");
+
+    // Corrupt one bit
+    unsigned int bitIdx = rand() % ((frameLen - 1) * 8);
+    frame[1 + bitIdx / 8] ^= 1 << (bitIdx % 8);
+    BinaryMotionProtocol::FrameResult corruptResult = BinaryMotionProtocol::checkFrame(frame, frameLen, checkedLen);
+    check(corruptResult != BinaryMotionProtocol::FRAME_OK, "corrupted frame rejected");
+  }
+
+  // Invalid start and record type
+  BinaryMotionCmd cmd;
+  cmd._recordType = 7;
+  cmd.setAxis(0, 1);
+  unsigned int numEncoded = 0;
+  unsigned int frameLen = BinaryMotionProtocol::encodeFrame(&cmd, 1, frame, sizeof(frame), numEncoded);
+  unsigned int checkedLen = 0;
+  check(BinaryMotionProtocol::checkFrame(frame, frameLen, checkedLen) == BinaryMotionProtocol::FRAME_OK, "frame with bad record ok");
+  unsigned int payloadLen = 0;
+  const uint8_t* pPayload = BinaryMotionProtocol::getPayload(frame, payloadLen);
+  BinaryMotionProtocol::ReadPos readPos;
+  check(!BinaryMotionProtocol::getMove(pPayload, payloadLen, readPos, cmd), "bad record type rejected");
+  check(!BinaryMotionProtocol::isPayloadComplete(payloadLen, readPos), "bad payload incomplete");
+  frame[0] = 'G';
+  check(BinaryMotionProtocol::checkFrame(frame, frameLen, checkedLen) == BinaryMotionProtocol::FRAME_BAD_START, "text not a frame");
+}
+
+// Parse axis values from G-code text with strtod as the GCodeInterpreter does
+static int parseGcodeText(const char* pStr, float vals[], float& feedrate)
+{
+  int numVals = 0;
+  char* pEndStr = NULL;
+  while (*pStr)
+  {
+    switch (toupper(*pStr))
+    {
+      case 'X': vals[0] = strtod(++pStr, &pEndStr); pStr = pEndStr; numVals++; break;
+      case 'Y': vals[1] = strtod(++pStr, &pEndStr); pStr = pEndStr; numVals++; break;
+      case 'Z': vals[2] = strtod(++pStr, &pEndStr); pStr = pEndStr; numVals++; break;
+      case 'F': feedrate = strtod(++pStr, &pEndStr); pStr = pEndStr; break;
+      default: pStr++; break;
+    }
+  }
+  return numVals;
+}
+
+// Encode moves into consecutive frames
+static std::vector<uint8_t> encodeJob(const std::vector<BinaryMotionCmd>& moves)
+{
+  std::vector<uint8_t> job;
+  uint8_t frame[BinaryMotionProtocol::MAX_FRAME_LEN];
+  unsigned int moveIdx = 0;
+  while (moveIdx < moves.size())
+  {
+    unsigned int numEncoded = 0;
+    unsigned int frameLen = BinaryMotionProtocol::encodeFrame(&moves[moveIdx], moves.size() - moveIdx,
+                                                              frame, sizeof(frame), numEncoded);
+    if (frameLen == 0)
+      break;
+    job.insert(job.end(), frame, frame + frameLen);
+    moveIdx += numEncoded;
+  }
+  return job;
+}
+
+// Decode a job - returns the number of moves and sums the values
+static int decodeJob(const std::vector<uint8_t>& job, double& valSum)
+{
+  int numDecoded = 0;
+  unsigned int bytePos = 0;
+  while (bytePos < job.size())
+  {
+    unsigned int frameLen = 0;
+    if (BinaryMotionProtocol::checkFrame(&job[bytePos], job.size() - bytePos, frameLen) != BinaryMotionProtocol::FRAME_OK)
+      break;
+    unsigned int payloadLen = 0;
+    const uint8_t* pPayload = BinaryMotionProtocol::getPayload(&job[bytePos], payloadLen);
+    BinaryMotionProtocol::ReadPos readPos;
+    BinaryMotionCmd cmd;
+    while (BinaryMotionProtocol::getMove(pPayload, payloadLen, readPos, cmd))
+    {
+      valSum += cmd._axisVals[0] / 1000.0f + cmd._axisVals[1] / 1000.0f;
+      numDecoded++;
+    }
+    bytePos += frameLen;
+  }
+  return numDecoded;
+}
+
+static void compareWithText()
+{
+  // Dense CAM-like output - short XY moves
+  const int NUM_MOVES = 200000;
+  std::vector<std::string> lines;
+  std::vector<BinaryMotionCmd> absMoves, relMoves;
+  size_t textBytes = 0;
+  char line[60];
+  int32_t prevXUm = 0, prevYUm = 0;
+  for (int i = 0; i < NUM_MOVES; i++)
+  {
+    int32_t xUm = 100000 + (i * 37) % 50000;
+    int32_t yUm = 60000 + (i * 53) % 30000;
+    int len = snprintf(line, sizeof(line), "G1 X%d.%03d Y%d.%03d\n", xUm / 1000, xUm % 1000, yUm / 1000, yUm % 1000);
+    lines.push_back(line);
+    textBytes += len;
+    // Absolute int32 micrometres
+    BinaryMotionCmd cmd;
+    cmd._recordType = BinaryMotionProtocol::RECORD_MOVE_MM;
+    cmd.setAxis(0, xUm);
+    cmd.setAxis(1, yUm);
+    absMoves.push_back(cmd);
+    // Relative int16 micrometres
+    cmd._flags = BinaryMotionProtocol::FLAG_RELATIVE | BinaryMotionProtocol::FLAG_INT16;
+    cmd.setAxis(0, xUm - prevXUm);
+    cmd.setAxis(1, yUm - prevYUm);
+    if ((i == 0) || (abs(xUm - prevXUm) > 32767) || (abs(yUm - prevYUm) > 32767))
+    {
+      cmd = absMoves.back();
+    }
+    relMoves.push_back(cmd);
+    prevXUm = xUm;
+    prevYUm = yUm;
+  }
+  std::vector<uint8_t> absJob = encodeJob(absMoves);
+  std::vector<uint8_t> relJob = encodeJob(relMoves);
+
+  // Parse text
+  float vals[3] = { 0, 0, 0 };
+  float feedrate = 0;
+  double sum = 0;
+  auto startTime = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < NUM_MOVES; i++)
+  {
+    parseGcodeText(lines[i].c_str(), vals, feedrate);
+    sum += vals[0] + vals[1];
+  }
+  double textUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+  // Decode binary
+  double absSum = 0, relSum = 0;
+  startTime = std::chrono::high_resolution_clock::now();
+  int numAbs = decodeJob(absJob, absSum);
+  double absUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+  int numRel = decodeJob(relJob, relSum);
+  check(numAbs == NUM_MOVES, "all absolute moves decoded");
+  check(numRel == NUM_MOVES, "all relative moves decoded");
+  check(fabs(sum - absSum) < NUM_MOVES * 0.01, "decoded values match text");
+  check(absJob.size() < textBytes / 2, "absolute binary less than half the size of text");
+  check(relJob.size() < textBytes / 3, "relative binary less than a third the size of text");
+
+  printf("Dense job %d moves: text %.1f bytes/move, binary abs int32 %.1f bytes/move, rel int16 %.1f bytes/move\n",
+         NUM_MOVES, double(textBytes) / NUM_MOVES, double(absJob.size()) / NUM_MOVES, double(relJob.size()) / NUM_MOVES);
+  printf("Parse text (strtod) %.3f us/move, decode binary (with CRC) %.3f us/move\n",
+         textUs / NUM_MOVES, absUs / NUM_MOVES);
+}
+
+int main()
+{
+  testRoundTrip();
+  compareWithText();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,219 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for CommandRingBuffer - the byte arena behind the CommandQueue
+// Random commands are added and taken and checked against a reference queue, taken commands are
+// checked to remain valid while more are added and heap allocations are counted
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <deque>
+#include <queue>
+#include <string>
+#include <chrono>
+#include "CommandRingBuffer.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Count heap allocations
+static unsigned long allocCount = 0;
+void* operator new(size_t size)
+{
+  allocCount++;
+  void* p = malloc(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static std::string randomCmd(unsigned int maxLen)
+{
+  unsigned int len = rand() % (maxLen + 1);
+  std::string cmd = "G1 X";
+  while (cmd.length() < len)
+    cmd += char('0' + rand() % 10);
+  return cmd.substr(0, len);
+}
+
+static void testAgainstReference()
+{
+  const unsigned int capacities[] = { 64, 100, 257, 2000 };
+  for (unsigned int capIdx = 0; capIdx < sizeof(capacities) / sizeof(capacities[0]); capIdx++)
+  {
+    unsigned int capacity = capacities[capIdx];
+    CommandRingBuffer ring(capacity);
+    std::deque<std::string> reference;
+    std::string taken;
+    unsigned long numPut = 0, numGot = 0, numFull = 0;
+    srand(capIdx + 1);
+    for (int opIdx = 0; opIdx < 200000; opIdx++)
+    {
+      if (rand() % 2)
+      {
+        std::string cmd = randomCmd(40);
+        bool canPut = ring.canPut(cmd.length());
+        bool putOk = ring.put(cmd.data(), cmd.length());
+        check(canPut == putOk, "canPut matches put");
+        if (putOk)
+        {
+          reference.push_back(cmd);
+          numPut++;
+        }
+        else
+        {
+          numFull++;
+          // Space can be lost at the end of the arena but never as much as a whole record
+          check(capacity - ring.bytesUsed() < 2 * CommandRingBuffer::getRecordLen(cmd.length()),
+                "full only when too little space");
+        }
+      }
+      else
+      {
+        const char* pStr = NULL;
+        unsigned int len = 0;
+        bool gotOk = ring.get(pStr, len);
+        check(gotOk == !reference.empty(), "get matches reference empty");
+        if (gotOk)
+        {
+          check(len == reference.front().length(), "length matches reference");
+          check(memcmp(pStr, reference.front().data(), len) == 0, "contents match reference");
+          check(pStr[len] == 0, "null-terminated");
+          reference.pop_front();
+          numGot++;
+        }
+      }
+      check(ring.count() == reference.size(), "count matches reference");
+      check(ring.bytesUsed() <= capacity, "bytes used within capacity");
+    }
+    printf("Capacity %4u: put %lu got %lu full %lu\n", capacity, numPut, numGot, numFull);
+  }
+}
+
+static void testTakenRemainsValid()
+{
+  CommandRingBuffer ring(100);
+  ring.put("G1 X10 Y10", 10);
+  ring.put("G1 X20 Y20", 10);
+  const char* pStr = NULL;
+  unsigned int len = 0;
+  ring.get(pStr, len);
+  std::string copy(pStr, len);
+  // Fill the ring while holding the taken command
+  int numAdded = 0;
+  while (ring.put("G1 X99 Y99", 10))
+    numAdded++;
+  check(numAdded > 0, "commands can be added while one is taken");
+  check(std::string(pStr, len) == copy, "taken command unchanged while adding");
+  // Next get releases it
+  ring.get(pStr, len);
+  check(std::string(pStr, len) == "G1 X20 Y20", "next command after taken");
+  check(ring.canPut(10), "space released by next get");
+
+  // Empty ring starts from the start of the arena
+  ring.clear();
+  check(ring.canPut(100 - 3), "largest command fits in empty ring");
+  check(!ring.canPut(100 - 2), "command larger than arena doesn't fit");
+}
+
+static void testNoAllocation()
+{
+  CommandRingBuffer ring(2000);
+  char cmd[50];
+  unsigned long allocsBefore = allocCount;
+  for (int i = 0; i < 100000; i++)
+  {
+    int len = snprintf(cmd, sizeof(cmd), "G1 X%d Y%d", i % 200, (i * 7) % 200);
+    ring.put(cmd, len);
+    if (i % 3 != 0)
+    {
+      const char* pStr = NULL;
+      unsigned int strLen = 0;
+      ring.get(pStr, strLen);
+    }
+  }
+  unsigned long allocs = allocCount - allocsBefore;
+  check(allocs == 0, "no heap allocations adding and getting");
+  printf("Heap allocations for 100000 commands: %lu\n", allocs);
+}
+
+static void benchmark()
+{
+  const int NUM_CMDS = 1000000;
+  char cmd[50];
+
+  // Previous approach - a queue of heap strings
+  std::queue<std::string> legacyQueue;
+  unsigned long allocsBefore = allocCount;
+  auto startTime = std::chrono::high_resolution_clock::now();
+  size_t lenSum = 0;
+  for (int i = 0; i < NUM_CMDS; i++)
+  {
+    int len = snprintf(cmd, sizeof(cmd), "G1 X%d.%03d Y%d.%03d", i % 200, i % 1000, (i * 7) % 200, i % 997);
+    legacyQueue.push(std::string(cmd, len));
+    if (legacyQueue.size() > 20)
+    {
+      std::string got = legacyQueue.front();
+      legacyQueue.pop();
+      lenSum += got.length();
+    }
+  }
+  double legacyUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+  unsigned long legacyAllocs = allocCount - allocsBefore;
+
+  // Ring
+  CommandRingBuffer ring(2000);
+  allocsBefore = allocCount;
+  startTime = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < NUM_CMDS; i++)
+  {
+    int len = snprintf(cmd, sizeof(cmd), "G1 X%d.%03d Y%d.%03d", i % 200, i % 1000, (i * 7) % 200, i % 997);
+    ring.put(cmd, len);
+    if (ring.count() > 20)
+    {
+      const char* pStr = NULL;
+      unsigned int strLen = 0;
+      ring.get(pStr, strLen);
+      lenSum += strLen;
+    }
+  }
+  double ringUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+  unsigned long ringAllocs = allocCount - allocsBefore;
+
+  printf("Queue of strings: %0.1fns per command, %lu allocations\n", legacyUs * 1000 / NUM_CMDS, legacyAllocs);
+  printf("Ring buffer:      %0.1fns per command, %lu allocations (checksum %lu)\n", ringUs * 1000 / NUM_CMDS,
+         ringAllocs, (unsigned long)lenSum);
+}
+
+int main()
+{
+  testAgainstReference();
+  testTakenRemainsValid();
+  testNoAllocation();
+  benchmark();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
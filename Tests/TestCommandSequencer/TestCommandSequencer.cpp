@@ -0,0 +1,180 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for CommandSequenceList - the compiled form of a command sequence used by
+// CommandSequencer - commands are split and classed by feed mode and a long sequence is run
+// through a simulated command queue and motion pipeline comparing the compiled list fed while
+// the queue has space with the previous approach (re-scanning the whole list for each command
+// and waiting for the queue to empty before each one)
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "CommandSequenceList.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static void testCompile()
+{
+  CommandSequenceList seqList;
+  check(!seqList.compile(""), "empty list");
+  check(seqList.getNumCmds() == 0, "no commands in empty list");
+  check(seqList.compile("G28;G0 X10 Y20; pattern1;;M84;"), "compile");
+  check(seqList.getNumCmds() == 4, "empty commands skipped");
+  check(strcmp(seqList.getCmd(0), "G28") == 0, "command 0");
+  check(strcmp(seqList.getCmd(1), "G0 X10 Y20") == 0, "command 1");
+  check(strcmp(seqList.getCmd(2), "pattern1") == 0, "leading space removed");
+  check(strcmp(seqList.getCmd(3), "M84") == 0, "command 3");
+  check(strcmp(seqList.getCmd(4), "") == 0, "past end is empty");
+  check(seqList.compile("G1 X1"), "single command");
+  check((seqList.getNumCmds() == 1) && (strcmp(seqList.getCmd(0), "G1 X1") == 0), "single command compiled");
+
+  check(CommandSequenceList::getFeedMode("G0 X1") == CommandSequenceList::FEED_QUEUED, "G0 queued");
+  check(CommandSequenceList::getFeedMode("g1 x1") == CommandSequenceList::FEED_QUEUED, "lower case queued");
+  check(CommandSequenceList::getFeedMode("M84") == CommandSequenceList::FEED_QUEUED, "M code queued");
+  check(CommandSequenceList::getFeedMode("G28") == CommandSequenceList::FEED_DRAIN_BEFORE, "homing drains");
+  check(CommandSequenceList::getFeedMode("G28 X") == CommandSequenceList::FEED_DRAIN_BEFORE, "axis homing drains");
+  check(CommandSequenceList::getFeedMode("G2") == CommandSequenceList::FEED_QUEUED, "G2 isn't homing");
+  check(CommandSequenceList::getFeedMode("Galaxy") == CommandSequenceList::FEED_DRAIN_BEFORE_AND_AFTER, "pattern name");
+  check(CommandSequenceList::getFeedMode("pause") == CommandSequenceList::FEED_DRAIN_BEFORE_AND_AFTER, "immediate command");
+}
+
+// Previous approach - the whole list is scanned up to the command wanted
+static std::string getCmdByScan(const char* pCmdList, int cmdIdx, unsigned long& bytesScanned)
+{
+  const char* pCurStr = pCmdList;
+  int curCmdIdx = 0;
+  std::string cmd;
+  while (true)
+  {
+    const char* pCurStrEnd = strchr(pCurStr, ';');
+    unsigned int stLen = pCurStrEnd ? pCurStrEnd - pCurStr : strlen(pCurStr);
+    bytesScanned += stLen + 1;
+    if (stLen == 0)
+      break;
+    if (cmdIdx == curCmdIdx)
+      cmd.assign(pCurStr, stLen);
+    curCmdIdx++;
+    if (!pCurStrEnd)
+      break;
+    pCurStr = pCurStrEnd + 1;
+  }
+  return cmd;
+}
+
+// Simulated queue and motion - the sequencer is serviced each loop and motion takes a queued
+// command when the previous move is done - a move takes moveLoops when the planner can see the
+// next command (so blends into it) and twice as long when it must stop at the end - returns the
+// number of moves which ended in a stop
+static unsigned long runSequence(const std::string& cmdList, bool compiled, std::vector<std::string>& fed,
+                unsigned long& bytesScanned, unsigned long& totalLoops)
+{
+  const unsigned int queueLen = 10;
+  const unsigned int moveLoops = 5;
+  CommandSequenceList seqList;
+  seqList.compile(cmdList.c_str());
+  unsigned int numCmds = seqList.getNumCmds();
+  unsigned int curCmdIdx = 0;
+  bool drainBeforeNext = false;
+  unsigned int queued = 0;
+  unsigned long numStops = 0;
+  unsigned long moveDoneLoop = 0;
+  bytesScanned = 0;
+  for (totalLoops = 0; totalLoops < 10000000; totalLoops++)
+  {
+    // Sequencer
+    while (curCmdIdx < numCmds)
+    {
+      if (queued >= queueLen)
+        break;
+      if (compiled)
+      {
+        const char* pCmdStr = seqList.getCmd(curCmdIdx);
+        CommandSequenceList::FeedMode feedMode = CommandSequenceList::getFeedMode(pCmdStr);
+        if ((drainBeforeNext || (feedMode != CommandSequenceList::FEED_QUEUED)) && (queued != 0))
+          break;
+        drainBeforeNext = feedMode == CommandSequenceList::FEED_DRAIN_BEFORE_AND_AFTER;
+        fed.push_back(pCmdStr);
+        bytesScanned += strlen(pCmdStr) + 1;
+      }
+      else
+      {
+        if (queued != 0)
+          break;
+        fed.push_back(getCmdByScan(cmdList.c_str(), curCmdIdx, bytesScanned));
+      }
+      curCmdIdx++;
+      queued++;
+      if (!compiled)
+        break;
+    }
+    // Motion
+    if ((totalLoops >= moveDoneLoop) && (queued > 0))
+    {
+      queued--;
+      bool blends = queued > 0;
+      moveDoneLoop = totalLoops + (blends ? moveLoops : 2 * moveLoops);
+      if (!blends)
+        numStops++;
+    }
+    if ((curCmdIdx >= numCmds) && (queued == 0))
+      break;
+  }
+  return numStops;
+}
+
+static void compareFeeding()
+{
+  std::string cmdList = "G28";
+  std::vector<std::string> cmds;
+  cmds.push_back("G28");
+  char cmdStr[50];
+  for (int i = 0; i < 2000; i++)
+  {
+    snprintf(cmdStr, sizeof(cmdStr), "G0 X%d.%d Y%d", i % 200, i % 10, (i * 7) % 150);
+    cmds.push_back(cmdStr);
+    if (i == 1000)
+      cmds.push_back("pattern1");
+  }
+  for (unsigned int i = 1; i < cmds.size(); i++)
+    cmdList += ";" + cmds[i];
+
+  std::vector<std::string> fedScan, fedCompiled;
+  unsigned long bytesScan = 0, bytesCompiled = 0, loopsScan = 0, loopsCompiled = 0;
+  unsigned long stopsScan = runSequence(cmdList, false, fedScan, bytesScan, loopsScan);
+  unsigned long stopsCompiled = runSequence(cmdList, true, fedCompiled, bytesCompiled, loopsCompiled);
+  check(fedScan == cmds, "scanned commands in order");
+  check(fedCompiled == cmds, "compiled commands in order");
+  check(bytesCompiled <= cmdList.length() + 1, "compiled list read once");
+  check(bytesScan > 100 * bytesCompiled, "scanning is quadratic");
+  check(stopsScan == cmds.size(), "draining before each command stops every move");
+  check(stopsCompiled <= 4, "motion only stops at drains");
+  check(loopsCompiled * 1.5 < loopsScan, "pipelined feeding is faster");
+  printf("Sequence %zu commands (%zu bytes): scanned %lu bytes, %lu loops, %lu stops\n",
+         cmds.size(), cmdList.length(), bytesScan, loopsScan, stopsScan);
+  printf("Compiled: read %lu bytes, %lu loops, %lu stops\n",
+         bytesCompiled, loopsCompiled, stopsCompiled);
+}
+
+int main()
+{
+  testCompile();
+  compareFeeding();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,222 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for CommsSerial - the firmware's CommsSerial runs unchanged against the host stubs
+// (chars are queued on the stub Serial port and the replies checked) with a stand-in for the
+// CommandInterpreter methods it uses so the command queue can be held full
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "application.h"
+class RobotController;
+#include "CommsSerial.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Command queue stand-in - holds up to capacity commands, the test frees space
+class TestQueue
+{
+public:
+  unsigned int _capacity;
+  std::vector<std::string> _queued;
+  std::vector<std::string> _immediate;
+  int _busyCount;
+
+  void reset(unsigned int capacity)
+  {
+    _capacity = capacity;
+    _queued.clear();
+    _immediate.clear();
+    _busyCount = 0;
+  }
+
+  void fill()
+  {
+    while (_queued.size() < _capacity)
+      _queued.push_back("G1 X0");
+  }
+
+  unsigned int spaces()
+  {
+    return _capacity - _queued.size();
+  }
+
+  static unsigned int numCmds(const char* pLine, unsigned int lineLen)
+  {
+    unsigned int cmdCount = 1;
+    for (unsigned int i = 0; i < lineLen; i++)
+      if (pLine[i] == ';')
+        cmdCount++;
+    return cmdCount;
+  }
+};
+static TestQueue testQueue;
+
+// CommandInterpreter methods used by CommsSerial - commands in a line are separated by ';' and
+// each takes one place in the queue
+CommandInterpreter::CommandInterpreter(WorkflowManager* pWorkflowManager, RobotController* pRobotController)
+{
+}
+
+bool CommandInterpreter::canAcceptLine(const char* pLine, unsigned int lineLen, bool& tooLarge)
+{
+  unsigned int cmdCount = TestQueue::numCmds(pLine, lineLen);
+  tooLarge = cmdCount > testQueue._capacity;
+  return cmdCount <= testQueue.spaces();
+}
+
+bool CommandInterpreter::isImmediateCommand(const char* pCmdStr, unsigned int cmdLen)
+{
+  return ((cmdLen == 4) && (strncasecmp(pCmdStr, "stop", 4) == 0)) ||
+         ((cmdLen == 5) && (strncasecmp(pCmdStr, "pause", 5) == 0)) ||
+         ((cmdLen == 6) && (strncasecmp(pCmdStr, "resume", 6) == 0));
+}
+
+// Commands which don't fit are dropped and reported as busy (as the real queue does)
+void CommandInterpreter::process(const char* pCmdStr, String& retStr, int cmdIdx)
+{
+  if (isImmediateCommand(pCmdStr, strlen(pCmdStr)))
+  {
+    testQueue._immediate.push_back(pCmdStr);
+    retStr = "{\"rslt\":\"ok\"}";
+    return;
+  }
+  retStr = "{\"rslt\":\"ok\"}";
+  std::string line = pCmdStr;
+  size_t cmdStart = 0;
+  while (true)
+  {
+    size_t cmdEnd = line.find(';', cmdStart);
+    std::string cmd = line.substr(cmdStart, cmdEnd == std::string::npos ? std::string::npos : cmdEnd - cmdStart);
+    if (testQueue.spaces() > 0)
+      testQueue._queued.push_back(cmd);
+    else
+      retStr = "{\"rslt\":\"busy\"}";
+    if (cmdEnd == std::string::npos)
+      break;
+    cmdStart = cmdEnd + 1;
+  }
+  if (retStr.indexOf("\"busy\"") >= 0)
+    testQueue._busyCount++;
+}
+
+bool CommandInterpreter::processBinaryFrame(const uint8_t* pFrame, unsigned int frameLen, String& retStr)
+{
+  return false;
+}
+
+static int countReplies(const char* pReply)
+{
+  int replyCount = 0;
+  for (size_t i = 0; i < Serial._txLines.size(); i++)
+    if (Serial._txLines[i] == pReply)
+      replyCount++;
+  return replyCount;
+}
+
+static void resetSerial()
+{
+  Serial._rxChars.clear();
+  Serial._txLines.clear();
+}
+
+// Stop sent while the line ring is full (the host has filled it while the queue is full) is acted
+// on straight away and not lost as an overflow - the lines in the ring are still processed
+static void testStopWhenRingFull()
+{
+  CommandInterpreter commandInterpreter(NULL, NULL);
+  CommsSerial commsSerial(0);
+  resetSerial();
+  testQueue.reset(20);
+  testQueue.fill();
+  const char* pLine = "G1 X10 Y10\n";
+  int linesInRing = CommsSerial::RX_RING_BYTES / strlen(pLine);
+  for (int lineIdx = 0; lineIdx < linesInRing + 1; lineIdx++)
+    Serial.hostReceive(pLine);
+  Serial.hostReceive("stop\n");
+  commsSerial.service(commandInterpreter);
+  check(testQueue._immediate.size() == 1 && testQueue._immediate[0] == "stop", "ring full: stop acted on");
+  check(countReplies("[MSG:stop]") == 1, "ring full: stop acknowledged");
+  check(countReplies("error:overflow") == 1, "ring full: only the line which didn't fit overflowed");
+  check(countReplies("ok") == 0 && countReplies("error:linetoolong") == 0, "ring full: no lines processed while queue full");
+
+  // Once the queue has space the lines in the ring are processed
+  testQueue.reset(1000);
+  commsSerial.service(commandInterpreter);
+  check(int(testQueue._queued.size()) == linesInRing, "ring full: lines in ring processed");
+  check(countReplies("ok") == linesInRing, "ring full: lines in ring acknowledged");
+
+  // Pause and resume are also acted on when the ring is full
+  testQueue.reset(20);
+  testQueue.fill();
+  resetSerial();
+  for (int lineIdx = 0; lineIdx < linesInRing + 1; lineIdx++)
+    Serial.hostReceive(pLine);
+  Serial.hostReceive("pause\r\nresume\r\n");
+  commsSerial.service(commandInterpreter);
+  check(testQueue._immediate.size() == 2 && testQueue._immediate[0] == "pause" && testQueue._immediate[1] == "resume",
+        "ring full: pause and resume acted on");
+  check(countReplies("[MSG:pause]") == 1 && countReplies("[MSG:resume]") == 1, "ring full: pause and resume acknowledged");
+}
+
+// A line with several commands is only taken from the ring once all of them fit - it is never
+// half queued and answered with busy
+static void testMultiCommandLine()
+{
+  CommandInterpreter commandInterpreter(NULL, NULL);
+  CommsSerial commsSerial(0);
+  resetSerial();
+  testQueue.reset(4);
+  testQueue._queued.push_back("G1 X0");
+  testQueue._queued.push_back("G1 X1");
+  Serial.hostReceive("G1 X2;G1 X3;G1 X4\nG1 X5\n");
+  commsSerial.service(commandInterpreter);
+  check(testQueue._queued.size() == 2, "multi-command: line left in ring until all commands fit");
+  check(Serial._txLines.empty(), "multi-command: not acknowledged until processed");
+  testQueue._queued.erase(testQueue._queued.begin());
+  commsSerial.service(commandInterpreter);
+  check(testQueue._queued.size() == 4 && testQueue._queued[3] == "G1 X4", "multi-command: all commands queued");
+  check(countReplies("ok") == 1, "multi-command: acknowledged once queued");
+  testQueue._queued.clear();
+  commsSerial.service(commandInterpreter);
+  check(testQueue._queued.size() == 1 && testQueue._queued[0] == "G1 X5", "multi-command: following line queued");
+  check(countReplies("ok") == 2 && testQueue._busyCount == 0, "multi-command: never busy");
+}
+
+// A line with more commands than the queue could ever hold is discarded rather than blocking
+static void testLineTooLargeForQueue()
+{
+  CommandInterpreter commandInterpreter(NULL, NULL);
+  CommsSerial commsSerial(0);
+  resetSerial();
+  testQueue.reset(2);
+  Serial.hostReceive("G1 X1;G1 X2;G1 X3\nG1 X4\n");
+  commsSerial.service(commandInterpreter);
+  check(Serial._txLines.size() == 2 && Serial._txLines[0] == "error:linetoolong" && Serial._txLines[1] == "ok",
+        "too large for queue: rejected and next line processed");
+  check(testQueue._queued.size() == 1 && testQueue._queued[0] == "G1 X4", "too large for queue: nothing queued from it");
+}
+
+int main()
+{
+  testStopWhenRingFull();
+  testMultiCommandLine();
+  testLineTooLargeForQueue();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,261 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for GCodeNumber - values are compared with strtod for the number forms CAM tools emit,
+// errors and fixed-point conversion are checked and the lines per second of a dense job parsed with
+// strtod (as GCodeInterpreter did) and with GCodeNumber are compared
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "GCodeNumber.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Parse a whole string as float - returns the result and the number of chars used
+static GCodeNumber::ParseResult parseStr(const char* pStr, float& val, int& numChars)
+{
+  const char* pNumEnd = NULL;
+  GCodeNumber::ParseResult rslt = GCodeNumber::parseFloat(pStr, pStr + strlen(pStr), val, pNumEnd);
+  numChars = pNumEnd - pStr;
+  return rslt;
+}
+
+static bool closeTo(float val, double expected)
+{
+  return fabs(val - expected) <= fabs(expected) * 2.5e-7;
+}
+
+static void testForms()
+{
+  struct
+  {
+    const char* pStr;
+    double expected;
+    int numChars;
+  } forms[] =
+  {
+    { "0", 0, 1 },
+    { "10", 10, 2 },
+    { "-.5", -0.5, 3 },
+    { "+1.", 1, 3 },
+    { " 10", 10, 3 },
+    { "0012.500", 12.5, 8 },
+    { "-0.000", 0, 6 },
+    { "123.456 Y1", 123.456, 7 },
+    { "1E2", 1, 1 },
+    { "3.5F1500", 3.5, 3 },
+    { "0.00001234", 0.00001234, 10 },
+    { "12345678901234", 12345678901234.0, 14 },
+    { "1.23456789012345", 1.23456789012345, 16 },
+    { "1.2.3", 1.2, 3 }
+  };
+  for (unsigned int i = 0; i < sizeof(forms) / sizeof(forms[0]); i++)
+  {
+    float val = -1;
+    int numChars = 0;
+    GCodeNumber::ParseResult rslt = parseStr(forms[i].pStr, val, numChars);
+    char msg[100];
+    snprintf(msg, sizeof(msg), "form \"%s\"", forms[i].pStr);
+    check((rslt == GCodeNumber::PARSE_OK) && closeTo(val, forms[i].expected) && (numChars == forms[i].numChars), msg);
+  }
+
+  // Errors - nothing is consumed when there are no digits
+  const char* noDigits[] = { "", ".", "-", "+.", " ", "Y10", "-E1" };
+  for (unsigned int i = 0; i < sizeof(noDigits) / sizeof(noDigits[0]); i++)
+  {
+    float val = 0;
+    int numChars = -1;
+    char msg[100];
+    snprintf(msg, sizeof(msg), "no digits \"%s\"", noDigits[i]);
+    check((parseStr(noDigits[i], val, numChars) == GCodeNumber::PARSE_NO_DIGITS) && (numChars == 0), msg);
+  }
+  float val = 0;
+  int numChars = 0;
+  std::string bigNum = "1" + std::string(40, '0');
+  check(parseStr(bigNum.c_str(), val, numChars) == GCodeNumber::PARSE_OUT_OF_RANGE, "too big out of range");
+  check(numChars == 41, "out of range number skipped");
+  std::string smallNum = "0." + std::string(50, '0') + "1";
+  check((parseStr(smallNum.c_str(), val, numChars) == GCodeNumber::PARSE_OK) && (val == 0), "tiny is zero");
+
+  // Parsing stops at the end given (args aren't null-terminated)
+  const char* pStr = "123456";
+  const char* pNumEnd = NULL;
+  check((GCodeNumber::parseFloat(pStr, pStr + 3, val, pNumEnd) == GCodeNumber::PARSE_OK) && (val == 123) &&
+        (pNumEnd == pStr + 3), "stops at end");
+}
+
+static void testFixed()
+{
+  struct
+  {
+    const char* pStr;
+    int fracDigits;
+    GCodeNumber::ParseResult rslt;
+    int32_t expected;
+  } fixed[] =
+  {
+    { "12.3456", 3, GCodeNumber::PARSE_OK, 12346 },
+    { "12.3454", 3, GCodeNumber::PARSE_OK, 12345 },
+    { "-0.0005", 3, GCodeNumber::PARSE_OK, -1 },
+    { "-.25", 2, GCodeNumber::PARSE_OK, -25 },
+    { "1500", 0, GCodeNumber::PARSE_OK, 1500 },
+    { "7", 3, GCodeNumber::PARSE_OK, 7000 },
+    { "2147483.64", 3, GCodeNumber::PARSE_OK, 2147483640 },
+    { "2147483.65", 3, GCodeNumber::PARSE_OUT_OF_RANGE, 0 },
+    { "99999999999", 0, GCodeNumber::PARSE_OUT_OF_RANGE, 0 }
+  };
+  for (unsigned int i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+  {
+    int32_t val = -1;
+    const char* pNumEnd = NULL;
+    const char* pStr = fixed[i].pStr;
+    GCodeNumber::ParseResult rslt = GCodeNumber::parseFixed(pStr, pStr + strlen(pStr), fixed[i].fracDigits, val, pNumEnd);
+    char msg[100];
+    snprintf(msg, sizeof(msg), "fixed \"%s\" with %d places", pStr, fixed[i].fracDigits);
+    check((rslt == fixed[i].rslt) && ((rslt != GCodeNumber::PARSE_OK) || (val == fixed[i].expected)), msg);
+  }
+}
+
+// Random values in the formats used by CAM tools compared with strtod
+static void testAgainstStrtod()
+{
+  const int NUM_VALS = 1000000;
+  srand(1);
+  int numWrong = 0;
+  char numStr[40];
+  for (int i = 0; i < NUM_VALS; i++)
+  {
+    double v = (rand() % 2000000 - 1000000) / pow(10, rand() % 7);
+    int decimals = rand() % 7;
+    snprintf(numStr, sizeof(numStr), "%.*f", decimals, v);
+    // Leading and trailing point forms
+    if ((rand() % 4 == 0) && (strncmp(numStr, "0.", 2) == 0))
+      memmove(numStr, numStr + 1, strlen(numStr));
+    if ((rand() % 4 == 0) && (decimals == 0))
+      strcat(numStr, ".");
+    float val = 0;
+    int numChars = 0;
+    float expected = strtod(numStr, NULL);
+    if ((parseStr(numStr, val, numChars) != GCodeNumber::PARSE_OK) || (numChars != (int)strlen(numStr)) ||
+              !closeTo(val, expected))
+    {
+      if (numWrong++ < 5)
+        printf("Mismatch %s %.9g %.9g\n", numStr, val, expected);
+    }
+  }
+  check(numWrong == 0, "values match strtod");
+}
+
+// Parse the numbers in a G-code line - with strtod (as GCodeInterpreter did) or GCodeNumber
+static int parseLineStrtod(const char* pStr, float vals[])
+{
+  int numVals = 0;
+  char* pEndStr = NULL;
+  while (*pStr)
+  {
+    switch (toupper(*pStr))
+    {
+      case 'X': case 'Y': case 'Z': case 'E': case 'F':
+        vals[numVals++] = strtod(++pStr, &pEndStr);
+        pStr = pEndStr;
+        break;
+      default: pStr++; break;
+    }
+  }
+  return numVals;
+}
+
+static int parseLineGCodeNumber(const char* pStr, const char* pEnd, float vals[])
+{
+  int numVals = 0;
+  const char* pNumEnd = NULL;
+  while (pStr < pEnd)
+  {
+    switch (toupper(*pStr))
+    {
+      case 'X': case 'Y': case 'Z': case 'E': case 'F':
+        if (GCodeNumber::parseFloat(pStr + 1, pEnd, vals[numVals++], pNumEnd) != GCodeNumber::PARSE_OK)
+          return -1;
+        pStr = pNumEnd;
+        break;
+      default: pStr++; break;
+    }
+  }
+  return numVals;
+}
+
+static void benchmark()
+{
+  // Dense printer-like output - XY moves with extrusion and occasional feedrate
+  const int NUM_LINES = 500000;
+  std::vector<std::string> lines;
+  char line[80];
+  for (int i = 0; i < NUM_LINES; i++)
+  {
+    int len = snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f", 100 + (i * 37 % 50000) / 1000.0,
+                       -60 + (i * 53 % 30000) / 1000.0, i * 0.00123);
+    if (i % 10 == 0)
+      snprintf(line + len, sizeof(line) - len, " F%d", 1200 + i % 3000);
+    lines.push_back(line);
+  }
+
+  float vals[5];
+  double strtodSum = 0;
+  auto startTime = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < NUM_LINES; i++)
+  {
+    int numVals = parseLineStrtod(lines[i].c_str(), vals);
+    for (int j = 0; j < numVals; j++)
+      strtodSum += vals[j];
+  }
+  double strtodUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+  double parserSum = 0;
+  bool allParsed = true;
+  startTime = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < NUM_LINES; i++)
+  {
+    int numVals = parseLineGCodeNumber(lines[i].c_str(), lines[i].c_str() + lines[i].length(), vals);
+    if (numVals < 0)
+      allParsed = false;
+    for (int j = 0; j < numVals; j++)
+      parserSum += vals[j];
+  }
+  double parserUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+  check(allParsed, "all lines parsed");
+  check(fabs(strtodSum - parserSum) <= fabs(strtodSum) * 1e-9, "line values match strtod");
+  check(parserUs < strtodUs, "faster than strtod");
+  printf("Dense job %d lines: strtod %.0f lines/s, GCodeNumber %.0f lines/s (%.1fx)\n", NUM_LINES,
+         NUM_LINES / strtodUs * 1e6, NUM_LINES / parserUs * 1e6, strtodUs / parserUs);
+}
+
+int main()
+{
+  testForms();
+  testFixed();
+  testAgainstStrtod();
+  benchmark();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,158 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for GCodeParser - the parsing of G and M code args into RobotCommandArgs done when
+// commands are queued - covering flag-only axis letters, bracketed comments, bad numbers, S on
+// M codes and the motion tuning M codes
+
+#include <stdio.h>
+#include <string.h>
+#include "GCodeParser.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static bool parse(const char* pCmdStr, int& cmdNum, RobotCommandArgs& cmdArgs)
+{
+  CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+  const char* pArgsStr = NULL;
+  unsigned int argsLen = 0;
+  return GCodeParser::parseGcode(pCmdStr, strlen(pCmdStr), recordType, cmdNum, cmdArgs, pArgsStr, argsLen);
+}
+
+// Parse an M code and get the motion tuning from it as GCodeInterpreter does
+static bool parseTuning(const char* pCmdStr, MotionTuning& tuning)
+{
+  CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+  int cmdNum = 0;
+  RobotCommandArgs cmdArgs;
+  const char* pArgsStr = NULL;
+  unsigned int argsLen = 0;
+  tuning.clear();
+  if (!GCodeParser::parseGcode(pCmdStr, strlen(pCmdStr), recordType, cmdNum, cmdArgs, pArgsStr, argsLen) ||
+              (recordType != CommandElem::RECORD_MCODE))
+    return false;
+  return GCodeParser::getMotionTuning(cmdNum, cmdArgs, pArgsStr, argsLen, tuning);
+}
+
+static void testAxisFlags()
+{
+  int cmdNum = 0;
+  RobotCommandArgs cmdArgs;
+  check(parse("G28 X", cmdNum, cmdArgs) && (cmdNum == 28), "G28 X parsed");
+  check(cmdArgs.isValid(0) && !cmdArgs.isValid(1) && !cmdArgs.isValid(2), "G28 X homes X only");
+  check(parse("G28 X Y", cmdNum, cmdArgs), "G28 X Y parsed");
+  check(cmdArgs.isValid(0) && cmdArgs.isValid(1) && !cmdArgs.isValid(2), "G28 X Y homes X and Y");
+  check(parse("G28 XY", cmdNum, cmdArgs) && cmdArgs.isValid(0) && cmdArgs.isValid(1), "G28 XY homes X and Y");
+  check(parse("G28 Z (home Z)", cmdNum, cmdArgs) && cmdArgs.isValid(2) && !cmdArgs.isValid(0), "flag before comment");
+  check(parse("G28", cmdNum, cmdArgs) && !cmdArgs.anyValid(), "G28 with no axes");
+  check(parse("G1 X Y2.5", cmdNum, cmdArgs) && (cmdArgs.getValMM(0) == 0) && (cmdArgs.getValMM(1) == 2.5f),
+        "flag is value 0");
+  check(parse("G1 X1 F", cmdNum, cmdArgs) && !cmdArgs.isFeedrateValid(), "bare F doesn't set feedrate");
+  check(parse("G1 X1 E", cmdNum, cmdArgs) && !cmdArgs.isExtrudeValid(), "bare E doesn't set extrude");
+}
+
+static void testComments()
+{
+  int cmdNum = 0;
+  RobotCommandArgs cmdArgs;
+  check(parse("G1 X10 (Cut X profile) Y5", cmdNum, cmdArgs), "comment with axis letter parsed");
+  check((cmdArgs.getValMM(0) == 10) && (cmdArgs.getValMM(1) == 5) && !cmdArgs.isValid(2), "comment args ignored");
+  check(parse("G0 (Feed) F1500", cmdNum, cmdArgs) && (cmdArgs.getFeedrate() == 1500) && !cmdArgs.anyValid(),
+        "comment with F ignored");
+  check(parse("G1 (Start)X1.5", cmdNum, cmdArgs) && (cmdArgs.getValMM(0) == 1.5f), "arg straight after comment");
+  check(parse("G1 X2 (not closed Y", cmdNum, cmdArgs) && (cmdArgs.getValMM(0) == 2) && !cmdArgs.isValid(1),
+        "unclosed comment runs to end");
+
+  float val = 0;
+  const char* pArgs = "(Set S low) S50";
+  check(GCodeParser::getArgVal(pArgs, strlen(pArgs), 'S', val) && (val == 50), "getArgVal skips comment");
+  pArgs = "(only S here)";
+  check(!GCodeParser::getArgVal(pArgs, strlen(pArgs), 'S', val), "getArgVal arg only in comment");
+}
+
+static void testErrors()
+{
+  int cmdNum = 0;
+  RobotCommandArgs cmdArgs;
+  HostLogger::clearLastMsg();
+  check(!parse("G1 X-", cmdNum, cmdArgs), "sign with no digits fails");
+  check(strstr(HostLogger::lastMsg(), "arg X at args pos 0 no digits") != NULL, "error reports arg and position");
+  check(!parse("G1 X1 Y.Z", cmdNum, cmdArgs), "point with no digits fails");
+  check(strstr(HostLogger::lastMsg(), "arg Y at args pos 3") != NULL, "error reports second arg position");
+  std::string bigNum = "G1 X1" + std::string(40, '0');
+  check(!parse(bigNum.c_str(), cmdNum, cmdArgs), "out of range fails");
+  check(parse("G1 X1E2", cmdNum, cmdArgs) && (cmdArgs.getValMM(0) == 1) && (cmdArgs.getExtrude() == 2),
+        "E after number is next word");
+  // Args are bounded by the length given
+  const char* pCmd = "G1 X12 Y34";
+  RobotCommandArgs boundedArgs;
+  CommandElem::RecordType recordType = CommandElem::RECORD_TEXT;
+  const char* pArgsStr = NULL;
+  unsigned int argsLen = 0;
+  check(GCodeParser::parseGcode(pCmd, 5, recordType, cmdNum, boundedArgs, pArgsStr, argsLen) &&
+        (boundedArgs.getValMM(0) == 1) && !boundedArgs.isValid(1), "parse bounded by length");
+}
+
+// S selects end-stops on G codes only
+static void testEndStopArg()
+{
+  int cmdNum = 0;
+  RobotCommandArgs cmdArgs;
+  HostLogger::clearLastMsg();
+  check(parse("M204 S100", cmdNum, cmdArgs) && (cmdArgs.getEndstopCheck()._uint == 0), "M204 S doesn't set end-stops");
+  check(parse("M220 S50", cmdNum, cmdArgs) && (cmdArgs.getEndstopCheck()._uint == 0), "M220 S doesn't set end-stops");
+  check(strstr(HostLogger::lastMsg(), "endstops") == NULL, "no end-stop log for M codes");
+  check(parse("M220 S50 X1", cmdNum, cmdArgs) && (cmdArgs.getValMM(0) == 1), "M code S number skipped");
+  check(!parse("M220 S-", cmdNum, cmdArgs), "M code S with bad number fails");
+  check(parse("G28 S1", cmdNum, cmdArgs) && (cmdArgs.getEndstopCheck()._uint != 0), "G28 S1 checks end-stops");
+}
+
+// Motion tuning M codes
+static void testMotionTuning()
+{
+  MotionTuning tuning;
+  check(parseTuning("M201 X200 Y-5 Z300", tuning), "M201 parsed");
+  check(tuning.isMaxAccValid(0) && (tuning._maxAccMMps2[0] == 200) && !tuning.isMaxAccValid(1) &&
+        tuning.isMaxAccValid(2) && (tuning._maxAccMMps2[2] == 300), "M201 axis accelerations (negative ignored)");
+  check(!tuning.isMaxSpeedValid(0), "M201 doesn't set speed");
+  check(parseTuning("M203 Y40", tuning) && tuning.isMaxSpeedValid(1) && (tuning._maxSpeedMMps[1] == 40) &&
+        !tuning.isMaxSpeedValid(0), "M203 axis speed");
+  check(parseTuning("M204 S250", tuning) && tuning._pathAccValid && (tuning._pathAccMMps2 == 250), "M204 S");
+  check(parseTuning("M204 P150", tuning) && tuning._pathAccValid && (tuning._pathAccMMps2 == 150), "M204 P");
+  check(parseTuning("M204 S0", tuning) && tuning._pathAccValid && (tuning._pathAccMMps2 == 0), "M204 S0 removes limit");
+  check(parseTuning("M204", tuning) && !tuning.anyValid(), "M204 with no value");
+  check(parseTuning("M205 J0.02", tuning) && tuning._junctionDeviationValid && (tuning._junctionDeviation == 0.02f),
+        "M205 J");
+  check(parseTuning("M220 S50", tuning) && tuning._feedrateOverrideValid && (tuning._feedrateOverridePC == 50) &&
+        !tuning._extrudeOverrideValid, "M220 S");
+  check(parseTuning("M220 S0", tuning) && !tuning._feedrateOverrideValid, "M220 S0 ignored");
+  check(parseTuning("M221 S120", tuning) && tuning._extrudeOverrideValid && (tuning._extrudeOverridePC == 120) &&
+        !tuning._feedrateOverrideValid, "M221 S");
+  check(parseTuning("M220 (slow down) S25", tuning) && (tuning._feedrateOverridePC == 25), "M220 with comment");
+  check(!parseTuning("M17", tuning), "other M code isn't tuning");
+}
+
+int main()
+{
+  testAxisFlags();
+  testComments();
+  testErrors();
+  testEndStopArg();
+  testMotionTuning();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
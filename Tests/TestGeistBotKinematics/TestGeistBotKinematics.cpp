@@ -0,0 +1,155 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for GeistBotKinematics
+// Round trips points through ptToActuator and actuatorToPt from a range of starting positions
+// and checks that the arm always takes the shortest rotation, that the rack coupling is applied
+// and that step overflow correction doesn't change the position
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include "GeistBotKinematics.h"
+
+// Geometry from the GeistBot config
+static const float STEPS_PER_ROT_0  = 12000;
+static const float UNITS_PER_ROT_0  = 360;
+static const float STEPS_PER_ROT_1  = 12000;
+static const float UNITS_PER_ROT_1  = 44.8f;
+static const float MIN_LINEAR_MM    = 0;
+static const float MAX_LINEAR_MM    = 195;
+
+// Round trip includes rounding to whole steps (half a rotation step at full reach is ~0.05mm and
+// half a linear step ~0.002mm but the linear position is also affected by the rotation rounding)
+static const double TOL_ROUND_TRIP_MM = 0.1;
+
+static int failCount = 0;
+
+static int32_t roundSteps(float steps)
+{
+  return int32_t(lroundf(steps));
+}
+
+static void checkRoundTrip(GeistBotKinematics& kin, double& maxErr)
+{
+  // Starting positions include several whole rotations either way
+  const int32_t startRots[] = { -5, -1, 0, 1, 7 };
+  const float startAngles[] = { 0, 1, 90, 179.9f, 180.1f, 359.99f };
+  const float startLinear[] = { 0, 50, 195 };
+  int checked = 0;
+  for (int32_t startRot : startRots)
+  for (float startAngle : startAngles)
+  for (float startLin : startLinear)
+  {
+    int32_t cur0 = startRot * int32_t(STEPS_PER_ROT_0) + roundSteps(startAngle * STEPS_PER_ROT_0 / UNITS_PER_ROT_0);
+    int32_t cur1 = cur0 + roundSteps(startLin * STEPS_PER_ROT_1 / UNITS_PER_ROT_1);
+    for (float y = -MAX_LINEAR_MM; y <= MAX_LINEAR_MM; y += 7.3f)
+    {
+      for (float x = -MAX_LINEAR_MM; x <= MAX_LINEAR_MM; x += 7.3f)
+      {
+        float s0 = 0, s1 = 0;
+        bool ok = kin.ptToActuator(x, y, cur0, cur1, s0, s1, false);
+        bool expectOk = sqrtf(x * x + y * y) <= MAX_LINEAR_MM;
+        if (ok != expectOk)
+        {
+          printf("FAIL bounds x %.2f y %.2f ok %d\n", x, y, ok);
+          failCount++;
+        }
+        if (!ok)
+          continue;
+
+        // Shortest rotation - never more than half a turn
+        if (fabsf(s0 - cur0) > STEPS_PER_ROT_0 / 2 + 0.5f)
+        {
+          printf("FAIL shortest path x %.2f y %.2f from %d rotates %.1f steps\n", x, y, cur0, s0 - cur0);
+          failCount++;
+        }
+
+        // Round trip
+        float rx = 0, ry = 0;
+        kin.actuatorToPt(roundSteps(s0), roundSteps(s1), rx, ry);
+        double err = sqrt((rx - x) * (rx - x) + (ry - y) * (ry - y));
+        if (err > maxErr)
+          maxErr = err;
+        if (err > TOL_ROUND_TRIP_MM)
+        {
+          printf("FAIL round trip x %.2f y %.2f from %d,%d -> %.3f %.3f err %.3f\n", x, y, cur0, cur1, rx, ry, err);
+          failCount++;
+        }
+        checked++;
+      }
+    }
+  }
+  printf("Round trip checked %d points: max err %.4f mm\n", checked, maxErr);
+}
+
+static void checkWrapAround(GeistBotKinematics& kin)
+{
+  // From just West of North at 100mm move to just East of North - should rotate clockwise a few
+  // degrees through 0 rather than almost a full turn anticlockwise
+  int32_t cur0 = roundSteps(359 * STEPS_PER_ROT_0 / UNITS_PER_ROT_0);
+  int32_t cur1 = cur0 + roundSteps(100 * STEPS_PER_ROT_1 / UNITS_PER_ROT_1);
+  float x = 100 * sinf(1 * M_PI / 180), y = 100 * cosf(1 * M_PI / 180);
+  float s0 = 0, s1 = 0;
+  kin.ptToActuator(x, y, cur0, cur1, s0, s1, false);
+  float expected0 = cur0 + 2 * STEPS_PER_ROT_0 / UNITS_PER_ROT_0;
+  if (fabsf(s0 - expected0) > 1)
+  {
+    printf("FAIL wrap around expected %.1f got %.1f\n", expected0, s0);
+    failCount++;
+  }
+
+  // Pure rotation - the linear actuator must make the same number of steps (rack coupling)
+  if (fabsf((s1 - cur1) - (s0 - cur0)) > 1)
+  {
+    printf("FAIL rack coupling rotation %.1f linear %.1f\n", s0 - cur0, s1 - cur1);
+    failCount++;
+  }
+
+  // Points at the centre don't rotate the arm
+  kin.ptToActuator(0, 0, cur0, cur1, s0, s1, false);
+  if (s0 != cur0)
+  {
+    printf("FAIL centre rotated from %d to %.1f\n", cur0, s0);
+    failCount++;
+  }
+}
+
+static void checkStepOverflow(GeistBotKinematics& kin)
+{
+  const int32_t testSteps0[] = { 0, 11999, 12000, 12001, 123456, -1, -12000, -12001, -987654 };
+  for (int32_t start0 : testSteps0)
+  {
+    int32_t steps0 = start0;
+    int32_t steps1 = start0 + 20000;
+    float x0 = 0, y0 = 0;
+    kin.actuatorToPt(steps0, steps1, x0, y0);
+    int32_t correction = kin.correctStepOverflow(steps0, steps1);
+    float x1 = 0, y1 = 0;
+    kin.actuatorToPt(steps0, steps1, x1, y1);
+    if ((abs(steps0) >= int32_t(STEPS_PER_ROT_0)) || (steps0 + correction != start0) ||
+        (steps1 - steps0 != 20000) || (fabsf(x1 - x0) > 1e-3f) || (fabsf(y1 - y0) > 1e-3f))
+    {
+      printf("FAIL step overflow %d -> %d,%d pos %.3f,%.3f -> %.3f,%.3f\n", start0, steps0, steps1, x0, y0, x1, y1);
+      failCount++;
+    }
+  }
+}
+
+int main()
+{
+  GeistBotKinematics kin;
+  kin.setGeometry(STEPS_PER_ROT_0, UNITS_PER_ROT_0, STEPS_PER_ROT_1 / UNITS_PER_ROT_1,
+                  true, MIN_LINEAR_MM, true, MAX_LINEAR_MM);
+  double maxErr = 0;
+  checkRoundTrip(kin, maxErr);
+  checkWrapAround(kin);
+  checkStepOverflow(kin);
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,233 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for JobFeeder - a job is uploaded in chunks of random size (split mid-line) while
+// lines are taken as a simulated command queue has space and the lines fed are checked against
+// the job - pause, stop, busy and progress are also checked and the time to upload a job in
+// chunks is compared with one HTTP request per line - lines are only removed from the feeder once
+// taken so a busy queue is simulated by leaving lines
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "JobFeeder.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static std::string makeJob(int numLines, std::vector<std::string>& lines)
+{
+  std::string job;
+  char line[60];
+  for (int i = 0; i < numLines; i++)
+  {
+    snprintf(line, sizeof(line), "G1 X%d.%02d Y%d.%02d", (i * 13) % 200, i % 100, (i * 7) % 200, (i * 3) % 100);
+    lines.push_back(line);
+    job += line;
+    // Mix of line endings and blank lines
+    job += (i % 5 == 0) ? "\r\n" : "\n";
+    if (i % 17 == 0)
+      job += "\n";
+  }
+  return job;
+}
+
+static void testChunkedFeed()
+{
+  std::vector<std::string> lines;
+  std::string job = makeJob(2000, lines);
+  // Last line without terminator
+  job.erase(job.find_last_not_of("\r\n") + 1);
+  JobFeeder feeder(1024);
+  feeder.start(0);
+  check(feeder.isRunning(), "running after start");
+
+  unsigned int sentBytes = 0;
+  unsigned int lineIdx = 0;
+  unsigned int busyCount = 0;
+  srand(3);
+  for (int iter = 0; (iter < 1000000) && (feeder.getState() != JobFeeder::JOB_DONE); iter++)
+  {
+    // Host sends a chunk if there's space
+    if (sentBytes < job.length())
+    {
+      unsigned int chunkLen = 1 + rand() % 400;
+      if (chunkLen > job.length() - sentBytes)
+        chunkLen = job.length() - sentBytes;
+      bool isLast = sentBytes + chunkLen == job.length();
+      if (feeder.append(job.data() + sentBytes, chunkLen, isLast))
+        sentBytes += chunkLen;
+      else
+        busyCount++;
+    }
+
+    // Queue takes a few lines
+    int numToTake = rand() % 4;
+    for (int i = 0; i < numToTake; i++)
+    {
+      unsigned int lineLen = 0;
+      const char* pLine = feeder.peekLine(lineLen);
+      if (!pLine)
+        break;
+      // Queue busy - the line is offered again
+      if (rand() % 3 == 0)
+        continue;
+      feeder.takeLine();
+      check(lineIdx < lines.size(), "not too many lines");
+      if (lineIdx < lines.size())
+        check((lines[lineIdx] == pLine) && (lineLen == lines[lineIdx].length()), "line matches job");
+      lineIdx++;
+    }
+  }
+  check(sentBytes == job.length(), "whole job sent");
+  check(lineIdx == lines.size(), "all lines fed");
+  check(feeder.getState() == JobFeeder::JOB_DONE, "done at end");
+  check(busyCount > 0, "busy when buffer full");
+  check(!feeder.append("G1 X1\n", 6, false), "no append after end");
+  char statusStr[200];
+  feeder.getStatusJSON(statusStr, sizeof(statusStr));
+  check(strstr(statusStr, "\"pct\":100") != NULL, "progress 100% at end");
+  printf("Chunked feed: %u bytes, %u lines, %u busy retries, status %s\n", sentBytes, lineIdx, busyCount, statusStr);
+}
+
+static void testPauseStop()
+{
+  JobFeeder feeder(256);
+  unsigned int lineLen = 0;
+  check(!feeder.append("G1 X1\n", 6, false), "no append before start");
+  feeder.start(18);
+  check(feeder.append("G1 X1\nG1 X2\n", 12, false), "append");
+  const char* pLine = feeder.peekLine(lineLen);
+  check(pLine && (strcmp(pLine, "G1 X1") == 0), "line when running");
+  pLine = feeder.peekLine(lineLen);
+  check(pLine && (strcmp(pLine, "G1 X1") == 0), "line kept until taken");
+  feeder.takeLine();
+  feeder.pause(true);
+  check(feeder.getState() == JobFeeder::JOB_PAUSED, "paused");
+  check(feeder.peekLine(lineLen) == NULL, "no line when paused");
+  check(feeder.append("G1 X3\n", 6, false), "append when paused");
+  feeder.pause(false);
+  pLine = feeder.peekLine(lineLen);
+  check(pLine && (strcmp(pLine, "G1 X2") == 0), "next line after resume");
+  feeder.takeLine();
+  char statusStr[200];
+  feeder.getStatusJSON(statusStr, sizeof(statusStr));
+  check(strstr(statusStr, "\"end\":1") != NULL, "end when total received");
+  check(strstr(statusStr, "\"pct\":66") != NULL, "progress from total");
+  feeder.stop();
+  check(feeder.getState() == JobFeeder::JOB_DONE, "done after stop");
+  check(feeder.peekLine(lineLen) == NULL, "no line after stop");
+
+  // Line longer than the buffer fails the job rather than blocking or running part of the line
+  feeder.start(0);
+  std::string longLine(300, 'X');
+  check(feeder.append(longLine.data(), 256, false), "fill buffer");
+  check(feeder.peekLine(lineLen) == NULL, "no line from over-long line");
+  check(feeder.getState() == JobFeeder::JOB_FAILED, "over-long line fails job");
+  check(feeder.getBufferFree() == 256, "over-long line removed");
+  feeder.getStatusJSON(statusStr, sizeof(statusStr));
+  check(strstr(statusStr, "\"err\":\"linetoolong\"") != NULL, "failure reason in status");
+  check(!feeder.append("G1 X1\n", 6, false), "no append after fail");
+
+  // Terminated line longer than JOB_MAX_LINE_LEN (but not the buffer) also fails the job
+  feeder.start(0);
+  std::string longCmd = "G1 X1\nG1 X2 (" + std::string(JobFeeder::JOB_MAX_LINE_LEN, 'c') + ")\nG1 X3\n";
+  check(feeder.append(longCmd.data(), longCmd.length(), true), "append long command");
+  pLine = feeder.peekLine(lineLen);
+  check(pLine && (strcmp(pLine, "G1 X1") == 0), "line before long command");
+  feeder.takeLine();
+  check(feeder.peekLine(lineLen) == NULL, "long command not fed");
+  check(feeder.getState() == JobFeeder::JOB_FAILED, "long command fails job");
+
+  // A job can fail from outside (e.g. a line which can never fit in the command queue)
+  feeder.start(0);
+  check(feeder.append("G1 X1\n", 6, false), "append before fail");
+  feeder.fail("toolarge");
+  check((feeder.getState() == JobFeeder::JOB_FAILED) && (feeder.peekLine(lineLen) == NULL), "failed from outside");
+}
+
+// Upload time with one HTTP request per line compared with chunked upload
+static void compareUploadTime()
+{
+  const double requestMs = 60;
+  const double planMsPerLine = 2;
+  const unsigned int chunkBytes = 2048;
+  std::vector<std::string> lines;
+  std::string job = makeJob(5000, lines);
+
+  // Per-line requests - each line waits for a round trip
+  double perLineMs = lines.size() * requestMs;
+
+  // Chunked - simulate in 1ms steps with a request in flight taking requestMs
+  JobFeeder feeder(4096);
+  feeder.start(job.length());
+  unsigned int sentBytes = 0;
+  double requestDoneMs = 0, nextPlanMs = 0, uploadDoneMs = 0;
+  unsigned int pendingChunk = 0;
+  unsigned int linesFed = 0;
+  double nowMs = 0;
+  for (; nowMs < 1e7; nowMs += 1)
+  {
+    // Host request completes
+    if ((pendingChunk > 0) && (nowMs >= requestDoneMs))
+    {
+      if (feeder.append(job.data() + sentBytes, pendingChunk, false))
+        sentBytes += pendingChunk;
+      pendingChunk = 0;
+      if ((sentBytes == job.length()) && (uploadDoneMs == 0))
+        uploadDoneMs = nowMs;
+    }
+    // Host starts the next request when it has a chunk that would fit
+    if ((pendingChunk == 0) && (sentBytes < job.length()))
+    {
+      unsigned int chunkLen = std::min<unsigned int>(chunkBytes, job.length() - sentBytes);
+      if (chunkLen <= feeder.getBufferFree())
+      {
+        pendingChunk = chunkLen;
+        requestDoneMs = nowMs + requestMs;
+      }
+    }
+    // Planner takes lines
+    if (nowMs >= nextPlanMs)
+    {
+      unsigned int lineLen = 0;
+      if (feeder.peekLine(lineLen))
+      {
+        feeder.takeLine();
+        linesFed++;
+        nextPlanMs = nowMs + planMsPerLine;
+      }
+    }
+    if (feeder.getState() == JobFeeder::JOB_DONE)
+      break;
+  }
+  check(linesFed == lines.size(), "chunked upload fed all lines");
+  check(nowMs < perLineMs / 5, "chunked upload at least 5x faster than per-line requests");
+  printf("Job %zu lines: per-line requests %.1f s, chunked upload complete %.1f s and fed %.1f s\n",
+         lines.size(), perLineMs / 1000, uploadDoneMs / 1000, nowMs / 1000);
+}
+
+int main()
+{
+  testChunkedFeed();
+  testPauseStop();
+  compareUploadTime();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,194 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for JobStore on a file-backed flash device - jobs are written in chunks and read
+// back, a job isn't valid until it is completely written, slots are independent and persist
+// when the device is reopened and a stored job is played through JobFeeder (reading ahead from
+// the store as lines are taken) with the lines fed checked against the job
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "FlashDeviceFile.h"
+#include "JobFeeder.h"
+
+static int failCount = 0;
+static const char* FLASH_FILE_NAME = "TestJobStore.bin";
+static const uint32_t FLASH_SIZE = 256 * 1024;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static std::string makeJob(int numLines, int seed, std::vector<std::string>& lines)
+{
+  std::string job;
+  char line[60];
+  for (int i = 0; i < numLines; i++)
+  {
+    snprintf(line, sizeof(line), "G1 X%d.%02d Y%d.%02d", (i * seed) % 200, i % 100, (i * 7) % 200, (i * 3) % 100);
+    lines.push_back(line);
+    job += line;
+    job += (i % 5 == 0) ? "\r\n" : "\n";
+    if (i % 17 == 0)
+      job += "\n";
+  }
+  return job;
+}
+
+static bool storeJob(JobStore& jobStore, unsigned int slotIdx, const char* pName, const std::string& job, bool complete)
+{
+  if (!jobStore.startWrite(slotIdx, pName))
+    return false;
+  unsigned int pos = 0;
+  while (pos < job.length())
+  {
+    unsigned int chunkLen = std::min<unsigned int>(1 + rand() % 1500, job.length() - pos);
+    if (!jobStore.write(job.data() + pos, chunkLen))
+      return false;
+    pos += chunkLen;
+  }
+  return !complete || jobStore.endWrite();
+}
+
+static std::string readJob(JobStore& jobStore, unsigned int slotIdx)
+{
+  uint32_t jobLen = 0;
+  std::string job;
+  if (!jobStore.getJobInfo(slotIdx, NULL, 0, jobLen))
+    return job;
+  job.resize(jobLen);
+  for (uint32_t pos = 0; pos < jobLen; pos += 1000)
+  {
+    uint32_t len = std::min<uint32_t>(1000, jobLen - pos);
+    if (jobStore.read(slotIdx, pos, &job[pos], len) != len)
+      return "";
+  }
+  return job;
+}
+
+static void testStore()
+{
+  remove(FLASH_FILE_NAME);
+  FlashDeviceFile flash;
+  check(flash.open(FLASH_FILE_NAME, FLASH_SIZE), "open flash file");
+  JobStore jobStore;
+  check(!jobStore.setup(&flash, 0), "no slots rejected");
+  check(jobStore.setup(&flash, 4), "setup");
+  check(jobStore.getMaxJobBytes() == FLASH_SIZE / 4 - JobStore::HEADER_BYTES, "max job size");
+  uint32_t jobLen = 0;
+  check(!jobStore.getJobInfo(0, NULL, 0, jobLen), "erased slot is empty");
+
+  srand(5);
+  std::vector<std::string> lines0, lines1, lines2;
+  std::string job0 = makeJob(2000, 13, lines0);
+  std::string job1 = makeJob(1500, 11, lines1);
+  check(storeJob(jobStore, 0, "square", job0, true), "store job 0");
+  check(storeJob(jobStore, 1, "spiral \"big\"", job1, false), "store job 1 without end");
+  check(!jobStore.getJobInfo(1, NULL, 0, jobLen), "job not valid until end of write");
+  check(jobStore.endWrite(), "end job 1");
+  char nameStr[JobStore::MAX_NAME_LEN + 1];
+  check(jobStore.getJobInfo(1, nameStr, sizeof(nameStr), jobLen) && (jobLen == job1.length()), "job 1 info");
+  check(strcmp(nameStr, "spiral _big_") == 0, "name made safe for JSON");
+  check(readJob(jobStore, 0) == job0, "job 0 read back");
+  check(readJob(jobStore, 1) == job1, "job 1 read back");
+  check(jobStore.findJob("square") == 0, "find job by name");
+  check(jobStore.findJob("circle") < 0, "unknown job not found");
+
+  // Overwrite a slot with a shorter job - other slots unchanged
+  std::string job2 = makeJob(300, 3, lines2);
+  check(storeJob(jobStore, 0, "small", job2, true), "overwrite job 0");
+  check(readJob(jobStore, 0) == job2, "overwritten job read back");
+  check(readJob(jobStore, 1) == job1, "other slot unchanged");
+  check(jobStore.findJob("square") < 0, "old name gone");
+
+  // Too big for a slot
+  std::string bigJob(jobStore.getMaxJobBytes() + 1, 'G');
+  check(!storeJob(jobStore, 2, "big", bigJob, true), "job larger than slot refused");
+  check(!jobStore.isWriting() && !jobStore.endWrite(), "failed write abandoned");
+  check(!jobStore.getJobInfo(2, NULL, 0, jobLen), "slot empty after failed write");
+
+  // Persists when reopened
+  flash.close();
+  check(flash.open(FLASH_FILE_NAME, FLASH_SIZE) && jobStore.setup(&flash, 4), "reopen");
+  check(readJob(jobStore, 1) == job1, "job persists");
+  char listStr[500];
+  jobStore.getJobsJSON(listStr, sizeof(listStr));
+  check(strstr(listStr, "{\"slot\":1,\"name\":\"spiral _big_\"") != NULL, "job list");
+  printf("Job list %s\n", listStr);
+}
+
+static void testPlayback()
+{
+  FlashDeviceFile flash;
+  JobStore jobStore;
+  check(flash.open(FLASH_FILE_NAME, FLASH_SIZE) && jobStore.setup(&flash, 4), "open for playback");
+  std::vector<std::string> lines;
+  std::string job = makeJob(1500, 11, lines);
+  // Last line without terminator
+  job.erase(job.find_last_not_of("\r\n") + 1);
+  check(storeJob(jobStore, 3, "play", job, true), "store job to play");
+
+  JobFeeder feeder(1024);
+  check(!feeder.startStored(jobStore, 2), "empty slot can't be played");
+  check(feeder.startStored(jobStore, 3), "start stored job");
+  check(feeder.isStored(), "playing from store");
+  check(!feeder.append("G1 X1\n", 6, false), "no upload while playing from store");
+  check(feeder.getBufferFree() < JobFeeder::STORE_READ_CHUNK_BYTES, "buffer filled ahead at start");
+  unsigned int lineIdx = 0;
+  srand(9);
+  for (int iter = 0; (iter < 1000000) && (feeder.getState() != JobFeeder::JOB_DONE); iter++)
+  {
+    int numToTake = rand() % 4;
+    for (int i = 0; i < numToTake; i++)
+    {
+      unsigned int lineLen = 0;
+      const char* pLine = feeder.peekLine(lineLen);
+      if (!pLine)
+        break;
+      feeder.takeLine();
+      check(lineIdx < lines.size(), "not too many lines");
+      if (lineIdx < lines.size())
+        check((lines[lineIdx] == pLine) && (lineLen == lines[lineIdx].length()), "line matches job");
+      lineIdx++;
+    }
+  }
+  check(lineIdx == lines.size(), "all lines fed");
+  check(feeder.getState() == JobFeeder::JOB_DONE, "done at end");
+  char statusStr[200];
+  feeder.getStatusJSON(statusStr, sizeof(statusStr));
+  check(strstr(statusStr, "\"pct\":100") != NULL, "progress 100% at end");
+  check(strstr(statusStr, "\"src\":\"store\"") != NULL, "status shows stored job");
+  printf("Playback: %zu bytes, %u lines, status %s\n", job.length(), lineIdx, statusStr);
+
+  // Stop part way
+  check(feeder.startStored(jobStore, 3), "restart stored job");
+  unsigned int lineLen = 0;
+  for (int i = 0; i < 100; i++)
+    if (feeder.peekLine(lineLen))
+      feeder.takeLine();
+  feeder.stop();
+  check(feeder.peekLine(lineLen) == NULL, "no line after stop");
+  remove(FLASH_FILE_NAME);
+}
+
+int main()
+{
+  testStore();
+  testPlayback();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
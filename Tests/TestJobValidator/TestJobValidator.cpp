@@ -0,0 +1,356 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for JobValidator
+// Jobs are validated against the SandTableScara kinematics (as the robot does on the device) and
+// the results checked - first failing point, travel, bounding box, time-budgeted processing,
+// parsing (which is shared with the command interpreter) and patterns named in a job
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "application.h"
+#include "JobValidator.h"
+#include "SandTableScaraKinematics.h"
+
+// Geometry from the default SandTableScara config
+static const float UNITS_PER_ROT = 628.318f;
+static const float STEPS_PER_ROT = 9600;
+static const float MAX_RADIUS_MM = 185;
+// Table frame limits (points beyond are out of bounds before the kinematics are tried)
+static const float FRAME_MM = 195;
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Point checker using the kinematics and simulated step counts in the same way as the
+// MotionPointChecker used on the device
+class ScaraPointChecker
+{
+public:
+  SandTableScaraKinematics _kinematics;
+  int32_t _steps0, _steps1;
+  int _homeCount;
+
+  ScaraPointChecker()
+  {
+    _kinematics.setGeometry(UNITS_PER_ROT, UNITS_PER_ROT, STEPS_PER_ROT, STEPS_PER_ROT, true, MAX_RADIUS_MM);
+    _steps0 = _steps1 = 0;
+    _homeCount = 0;
+  }
+
+  JobValidatorStatus::PointResult checkPoint(const float pt[])
+  {
+    if (fabsf(pt[0]) > FRAME_MM || fabsf(pt[1]) > FRAME_MM)
+      return JobValidatorStatus::POINT_OUT_OF_BOUNDS;
+    float steps0 = 0, steps1 = 0;
+    if (_kinematics.ptToActuatorMinTravel(pt[0], pt[1], _steps0, _steps1, steps0, steps1) ==
+              SandTableScaraKinematics::ROTATION_OUT_OF_BOUNDS)
+      return JobValidatorStatus::POINT_UNREACHABLE;
+    _steps0 += int32_t(ceilf(steps0 - _steps0));
+    _steps1 += int32_t(ceilf(steps1 - _steps1));
+    _kinematics.correctStepOverflow(_steps0, _steps1);
+    return JobValidatorStatus::POINT_OK;
+  }
+
+  void goHome()
+  {
+    _steps0 = _steps1 = 0;
+    _homeCount++;
+  }
+
+  bool isPrimaryAxis(int axisIdx)
+  {
+    return axisIdx < 2;
+  }
+};
+
+// Simulated clock - advances on every read
+static uint32_t simMicrosVal = 0;
+static uint32_t simMicros()
+{
+  simMicrosVal += 10;
+  return simMicrosVal;
+}
+
+static const float ORIGIN[RobotConsts::MAX_AXES] = { 0 };
+
+// Pattern source with one pattern ("circle") - a circle of the radius set and a number of points
+// (or never stopping if numPts is 0)
+class CirclePatternSource : public JobValidatorPatternSource
+{
+public:
+  float _radius;
+  int _numPts;
+  int _ptIdx;
+  bool _running;
+  int _stopCount;
+
+  CirclePatternSource(float radius, int numPts)
+  {
+    _radius = radius;
+    _numPts = numPts;
+    _ptIdx = 0;
+    _running = false;
+    _stopCount = 0;
+  }
+
+  virtual bool startPattern(const char* pCmdStr)
+  {
+    if (strcmp(pCmdStr, "circle") != 0)
+      return false;
+    _ptIdx = 0;
+    _running = true;
+    return true;
+  }
+
+  virtual bool getPatternPoint(float& x, float& y)
+  {
+    if (!_running)
+      return false;
+    float ang = 2 * 3.14159265f * _ptIdx / (_numPts > 0 ? _numPts : 360);
+    x = _radius * sinf(ang);
+    y = _radius * cosf(ang);
+    _ptIdx++;
+    if ((_numPts > 0) && (_ptIdx > _numPts))
+      _running = false;
+    return true;
+  }
+
+  virtual void stopPattern()
+  {
+    _running = false;
+    _stopCount++;
+  }
+};
+
+// Circle of the given radius as G-code lines
+static std::string circleJob(float radius, int numPts, const char* pSep)
+{
+  std::string job = "G90";
+  char line[100];
+  for (int ptIdx = 0; ptIdx <= numPts; ptIdx++)
+  {
+    float ang = 2 * 3.14159265f * ptIdx / numPts;
+    snprintf(line, sizeof(line), "%sG1 X%0.3f Y%0.3f", pSep, radius * sinf(ang), radius * cosf(ang));
+    job += line;
+  }
+  return job;
+}
+
+static void testValidJob()
+{
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+  // Move out to the circle then go round it
+  std::string job = circleJob(100, 360, "\n");
+  JobValidatorStatus& status = validator.validate(job.c_str(), ORIGIN, ORIGIN, false);
+  check(status._state == JobValidatorStatus::STATE_PASSED, "circle job should pass");
+  check(status._linesChecked == 362, "circle job line count");
+  check(status._movesChecked == 361, "circle job move count");
+  float expectedTravel = 100 + 2 * 3.14159265f * 100;
+  check(fabsf(status._travelMM - expectedTravel) < expectedTravel * 0.001f, "circle job travel");
+  check(status._boundsValid, "circle job bounds valid");
+  check(fabsf(status._boundsMin[0] + 100) < 0.01f && fabsf(status._boundsMax[0] - 100) < 0.01f, "circle job X bounds");
+  check(fabsf(status._boundsMin[1] + 100) < 0.01f && fabsf(status._boundsMax[1] - 100) < 0.01f, "circle job Y bounds");
+  printf("Circle job: %d lines, %d moves, travel %0.2fmm (expected %0.2fmm)\n",
+         status._linesChecked, status._movesChecked, status._travelMM, expectedTravel);
+}
+
+static void testFirstFailure()
+{
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+  // Line 4 is beyond the arm reach but inside the frame, line 6 is beyond the frame
+  const char* pJob = "G90;G1 X10 Y10;G1 X50 Y0;G1 X0 Y190;G1 X0 Y0;G1 X300 Y0";
+  JobValidatorStatus& status = validator.validate(pJob, ORIGIN, ORIGIN, false);
+  check(status._state == JobValidatorStatus::STATE_FAILED, "unreachable job should fail");
+  check(status._failLineNum == 4, "unreachable job fail line");
+  check(status._failResult == JobValidatorStatus::POINT_UNREACHABLE, "unreachable job fail result");
+  check(status._failPt[0] == 0 && status._failPt[1] == 190, "unreachable job fail point");
+  check(status._linesChecked == 4, "unreachable job stops at first failure");
+
+  // Out of bounds
+  pJob = "G1 X10 Y10\r\nG1 X300 Y0\r\nG1 X0 Y0";
+  validator.validate(pJob, ORIGIN, ORIGIN, false);
+  check(status._state == JobValidatorStatus::STATE_FAILED, "out of bounds job should fail");
+  check(status._failLineNum == 2, "out of bounds job fail line");
+  check(status._failResult == JobValidatorStatus::POINT_OUT_OF_BOUNDS, "out of bounds job fail result");
+
+  char jsonStr[300];
+  status.toJSON(jsonStr, sizeof(jsonStr));
+  check(strstr(jsonStr, "\"failLine\":2") != NULL, "JSON contains fail line");
+  check(strstr(jsonStr, "\"fail\":\"outOfBounds\"") != NULL, "JSON contains fail reason");
+  printf("Out of bounds job: %s\n", jsonStr);
+}
+
+static void testModalState()
+{
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+  float homePos[RobotConsts::MAX_AXES] = { 0 };
+  homePos[1] = 20;
+  // Relative moves add up, G92 sets the position without moving and G28 goes home
+  const char* pJob = "G91;G1 X50;G1 X50;G1 Y-30;G92 X0 Y0;G1 X-20;G90;G28;G1 X0 Y0;M17;; G1 x5 y5";
+  JobValidatorStatus& status = validator.validate(pJob, ORIGIN, homePos, false);
+  check(status._state == JobValidatorStatus::STATE_PASSED, "modal job should pass");
+  check(status._movesChecked == 6, "modal job move count");
+  check(fabsf(status._boundsMax[0] - 100) < 0.001f, "relative moves accumulate");
+  check(fabsf(status._boundsMin[0] + 20) < 0.001f, "G92 sets position");
+  check(fabsf(status._boundsMin[1] + 30) < 0.001f, "relative Y move");
+  check(checker._homeCount == 1, "G28 resets checker to home");
+  // 50 + 50 + 30 + 20 + 20 (home to origin) + 7.07
+  float expectedTravel = 170 + sqrtf(50);
+  check(fabsf(status._travelMM - expectedTravel) < 0.01f, "modal job travel");
+
+  // Starting in relative mode from a non-zero position
+  float startPos[RobotConsts::MAX_AXES] = { 0 };
+  startPos[0] = 10;
+  validator.validate("G1 X10", startPos, homePos, true);
+  check(status._boundsMax[0] == 20 && status._boundsMin[0] == 20, "relative from start position");
+}
+
+static void testTimeBudget()
+{
+  std::string job = circleJob(150, 2000, ";");
+
+  // Whole job in one go for reference
+  ScaraPointChecker refChecker;
+  JobValidator<ScaraPointChecker> refValidator(refChecker, simMicros);
+  JobValidatorStatus refStatus = refValidator.validate(job.c_str(), ORIGIN, ORIGIN, false);
+
+  // Each line costs one clock read (10us) so a 200us budget is about 20 lines per call
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+  validator.start(job.c_str(), ORIGIN, ORIGIN, false);
+  int serviceCalls = 0;
+  int maxLinesPerCall = 0;
+  int prevLines = 0;
+  while (!validator.service(200))
+  {
+    serviceCalls++;
+    int linesThisCall = validator.getStatus()._linesChecked - prevLines;
+    prevLines = validator.getStatus()._linesChecked;
+    if (maxLinesPerCall < linesThisCall)
+      maxLinesPerCall = linesThisCall;
+    if (serviceCalls > 10000)
+      break;
+  }
+  JobValidatorStatus& status = validator.getStatus();
+  check(status._state == JobValidatorStatus::STATE_PASSED, "budgeted job should pass");
+  check(serviceCalls > 50, "budgeted job split over service calls");
+  check(maxLinesPerCall <= 20, "budget limits lines per service call");
+  check(status._linesChecked == refStatus._linesChecked, "budgeted job line count matches");
+  check(status._travelMM == refStatus._travelMM, "budgeted job travel matches");
+  check(checker._steps0 == refChecker._steps0 && checker._steps1 == refChecker._steps1, "budgeted job steps match");
+  printf("Budgeted job: %d lines over %d service calls (max %d lines per call), travel %0.1fmm\n",
+         status._linesChecked, serviceCalls + 1, maxLinesPerCall, status._travelMM);
+
+  // Stop part way
+  validator.start(job.c_str(), ORIGIN, ORIGIN, false);
+  validator.service(200);
+  validator.stop();
+  check(!validator.isRunning() && validator.service(200), "stopped validator doesn't run");
+  check(status._state == JobValidatorStatus::STATE_IDLE, "stopped validator is idle");
+}
+
+// Lines are parsed in the same way as by the command interpreter
+static void testParsing()
+{
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+  float homePos[RobotConsts::MAX_AXES] = { 0 };
+  homePos[0] = 20;
+  homePos[1] = 20;
+
+  // Bare axis letters on G28 home just those axes and comments are skipped (including axis letters)
+  const char* pJob = "G1 X50 Y50\nG28 X\nG1 (Cut X profile) Y-10\nM204 S100\ng1 x5 (Feed)";
+  JobValidatorStatus& status = validator.validate(pJob, ORIGIN, homePos, false);
+  check(status._state == JobValidatorStatus::STATE_PASSED, "parsing job should pass");
+  check(status._movesChecked == 3, "parsing job move count");
+  check(fabsf(status._boundsMin[1] + 10) < 0.001f, "move with comment parsed");
+  check(fabsf(status._boundsMin[0] - 5) < 0.001f, "lower case move parsed");
+  // 70.71 + 60 (Y from 50 to -10 as G28 X only homes X) + 15 (X from home at 20)
+  check(fabsf(status._travelMM - (sqrtf(5000) + 75)) < 0.01f, "G28 X only homes X");
+
+  // A G or M code which doesn't parse fails the job (it wouldn't be run)
+  pJob = "G1 X10\nG1 X--2 Y3\nG1 X0";
+  validator.validate(pJob, ORIGIN, homePos, false);
+  check(status._state == JobValidatorStatus::STATE_FAILED, "bad number fails");
+  check((status._failLineNum == 2) && (status._failResult == JobValidatorStatus::POINT_INVALID_COMMAND),
+        "bad number fail line and result");
+  char jsonStr[300];
+  status.toJSON(jsonStr, sizeof(jsonStr));
+  check(strstr(jsonStr, "\"fail\":\"invalidCommand\"") != NULL, "JSON contains invalid command");
+
+  // Other text is skipped
+  validator.validate("pause\nGo home\nG1 X10", ORIGIN, homePos, false);
+  check((status._state == JobValidatorStatus::STATE_PASSED) && (status._movesChecked == 1), "text lines skipped");
+}
+
+// Patterns named in a job are run and their points checked as the moves the pattern would send
+static void testPatterns()
+{
+  ScaraPointChecker checker;
+  JobValidator<ScaraPointChecker> validator(checker, simMicros);
+
+  // A pattern within reach - the lines after it are checked once it has finished
+  CirclePatternSource patternSource(100, 360);
+  const char* pJob = "G1 X0 Y0\ncircle\nG1 X0 Y0";
+  JobValidatorStatus& status = validator.validate(pJob, ORIGIN, ORIGIN, false, &patternSource);
+  check(status._state == JobValidatorStatus::STATE_PASSED, "pattern job should pass");
+  check(status._movesChecked == 363, "pattern points checked");
+  float expectedTravel = 200 + 2 * 3.14159265f * 100;
+  check(fabsf(status._travelMM - expectedTravel) < expectedTravel * 0.001f, "pattern travel");
+
+  // Without a pattern source the pattern name is skipped
+  validator.validate(pJob, ORIGIN, ORIGIN, false);
+  check((status._state == JobValidatorStatus::STATE_PASSED) && (status._movesChecked == 2), "pattern skipped without source");
+
+  // Pattern out of reach fails at the pattern's line
+  CirclePatternSource bigPatternSource(190, 360);
+  validator.validate("G1 X0 Y0\ncircle", ORIGIN, ORIGIN, false, &bigPatternSource);
+  check(status._state == JobValidatorStatus::STATE_FAILED, "unreachable pattern fails");
+  check((status._failLineNum == 2) && (status._failResult == JobValidatorStatus::POINT_UNREACHABLE),
+        "unreachable pattern fail line and result");
+  check(bigPatternSource._stopCount == 1, "failed pattern stopped");
+
+  // A pattern which never stops fails
+  CirclePatternSource endlessPatternSource(100, 0);
+  validator.validate("circle", ORIGIN, ORIGIN, false, &endlessPatternSource);
+  check((status._state == JobValidatorStatus::STATE_FAILED) &&
+        (status._failResult == JobValidatorStatus::POINT_PATTERN_UNBOUNDED), "unbounded pattern fails");
+
+  // Stopping the validator stops the pattern
+  CirclePatternSource stopPatternSource(100, 360);
+  validator.start("circle", ORIGIN, ORIGIN, false, &stopPatternSource);
+  validator.service(200);
+  validator.stop();
+  check(!stopPatternSource._running && (stopPatternSource._stopCount == 1), "pattern stopped with validator");
+}
+
+int main()
+{
+  testValidJob();
+  testFirstFailure();
+  testModalState();
+  testTimeBudget();
+  testParsing();
+  testPatterns();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,340 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test and benchmark for kinematics policies (KinematicsPolicy.h) - moves are split into
+// blocks by MotionHelper with the cartesian transforms given in three ways:
+// - as function pointers converting each block (robots without a batch transform)
+// - as function pointers with the batch transform (setTransforms with ptsToActuator)
+// - as a policy (setKinematics<CartesianKinematics>) where the blocks are stepped along the line
+//   in actuator coordinates with no conversion of each block
+// The planned blocks must be the same whichever way the transforms are given - except that
+// stepping along the line in actuator coordinates rounds differently so a step can move to the
+// next block
+// MotionHelper and MotionPlanner run unchanged against the host stubs with motion paused so the
+// planned blocks can be inspected
+
+#include <stdio.h>
+#include <chrono>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// 80 steps per mm with both axes bounded to 0..200mm
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":500,\"blockDistanceMM\":1.0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":100,\"maxAcc\":1000,\"stepsPerRot\":80,\"unitsPerRot\":1,\"minVal\":0,\"maxVal\":200,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":100,\"maxAcc\":1000,\"stepsPerRot\":80,\"unitsPerRot\":1,\"minVal\":0,\"maxVal\":200,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// As ROBOT_CONFIG but split into 0.05mm blocks for the benchmark
+static const char* BENCH_CONFIG =
+  "{\"pipelineLen\":250,\"blockDistanceMM\":0.05,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":100,\"maxAcc\":1000,\"stepsPerRot\":80,\"unitsPerRot\":1,\"minVal\":0,\"maxVal\":200,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":100,\"maxAcc\":1000,\"stepsPerRot\":80,\"unitsPerRot\":1,\"minVal\":0,\"maxVal\":200,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// The cartesian transforms as a policy which isn't linear on each axis - every block is converted
+// with the batch transform (as for SandTableScara)
+class NonLinearKinematics : public CartesianKinematics
+{
+public:
+  static constexpr bool IS_AXIS_LINEAR = false;
+};
+
+enum TransformsType
+{
+  TRANSFORMS_PER_POINT,
+  TRANSFORMS_BATCH,
+  TRANSFORMS_POLICY,
+  TRANSFORMS_POLICY_NON_LINEAR
+};
+
+static const char* TRANSFORMS_NAMES[] = { "per-point fn", "batch fn", "policy", "policy non-linear" };
+static const int NUM_TRANSFORMS_TYPES = 4;
+
+static void setTransforms(MotionHelper& motionHelper, TransformsType transformsType)
+{
+  switch (transformsType)
+  {
+  case TRANSFORMS_PER_POINT:
+    motionHelper.setTransforms(CartesianKinematics::ptToActuator, CartesianKinematics::actuatorToPt,
+                               CartesianKinematics::correctStepOverflow);
+    break;
+  case TRANSFORMS_BATCH:
+    motionHelper.setTransforms(CartesianKinematics::ptToActuator, CartesianKinematics::actuatorToPt,
+                               CartesianKinematics::correctStepOverflow, CartesianKinematics::ptsToActuator);
+    break;
+  case TRANSFORMS_POLICY:
+    motionHelper.setKinematics<CartesianKinematics>();
+    break;
+  case TRANSFORMS_POLICY_NON_LINEAR:
+    motionHelper.setKinematics<NonLinearKinematics>();
+    break;
+  }
+}
+
+// Move - motion is paused so service() only adds the blocks to the pipeline
+static bool moveTo(MotionHelper& motionHelper, float xMM, float yMM, bool allowOutOfBounds = false)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setAxisValMM(1, yMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  args.setFeedrate(50);
+  args.setAllowOutOfBounds(allowOutOfBounds);
+  if (!motionHelper.moveTo(args))
+    return false;
+  for (int i = 0; (i < 100000) && !motionHelper.canAccept(); i++)
+    motionHelper.service();
+  return true;
+}
+
+// Position (both axes) at the end of each planned block
+class PlannedSteps
+{
+public:
+  static const int MAX_BLOCKS = 500;
+  int _numBlocks;
+  int32_t _steps[MAX_BLOCKS][2];
+  int32_t _endSteps[2];
+
+  PlannedSteps(MotionHelper& motionHelper)
+  {
+    _numBlocks = motionHelper.testGetPipelineCount();
+    _endSteps[0] = _endSteps[1] = 0;
+    for (int blockIdx = 0; (blockIdx < _numBlocks) && (blockIdx < MAX_BLOCKS); blockIdx++)
+    {
+      MotionBlock block;
+      motionHelper.testGetPipelineBlock(blockIdx, block);
+      for (int axisIdx = 0; axisIdx < 2; axisIdx++)
+      {
+        _endSteps[axisIdx] += block._stepsTotalMaybeNeg[axisIdx];
+        _steps[blockIdx][axisIdx] = _endSteps[axisIdx];
+      }
+    }
+  }
+
+  // Same blocks with every block ending within maxStepsDiff of the other and the same end
+  bool isNear(const PlannedSteps& other, int32_t maxStepsDiff) const
+  {
+    if ((_numBlocks != other._numBlocks) || (_endSteps[0] != other._endSteps[0]) || (_endSteps[1] != other._endSteps[1]))
+      return false;
+    for (int blockIdx = 0; (blockIdx < _numBlocks) && (blockIdx < MAX_BLOCKS); blockIdx++)
+      if ((abs(_steps[blockIdx][0] - other._steps[blockIdx][0]) > maxStepsDiff) ||
+          (abs(_steps[blockIdx][1] - other._steps[blockIdx][1]) > maxStepsDiff))
+        return false;
+    return true;
+  }
+};
+
+// Steps a block can differ by from the per-point transform
+static int32_t maxStepsDiff(TransformsType transformsType)
+{
+  return (transformsType == TRANSFORMS_POLICY) ? 1 : 0;
+}
+
+// Moves within bounds - lines which don't divide into whole steps per block, a move back and
+// a move along one axis
+static void queueInBoundsMoves(MotionHelper& motionHelper)
+{
+  check(moveTo(motionHelper, 10, 10), "in bounds: move to start queued");
+  check(moveTo(motionHelper, 123.456f, 77.7f), "in bounds: diagonal queued");
+  check(moveTo(motionHelper, 3.3f, 150.05f), "in bounds: move back queued");
+  check(moveTo(motionHelper, 3.3f, 20), "in bounds: Y move queued");
+}
+
+// Moves which go out of bounds - the blocks beyond 200mm are brought in bounds unless out of
+// bounds is allowed
+static void queueOutOfBoundsMoves(MotionHelper& motionHelper)
+{
+  check(moveTo(motionHelper, 150, 100), "out of bounds: move to start queued");
+  check(moveTo(motionHelper, 250, 120), "out of bounds: move past X max queued");
+  check(moveTo(motionHelper, 150, 100), "out of bounds: move back queued");
+  check(moveTo(motionHelper, 210, 100, true), "out of bounds: allowed move queued");
+}
+
+static void testSameBlocks(const char* pName, void (*queueMoves)(MotionHelper&))
+{
+  MotionHelper perPointHelper;
+  setTransforms(perPointHelper, TRANSFORMS_PER_POINT);
+  perPointHelper.configure(ROBOT_CONFIG);
+  queueMoves(perPointHelper);
+  PlannedSteps perPoint(perPointHelper);
+  check(perPoint._numBlocks > 300, "moves split into blocks");
+  for (int transformsIdx = TRANSFORMS_BATCH; transformsIdx < NUM_TRANSFORMS_TYPES; transformsIdx++)
+  {
+    MotionHelper motionHelper;
+    setTransforms(motionHelper, TransformsType(transformsIdx));
+    motionHelper.configure(ROBOT_CONFIG);
+    queueMoves(motionHelper);
+    PlannedSteps planned(motionHelper);
+    if (!planned.isNear(perPoint, maxStepsDiff(TransformsType(transformsIdx))))
+    {
+      printf("FAIL %s: %s blocks differ from per-point (%d blocks to %ld,%ld vs %d blocks to %ld,%ld)\n",
+             pName, TRANSFORMS_NAMES[transformsIdx], planned._numBlocks, (long)planned._endSteps[0],
+             (long)planned._endSteps[1], perPoint._numBlocks, (long)perPoint._endSteps[0], (long)perPoint._endSteps[1]);
+      failCount++;
+    }
+  }
+}
+
+// The move past X max must stop at 200mm (16000 steps) and the allowed one reach 210mm
+static void testOutOfBoundsEnds()
+{
+  MotionHelper motionHelper;
+  setTransforms(motionHelper, TRANSFORMS_POLICY);
+  motionHelper.configure(ROBOT_CONFIG);
+  check(moveTo(motionHelper, 150, 100), "out of bounds ends: move to start queued");
+  check(moveTo(motionHelper, 250, 120), "out of bounds ends: move past X max queued");
+  PlannedSteps pastMax(motionHelper);
+  check(pastMax._endSteps[0] == 16000, "out of bounds ends: X brought in bounds");
+  check(pastMax._endSteps[1] == 9600, "out of bounds ends: Y reaches end");
+  check(moveTo(motionHelper, 210, 120, true), "out of bounds ends: allowed move queued");
+  PlannedSteps allowed(motionHelper);
+  check(allowed._endSteps[0] == 16800, "out of bounds ends: allowed move reaches end");
+}
+
+// Time to split a 10mm line into 200 blocks and plan them (end to end) and to convert the
+// blocks' destinations only - planning each block is far more work than converting it
+// The line starts from home so the pipeline only holds its blocks
+static const int BENCH_REPEATS = 5;
+static const int CONVERT_BLOCKS = 4000000;
+
+static double benchPlan(TransformsType transformsType, PlannedSteps*& pPlanned)
+{
+  double bestSecs = 1e9;
+  for (int repeatIdx = 0; repeatIdx < BENCH_REPEATS; repeatIdx++)
+  {
+    MotionHelper motionHelper;
+    setTransforms(motionHelper, transformsType);
+    motionHelper.configure(BENCH_CONFIG);
+    auto start = std::chrono::steady_clock::now();
+    moveTo(motionHelper, 8, 6);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (secs < bestSecs)
+      bestSecs = secs;
+    if (repeatIdx == 0)
+      pPlanned = new PlannedSteps(motionHelper);
+  }
+  return bestSecs;
+}
+
+static double benchConvert(TransformsType transformsType, AxesParams& axesParams, double& checksum)
+{
+  AxisFloats startPt(0, 0), endPt(8, 6);
+  AxisFloats deltaPt = (endPt - startPt) / float(CONVERT_BLOCKS);
+  AxisPosition curPos;
+  ptToActuatorFnType volatile ptToActuatorFn = CartesianKinematics::ptToActuator;
+  ptsToActuatorFnType volatile ptsToActuatorFn = CartesianKinematics::ptsToActuator;
+  AxisFloatsBatch pts, actuatorBatch;
+  AxisFloats pt, actuator, startActuator, endActuator, deltaActuator;
+  checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  switch (transformsType)
+  {
+  case TRANSFORMS_PER_POINT:
+    for (int blockIdx = 1; blockIdx <= CONVERT_BLOCKS; blockIdx++)
+    {
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        pt._pt[axisIdx] = startPt._pt[axisIdx] + deltaPt._pt[axisIdx] * float(blockIdx);
+      ptToActuatorFn(pt, actuator, curPos, axesParams, false);
+      checksum += actuator._pt[0] + actuator._pt[1];
+    }
+    break;
+  case TRANSFORMS_BATCH:
+  case TRANSFORMS_POLICY_NON_LINEAR:
+    for (int blockIdx = 1; blockIdx <= CONVERT_BLOCKS; blockIdx += AxisFloatsBatch::MAX_POINTS)
+    {
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+      {
+        float* pVals = pts.axisVals(axisIdx);
+        for (int ptIdx = 0; ptIdx < AxisFloatsBatch::MAX_POINTS; ptIdx++)
+          pVals[ptIdx] = startPt._pt[axisIdx] + deltaPt._pt[axisIdx] * float(blockIdx + ptIdx);
+      }
+      pts._count = AxisFloatsBatch::MAX_POINTS;
+      if (transformsType == TRANSFORMS_BATCH)
+        ptsToActuatorFn(pts, actuatorBatch, curPos, axesParams, false);
+      else
+        NonLinearKinematics::ptsToActuator(pts, actuatorBatch, curPos, axesParams, false);
+      for (int ptIdx = 0; ptIdx < AxisFloatsBatch::MAX_POINTS; ptIdx++)
+        checksum += actuatorBatch.axisVals(0)[ptIdx] + actuatorBatch.axisVals(1)[ptIdx];
+    }
+    break;
+  case TRANSFORMS_POLICY:
+    CartesianKinematics::ptToActuator(startPt, startActuator, curPos, axesParams, false);
+    CartesianKinematics::ptToActuator(endPt, endActuator, curPos, axesParams, false);
+    deltaActuator = (endActuator - startActuator) / float(CONVERT_BLOCKS);
+    for (int blockIdx = 1; blockIdx <= CONVERT_BLOCKS; blockIdx++)
+    {
+      for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+        actuator._pt[axisIdx] = startActuator._pt[axisIdx] + deltaActuator._pt[axisIdx] * float(blockIdx);
+      checksum += actuator._pt[0] + actuator._pt[1];
+    }
+    break;
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void testBenchmark()
+{
+  MotionHelper motionHelper;
+  motionHelper.configure(BENCH_CONFIG);
+  AxesParams& axesParams = motionHelper.getAxesParams();
+  PlannedSteps* pPlannedPerPoint = NULL;
+  // Untimed run first so the first variant timed isn't favoured (memory already in use)
+  benchPlan(TRANSFORMS_PER_POINT, pPlannedPerPoint);
+  delete pPlannedPerPoint;
+  double planSecsPerPoint = 0, convertSecsPerPoint = 0, checksumPerPoint = 0;
+  for (int transformsIdx = 0; transformsIdx < NUM_TRANSFORMS_TYPES; transformsIdx++)
+  {
+    PlannedSteps* pPlanned = NULL;
+    double planSecs = benchPlan(TransformsType(transformsIdx), pPlanned);
+    double checksum = 0;
+    double convertSecs = benchConvert(TransformsType(transformsIdx), axesParams, checksum);
+    if (transformsIdx == TRANSFORMS_PER_POINT)
+    {
+      pPlannedPerPoint = pPlanned;
+      planSecsPerPoint = planSecs;
+      convertSecsPerPoint = convertSecs;
+      checksumPerPoint = checksum;
+      check(pPlanned->_numBlocks >= 199, "benchmark: line split into blocks");
+    }
+    else
+    {
+      check(pPlanned->isNear(*pPlannedPerPoint, maxStepsDiff(TransformsType(transformsIdx))), "benchmark: blocks same as per-point");
+      // Different rounding of the blocks' actuator coordinates - well under a step per block
+      check(fabs(checksum - checksumPerPoint) < 0.01 * CONVERT_BLOCKS, "benchmark: conversions same as per-point");
+    }
+    printf("%-18s split and plan %8.0f blocks/s (%.2fx), convert only %11.0f blocks/s (%.2fx)\n",
+           TRANSFORMS_NAMES[transformsIdx], pPlanned->_numBlocks / planSecs, planSecsPerPoint / planSecs,
+           CONVERT_BLOCKS / convertSecs, convertSecsPerPoint / convertSecs);
+    if (pPlanned != pPlannedPerPoint)
+      delete pPlanned;
+  }
+  delete pPlannedPerPoint;
+}
+
+int main()
+{
+  testSameBlocks("in bounds", queueInBoundsMoves);
+  testSameBlocks("out of bounds", queueOutOfBoundsMoves);
+  testOutOfBoundsEnds();
+  testBenchmark();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
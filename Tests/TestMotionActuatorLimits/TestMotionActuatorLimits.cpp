@@ -0,0 +1,277 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for the planner's actuator space limits - the feedrate, acceleration and junction
+// speed of each block are limited so that no actuator exceeds its own max speed or acceleration
+// MotionHelper and MotionPlanner run unchanged against the host stubs with motion paused so the
+// planned blocks can be inspected
+
+#include <stdio.h>
+#include "application.h"
+#include "MotionHelper.h"
+#include "SandTableScaraKinematics.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Axes from the default SandTableScara config
+static const char* SCARA_CONFIG =
+  "{\"pipelineLen\":500,\"blockDistanceMM\":1.0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":75,\"maxAcc\":5,\"stepsPerRot\":9600,\"unitsPerRot\":628.318,\"maxVal\":185,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":75,\"maxAcc\":5,\"stepsPerRot\":9600,\"unitsPerRot\":628.318,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// Y axis with a lower acceleration than X (the master axis) and a Z axis which isn't a primary
+// axis (so it doesn't add to the path length)
+static const char* CARTESIAN_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":100,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"},"
+  "\"axis2\":{\"maxSpeed\":5,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"isPrimaryAxis\":0,\"stepPin\":\"D6\",\"dirnPin\":\"D7\"}}";
+
+static SandTableScaraKinematics scaraKinematics;
+
+// SandTableScara transforms (as RobotSandTableScara)
+static bool scaraPtToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                              bool allowOutOfBounds)
+{
+  SandTableScaraKinematics::ROTATION_TYPE rotationResult = scaraKinematics.ptToActuatorMinTravel(targetPt._pt[0], targetPt._pt[1],
+              curPos._stepsFromHome.getVal(0), curPos._stepsFromHome.getVal(1), outActuator._pt[0], outActuator._pt[1]);
+  return allowOutOfBounds || (rotationResult != SandTableScaraKinematics::ROTATION_OUT_OF_BOUNDS);
+}
+
+static void scaraActuatorToPt(AxisFloats& actuatorPos, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  float alphaDegs = 0, betaDegs = 0;
+  scaraKinematics.actuatorToRotation(int32_t(actuatorPos.getVal(0)), int32_t(actuatorPos.getVal(1)), alphaDegs, betaDegs);
+  scaraKinematics.rotationsToPoint(alphaDegs, betaDegs, outPt._pt[0], outPt._pt[1]);
+}
+
+static void scaraCorrectStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+// Move (feedrate in mm/s) - motion is paused so service() only adds the blocks to the pipeline
+static bool moveTo(MotionHelper& motionHelper, float xMM, float yMM, float zMM, float feedrate)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setAxisValMM(1, yMM, true);
+  args.setAxisValMM(2, zMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  args.setFeedrate(feedrate);
+  if (!motionHelper.moveTo(args))
+    return false;
+  for (int i = 0; (i < 10000) && !motionHelper.canAccept(); i++)
+    motionHelper.service();
+  return true;
+}
+
+static MotionBlock getBlock(MotionHelper& motionHelper, int blockIdx)
+{
+  MotionBlock block;
+  motionHelper.testGetPipelineBlock(blockIdx, block);
+  return block;
+}
+
+static bool isNear(float val, float expected)
+{
+  return fabsf(val - expected) < 0.001f * fabsf(expected) + 0.001f;
+}
+
+// Steps per second (and per second squared) of each actuator at the block's feedrate (and
+// acceleration) must be within the axis limits - the planner limits the unrounded steps so the
+// block's whole steps can be up to one more
+static bool isWithinActuatorLimits(MotionBlock& block, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    int32_t absSteps = block.getAbsStepsToTarget(axisIdx);
+    float stepsPerMM = ((absSteps > 0) ? absSteps - 1 : 0) / block._moveDistPrimaryAxesMM;
+    if (stepsPerMM * block._feedrateMMps > axesParams._maxStepRatesPerSec.getValNoCk(axisIdx) * 1.001f)
+      return false;
+    if (stepsPerMM * block._maxAccMMps2 > axesParams.getMaxAccStepsPerSec2(axisIdx) * 1.001f)
+      return false;
+  }
+  return true;
+}
+
+// Max junction speed from the junction deviation rule applied to the direction of motion of the
+// actuators (in their own units) - the planner uses unrounded steps so this is approximate
+static float actuatorJunctionSpeed(MotionBlock& prevBlock, MotionBlock& block, AxesParams& axesParams, float junctionDeviation)
+{
+  float prevVec[RobotConsts::MAX_AXES], vec[RobotConsts::MAX_AXES];
+  float prevLen = 0, len = 0, dot = 0;
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+  {
+    prevVec[axisIdx] = prevBlock._stepsTotalMaybeNeg[axisIdx] * axesParams.getStepDistMM(axisIdx) / prevBlock._moveDistPrimaryAxesMM;
+    vec[axisIdx] = block._stepsTotalMaybeNeg[axisIdx] * axesParams.getStepDistMM(axisIdx) / block._moveDistPrimaryAxesMM;
+    prevLen += prevVec[axisIdx] * prevVec[axisIdx];
+    len += vec[axisIdx] * vec[axisIdx];
+    dot += prevVec[axisIdx] * vec[axisIdx];
+  }
+  prevLen = sqrtf(prevLen);
+  len = sqrtf(len);
+  float cosTheta = -dot / (prevLen * len);
+  if (cosTheta >= 0.95f)
+    return 0;
+  if (cosTheta <= -0.95f)
+    return 1e8;
+  float sinThetaD2 = sqrtf(0.5f * (1.0f - cosTheta));
+  return sqrtf(axesParams._masterAxisMaxAccMMps2 * junctionDeviation * sinThetaD2 / (1.0f - sinThetaD2)) / fmaxf(prevLen, len);
+}
+
+static void setupScara(MotionHelper& motionHelper)
+{
+  motionHelper.setTransforms(scaraPtToActuator, scaraActuatorToPt, scaraCorrectStepOverflow);
+  motionHelper.configure(SCARA_CONFIG);
+  AxesParams& axesParams = motionHelper.getAxesParams();
+  scaraKinematics.setGeometry(axesParams.getunitsPerRot(0), axesParams.getunitsPerRot(1),
+              axesParams.getstepsPerRot(0), axesParams.getstepsPerRot(1), true, 185);
+}
+
+// Blocks of a line across a SandTableScara (split into 1mm blocks) at 40mm/s
+class ScaraLine
+{
+public:
+  float _minFeedrate, _minOuterFeedrate, _minEntrySpeed;
+  bool _withinLimits, _withinJunctionLimits;
+  int _actuatorLimitedJunctions;
+
+  ScaraLine(MotionHelper& motionHelper, float yMM)
+  {
+    _minFeedrate = _minOuterFeedrate = _minEntrySpeed = 1e8;
+    _withinLimits = _withinJunctionLimits = true;
+    _actuatorLimitedJunctions = 0;
+    AxesParams& axesParams = motionHelper.getAxesParams();
+    check(moveTo(motionHelper, -50, yMM, 0, 40), "scara: move to start queued");
+    int firstBlockIdx = motionHelper.testGetPipelineCount();
+    check(moveTo(motionHelper, 50, yMM, 0, 40), "scara: line queued");
+    int lastBlockIdx = motionHelper.testGetPipelineCount() - 1;
+    check(lastBlockIdx - firstBlockIdx >= 90, "scara: line split into blocks");
+    for (int blockIdx = firstBlockIdx; blockIdx <= lastBlockIdx; blockIdx++)
+    {
+      MotionBlock block = getBlock(motionHelper, blockIdx);
+      if (!isWithinActuatorLimits(block, axesParams))
+        _withinLimits = false;
+      // Blocks more than 20mm from the centre
+      if (abs(blockIdx - (firstBlockIdx + lastBlockIdx) / 2) > 20)
+        _minOuterFeedrate = fminf(_minOuterFeedrate, block._feedrateMMps);
+      _minFeedrate = fminf(_minFeedrate, block._feedrateMMps);
+      check(block._maxEntrySpeedMMps <= block._feedrateMMps * 1.001f, "scara: entry speed within feedrate");
+      check(block._maxAccMMps2 > 0, "scara: acceleration not zero");
+      if (blockIdx == firstBlockIdx)
+        continue;
+      // The line is straight so any limit at a junction comes from the actuators
+      _minEntrySpeed = fminf(_minEntrySpeed, block._maxEntrySpeedMMps);
+      MotionBlock prevBlock = getBlock(motionHelper, blockIdx - 1);
+      float junctionSpeed = actuatorJunctionSpeed(prevBlock, block, axesParams, 0.05f);
+      if (block._maxEntrySpeedMMps > junctionSpeed * 1.05f + 0.01f)
+        _withinJunctionLimits = false;
+      if (block._maxEntrySpeedMMps < fminf(prevBlock._feedrateMMps, block._feedrateMMps) * 0.99f)
+        _actuatorLimitedJunctions++;
+    }
+    printf("SandTableScara line at y=%0.1fmm: feedrate %0.2fmm/s away from centre, min %0.2fmm/s, min junction %0.2fmm/s, "
+           "%d junctions limited by the actuators\n",
+           yMM, _minOuterFeedrate, _minFeedrate, _minEntrySpeed, _actuatorLimitedJunctions);
+  }
+};
+
+// A line passing close to the centre of a SandTableScara - the arms turn fastest near the centre
+// so only the blocks there are slowed and every block keeps the actuators within their limits
+static void testScaraNearCentre()
+{
+  MotionHelper motionHelper;
+  setupScara(motionHelper);
+  ScaraLine line(motionHelper, 0.5f);
+  check(line._withinLimits, "near centre: actuators within max speed and acceleration");
+  check(line._withinJunctionLimits, "near centre: junction speeds within actuator junction deviation");
+  check(isNear(line._minOuterFeedrate, 40), "near centre: full feedrate away from centre");
+  check(line._minFeedrate < 20, "near centre: slowed near centre");
+}
+
+// A line through the centre - the blocks all keep the feedrate but the actuators change direction
+// sharply at the centre so the junctions there are slowed
+static void testScaraThroughCentre()
+{
+  MotionHelper motionHelper;
+  setupScara(motionHelper);
+  ScaraLine line(motionHelper, 0);
+  check(line._withinLimits, "through centre: actuators within max speed and acceleration");
+  check(line._withinJunctionLimits, "through centre: junction speeds within actuator junction deviation");
+  check(isNear(line._minFeedrate, 40), "through centre: full feedrate");
+  check(line._actuatorLimitedJunctions > 0, "through centre: junctions at centre limited by the actuators");
+  check(line._minEntrySpeed < 5, "through centre: slow junction at centre");
+}
+
+// On cartesian robots an axis with a lower acceleration than the master axis limits the
+// acceleration of moves which use it
+static void testCartesianAxisAcc()
+{
+  MotionHelper motionHelper;
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(CARTESIAN_CONFIG);
+  check(moveTo(motionHelper, 10, 0, 0, 20), "cartesian: X move queued");
+  check(moveTo(motionHelper, 10, 10, 0, 20), "cartesian: Y move queued");
+  check(moveTo(motionHelper, 20, 20, 0, 20), "cartesian: diagonal move queued");
+  check(isNear(getBlock(motionHelper, 0)._maxAccMMps2, 500), "cartesian: X move at X acceleration");
+  check(isNear(getBlock(motionHelper, 1)._maxAccMMps2, 100), "cartesian: Y move at Y acceleration");
+  check(isNear(getBlock(motionHelper, 2)._maxAccMMps2, 100 / sqrtf(0.5f)), "cartesian: diagonal move limited by Y");
+}
+
+// A non-primary axis limits the feedrate of moves which use it (but doesn't add to the path)
+static void testCartesianNonPrimaryAxis()
+{
+  MotionHelper motionHelper;
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(CARTESIAN_CONFIG);
+  check(moveTo(motionHelper, 10, 0, 10, 20), "non-primary: move queued");
+  MotionBlock block = getBlock(motionHelper, 0);
+  check(isNear(block._moveDistPrimaryAxesMM, 10), "non-primary: path length of primary axes");
+  check(isNear(block._feedrateMMps, 5), "non-primary: feedrate limited by Z");
+  check(moveTo(motionHelper, 20, 0, 10, 20), "non-primary: X move queued");
+  check(isNear(getBlock(motionHelper, 1)._feedrateMMps, 20), "non-primary: X move at requested feedrate");
+}
+
+int main()
+{
+  testScaraNearCentre();
+  testScaraThroughCentre();
+  testCartesianAxisAcc();
+  testCartesianNonPrimaryAxis();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
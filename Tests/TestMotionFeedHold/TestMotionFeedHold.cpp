@@ -0,0 +1,273 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for feed hold (pause) and resume - MotionHelper, MotionPlanner and MotionActuator run
+// unchanged against the host stubs with the actuator ticked from service() and the step pulses
+// counted so that the speed can be followed through the hold and no steps are lost or added
+
+#include <stdio.h>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// 100 steps per mm, 50mm/s (5000 steps/s) and 500mm/s^2 - stopping from full speed takes 250 steps
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+static const int32_t FULL_SPEED_STOP_STEPS = 250;
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+static bool moveXY(MotionHelper& motionHelper, float xMM, float yMM)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setAxisValMM(1, yMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  return motionHelper.moveTo(args);
+}
+
+// Step pulses on both axes - the interval (in ticks) between pulses gives the speed along the path
+class StepMonitor
+{
+public:
+  int32_t _steps[2];
+  int _lastEdges[2];
+  uint32_t _tick;
+  uint32_t _lastStepTick;
+  uint32_t _lastInterval;
+  uint32_t _stepsCounted;
+  bool _speedIncreased;
+
+  StepMonitor()
+  {
+    for (int i = 0; i < 2; i++)
+      _steps[i] = 0;
+    _lastEdges[0] = HostPins::risingEdges()[D2];
+    _lastEdges[1] = HostPins::risingEdges()[D4];
+    _tick = 0;
+    _lastStepTick = 0;
+    _lastInterval = 0;
+    _stepsCounted = 0;
+    _speedIncreased = false;
+  }
+
+  // Start checking that the speed doesn't increase
+  void startHold()
+  {
+    _stepsCounted = 0;
+    _speedIncreased = false;
+    _lastInterval = 0;
+  }
+
+  // Returns true if a step pulse was seen - a gap of one tick less than before is accumulator jitter
+  bool tick(MotionHelper& motionHelper)
+  {
+    motionHelper.service();
+    HostClock::advanceUs(MotionBlock::TICK_INTERVAL_NS / 1000);
+    _tick++;
+    bool stepped = false;
+    const int edgePins[2] = { D2, D4 };
+    const int dirnPins[2] = { D3, D5 };
+    for (int axisIdx = 0; axisIdx < 2; axisIdx++)
+    {
+      int edges = HostPins::risingEdges()[edgePins[axisIdx]];
+      if (edges == _lastEdges[axisIdx])
+        continue;
+      _steps[axisIdx] += (edges - _lastEdges[axisIdx]) * (HostPins::levels()[dirnPins[axisIdx]] ? -1 : 1);
+      _lastEdges[axisIdx] = edges;
+      stepped = true;
+    }
+    if (stepped)
+    {
+      uint32_t interval = _tick - _lastStepTick;
+      if ((_stepsCounted > 0) && (_lastInterval > 0) && (interval + 1 < _lastInterval))
+        _speedIncreased = true;
+      if (_stepsCounted > 0)
+        _lastInterval = interval;
+      _lastStepTick = _tick;
+      _stepsCounted++;
+    }
+    return stepped;
+  }
+
+  // Tick until no steps have been seen for a while (or the pipeline empties)
+  void runUntilStill(MotionHelper& motionHelper)
+  {
+    uint32_t quietTicks = 0;
+    for (int ticks = 0; (ticks < 1000000) && (quietTicks < 5000); ticks++)
+    {
+      if (tick(motionHelper))
+        quietTicks = 0;
+      else
+        quietTicks++;
+    }
+  }
+
+  void runUntilStepsX(MotionHelper& motionHelper, int32_t stepsX)
+  {
+    for (int ticks = 0; (ticks < 1000000) && (_steps[0] < stepsX); ticks++)
+      tick(motionHelper);
+  }
+
+  void runToIdle(MotionHelper& motionHelper)
+  {
+    for (int ticks = 0; (ticks < 1000000) && !motionHelper.isIdle(); ticks++)
+      tick(motionHelper);
+    for (int i = 0; i < 100; i++)
+      tick(motionHelper);
+  }
+};
+
+static int32_t liveSteps(MotionHelper& motionHelper, int axisIdx)
+{
+  return motionHelper.getLivePosition()._stepsFromHome.getVal(axisIdx);
+}
+
+static void setup(MotionHelper& motionHelper)
+{
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(ROBOT_CONFIG);
+  motionHelper.pause(false);
+}
+
+// Hold while cruising - decelerates at max acceleration, waits and then the rest of the block is
+// replanned from a standstill
+static void testHoldMidBlock()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  StepMonitor monitor;
+  check(moveXY(motionHelper, 100, 0), "move queued");
+  monitor.runUntilStepsX(motionHelper, 5000);
+  motionHelper.pause(true);
+  int32_t holdSteps = monitor._steps[0];
+  monitor.startHold();
+  monitor.runUntilStill(motionHelper);
+  int32_t stopSteps = monitor._steps[0] - holdSteps;
+  printf("Hold mid-block: stopped in %d steps\n", stopSteps);
+  check(!monitor._speedIncreased, "mid-block: no speed increase during hold");
+  check((stopSteps >= FULL_SPEED_STOP_STEPS - 10) && (stopSteps <= FULL_SPEED_STOP_STEPS + 20), "mid-block: stop distance");
+  check(liveSteps(motionHelper, 0) == monitor._steps[0], "mid-block: live position is the stop point");
+  check(motionHelper.testGetPipelineCount() == 1, "mid-block: block kept while held");
+
+  // Resume - the block is trimmed to the remaining steps and replanned from rest
+  motionHelper.pause(false);
+  MotionBlock block;
+  check(motionHelper.testGetPipelineBlock(0, block), "mid-block: block after resume");
+  check(block._stepsTotalMaybeNeg[0] == 10000 - monitor._steps[0], "mid-block: block trimmed to remaining steps");
+  check(block._entrySpeedMMps == 0, "mid-block: resumed block starts from rest");
+  check(block._canExecute, "mid-block: resumed block can execute");
+  monitor.runToIdle(motionHelper);
+  check((monitor._steps[0] == 10000) && (liveSteps(motionHelper, 0) == 10000), "mid-block: completes at target");
+}
+
+// Hold while accelerating - the speed doesn't increase after the hold and it stops quickly
+static void testHoldAccelerating()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  StepMonitor monitor;
+  check(moveXY(motionHelper, 100, 0), "accel: move queued");
+  monitor.runUntilStepsX(motionHelper, 60);
+  motionHelper.pause(true);
+  int32_t holdSteps = monitor._steps[0];
+  monitor.startHold();
+  monitor.runUntilStill(motionHelper);
+  int32_t stopSteps = monitor._steps[0] - holdSteps;
+  printf("Hold accelerating: held at %d steps, stopped in %d steps\n", holdSteps, stopSteps);
+  check(!monitor._speedIncreased, "accel: no speed increase during hold");
+  // Speed at the hold is about that reached after 60 steps of acceleration so stopping takes about as many
+  check(stopSteps <= 80, "accel: stop distance");
+  motionHelper.pause(false);
+  monitor.runToIdle(motionHelper);
+  check((monitor._steps[0] == 10000) && (liveSteps(motionHelper, 0) == 10000), "accel: completes at target");
+}
+
+// Hold while decelerating into a corner - the hold carries on decelerating into the next block if
+// needed and both blocks complete after resume
+static void testHoldDeceleratingIntoCorner()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  StepMonitor monitor;
+  check(moveXY(motionHelper, 20, 0) && moveXY(motionHelper, 20, 20), "corner: moves queued");
+  // Deceleration for the corner starts about 250 steps before it
+  monitor.runUntilStepsX(motionHelper, 1900);
+  motionHelper.pause(true);
+  monitor.startHold();
+  monitor.runUntilStill(motionHelper);
+  printf("Hold decelerating into corner: stopped at %d,%d\n", monitor._steps[0], monitor._steps[1]);
+  check(!monitor._speedIncreased, "corner: no speed increase during hold");
+  check((liveSteps(motionHelper, 0) == monitor._steps[0]) && (liveSteps(motionHelper, 1) == monitor._steps[1]),
+        "corner: live position is the stop point");
+  motionHelper.pause(false);
+  monitor.runToIdle(motionHelper);
+  check((monitor._steps[0] == 2000) && (monitor._steps[1] == 2000), "corner: axes at target");
+  check((liveSteps(motionHelper, 0) == 2000) && (liveSteps(motionHelper, 1) == 2000), "corner: live position at target");
+}
+
+// Hold while decelerating at the end of the last block - the block may complete before the hold
+// has stopped and resume then has nothing left to do
+static void testHoldDeceleratingAtEnd()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  StepMonitor monitor;
+  check(moveXY(motionHelper, 10, 0), "end: move queued");
+  monitor.runUntilStepsX(motionHelper, 900);
+  motionHelper.pause(true);
+  monitor.startHold();
+  monitor.runUntilStill(motionHelper);
+  check(!monitor._speedIncreased, "end: no speed increase during hold");
+  check(monitor._steps[0] <= 1000, "end: no overshoot");
+  motionHelper.pause(false);
+  monitor.runToIdle(motionHelper);
+  check((monitor._steps[0] == 1000) && (liveSteps(motionHelper, 0) == 1000), "end: completes at target");
+  check(motionHelper.testGetPipelineCount() == 0, "end: pipeline empty");
+}
+
+int main()
+{
+  testHoldMidBlock();
+  testHoldAccelerating();
+  testHoldDeceleratingIntoCorner();
+  testHoldDeceleratingAtEnd();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,273 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for correcting the step counts from home sensor edges seen during motion - the axis
+// is simulated by counting step pulses (so steps can be lost) and the home sensor is driven from
+// the simulated position while MotionHelper, MotionPlanner and MotionActuator run unchanged
+// against the host stubs with the actuator ticked from service()
+
+#include <stdio.h>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Sensor edge expected at 500 steps moving positive (maxSteps limits a correction to 20 steps)
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"homingSeq\":\"$\",\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\","
+  "\"homeSyncSteps\":500,\"homeSyncDirn\":1,\"homeSyncMaxSteps\":20,"
+  "\"endStop0\":{\"sensePin\":\"A6\",\"actLvl\":1}},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// Same with the edge expected moving negative
+static const char* ROBOT_CONFIG_NEG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"homingSeq\":\"$\",\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\","
+  "\"homeSyncSteps\":500,\"homeSyncDirn\":-1,\"homeSyncMaxSteps\":20,"
+  "\"endStop0\":{\"sensePin\":\"A6\",\"actLvl\":1}},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+// Simulated X axis - the position is changed by step pulses only (the direction pin is low for
+// positive steps) and the home sensor is active at and beyond the sensor position (in the
+// sensor's active direction)
+class SimAxis
+{
+public:
+  int32_t _physSteps;
+  int32_t _sensorSteps;
+  int _sensorDirn;
+  int _lastEdges;
+
+  SimAxis(int32_t physSteps, int32_t sensorSteps, int sensorDirn)
+  {
+    _physSteps = physSteps;
+    _sensorSteps = sensorSteps;
+    _sensorDirn = sensorDirn;
+    _lastEdges = HostPins::risingEdges()[D2];
+    updateSensor();
+  }
+
+  void update()
+  {
+    int edges = HostPins::risingEdges()[D2];
+    _physSteps += (edges - _lastEdges) * (HostPins::levels()[D3] ? -1 : 1);
+    _lastEdges = edges;
+    updateSensor();
+  }
+
+  void updateSensor()
+  {
+    bool active = (_sensorDirn > 0) ? (_physSteps >= _sensorSteps) : (_physSteps <= _sensorSteps);
+    HostPins::levels()[A6] = active ? 1 : 0;
+  }
+};
+
+static bool moveX(MotionHelper& motionHelper, float xMM)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  return motionHelper.moveTo(args);
+}
+
+static int32_t liveStepsX(MotionHelper& motionHelper)
+{
+  return motionHelper.getLivePosition()._stepsFromHome.getVal(0);
+}
+
+// Run until the pipeline is empty (one actuator tick per service call)
+static void runToIdle(MotionHelper& motionHelper, SimAxis& axis)
+{
+  for (int ticks = 0; (ticks < 1000000) && !motionHelper.isIdle(); ticks++)
+  {
+    motionHelper.service();
+    axis.update();
+    HostClock::advanceUs(MotionBlock::TICK_INTERVAL_NS / 1000);
+  }
+  for (int i = 0; i < 10; i++)
+    motionHelper.service();
+  check(motionHelper.isIdle(), "motion complete");
+}
+
+static void setupHomed(MotionHelper& motionHelper, const char* pConfig)
+{
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  HostPins::levels()[A6] = 0;
+  motionHelper.configure(pConfig);
+  RobotCommandArgs homeArgs;
+  motionHelper.goHome(homeArgs);
+  motionHelper.service();
+  motionHelper.pause(false);
+}
+
+// Steps lost before the sensor are corrected at the edge and the count then matches the axis
+static void testCorrection()
+{
+  MotionHelper motionHelper;
+  setupHomed(motionHelper, ROBOT_CONFIG);
+  // 7 steps lost
+  SimAxis axis(-7, 500, 1);
+  check(moveX(motionHelper, 10), "move queued");
+  runToIdle(motionHelper, axis);
+  check(axis._physSteps == 993, "axis 7 steps short");
+  check(liveStepsX(motionHelper) == axis._physSteps, "count corrected to axis position");
+
+  // The next move is planned from the corrected position
+  check(moveX(motionHelper, 0), "move back queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == 0) && (liveStepsX(motionHelper) == 0), "back at zero");
+
+  // No correction when the count is right and edges moving the other way are ignored
+  check(moveX(motionHelper, 10), "move queued again");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == 1000) && (liveStepsX(motionHelper) == 1000), "no correction when count is right");
+  axis._physSteps -= 3;
+  check(moveX(motionHelper, 0), "negative move queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == -3) && (liveStepsX(motionHelper) == 0), "no correction moving away from the sensor");
+}
+
+// Corrections are limited to homeSyncMaxSteps per edge
+static void testMaxCorrection()
+{
+  MotionHelper motionHelper;
+  setupHomed(motionHelper, ROBOT_CONFIG);
+  SimAxis axis(-50, 500, 1);
+  check(moveX(motionHelper, 10), "move queued");
+  runToIdle(motionHelper, axis);
+  check(liveStepsX(motionHelper) == 1000 - 20, "correction limited to max steps");
+}
+
+// Edges before homing are ignored
+static void testNotHomed()
+{
+  MotionHelper motionHelper;
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  HostPins::levels()[A6] = 0;
+  motionHelper.configure(ROBOT_CONFIG);
+  motionHelper.pause(false);
+  SimAxis axis(-7, 500, 1);
+  check(moveX(motionHelper, 10), "move queued");
+  runToIdle(motionHelper, axis);
+  check(liveStepsX(motionHelper) == 1000, "no correction before homing");
+}
+
+// All moves are queued before the first edge so the correction waits (in the planner) to be
+// carried to the actuator - the second edge is seen before that and mustn't be corrected again
+static void testNoDoubleCorrection()
+{
+  MotionHelper motionHelper;
+  setupHomed(motionHelper, ROBOT_CONFIG);
+  SimAxis axis(-7, 500, 1);
+  check(moveX(motionHelper, 10) && moveX(motionHelper, 0) && moveX(motionHelper, 10), "moves queued");
+  runToIdle(motionHelper, axis);
+  check(axis._physSteps == 993, "axis 7 steps short");
+  check(liveStepsX(motionHelper) == axis._physSteps, "corrected once");
+
+  // Once the correction has reached the actuator the next edge is used
+  axis._physSteps -= 4;
+  check(moveX(motionHelper, 0) && moveX(motionHelper, 10), "moves queued again");
+  runToIdle(motionHelper, axis);
+  check(liveStepsX(motionHelper) == axis._physSteps, "later edge corrected");
+}
+
+// Home is set at the end of a queued move - an edge seen during that move is in the old frame
+// and mustn't be compared with the expected count (which is in the new frame)
+static void testPendingHomeRebase()
+{
+  MotionHelper motionHelper;
+  setupHomed(motionHelper, ROBOT_CONFIG_NEG);
+  // Sensor 500 steps from the new home which is at -2000 in the current frame
+  SimAxis axis(0, -1500, -1);
+  check(moveX(motionHelper, -20), "move queued");
+  motionHelper.setCurPositionAsHome(0);
+  runToIdle(motionHelper, axis);
+  check(axis._physSteps == -2000, "axis at new home");
+  check(liveStepsX(motionHelper) == 0, "home set and no correction from old frame edge");
+
+  // Moving back over the sensor in the new frame is consistent
+  check(moveX(motionHelper, 10), "move queued");
+  runToIdle(motionHelper, axis);
+  check(moveX(motionHelper, 0), "move back over sensor queued");
+  runToIdle(motionHelper, axis);
+  check(liveStepsX(motionHelper) == 0, "no correction in new frame");
+}
+
+// Stopped while home being set is still waiting to reach the actuator - the change is applied on
+// stop so the counts are consistent again and the next edge is corrected
+static void testStopWithRebasePending()
+{
+  MotionHelper motionHelper;
+  setupHomed(motionHelper, ROBOT_CONFIG);
+  // Home will be set at 2000 steps so the sensor is 20 steps before 500 in the new frame
+  SimAxis axis(0, 2480, 1);
+  check(moveX(motionHelper, 20), "move queued");
+  motionHelper.setCurPositionAsHome(0);
+  check(moveX(motionHelper, 10), "move after home set queued");
+  for (int ticks = 0; (ticks < 1000000) && (axis._physSteps < 300); ticks++)
+  {
+    motionHelper.service();
+    axis.update();
+    HostClock::advanceUs(MotionBlock::TICK_INTERVAL_NS / 1000);
+  }
+  motionHelper.stop();
+  check(liveStepsX(motionHelper) == axis._physSteps - 2000, "home set applied on stop");
+
+  // Over the sensor in the new frame
+  check(moveX(motionHelper, 10), "move over sensor queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == 3000) && (liveStepsX(motionHelper) == 1020), "edge corrected after stop");
+
+  // The next move is planned from the corrected position
+  check(moveX(motionHelper, 0), "move home queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == 1980) && (liveStepsX(motionHelper) == 0), "at corrected home");
+}
+
+int main()
+{
+  testCorrection();
+  testMaxCorrection();
+  testNotHomed();
+  testNoDoubleCorrection();
+  testPendingHomeRebase();
+  testStopWithRebasePending();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,215 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for the live position and for changes to the step counts (home being set) carried to
+// the actuator in the blocks - MotionHelper, MotionPlanner and MotionActuator run unchanged against
+// the host stubs with the actuator ticked from service() and the step pulses counted so the live
+// position can be compared with where the axis actually is
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// The live position is recalculated at most once per ms - at full speed (5000 steps/s) that is 5 steps
+static const int32_t MAX_LIVE_LAG_STEPS = 5;
+
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+// Simulated X axis - the position is changed by step pulses only (the direction pin is low for
+// positive steps)
+class SimAxis
+{
+public:
+  int32_t _physSteps;
+  int _lastEdges;
+
+  SimAxis()
+  {
+    _physSteps = 0;
+    _lastEdges = HostPins::risingEdges()[D2];
+  }
+
+  void update()
+  {
+    int edges = HostPins::risingEdges()[D2];
+    _physSteps += (edges - _lastEdges) * (HostPins::levels()[D3] ? -1 : 1);
+    _lastEdges = edges;
+  }
+};
+
+static bool moveX(MotionHelper& motionHelper, float xMM)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  return motionHelper.moveTo(args);
+}
+
+static int32_t liveStepsX(MotionHelper& motionHelper)
+{
+  return motionHelper.getLivePosition()._stepsFromHome.getVal(0);
+}
+
+// One actuator tick per service call (20us)
+static void tick(MotionHelper& motionHelper, SimAxis& axis)
+{
+  motionHelper.service();
+  axis.update();
+  HostClock::advanceUs(MotionBlock::TICK_INTERVAL_NS / 1000);
+}
+
+static void runToIdle(MotionHelper& motionHelper, SimAxis& axis)
+{
+  for (int ticks = 0; (ticks < 1000000) && !motionHelper.isIdle(); ticks++)
+    tick(motionHelper, axis);
+  for (int i = 0; i < 10; i++)
+    tick(motionHelper, axis);
+  check(motionHelper.isIdle(), "motion complete");
+}
+
+static void setup(MotionHelper& motionHelper)
+{
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(ROBOT_CONFIG);
+  motionHelper.pause(false);
+}
+
+// The live position follows the axis during the move (the planned position is already at the end)
+static void testLivePosition()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  SimAxis axis;
+  check(moveX(motionHelper, 10), "move queued");
+  bool liveMatches = true, sawMidMove = false;
+  for (int ticks = 0; (ticks < 1000000) && !motionHelper.isIdle(); ticks++)
+  {
+    tick(motionHelper, axis);
+    if (abs(liveStepsX(motionHelper) - axis._physSteps) > MAX_LIVE_LAG_STEPS)
+      liveMatches = false;
+    if ((axis._physSteps > 400) && (axis._physSteps < 600))
+    {
+      RobotCommandArgs status;
+      motionHelper.getCurStatus(status);
+      if ((status.getPointMM().getVal(0) > 3.9) && (status.getPointMM().getVal(0) < 6.1))
+        sawMidMove = true;
+    }
+  }
+  check(liveMatches, "live steps match the axis throughout the move");
+  check(sawMidMove, "status reports the position part way through the move");
+  check((axis._physSteps == 1000) && (liveStepsX(motionHelper) == 1000), "live position at target");
+}
+
+// Home is set after a move is queued - the change reaches the live counts when the next block
+// starts (or once the pipeline is empty) so the live position never jumps part way through a move
+static void testRebaseCarried()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  SimAxis axis;
+  check(moveX(motionHelper, 10), "move queued");
+  motionHelper.setCurPositionAsHome(0);
+  check(moveX(motionHelper, 5), "move after home set queued");
+  bool jumpedEarly = false;
+  for (int ticks = 0; (ticks < 1000000) && (axis._physSteps < 1000); ticks++)
+  {
+    tick(motionHelper, axis);
+    if ((axis._physSteps < 1000) && (abs(liveStepsX(motionHelper) - axis._physSteps) > MAX_LIVE_LAG_STEPS))
+      jumpedEarly = true;
+  }
+  check(!jumpedEarly, "live counts unchanged during the first move");
+  runToIdle(motionHelper, axis);
+  check(axis._physSteps == 1500, "axis moved 15mm");
+  check(liveStepsX(motionHelper) == 500, "live counts in the new frame");
+
+  // Home set with nothing queued is applied from service()
+  motionHelper.setCurPositionAsHome(0);
+  runToIdle(motionHelper, axis);
+  check(liveStepsX(motionHelper) == 0, "home set while idle");
+}
+
+// Stopping part way through a move discards the queued blocks - the change to the step counts
+// they carried is still applied and the next move is planned from where the axis stopped
+static void testStopWithRebasePending()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  SimAxis axis;
+  check(moveX(motionHelper, 10), "move queued");
+  motionHelper.setCurPositionAsHome(0);
+  check(moveX(motionHelper, 5), "move after home set queued");
+  for (int ticks = 0; (ticks < 1000000) && (axis._physSteps < 300); ticks++)
+    tick(motionHelper, axis);
+  motionHelper.stop();
+  for (int i = 0; i < 10; i++)
+    tick(motionHelper, axis);
+  int32_t stopSteps = axis._physSteps;
+  printf("Stopped at %d steps\n", stopSteps);
+  check(motionHelper.testGetPipelineCount() == 0, "pipeline cleared");
+  check(liveStepsX(motionHelper) == stopSteps - 1000, "live counts in the new frame after stop");
+  RobotCommandArgs status;
+  motionHelper.getCurStatus(status);
+  check(fabsf(status.getPointMM().getVal(0) - (stopSteps - 1000) / 100.0f) < 0.01f, "status position after stop");
+
+  // Relative moves are from where the axis stopped
+  RobotCommandArgs args;
+  args.setAxisValMM(0, 2, true);
+  args.setMoveType(RobotMoveTypeArg_Relative);
+  check(motionHelper.moveTo(args), "relative move queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == stopSteps + 200) && (liveStepsX(motionHelper) == stopSteps - 800), "relative move from stop point");
+
+  // Moving to home goes to where home was set
+  check(moveX(motionHelper, 0), "move home queued");
+  runToIdle(motionHelper, axis);
+  check((axis._physSteps == 1000) && (liveStepsX(motionHelper) == 0), "home where it was set");
+}
+
+int main()
+{
+  testLivePosition();
+  testRebaseCarried();
+  testStopWithRebasePending();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,276 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host stress test and micro-benchmark for MotionRingBuffer
+
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <chrono>
+#include "MotionRingBuffer.h"
+
+// Previous (index comparison based) ring buffer position class - kept here for benchmark comparison
+class LegacyRingBufferPosn
+{
+public:
+  volatile unsigned int _putPos;
+  volatile unsigned int _getPos;
+  unsigned int _bufLen;
+
+  LegacyRingBufferPosn(int maxLen)
+  {
+    _bufLen = maxLen;
+    _putPos = 0;
+    _getPos = 0;
+  }
+  bool canPut()
+  {
+    if (_putPos == _getPos)
+      return true;
+    unsigned int gp = _getPos;
+    if (_putPos > gp)
+    {
+      if ((_putPos != _bufLen - 1) || (gp != 0))
+        return true;
+    }
+    else
+    {
+      if (gp - _putPos > 1)
+        return true;
+    }
+    return false;
+  }
+  bool canGet()
+  {
+    return _putPos != _getPos;
+  }
+  void hasPut()
+  {
+    _putPos++;
+    if (_putPos >= _bufLen)
+      _putPos = 0;
+  }
+  void hasGot()
+  {
+    _getPos++;
+    if (_getPos >= _bufLen)
+      _getPos = 0;
+  }
+  int getNthFromPut(unsigned int N)
+  {
+    if (!canGet())
+      return -1;
+    if (N >= _bufLen)
+      return -1;
+    int nthPos = _putPos - 1 - N;
+    if (nthPos < 0)
+      nthPos += _bufLen;
+    if (((unsigned int) (nthPos + 1) == _getPos) || ((unsigned int) (nthPos + 1) == _bufLen && _getPos == 0))
+      return -1;
+    return nthPos;
+  }
+};
+
+// Element with redundant content so a partially written element can be detected
+struct TestElem
+{
+  uint32_t _seq;
+  uint32_t _payload[8];
+  uint32_t _check;
+
+  void fill(uint32_t seq)
+  {
+    _seq   = seq;
+    _check = seq;
+    for (int i = 0; i < 8; i++)
+    {
+      _payload[i] = seq * 2654435761u + i;
+      _check     ^= _payload[i];
+    }
+  }
+  bool isValid()
+  {
+    uint32_t check = _seq;
+    for (int i = 0; i < 8; i++)
+      check ^= _payload[i];
+    return check == _check;
+  }
+};
+
+static int _failCount = 0;
+
+static void testCheck(bool ok, const char* msg)
+{
+  if (!ok)
+  {
+    printf("FAIL: %s\n", msg);
+    _failCount++;
+  }
+}
+
+static void testBasics()
+{
+  // Capacity rounds up to power of 2
+  MotionRingBuffer<int> ring(100);
+  testCheck(ring.capacity() == 128, "capacity rounded to power of two");
+  testCheck(!ring.canGet() && ring.peekGet() == NULL, "empty initially");
+  testCheck(ring.peekNthFromPut(0) == NULL && ring.peekNthFromGet(0) == NULL, "peek on empty");
+
+  // Fill completely
+  for (int i = 0; i < 128; i++)
+    testCheck(ring.put(i), "put while not full");
+  testCheck(!ring.canPut() && !ring.put(999), "full after capacity puts");
+  testCheck(ring.count() == 128, "count when full");
+
+  // Peek from both ends
+  testCheck(*ring.peekNthFromPut(0) == 127 && *ring.peekNthFromPut(127) == 0, "peek from put");
+  testCheck(ring.peekNthFromPut(128) == NULL, "peek from put beyond count");
+  testCheck(*ring.peekNthFromGet(0) == 0 && *ring.peekNthFromGet(127) == 127, "peek from get");
+  testCheck(ring.peekNthFromGet(128) == NULL, "peek from get beyond count");
+
+  // Wrap around many times
+  int val = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    int got = -1;
+    testCheck(ring.get(got) && got == val, "get in order");
+    testCheck(ring.put(val + 128), "put after get");
+    val++;
+  }
+  testCheck(*ring.peekNthFromGet(0) == val && *ring.peekNthFromPut(0) == val + 127, "peek after wrap");
+
+  // Clear
+  ring.clear();
+  testCheck(ring.count() == 0 && !ring.canGet(), "clear");
+
+  // Zero capacity never accepts
+  MotionRingBuffer<int> emptyRing(0);
+  testCheck(!emptyRing.canPut() && !emptyRing.put(1), "zero capacity");
+}
+
+static void testStress()
+{
+  const uint32_t NUM_ELEMS = 2000000;
+  MotionRingBuffer<TestElem> ring(64);
+
+  // Consumer - stands in for the ISR
+  uint32_t consumerErrors = 0;
+  std::thread consumer([&]() {
+    uint32_t expected = 0;
+    while (expected < NUM_ELEMS)
+    {
+      TestElem* pElem = ring.peekGet();
+      if (!pElem)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      if ((pElem->_seq != expected) || !pElem->isValid())
+        consumerErrors++;
+      // Look ahead as the planner does
+      TestElem* pNext = ring.peekNthFromGet(1);
+      if (pNext && ((pNext->_seq != expected + 1) || !pNext->isValid()))
+        consumerErrors++;
+      ring.hasGot();
+      expected++;
+    }
+  });
+
+  // Producer - stands in for the planner
+  uint32_t producerErrors = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  for (uint32_t seq = 0; seq < NUM_ELEMS; )
+  {
+    TestElem* pSlot = ring.putSlot();
+    if (!pSlot)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    pSlot->fill(seq);
+    ring.hasPut();
+    // The last element put must be visible to the producer unless the consumer has already got it
+    TestElem* pLast = ring.peekNthFromPut(0);
+    if (pLast && pLast->_seq != seq)
+      producerErrors++;
+    seq++;
+  }
+  consumer.join();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  printf("Stress: %u elements through 64 slot ring in %.2fs (%.1fM/s)\n",
+         NUM_ELEMS, secs, NUM_ELEMS / secs / 1e6);
+  testCheck(consumerErrors == 0, "consumer saw out of order or torn elements");
+  testCheck(producerErrors == 0, "producer peek inconsistent");
+  testCheck(ring.count() == 0, "ring empty at end");
+}
+
+static void benchPeek()
+{
+  const int PIPELINE_LEN = 100;
+  const int NUM_ITERATIONS = 200000;
+  std::vector<int> legacyBuf(PIPELINE_LEN);
+  LegacyRingBufferPosn legacyPosn(PIPELINE_LEN);
+  MotionRingBuffer<int> ring(PIPELINE_LEN);
+
+  // Fill both to a typical level with the put position wrapped
+  for (int i = 0; i < 150; i++)
+  {
+    if (!legacyPosn.canPut())
+      legacyPosn.hasGot();
+    legacyBuf[legacyPosn._putPos] = i;
+    legacyPosn.hasPut();
+    if (!ring.canPut())
+      ring.hasGot();
+    ring.put(i);
+  }
+
+  // Walk back from the put position as recalculatePipeline does
+  volatile long sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < NUM_ITERATIONS; iter++)
+  {
+    long sum = 0;
+    for (unsigned int n = 0; ; n++)
+    {
+      int idx = legacyPosn.getNthFromPut(n);
+      if (idx < 0)
+        break;
+      sum += legacyBuf[idx];
+    }
+    sink = sink + sum;
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < NUM_ITERATIONS; iter++)
+  {
+    long sum = 0;
+    for (unsigned int n = 0; ; n++)
+    {
+      int* pVal = ring.peekNthFromPut(n);
+      if (!pVal)
+        break;
+      sum += *pVal;
+    }
+    sink = sink + sum;
+  }
+  auto t2 = std::chrono::steady_clock::now();
+
+  double legacyNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / NUM_ITERATIONS;
+  double ringNs   = std::chrono::duration<double, std::nano>(t2 - t1).count() / NUM_ITERATIONS;
+  printf("Bench: full pipeline walk from put - legacy %.1fns, MotionRingBuffer %.1fns (%.2fx)\n",
+         legacyNs, ringNs, legacyNs / ringNs);
+}
+
+int main()
+{
+  testBasics();
+  testStress();
+  benchPeek();
+  if (_failCount != 0)
+  {
+    printf("%d checks FAILED\n", _failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
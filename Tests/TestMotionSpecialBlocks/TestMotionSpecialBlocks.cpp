@@ -0,0 +1,164 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for dwell (G4) and event (M42/M400) blocks in the motion pipeline - MotionHelper,
+// MotionPlanner and MotionActuator run unchanged against the host stubs with the actuator ticked
+// from service() (as it is when the ISR isn't used) and the live position, event status and pins
+// are checked as the moves, dwell and event are executed
+
+#include <stdio.h>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\","
+  "\"endStop0\":{\"sensePin\":\"A6\",\"actLvl\":0}},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+static const int EVENT_PIN = D7;
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+static bool moveX(MotionHelper& motionHelper, float xMM)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  return motionHelper.moveTo(args);
+}
+
+// One actuator tick per service call (20us)
+static void tick(MotionHelper& motionHelper)
+{
+  motionHelper.service();
+  HostClock::advanceUs(MotionBlock::TICK_INTERVAL_NS / 1000);
+}
+
+static int32_t liveStepsX(MotionHelper& motionHelper)
+{
+  return motionHelper.getLivePosition()._stepsFromHome.getVal(0);
+}
+
+static RobotCommandArgs getStatus(MotionHelper& motionHelper)
+{
+  RobotCommandArgs status;
+  motionHelper.getCurStatus(status);
+  return status;
+}
+
+static void testDwellAndEvent()
+{
+  MotionHelper motionHelper;
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(ROBOT_CONFIG);
+  motionHelper.pause(false);
+  HostPins::modes()[EVENT_PIN] = INPUT;
+  HostPins::levels()[EVENT_PIN] = 0;
+
+  // Pins used for motion are refused for events
+  check(!motionHelper.addEvent(1, D2, true, -1), "step pin refused");
+  check(!motionHelper.addEvent(1, D5, true, -1), "direction pin refused");
+  check(!motionHelper.addEvent(1, A2, true, -1), "enable pin refused");
+  check(!motionHelper.addEvent(1, A6, true, -1), "end-stop pin refused");
+  check(motionHelper.testGetPipelineCount() == 0, "nothing queued for refused pins");
+
+  // Move, dwell, event, marker, move
+  const uint32_t DWELL_MS = 50;
+  check(moveX(motionHelper, 10), "first move queued");
+  check(motionHelper.dwell(DWELL_MS, -1), "dwell queued");
+  check(motionHelper.addEvent(5, EVENT_PIN, true, -1), "event queued");
+  check(motionHelper.addEvent(6, -1, false, -1), "marker queued");
+  check(moveX(motionHelper, 20), "second move queued");
+  check(motionHelper.testGetPipelineCount() == 5, "five blocks queued");
+  check(HostPins::modes()[EVENT_PIN] == INPUT, "event pin not changed when queued");
+
+  // The dwell and events are zero-speed junctions
+  MotionBlock block;
+  check(motionHelper.testGetPipelineBlock(0, block) && (block._exitSpeedMMps == 0), "first move stops before dwell");
+  check(motionHelper.testGetPipelineBlock(4, block) && (block._entrySpeedMMps == 0), "second move starts from rest");
+
+  // Run the first move
+  int ticks = 0;
+  while ((liveStepsX(motionHelper) < 1000) && (ticks < 1000000))
+  {
+    tick(motionHelper);
+    ticks++;
+    if (getStatus(motionHelper).getEventsReached() != 0)
+      break;
+  }
+  check(liveStepsX(motionHelper) == 1000, "first move complete");
+  check(getStatus(motionHelper).getEventsReached() == 0, "no event during first move");
+
+  // Dwell - no steps and no event until the time is up
+  uint64_t dwellStartUs = HostClock::us();
+  while ((getStatus(motionHelper).getEventsReached() == 0) && (ticks < 1000000))
+  {
+    tick(motionHelper);
+    ticks++;
+    check(liveStepsX(motionHelper) == 1000, "no steps during dwell");
+    if (liveStepsX(motionHelper) != 1000)
+      break;
+  }
+  double dwellMs = (HostClock::us() - dwellStartUs) / 1000.0;
+  check((dwellMs >= DWELL_MS) && (dwellMs < DWELL_MS + 1), "dwell time");
+  check(HostPins::modes()[EVENT_PIN] == OUTPUT, "event pin made output when reached");
+  check(HostPins::levels()[EVENT_PIN] == 1, "event pin set when reached");
+  RobotCommandArgs status = getStatus(motionHelper);
+  check((status.getLastEventId() == 5) && (status.getEventsReached() == 1), "event reported");
+
+  // Marker then second move
+  while ((liveStepsX(motionHelper) < 2000) && (ticks < 1000000))
+  {
+    tick(motionHelper);
+    ticks++;
+  }
+  status = getStatus(motionHelper);
+  check((status.getLastEventId() == 6) && (status.getEventsReached() == 2), "marker reported");
+  check(liveStepsX(motionHelper) == 2000, "second move complete");
+  for (int i = 0; i < 100; i++)
+    tick(motionHelper);
+  check(motionHelper.testGetPipelineCount() == 0, "pipeline empty");
+  printf("Move, %ums dwell, event, marker and move took %.1fms\n", DWELL_MS, ticks * MotionBlock::TICK_INTERVAL_NS / 1e6);
+}
+
+int main()
+{
+  testDwellAndEvent();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
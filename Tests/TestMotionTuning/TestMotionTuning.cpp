@@ -0,0 +1,178 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for runtime motion tuning (M201, M203, M204, M205 and M220) - the tuning is applied
+// through MotionHelper and the feedrate, acceleration and junction speeds the planner gives the
+// blocks added afterwards are checked (MotionHelper and MotionPlanner run unchanged against the
+// host stubs)
+
+#include <stdio.h>
+#include "application.h"
+#include "MotionHelper.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+static const char* ROBOT_CONFIG =
+  "{\"pipelineLen\":20,\"blockDistanceMM\":0,\"junctionDeviation\":0.05,\"livePositionUpdateMs\":0,"
+  "\"stepEnablePin\":\"A2\",\"stepEnLev\":0,"
+  "\"axis0\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D2\",\"dirnPin\":\"D3\"},"
+  "\"axis1\":{\"maxSpeed\":50,\"maxAcc\":500,\"stepsPerRot\":100,\"unitsPerRot\":1,\"stepPin\":\"D4\",\"dirnPin\":\"D5\"}}";
+
+// Cartesian transforms (steps = mm * stepsPerUnit)
+static bool ptToActuator(AxisFloats& targetPt, AxisFloats& outActuator, AxisPosition& curPos, AxesParams& axesParams,
+                         bool allowOutOfBounds)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outActuator.setVal(axisIdx, targetPt.getVal(axisIdx) * axesParams.getStepsPerUnit(axisIdx));
+  return true;
+}
+
+static void actuatorToPt(AxisFloats& targetActuator, AxisFloats& outPt, AxisPosition& curPos, AxesParams& axesParams)
+{
+  for (int axisIdx = 0; axisIdx < RobotConsts::MAX_AXES; axisIdx++)
+    outPt.setVal(axisIdx, targetActuator.getVal(axisIdx) / axesParams.getStepsPerUnit(axisIdx));
+}
+
+static void correctStepOverflow(AxisPosition& curPos, AxesParams& axesParams)
+{
+}
+
+// Move (feedrate in mm/s - 0 for none)
+static bool moveXY(MotionHelper& motionHelper, float xMM, float yMM, float feedrate)
+{
+  RobotCommandArgs args;
+  args.setAxisValMM(0, xMM, true);
+  args.setAxisValMM(1, yMM, true);
+  args.setMoveType(RobotMoveTypeArg_Absolute);
+  if (feedrate > 0)
+    args.setFeedrate(feedrate);
+  return motionHelper.moveTo(args);
+}
+
+// Block in the pipeline (motion is paused so nothing is executed)
+static MotionBlock getBlock(MotionHelper& motionHelper, int blockIdx)
+{
+  MotionBlock block;
+  motionHelper.testGetPipelineBlock(blockIdx, block);
+  return block;
+}
+
+static bool isNear(float val, float expected)
+{
+  return fabsf(val - expected) < 0.001f * fabsf(expected) + 0.001f;
+}
+
+static void setup(MotionHelper& motionHelper)
+{
+  motionHelper.setTransforms(ptToActuator, actuatorToPt, correctStepOverflow);
+  motionHelper.configure(ROBOT_CONFIG);
+}
+
+// M220 - the feedrate override scales a requested feedrate and also slows moves limited by the axis
+// max speeds (but an override above 100% doesn't exceed them)
+static void testFeedrateOverride()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  check(moveXY(motionHelper, 10, 0, 20) && isNear(getBlock(motionHelper, 0)._feedrateMMps, 20), "feedrate as requested");
+  MotionTuning tuning;
+  tuning._feedrateOverrideValid = true;
+  tuning._feedrateOverridePC = 50;
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 20, 0, 20) && isNear(getBlock(motionHelper, 1)._feedrateMMps, 10), "feedrate halved");
+  check(moveXY(motionHelper, 30, 0, 0) && isNear(getBlock(motionHelper, 2)._feedrateMMps, 25), "max speed halved");
+  check(isNear(getBlock(motionHelper, 0)._feedrateMMps, 20), "queued block keeps its feedrate");
+  tuning._feedrateOverridePC = 200;
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 40, 0, 20) && isNear(getBlock(motionHelper, 3)._feedrateMMps, 40), "feedrate doubled");
+  check(moveXY(motionHelper, 50, 0, 0) && isNear(getBlock(motionHelper, 4)._feedrateMMps, 50), "max speed not exceeded");
+}
+
+// M201 and M203 - axis limits apply to moves using that axis (Y is used as the X (master axis)
+// acceleration also limits the path)
+static void testAxisLimits()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  MotionTuning tuning;
+  tuning.setMaxAcc(1, 200);
+  tuning.setMaxSpeed(1, 10);
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 10, 0, 0), "X move queued");
+  MotionBlock block = getBlock(motionHelper, 0);
+  check(isNear(block._maxAccMMps2, 500) && isNear(block._feedrateMMps, 50), "X move uses X limits");
+  check(moveXY(motionHelper, 10, 10, 0), "Y move queued");
+  block = getBlock(motionHelper, 1);
+  check(isNear(block._maxAccMMps2, 200) && isNear(block._feedrateMMps, 10), "Y move uses Y limits");
+}
+
+// M204 - the path acceleration limit lowers the acceleration of every block and S0 removes it
+static void testPathAcc()
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  check(moveXY(motionHelper, 10, 0, 0) && isNear(getBlock(motionHelper, 0)._maxAccMMps2, 500), "axis acceleration");
+  MotionTuning tuning;
+  tuning._pathAccValid = true;
+  tuning._pathAccMMps2 = 100;
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 10, 10, 0) && isNear(getBlock(motionHelper, 1)._maxAccMMps2, 100), "path acceleration limit");
+  check(moveXY(motionHelper, 20, 20, 0) && isNear(getBlock(motionHelper, 2)._maxAccMMps2, 100), "diagonal limited too");
+  tuning._pathAccMMps2 = 1000;
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 30, 20, 0) && isNear(getBlock(motionHelper, 3)._maxAccMMps2, 500), "limit above axes has no effect");
+  tuning._pathAccMMps2 = 0;
+  motionHelper.setMotionTuning(tuning);
+  check(moveXY(motionHelper, 40, 20, 0) && isNear(getBlock(motionHelper, 4)._maxAccMMps2, 500), "S0 removes limit");
+  check(isNear(getBlock(motionHelper, 1)._maxAccMMps2, 100), "queued block keeps its acceleration");
+}
+
+// M205 - a larger junction deviation allows a faster corner
+static float cornerSpeed(float junctionDeviation)
+{
+  MotionHelper motionHelper;
+  setup(motionHelper);
+  MotionTuning tuning;
+  tuning._junctionDeviationValid = true;
+  tuning._junctionDeviation = junctionDeviation;
+  motionHelper.setMotionTuning(tuning);
+  moveXY(motionHelper, 20, 0, 0);
+  moveXY(motionHelper, 20, 20, 0);
+  return getBlock(motionHelper, 1)._maxEntrySpeedMMps;
+}
+
+static void testJunctionDeviation()
+{
+  float slowCorner = cornerSpeed(0.01f);
+  float fastCorner = cornerSpeed(0.2f);
+  printf("Right angle corner speed %0.2fmm/s (0.01mm) %0.2fmm/s (0.2mm)\n", slowCorner, fastCorner);
+  check(slowCorner > 0, "corner speed not zero");
+  check(fastCorner > slowCorner * 2, "larger junction deviation gives faster corner");
+  // Square root of (acceleration * deviation * sin(theta/2) / (1 - sin(theta/2))) for a right angle
+  float sinHalf = sqrtf(0.5f);
+  check(isNear(slowCorner, sqrtf(500 * 0.01f * sinHalf / (1 - sinHalf))), "corner speed from junction deviation");
+}
+
+int main()
+{
+  testFeedrateOverride();
+  testAxisLimits();
+  testPathAcc();
+  testJunctionDeviation();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -22,7 +22,7 @@ static const char* ROBOT_CONFIG_STR =
 " \"stepsPerRotation\":6400, \"unitsPerRotation\":360 },"
 " \"axis1\": { \"stepPin\": \"A5\", \"dirnPin\":\"A4\", \"maxSpeed\":10.0, \"maxAcc\":10.0,"
 " \"stepsPerRotation\":1600, \"unitsPerRotation\":1 },"
-" \"commandQueue\": { \"cmdQueueMaxLen\":50 } "
+" \"commandQueue\": { \"cmdQueueBytes\":2000 } "
 "}";
 
 static bool ptToActuator(AxisFloats& pt, AxisFloats& actuatorCoords, AxesParams& axesParams)
@@ -56,7 +56,7 @@ static const char* ROBOT_CONFIG_STR =
 " \"stepsPerRotation\":3200, \"unitsPerRotation\":32 },"
 " \"axis1\": { \"stepPin\": \"A5\", \"dirnPin\":\"A4\", \"maxSpeed\":100.0, \"maxAcc\":10.0,"
 " \"stepsPerRotation\":3200, \"unitsPerRotation\":32 },"
-" \"commandQueue\": { \"cmdQueueMaxLen\":50 } "
+" \"commandQueue\": { \"cmdQueueBytes\":2000 } "
 "}";
 
 static bool ptToActuator(AxisFloats& pt, AxisFloats& actuatorCoords, AxesParams& axesParams)
@@ -91,7 +91,7 @@ static const char* ROBOT_CONFIG_STR =
 " \"stepsPerRotation\":3200, \"unitsPerRotation\":32 },"
 " \"axis1\": { \"stepPin\": \"A5\", \"dirnPin\":\"A4\", \"maxSpeed\":10.0, \"maxAcc\":10.0,"
 " \"stepsPerRotation\":1600, \"unitsPerRotation\":32 },"
-" \"commandQueue\": { \"cmdQueueMaxLen\":50 } "
+" \"commandQueue\": { \"cmdQueueBytes\":2000 } "
 "}";
 
 static bool ptToActuator(AxisFloats& pt, AxisFloats& actuatorCoords, AxesParams& axesParams)
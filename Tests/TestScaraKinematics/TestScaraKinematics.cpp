@@ -0,0 +1,392 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for SandTableScaraKinematics
+// Checks the float kinematics against the previous double-precision implementation over the
+// whole working area and benchmarks the number of transforms per second
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "SandTableScaraKinematics.h"
+
+// Geometry from the default SandTableScara config
+static const double UNITS_PER_ROT = 628.318;
+static const double STEPS_PER_ROT = 9600;
+static const double MAX_RADIUS_MM = 185;
+
+// Tolerances the float path must meet
+static const double TOL_ANGLE_DEGS = 0.02;
+static const double TOL_STEPS      = 0.5;
+static const double TOL_POINT_MM   = 0.01;
+// Round trip includes rounding to whole steps (half a step on each arm is ~0.07mm at full reach)
+static const double TOL_ROUND_TRIP_MM = 0.15;
+
+// Previous double-precision implementation (logging removed)
+// rotationsToPoint previously added 180 degrees to beta which doesn't match ptToRotations (the
+// lower arm ended up pointing the wrong way) - that is corrected here as in the float version
+class LegacyScaraKinematics
+{
+public:
+  static int ptToRotations(double x, double y, double& alpha, double& beta)
+  {
+    double shoulderElbowMM = UNITS_PER_ROT / M_PI / 2;
+    double elbowHandMM     = UNITS_PER_ROT / M_PI / 2;
+    if (isApprox(x, 0, 0.1) && isApprox(y, 0, 0.1))
+    {
+      alpha = 0;
+      beta  = 180;
+      return SandTableScaraKinematics::ROTATION_IS_NEAR_CENTRE;
+    }
+    double thirdSideMM = sqrt(pow(x, 2) + pow(y, 2));
+    bool posValid = thirdSideMM <= shoulderElbowMM + elbowHandMM;
+    posValid &= thirdSideMM <= MAX_RADIUS_MM;
+    double delta1 = atan2(x, y);
+    if (delta1 < 0)
+      delta1 += M_PI * 2;
+    double delta2             = cosineRule(thirdSideMM, shoulderElbowMM, elbowHandMM);
+    double innerAngleOppThird = cosineRule(shoulderElbowMM, elbowHandMM, thirdSideMM);
+    double alpha1rads = delta1 - delta2;
+    double beta1rads  = alpha1rads - innerAngleOppThird + M_PI;
+    double alpha2rads = delta1 + delta2;
+    double beta2rads  = alpha2rads + innerAngleOppThird - M_PI;
+    double alpha1 = r2d(wrapRadians(alpha1rads + 2 * M_PI));
+    double beta1  = r2d(wrapRadians(beta1rads + 2 * M_PI));
+    double alpha2 = r2d(wrapRadians(alpha2rads + 2 * M_PI));
+    double beta2  = r2d(wrapRadians(beta2rads + 2 * M_PI));
+    double betweenArms1 = wrapDegrees(beta1 - alpha1);
+    if (betweenArms1 >= 0 && betweenArms1 < 180)
+    {
+      alpha = alpha1;
+      beta  = beta1;
+    }
+    else
+    {
+      alpha = alpha2;
+      beta  = beta2;
+    }
+    return posValid ? SandTableScaraKinematics::ROTATION_NORMAL : SandTableScaraKinematics::ROTATION_OUT_OF_BOUNDS;
+  }
+
+  static void rotationsToPoint(double alphaDegs, double betaDegs, double& x, double& y)
+  {
+    double shoulderElbowMM = UNITS_PER_ROT / M_PI / 2;
+    double elbowHandMM     = UNITS_PER_ROT / M_PI / 2;
+    double alpha = d2r(alphaDegs);
+    double beta  = d2r(betaDegs);
+    x = shoulderElbowMM * sin(alpha) + elbowHandMM * sin(beta);
+    y = shoulderElbowMM * cos(alpha) + elbowHandMM * cos(beta);
+  }
+
+  static void rotationToActuator(double alphaDegs, double betaDegs, double& steps0, double& steps1)
+  {
+    steps0 = alphaDegs * STEPS_PER_ROT / 360;
+    double betaStepTarget = STEPS_PER_ROT - wrapDegrees(betaDegs - 180) * STEPS_PER_ROT / 360;
+    if (betaStepTarget >= 0 && betaStepTarget < STEPS_PER_ROT / 2)
+      steps1 = betaStepTarget;
+    else
+      steps1 = betaStepTarget - STEPS_PER_ROT;
+  }
+
+  static void actuatorToRotation(int32_t steps0, int32_t steps1, double& alphaDegs, double& betaDegs)
+  {
+    alphaDegs = wrapDegrees(steps0 * 360 / STEPS_PER_ROT);
+    betaDegs  = wrapDegrees(540 - (steps1 * 360 / STEPS_PER_ROT));
+  }
+
+private:
+  static double cosineRule(double a, double b, double c)
+  {
+    double val = (a * a + b * b - c * c) / (2 * a * b);
+    if (val > 1) val = 1;
+    if (val < -1) val = -1;
+    return acos(val);
+  }
+  static double wrapRadians(double angle)
+  {
+    return angle - 2.0 * M_PI * floor(angle / (2.0 * M_PI));
+  }
+  static double wrapDegrees(double angle)
+  {
+    return angle - 360.0 * floor(angle / 360.0);
+  }
+  static double r2d(double angleRadians)
+  {
+    return angleRadians * 180.0 / M_PI;
+  }
+  static double d2r(double angleDegrees)
+  {
+    return angleDegrees * M_PI / 180.0;
+  }
+  static bool isApprox(double v1, double v2, double withinRng)
+  {
+    return fabs(v1 - v2) < withinRng;
+  }
+};
+
+static int failCount = 0;
+
+// Difference between two angles allowing for wrap-around
+static double angleDiff(double a, double b)
+{
+  double diff = fmod(fabs(a - b), 360.0);
+  return diff > 180 ? 360 - diff : diff;
+}
+
+// Difference between two step targets - the beta target may legitimately differ by a whole
+// rotation when it is right on the half-rotation boundary
+static double stepsDiff(double a, double b)
+{
+  double diff = fmod(fabs(a - b), STEPS_PER_ROT);
+  return diff > STEPS_PER_ROT / 2 ? STEPS_PER_ROT - diff : diff;
+}
+
+static void testAgainstLegacy()
+{
+  SandTableScaraKinematics kinematics;
+  kinematics.setGeometry(UNITS_PER_ROT, UNITS_PER_ROT, STEPS_PER_ROT, STEPS_PER_ROT, true, MAX_RADIUS_MM);
+
+  double maxAngleErr = 0, maxStepsErr = 0, maxPointErr = 0, maxRoundTripErr = 0;
+  int numPts = 0;
+  for (double x = -MAX_RADIUS_MM; x <= MAX_RADIUS_MM; x += 0.73)
+  {
+    for (double y = -MAX_RADIUS_MM; y <= MAX_RADIUS_MM; y += 0.71)
+    {
+      if (x * x + y * y > MAX_RADIUS_MM * MAX_RADIUS_MM)
+        continue;
+      numPts++;
+
+      // Point to rotations
+      double alphaD = 0, betaD = 0;
+      float alphaF = 0, betaF = 0;
+      int typeD = LegacyScaraKinematics::ptToRotations(x, y, alphaD, betaD);
+      int typeF = kinematics.ptToRotations(float(x), float(y), alphaF, betaF);
+      if (typeD != typeF)
+      {
+        printf("FAIL rotation type x %.3f y %.3f double %d float %d\n", x, y, typeD, typeF);
+        failCount++;
+        continue;
+      }
+      double angleErr = fmax(angleDiff(alphaD, alphaF), angleDiff(betaD, betaF));
+      if (angleErr > maxAngleErr)
+        maxAngleErr = angleErr;
+
+      // Rotations to actuator
+      double steps0D = 0, steps1D = 0;
+      float steps0F = 0, steps1F = 0;
+      LegacyScaraKinematics::rotationToActuator(alphaD, betaD, steps0D, steps1D);
+      kinematics.rotationToActuator(alphaF, betaF, steps0F, steps1F);
+      double stepsErr = fmax(stepsDiff(steps0D, steps0F), stepsDiff(steps1D, steps1F));
+      if (stepsErr > maxStepsErr)
+        maxStepsErr = stepsErr;
+
+      // Actuator to point
+      double xD = 0, yD = 0, aD = 0, bD = 0;
+      float xF = 0, yF = 0, aF = 0, bF = 0;
+      LegacyScaraKinematics::actuatorToRotation(int32_t(steps0D), int32_t(steps1D), aD, bD);
+      LegacyScaraKinematics::rotationsToPoint(aD, bD, xD, yD);
+      kinematics.actuatorToRotation(int32_t(steps0D), int32_t(steps1D), aF, bF);
+      kinematics.rotationsToPoint(aF, bF, xF, yF);
+      double pointErr = hypot(xD - xF, yD - yF);
+      if (pointErr > maxPointErr)
+        maxPointErr = pointErr;
+
+      // Round trip through the float path to whole steps and back (only meaningful away from the centre)
+      if (typeF == SandTableScaraKinematics::ROTATION_NORMAL)
+      {
+        float xR = 0, yR = 0, aR = 0, bR = 0;
+        kinematics.actuatorToRotation(int32_t(lroundf(steps0F)), int32_t(lroundf(steps1F)), aR, bR);
+        kinematics.rotationsToPoint(aR, bR, xR, yR);
+        double roundTripErr = hypot(x - xR, y - yR);
+        if (roundTripErr > maxRoundTripErr)
+          maxRoundTripErr = roundTripErr;
+      }
+    }
+  }
+
+  printf("Checked %d points: max angle err %.5f deg, max steps err %.4f, max fwd point err %.5f mm, max round trip err %.5f mm\n",
+         numPts, maxAngleErr, maxStepsErr, maxPointErr, maxRoundTripErr);
+  if (maxAngleErr > TOL_ANGLE_DEGS || maxStepsErr > TOL_STEPS || maxPointErr > TOL_POINT_MM || maxRoundTripErr > TOL_ROUND_TRIP_MM)
+  {
+    printf("FAIL tolerance (angle %.3f deg, steps %.2f, point %.3f mm, round trip %.3f mm)\n",
+           TOL_ANGLE_DEGS, TOL_STEPS, TOL_POINT_MM, TOL_ROUND_TRIP_MM);
+    failCount++;
+  }
+}
+
+// Removing whole rotations must leave the counts in the ranges used by rotationToActuator without
+// changing the arm rotations
+static void testStepOverflow()
+{
+  SandTableScaraKinematics kinematics;
+  kinematics.setGeometry(UNITS_PER_ROT, UNITS_PER_ROT, STEPS_PER_ROT, STEPS_PER_ROT, true, MAX_RADIUS_MM);
+  const int32_t stepsPerRot = int32_t(STEPS_PER_ROT);
+  const int32_t testSteps[] = { 0, 1, 4799, 4800, 9599, 9600, 9601, 123457, -1, -4800, -4801, -9600, -2000000001 };
+  for (int32_t steps0 : testSteps)
+  {
+    for (int32_t steps1 : testSteps)
+    {
+      float alphaBefore = 0, betaBefore = 0;
+      kinematics.actuatorToRotation(steps0, steps1, alphaBefore, betaBefore);
+      int32_t new0 = steps0, new1 = steps1;
+      kinematics.correctStepOverflow(new0, new1);
+      float alphaAfter = 0, betaAfter = 0;
+      kinematics.actuatorToRotation(new0, new1, alphaAfter, betaAfter);
+      bool inRange = (new0 >= 0) && (new0 < stepsPerRot) && (new1 >= -stepsPerRot / 2) && (new1 < stepsPerRot / 2);
+      bool wholeRots = ((steps0 - new0) % stepsPerRot == 0) && ((steps1 - new1) % stepsPerRot == 0);
+      if (!inRange || !wholeRots || angleDiff(alphaBefore, alphaAfter) > 1e-3 || angleDiff(betaBefore, betaAfter) > 1e-3)
+      {
+        printf("FAIL step overflow %d,%d -> %d,%d alpha %.3f -> %.3f beta %.3f -> %.3f\n", steps0, steps1, new0, new1,
+               alphaBefore, alphaAfter, betaBefore, betaAfter);
+        failCount++;
+      }
+    }
+  }
+}
+
+// Travel in steps from the current position (both axes equally weighted)
+static double travelSteps(int32_t cur0, int32_t cur1, float steps0, float steps1)
+{
+  return fabs(steps0 - cur0) + fabs(steps1 - cur1);
+}
+
+// The solution with least travel must reach the point, never turn an arm more than half a rotation
+// and never travel further than the fixed (between arms < 180) solution
+static void testMinTravel()
+{
+  SandTableScaraKinematics kinematics;
+  kinematics.setGeometry(UNITS_PER_ROT, UNITS_PER_ROT, STEPS_PER_ROT, STEPS_PER_ROT, true, MAX_RADIUS_MM);
+  const int32_t curOptions[][2] = { { 0, 0 }, { 2400, -1000 }, { 9599, 4799 }, { -30000, 17000 }, { 123457, -98765 } };
+  double maxRoundTripErr = 0;
+  int numPts = 0;
+  for (auto& cur : curOptions)
+  {
+    for (double x = -MAX_RADIUS_MM; x <= MAX_RADIUS_MM; x += 3.7)
+    {
+      for (double y = -MAX_RADIUS_MM; y <= MAX_RADIUS_MM; y += 3.3)
+      {
+        if (x * x + y * y > MAX_RADIUS_MM * MAX_RADIUS_MM)
+          continue;
+        numPts++;
+        float steps0 = 0, steps1 = 0;
+        kinematics.ptToActuatorMinTravel(float(x), float(y), cur[0], cur[1], steps0, steps1);
+        float xR = 0, yR = 0, aR = 0, bR = 0;
+        kinematics.actuatorToRotation(int32_t(lroundf(steps0)), int32_t(lroundf(steps1)), aR, bR);
+        kinematics.rotationsToPoint(aR, bR, xR, yR);
+        double roundTripErr = hypot(x - xR, y - yR);
+        if (roundTripErr > maxRoundTripErr)
+          maxRoundTripErr = roundTripErr;
+
+        // Fixed solution turning each arm the shortest way
+        float alphaF = 0, betaF = 0, curAlpha = 0, curBeta = 0;
+        kinematics.ptToRotations(float(x), float(y), alphaF, betaF);
+        kinematics.actuatorToRotation(cur[0], cur[1], curAlpha, curBeta);
+        float fixed0 = cur[0] + SandTableScaraKinematics::angleDiffDegs(alphaF, curAlpha) * STEPS_PER_ROT / 360;
+        float fixed1 = cur[1] - SandTableScaraKinematics::angleDiffDegs(betaF, curBeta) * STEPS_PER_ROT / 360;
+        bool isCentre = (fabs(x) < SandTableScaraKinematics::NEAR_CENTRE_MM) && (fabs(y) < SandTableScaraKinematics::NEAR_CENTRE_MM);
+        if ((fabsf(steps0 - cur[0]) > STEPS_PER_ROT / 2 + 0.5) || (fabsf(steps1 - cur[1]) > STEPS_PER_ROT / 2 + 0.5) ||
+            (!isCentre && (travelSteps(cur[0], cur[1], steps0, steps1) > travelSteps(cur[0], cur[1], fixed0, fixed1) + 0.01)))
+        {
+          printf("FAIL min travel x %.2f y %.2f from %d,%d -> %.1f,%.1f (fixed %.1f,%.1f)\n", x, y, cur[0], cur[1],
+                 steps0, steps1, fixed0, fixed1);
+          failCount++;
+        }
+      }
+    }
+
+    // At the centre the upper arm stays where it is and the lower arm points back along it
+    float steps0 = 0, steps1 = 0, alpha = 0, beta = 0;
+    kinematics.ptToActuatorMinTravel(0, 0, cur[0], cur[1], steps0, steps1);
+    kinematics.actuatorToRotation(int32_t(lroundf(steps0)), int32_t(lroundf(steps1)), alpha, beta);
+    if ((steps0 != float(cur[0])) || (angleDiff(alpha + 180, beta) > 0.1))
+    {
+      printf("FAIL centre from %d,%d -> %.1f,%.1f alpha %.2f beta %.2f\n", cur[0], cur[1], steps0, steps1, alpha, beta);
+      failCount++;
+    }
+  }
+  printf("Min travel checked %d points: max round trip err %.5f mm\n", numPts, maxRoundTripErr);
+  if (maxRoundTripErr > TOL_ROUND_TRIP_MM)
+  {
+    printf("FAIL min travel round trip tolerance %.3f mm\n", TOL_ROUND_TRIP_MM);
+    failCount++;
+  }
+
+  // Joint travel following a spiral in to the centre and out again (like a sand table pattern)
+  // with the fixed solution and with the least travel solution
+  double fixedTravel = 0, minTravel = 0;
+  int32_t fixedCur0 = 0, fixedCur1 = 0, minCur0 = 0, minCur1 = 0;
+  for (int ptIdx = 0; ptIdx <= 20000; ptIdx++)
+  {
+    double radius = MAX_RADIUS_MM * fabs(1 - ptIdx / 10000.0);
+    double angle = ptIdx * 0.05;
+    float x = float(radius * sin(angle)), y = float(radius * cos(angle));
+    float alpha = 0, beta = 0, steps0 = 0, steps1 = 0;
+    kinematics.ptToRotations(x, y, alpha, beta);
+    kinematics.rotationToActuator(alpha, beta, steps0, steps1);
+    fixedTravel += travelSteps(fixedCur0, fixedCur1, steps0, steps1);
+    fixedCur0 = int32_t(ceilf(steps0));
+    fixedCur1 = int32_t(ceilf(steps1));
+    kinematics.ptToActuatorMinTravel(x, y, minCur0, minCur1, steps0, steps1);
+    minTravel += travelSteps(minCur0, minCur1, steps0, steps1);
+    minCur0 += int32_t(ceilf(steps0 - minCur0));
+    minCur1 += int32_t(ceilf(steps1 - minCur1));
+  }
+  printf("Spiral joint travel: fixed solution %.0f steps, least travel %.0f steps (%.1f%%)\n",
+         fixedTravel, minTravel, 100.0 * minTravel / fixedTravel);
+  if (minTravel > fixedTravel)
+  {
+    printf("FAIL least travel solution travels further on spiral\n");
+    failCount++;
+  }
+}
+
+static void benchmark()
+{
+  static const int BENCH_ITERS = 2000000;
+  SandTableScaraKinematics kinematics;
+  kinematics.setGeometry(UNITS_PER_ROT, UNITS_PER_ROT, STEPS_PER_ROT, STEPS_PER_ROT, true, MAX_RADIUS_MM);
+
+  // Points on a spiral (similar to a typical sand table pattern)
+  volatile double sinkD = 0;
+  volatile float sinkF = 0;
+
+  auto startD = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_ITERS; i++)
+  {
+    double ang = i * 0.001, rad = fmod(i * 0.0001, MAX_RADIUS_MM);
+    double alpha = 0, beta = 0, steps0 = 0, steps1 = 0;
+    LegacyScaraKinematics::ptToRotations(rad * sin(ang), rad * cos(ang), alpha, beta);
+    LegacyScaraKinematics::rotationToActuator(alpha, beta, steps0, steps1);
+    sinkD = sinkD + steps0 + steps1;
+  }
+  double secsD = std::chrono::duration<double>(std::chrono::steady_clock::now() - startD).count();
+
+  auto startF = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_ITERS; i++)
+  {
+    float ang = i * 0.001f, rad = fmodf(i * 0.0001f, float(MAX_RADIUS_MM));
+    float alpha = 0, beta = 0, steps0 = 0, steps1 = 0;
+    kinematics.ptToRotations(rad * sinf(ang), rad * cosf(ang), alpha, beta);
+    kinematics.rotationToActuator(alpha, beta, steps0, steps1);
+    sinkF = sinkF + steps0 + steps1;
+  }
+  double secsF = std::chrono::duration<double>(std::chrono::steady_clock::now() - startF).count();
+
+  printf("Benchmark ptToActuator: double %.0f/s, float %.0f/s (%.2fx)\n",
+         BENCH_ITERS / secsD, BENCH_ITERS / secsF, secsD / secsF);
+}
+
+int main()
+{
+  testAgainstLegacy();
+  testStepOverflow();
+  testMinTravel();
+  benchmark();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,284 @@
+// RBotFirmware
+// Rob Dobson 2016-2018
+
+// Host test for serial G-code streaming - a simulated host streams lines over a 115200 baud link
+// using Grbl-style character counting to a model of CommsSerial::service (SerialLineRing plus a
+// command queue drained at the planning rate) and the throughput is compared with the previous
+// one character per loop ingestion
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "SerialLineRing.h"
+
+static int failCount = 0;
+
+static void check(bool ok, const char* pMsg)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", pMsg);
+    failCount++;
+  }
+}
+
+// Simulation settings
+static const double BAUD_BYTES_PER_MS = 115200.0 / 10 / 1000;
+static const unsigned int RX_RING_BYTES = 1024;
+static const unsigned int CMD_QUEUE_LEN = 20;
+static const unsigned int MAX_LINE_LEN = 1000;
+
+struct StreamResult
+{
+  double elapsedMs;
+  unsigned long linesDelivered;
+  unsigned long bytesDelivered;
+  unsigned long acks;
+  bool inOrder;
+  bool overrun;
+  unsigned long queueStarvedSteps;
+};
+
+static std::vector<std::string> makeJob(int numLines)
+{
+  std::vector<std::string> lines;
+  char line[60];
+  for (int i = 0; i < numLines; i++)
+  {
+    snprintf(line, sizeof(line), "G1 X%d.%03d Y%d.%03d F3000\n", (i * 13) % 200, i % 1000, (i * 7) % 200, (i * 3) % 1000);
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// Stream a job - loopMs is the device loop time and msPerCmd the time the planner takes to
+// consume a command from the queue - drainAll selects the new ingestion, otherwise one char is
+// read per loop and lines are processed (or dropped if the queue is full) as they complete
+static StreamResult streamJob(const std::vector<std::string>& job, double loopMs, double msPerCmd, bool drainAll)
+{
+  StreamResult result = { 0, 0, 0, 0, true, false, 0 };
+  SerialLineRing rxRing(RX_RING_BYTES);
+  std::deque<char> wire;
+  std::deque<unsigned int> unackedLineLens;
+  std::deque<unsigned long> cmdQueue;
+  std::string curLine;
+  char lineBuf[MAX_LINE_LEN + 1];
+  unsigned int hostLineIdx = 0, hostCharIdx = 0, hostWindowUsed = 0;
+  unsigned long expectedLineIdx = 0;
+  double wireBudget = 0, nextLoopMs = 0, nextCmdMs = 0;
+  bool queueEverFull = false;
+
+  // Simulate in 0.1ms steps
+  const double stepMs = 0.1;
+  for (double nowMs = 0; nowMs < 600000; nowMs += stepMs)
+  {
+    // Host sends bytes at the baud rate - with character counting it only starts a line if it
+    // fits in the window (the previous protocol had no flow control so the host just sends)
+    wireBudget += BAUD_BYTES_PER_MS * stepMs;
+    while ((wireBudget >= 1) && (hostLineIdx < job.size()))
+    {
+      const std::string& line = job[hostLineIdx];
+      if (drainAll && (hostCharIdx == 0))
+      {
+        if (hostWindowUsed + line.length() > RX_RING_BYTES)
+          break;
+        hostWindowUsed += line.length();
+        unackedLineLens.push_back(line.length());
+      }
+      wire.push_back(line[hostCharIdx++]);
+      wireBudget -= 1;
+      if (hostCharIdx >= line.length())
+      {
+        hostLineIdx++;
+        hostCharIdx = 0;
+      }
+    }
+    if (wireBudget > 1)
+      wireBudget = 1;
+
+    // Planner consumes commands
+    if ((nowMs >= nextCmdMs) && !cmdQueue.empty())
+    {
+      cmdQueue.pop_front();
+      nextCmdMs = nowMs + msPerCmd;
+    }
+    if (queueEverFull && cmdQueue.empty() && (hostLineIdx < job.size()))
+      result.queueStarvedSteps++;
+
+    // Device loop
+    if (nowMs >= nextLoopMs)
+    {
+      nextLoopMs = nowMs + loopMs;
+      if (drainAll)
+      {
+        // As CommsSerial::service
+        while (!rxRing.isFull() && !wire.empty())
+        {
+          rxRing.put(wire.front());
+          wire.pop_front();
+        }
+        if (!wire.empty() && rxRing.isFull())
+          result.overrun = true;
+        while (rxRing.hasLine())
+        {
+          unsigned int lineLen = 0;
+          unsigned int lineBytes = rxRing.peekLine(lineBuf, MAX_LINE_LEN, lineLen);
+          if (lineLen == 0)
+          {
+            rxRing.consume(lineBytes);
+            continue;
+          }
+          if (cmdQueue.size() >= CMD_QUEUE_LEN)
+            break;
+          rxRing.consume(lineBytes);
+          std::string expected = job[expectedLineIdx].substr(0, job[expectedLineIdx].length() - 1);
+          if (expected != lineBuf)
+            result.inOrder = false;
+          cmdQueue.push_back(expectedLineIdx++);
+          result.bytesDelivered += lineBytes;
+          result.linesDelivered++;
+          // Ack
+          result.acks++;
+          hostWindowUsed -= unackedLineLens.front();
+          unackedLineLens.pop_front();
+        }
+      }
+      else if (!wire.empty())
+      {
+        // Previous CommsSerial::service
+        char ch = wire.front();
+        wire.pop_front();
+        if (SerialLineRing::isLineEnd(ch))
+        {
+          if (curLine.length() > 0)
+          {
+            if (cmdQueue.size() < CMD_QUEUE_LEN)
+              cmdQueue.push_back(result.linesDelivered);
+            else
+              result.inOrder = false;
+            result.bytesDelivered += curLine.length() + 1;
+            result.linesDelivered++;
+          }
+          curLine = "";
+        }
+        else
+        {
+          curLine += ch;
+        }
+      }
+      if (cmdQueue.size() >= CMD_QUEUE_LEN)
+        queueEverFull = true;
+    }
+
+    // Done when all lines delivered
+    if (result.linesDelivered >= job.size())
+    {
+      result.elapsedMs = nowMs;
+      break;
+    }
+  }
+  return result;
+}
+
+static void testThroughput()
+{
+  std::vector<std::string> job = makeJob(2000);
+  unsigned long jobBytes = 0;
+  for (unsigned int i = 0; i < job.size(); i++)
+    jobBytes += job[i].length();
+  double lineRateMs = jobBytes / BAUD_BYTES_PER_MS;
+
+  // Fast planner so the link is the limit
+  StreamResult newResult = streamJob(job, 5, 0.1, true);
+  check(newResult.linesDelivered == job.size(), "all lines delivered");
+  check(newResult.acks == job.size(), "one ack per line");
+  check(newResult.inOrder, "lines delivered in order and intact");
+  check(!newResult.overrun, "ring never overrun");
+  double newBytesPerSec = newResult.bytesDelivered / newResult.elapsedMs * 1000;
+  check(newResult.elapsedMs < lineRateMs * 1.2, "throughput within 20% of the line rate");
+
+  // Previous ingestion (shorter job as it is slow)
+  std::vector<std::string> shortJob = makeJob(100);
+  StreamResult oldResult = streamJob(shortJob, 5, 0.1, false);
+  double oldBytesPerSec = oldResult.bytesDelivered / oldResult.elapsedMs * 1000;
+  check(oldBytesPerSec <= 1000 / 5.0 + 1, "previous ingestion limited to one char per loop");
+
+  printf("Line rate %.0f bytes/s\n", BAUD_BYTES_PER_MS * 1000);
+  printf("Drain all + char counting: %.0f bytes/s (%.0f lines/s)\n", newBytesPerSec,
+         newResult.linesDelivered / newResult.elapsedMs * 1000);
+  printf("One char per loop:         %.0f bytes/s (%.0f lines/s)\n", oldBytesPerSec,
+         oldResult.linesDelivered / oldResult.elapsedMs * 1000);
+}
+
+static void testSlowPlanner()
+{
+  // Planner slower than the link - flow control must hold the host back without losing lines
+  // and the command queue should stay fed
+  std::vector<std::string> job = makeJob(500);
+  StreamResult result = streamJob(job, 5, 20, true);
+  check(result.linesDelivered == job.size(), "slow planner all lines delivered");
+  check(result.inOrder, "slow planner lines in order");
+  check(!result.overrun, "slow planner ring never overrun");
+  check(result.queueStarvedSteps == 0, "slow planner queue never starved");
+  printf("Slow planner: %lu lines in %.0f ms, queue starved %lu steps\n", result.linesDelivered,
+         result.elapsedMs, result.queueStarvedSteps);
+}
+
+static void testLineRing()
+{
+  SerialLineRing ring(16);
+  char lineBuf[MAX_LINE_LEN + 1];
+  unsigned int lineLen = 0;
+  const char* pIn = "G28\r\nG1 X1\n";
+  for (const char* p = pIn; *p; p++)
+    check(ring.put(*p), "put within capacity");
+  check(ring.hasLine(), "line complete");
+  unsigned int lineBytes = ring.peekLine(lineBuf, MAX_LINE_LEN, lineLen);
+  check((lineBytes == 4) && (lineLen == 3) && (strcmp(lineBuf, "G28") == 0), "first line");
+  ring.consume(lineBytes);
+  // LF of CR LF is an empty line
+  lineBytes = ring.peekLine(lineBuf, MAX_LINE_LEN, lineLen);
+  check((lineBytes == 1) && (lineLen == 0), "empty line from CR LF");
+  ring.consume(lineBytes);
+  lineBytes = ring.peekLine(lineBuf, MAX_LINE_LEN, lineLen);
+  check((lineLen == 5) && (strcmp(lineBuf, "G1 X1") == 0), "second line");
+  ring.consume(lineBytes);
+  check(!ring.hasLine() && (ring.bytesUsed() == 0), "ring empty");
+
+  // Wrap and fill
+  for (int i = 0; i < 16; i++)
+    check(ring.put((i == 15) ? '\n' : char('A' + i)), "fill");
+  check(ring.isFull() && !ring.put('X'), "full ring rejects put");
+  lineBytes = ring.peekLine(lineBuf, 4, lineLen);
+  check((lineBytes == 16) && (lineLen == 4) && (strcmp(lineBuf, "ABCD") == 0), "long line truncated to max");
+  check(lineBytes > lineLen + 1, "truncation detectable from line bytes");
+
+  // Removing the bytes of a partly received line (e.g. an immediate command or a line which
+  // overflowed) leaves the complete lines before it
+  ring.consume(lineBytes);
+  const char* pPart = "G1 X2\nsto";
+  for (const char* p = pPart; *p; p++)
+    ring.put(*p);
+  check(ring.unput(3) == 3, "unput partial line");
+  check(ring.hasLine() && (ring.bytesUsed() == 6), "complete line kept after unput");
+  lineBytes = ring.peekLine(lineBuf, MAX_LINE_LEN, lineLen);
+  check((lineBytes == 6) && (strcmp(lineBuf, "G1 X2") == 0), "line after unput");
+  check((ring.unput(10) == 6) && !ring.hasLine() && (ring.bytesUsed() == 0), "unput line end");
+}
+
+int main()
+{
+  testLineRing();
+  testThroughput();
+  testSlowPlanner();
+  if (failCount != 0)
+  {
+    printf("%d checks FAILED\n", failCount);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}